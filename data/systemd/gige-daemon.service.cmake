@@ -7,6 +7,8 @@ After=network.target
 Type=simple
 ExecStart=@CMAKE_INSTALL_PREFIX@/bin/gige-daemon start --no-fork
 ExecStop=@CMAKE_INSTALL_PREFIX@/bin/gige-daemon stop
+RuntimeDirectory=tcam-gige-daemon
+RuntimeDirectoryMode=0755
 
 [Install]
 WantedBy=multi-user.target
@@ -24,6 +24,9 @@
 #include <algorithm>
 #include <cstring>
 #include <cmath>
+#include <functional>
+#include <map>
+#include <mutex>
 
 
 using namespace tcam;
@@ -100,7 +103,23 @@ AravisDevice::AravisDevice (const DeviceInfo& device_desc)
     handler = std::make_shared<AravisPropertyHandler>(this);
     format_handler = std::make_shared<AravisFormatHandler>(this);
 
-    index_genicam();
+    genicam = arv_device_get_genicam(arv_camera_get_device(this->arv_camera));
+
+    auto cache = create_cache_entry();
+
+    layout_key = cache.model + "/" + cache.firmware;
+    for (const auto& s : cache.signature)
+    {
+        layout_key += "/" + std::to_string(s);
+    }
+
+    if (!restore_from_cache(cache))
+    {
+        index_genicam();
+        index_feature_access();
+
+        store_in_cache(cache);
+    }
     determine_active_video_format();
 }
 
@@ -270,16 +289,608 @@ bool AravisDevice::set_property (const Property& p)
             break;
         }
     }
+
+    // aravis does not expose which features are invalidated by a write
+    invalidate_feature_values();
+
     return true;
 }
 
 
-bool AravisDevice::get_property (Property&)
+bool AravisDevice::get_property (Property& p)
 {
+    auto f = [&p] (const property_mapping& m)
+        {
+            return p.get_name().compare(m.prop->get_name()) == 0;
+        };
+
+    auto pm = std::find_if(handler->properties.begin(), handler->properties.end(), f);
+
+    if (pm == handler->properties.end())
+    {
+        return false;
+    }
+
+    if (!pm->is_valid || is_volatile(*pm))
+    {
+        if (!read_features({&*pm}))
+        {
+            return false;
+        }
+    }
+
+    p.set_struct(pm->prop->get_struct());
+
+    return true;
+}
+
+
+bool AravisDevice::update_properties (const std::vector<TCAM_PROPERTY_ID>& ids)
+{
+    std::vector<property_mapping*> mappings;
+
+    for (auto& m : handler->properties)
+    {
+        if (!ids.empty() && std::find(ids.begin(), ids.end(), m.prop->get_ID()) == ids.end())
+        {
+            continue;
+        }
+
+        // values that can only change by being written are served from the cache
+        if (m.is_valid && !is_volatile(m))
+        {
+            continue;
+        }
+
+        mappings.push_back(&m);
+    }
+
+    // values of features that could not be read stay at their last known state
+    return read_features(mappings);
+}
+
+
+//// feature value cache
+
+// cameras with the same genicam description share their register layout,
+// registers verified on one device are used directly by the next one
+struct known_register
+{
+    uint64_t address;
+    bool big_endian;
+};
+
+static std::mutex known_registers_mtx;
+static std::map<std::string, std::map<std::string, known_register>> known_registers;
+
+
+static void set_integer_value (struct tcam_device_property& s, int64_t value)
+{
+    if (s.type == TCAM_PROPERTY_TYPE_DOUBLE)
+    {
+        s.value.d.value = value;
+    }
+    else if (s.type == TCAM_PROPERTY_TYPE_BOOLEAN)
+    {
+        s.value.b.value = (value != 0);
+    }
+    else
+    {
+        s.value.i.value = value;
+    }
+}
+
+
+static int64_t get_integer_value (const struct tcam_device_property& s)
+{
+    if (s.type == TCAM_PROPERTY_TYPE_DOUBLE)
+    {
+        return s.value.d.value;
+    }
+    else if (s.type == TCAM_PROPERTY_TYPE_BOOLEAN)
+    {
+        return s.value.b.value ? 1 : 0;
+    }
+    return s.value.i.value;
+}
+
+
+static int64_t decode_register (uint32_t raw, bool big_endian, bool is_signed)
+{
+    uint32_t value = big_endian ? raw : GUINT32_SWAP_LE_BE(raw);
+
+    if (is_signed)
+    {
+        return (int32_t)value;
+    }
+    return value;
+}
+
+
+static bool is_signed_value (const struct tcam_device_property& s)
+{
+    return s.type == TCAM_PROPERTY_TYPE_INTEGER && s.value.i.min < 0;
+}
+
+
+/**
+ * SFNC names the auto feature after the feature it controls,
+ * e.g. ExposureTimeAbs -> ExposureAuto, GainRaw -> GainAuto
+ */
+static std::string get_auto_feature_name (const std::string& feature)
+{
+    if (feature.compare(0, 7, "Balance") == 0)
+    {
+        return "BalanceWhiteAuto";
+    }
+
+    std::string name = feature;
+
+    for (const std::string suffix : { "Abs", "Raw", "Time" })
+    {
+        if (name.size() > suffix.size()
+            && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+        {
+            name.erase(name.size() - suffix.size());
+        }
+    }
+
+    return name + "Auto";
+}
+
+
+static bool has_child_node (ArvGcNode* node, const char* name)
+{
+    for (ArvDomNode* child = arv_dom_node_get_first_child(ARV_DOM_NODE(node));
+         child != NULL;
+         child = arv_dom_node_get_next_sibling(child))
+    {
+        if (strcmp(arv_dom_node_get_node_name(child), name) == 0)
+        {
+            return true;
+        }
+    }
     return false;
 }
 
 
+void AravisDevice::index_feature_access ()
+{
+    // features whose values change on their own
+    static std::vector<std::string> volatile_features = { "Temperature",
+                                                          "Timestamp",
+                                                          "Counter",
+                                                          "Status" };
+
+    std::map<std::string, known_register> known;
+    {
+        std::lock_guard<std::mutex> lck(known_registers_mtx);
+
+        auto k = known_registers.find(layout_key);
+        if (k != known_registers.end())
+        {
+            known = k->second;
+        }
+    }
+
+    auto& props = handler->properties;
+
+    for (unsigned int i = 0; i < props.size(); ++i)
+    {
+        auto& m = props[i];
+
+        for (const auto& v : volatile_features)
+        {
+            if (m.arv_ident.find(v) != std::string::npos)
+            {
+                m.always_volatile = true;
+            }
+        }
+
+        std::string auto_name = get_auto_feature_name(m.arv_ident);
+
+        auto f = [&auto_name] (const property_mapping& p)
+            {
+                return p.arv_ident == auto_name;
+            };
+
+        auto a = std::find_if(props.begin(), props.end(), f);
+
+        if (a != props.end() && a != props.begin() + i)
+        {
+            m.auto_index = a - props.begin();
+            a->is_auto = true;
+        }
+
+        auto value_type = m.prop->get_value_type();
+
+        if (value_type != Property::INTEGER && value_type != Property::BOOLEAN)
+        {
+            continue;
+        }
+
+        auto k = known.find(m.arv_ident);
+
+        if (k != known.end())
+        {
+            m.address = k->second.address;
+            m.order = k->second.big_endian ? ORDER_BIG_ENDIAN : ORDER_LITTLE_ENDIAN;
+        }
+        else
+        {
+            m.address = find_register_address(m.arv_ident);
+        }
+    }
+}
+
+
+uint64_t AravisDevice::find_register_address (const std::string& feature)
+{
+    ArvGcNode* node = arv_gc_get_node(genicam, feature.c_str());
+
+    if (node == NULL)
+    {
+        return 0;
+    }
+
+    ArvGcNode* reg = NULL;
+
+    if (strcmp(arv_dom_node_get_node_name(ARV_DOM_NODE(node)), "IntReg") == 0)
+    {
+        reg = node;
+    }
+    else
+    {
+        for (ArvDomNode* child = arv_dom_node_get_first_child(ARV_DOM_NODE(node));
+             child != NULL;
+             child = arv_dom_node_get_next_sibling(child))
+        {
+            if (ARV_IS_GC_PROPERTY_NODE(child)
+                && strcmp(arv_dom_node_get_node_name(child), "pValue") == 0)
+            {
+                reg = arv_gc_property_node_get_linked_node(ARV_GC_PROPERTY_NODE(child));
+                break;
+            }
+        }
+    }
+
+    // masked registers and registers with selector dependent addresses
+    // can not be decoded from the raw content
+    if (reg == NULL
+        || !ARV_IS_GC_REGISTER(reg)
+        || strcmp(arv_dom_node_get_node_name(ARV_DOM_NODE(reg)), "IntReg") != 0
+        || has_child_node(reg, "pAddress")
+        || has_child_node(reg, "pIndex"))
+    {
+        return 0;
+    }
+
+    GError* error = NULL;
+
+    guint64 length = arv_gc_register_get_length(ARV_GC_REGISTER(reg), &error);
+    guint64 address = 0;
+
+    if (error == NULL)
+    {
+        address = arv_gc_register_get_address(ARV_GC_REGISTER(reg), &error);
+    }
+
+    if (error != NULL)
+    {
+        tcam_log(TCAM_LOG_DEBUG, "Unable to query register of '%s': %s", feature.c_str(), error->message);
+        g_error_free(error);
+        return 0;
+    }
+
+    // blocks are read in aligned 32 bit units
+    if (length != 4 || address % 4 != 0)
+    {
+        return 0;
+    }
+
+    return address;
+}
+
+
+bool AravisDevice::is_auto_active (const property_mapping& m) const
+{
+    if (!m.is_valid)
+    {
+        return true;
+    }
+
+    auto s = m.prop->get_struct();
+
+    switch (s.type)
+    {
+        case TCAM_PROPERTY_TYPE_ENUMERATION:
+            return static_cast<PropertyEnumeration&>(*m.prop).get_value().compare("Off") != 0;
+        case TCAM_PROPERTY_TYPE_BOOLEAN:
+            return s.value.b.value;
+        case TCAM_PROPERTY_TYPE_INTEGER:
+            return s.value.i.value != 0;
+        default:
+            return false;
+    }
+}
+
+
+bool AravisDevice::is_volatile (const property_mapping& m) const
+{
+    if (m.always_volatile)
+    {
+        return true;
+    }
+
+    // auto features may switch themselves off, e.g. 'Once'
+    if (m.is_auto && is_auto_active(m))
+    {
+        return true;
+    }
+
+    return m.auto_index >= 0 && is_auto_active(handler->properties.at(m.auto_index));
+}
+
+
+void AravisDevice::invalidate_feature_values ()
+{
+    for (auto& m : handler->properties)
+    {
+        m.is_valid = false;
+    }
+}
+
+
+bool AravisDevice::read_features (const std::vector<property_mapping*>& mappings)
+{
+    std::vector<uint64_t> addresses;
+
+    // unverified registers are read as well to compare them with the aravis value
+    for (const auto m : mappings)
+    {
+        if (m->address != 0)
+        {
+            addresses.push_back(m->address);
+        }
+    }
+
+    auto registers = read_register_blocks(addresses);
+
+    bool ret = true;
+
+    for (auto m : mappings)
+    {
+        auto reg = registers.end();
+
+        if (m->address != 0)
+        {
+            reg = registers.find(m->address);
+        }
+
+        if (reg != registers.end() && m->order != ORDER_UNKNOWN)
+        {
+            auto s = m->prop->get_struct();
+
+            set_integer_value(s, decode_register(reg->second,
+                                                 m->order == ORDER_BIG_ENDIAN,
+                                                 is_signed_value(s)));
+
+            apply_feature_value(*m, s);
+            continue;
+        }
+
+        if (!read_feature(*m))
+        {
+            ret = false;
+            continue;
+        }
+
+        if (reg != registers.end())
+        {
+            verify_register(*m, reg->second);
+        }
+    }
+
+    return ret;
+}
+
+
+bool AravisDevice::read_feature (property_mapping& m)
+{
+    auto dev = arv_camera_get_device(arv_camera);
+
+    auto s = m.prop->get_struct();
+    const char* ident = m.arv_ident.c_str();
+
+    switch (m.prop->get_value_type())
+    {
+        case Property::INTEGER:
+        case Property::INTSWISSKNIFE:
+        case Property::BOOLEAN:
+        {
+            set_integer_value(s, arv_device_get_integer_feature_value(dev, ident));
+            break;
+        }
+        case Property::FLOAT:
+        {
+            double value = arv_device_get_float_feature_value(dev, ident);
+
+            if (s.type == TCAM_PROPERTY_TYPE_DOUBLE)
+            {
+                s.value.d.value = value;
+            }
+            else
+            {
+                s.value.i.value = value;
+            }
+            break;
+        }
+        case Property::ENUM:
+        {
+            if (s.type == TCAM_PROPERTY_TYPE_ENUMERATION)
+            {
+                const char* value = arv_device_get_string_feature_value(dev, ident);
+
+                if (value == nullptr)
+                {
+                    return false;
+                }
+
+                auto mapping = static_cast<PropertyEnumeration&>(*m.prop).get_mapping();
+                auto entry = mapping.find(value);
+
+                if (entry == mapping.end())
+                {
+                    return false;
+                }
+                s.value.i.value = entry->second;
+            }
+            else if (s.type == TCAM_PROPERTY_TYPE_BOOLEAN)
+            {
+                s.value.b.value = (arv_device_get_integer_feature_value(dev, ident) != 0);
+            }
+            else
+            {
+                s.value.i.value = arv_device_get_integer_feature_value(dev, ident);
+            }
+            break;
+        }
+        default:
+        {
+            // commands have no value
+            m.is_valid = true;
+            return true;
+        }
+    }
+
+
+    apply_feature_value(m, s);
+
+    return true;
+}
+
+
+void AravisDevice::apply_feature_value (property_mapping& m, const struct tcam_device_property& s)
+{
+    // aravis offers no event channel for feature changes,
+    // so changes are detected when values are refreshed
+    auto current = m.prop->get_struct();
+    bool changed = (memcmp(&s.value, &current.value, sizeof(s.value)) != 0);
+
+    m.prop->set_struct_value(s);
+    m.is_valid = true;
+
+    if (changed)
+    {
+        notify_property_change(*m.prop);
+    }
+}
+
+
+void AravisDevice::verify_register (property_mapping& m, uint32_t raw)
+{
+    // values like 0 look the same in both byte orders
+    static const unsigned int max_verify_attempts = 5;
+
+    auto s = m.prop->get_struct();
+    int64_t value = get_integer_value(s);
+
+    bool big = (decode_register(raw, true, is_signed_value(s)) == value);
+    bool little = (decode_register(raw, false, is_signed_value(s)) == value);
+
+    if (big != little)
+    {
+        m.order = big ? ORDER_BIG_ENDIAN : ORDER_LITTLE_ENDIAN;
+
+        std::lock_guard<std::mutex> lck(known_registers_mtx);
+
+        known_registers[layout_key][m.arv_ident] = { m.address, big };
+        return;
+    }
+
+    if ((!big && !little) || ++m.verify_attempts >= max_verify_attempts)
+    {
+        // value is not the plain register content
+        m.address = 0;
+    }
+}
+
+
+std::map<uint64_t, uint32_t> AravisDevice::read_register_blocks (std::vector<uint64_t> addresses)
+{
+    // only adjacent registers are combined; addresses no feature owns may have
+    // side effects on read or be refused by the device
+    static const uint64_t register_size = 4;
+    // stays within a single GVCP READMEM answer
+    static const uint64_t max_block_size = 512;
+
+    std::map<uint64_t, uint32_t> values;
+
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+
+    auto dev = arv_camera_get_device(arv_camera);
+
+    auto isolated = [this] (uint64_t address)
+        {
+            return isolated_registers.count(address) > 0;
+        };
+
+    auto begin = addresses.begin();
+
+    while (begin != addresses.end())
+    {
+        auto end = begin + 1;
+
+        while (!isolated(*begin)
+               && end != addresses.end()
+               && !isolated(*end)
+               && *end == *(end - 1) + register_size
+               && *end + register_size - *begin <= max_block_size)
+        {
+            ++end;
+        }
+
+        uint64_t start = *begin;
+        std::vector<uint8_t> block(*(end - 1) + register_size - start);
+
+        GError* error = NULL;
+
+        if (arv_device_read_memory(dev, start, block.size(), block.data(), &error))
+        {
+            for (auto a = begin; a != end; ++a)
+            {
+                const uint8_t* b = &block[*a - start];
+
+                values[*a] = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+            }
+        }
+        else
+        {
+            // features of this block fall back to single reads
+            tcam_log(TCAM_LOG_DEBUG, "Unable to read registers 0x%llx - 0x%llx: %s",
+                     (unsigned long long)start, (unsigned long long)(start + block.size()),
+                     error != NULL ? error->message : "");
+            if (error != NULL)
+            {
+                g_error_free(error);
+            }
+
+            // the device may refuse reads spanning several registers;
+            // do not let one refused block fail every following refresh
+            if (end - begin > 1)
+            {
+                isolated_registers.insert(begin, end);
+            }
+        }
+
+        begin = end;
+    }
+
+    return values;
+}
+
+
 bool AravisDevice::set_video_format (const VideoFormat& new_format)
 {
     // bool valid = false;
@@ -312,6 +923,9 @@ bool AravisDevice::set_video_format (const VideoFormat& new_format)
                           offset_x, offset_y,
                           new_format.get_size().width, new_format.get_size().height);
 
+    // limits and values like the exposure range depend on the format
+    invalidate_feature_values();
+
     determine_active_video_format();
 
     return true;
@@ -625,6 +1239,98 @@ void AravisDevice::index_genicam ()
 }
 
 
+device_cache_entry AravisDevice::create_cache_entry ()
+{
+    device_cache_entry entry = {};
+
+    entry.model = device.get_info().name;
+    entry.serial = device.get_info().serial_number;
+
+    auto dev = arv_camera_get_device(this->arv_camera);
+
+    const char* version = arv_device_get_string_feature_value(dev, "DeviceVersion");
+
+    if (version != nullptr)
+    {
+        entry.firmware = version;
+    }
+
+    // aravis already downloaded the xml, comparing it costs no register reads
+    size_t xml_size = 0;
+    const char* xml = arv_device_get_genicam_xml(dev, &xml_size);
+
+    if (xml != nullptr)
+    {
+        uint64_t hash = std::hash<std::string>()(std::string(xml, xml_size));
+
+        entry.signature.push_back(xml_size);
+        entry.signature.push_back(hash & 0xffffffff);
+        entry.signature.push_back(hash >> 32);
+    }
+
+    return entry;
+}
+
+
+bool AravisDevice::restore_from_cache (device_cache_entry entry)
+{
+    if (!load_device_cache("aravis", entry))
+    {
+        return false;
+    }
+
+    std::vector<property_mapping> props;
+
+    for (const auto& c : entry.properties)
+    {
+        property_mapping m;
+
+        m.arv_ident = c.identifier;
+        m.prop = restore_cached_property(c, handler);
+
+        if (m.prop == nullptr)
+        {
+            return false;
+        }
+
+        props.push_back(m);
+    }
+
+    handler->properties = props;
+
+    index_feature_access();
+
+    // cached values are outdated
+    update_properties({});
+
+    for (const auto& f : entry.formats)
+    {
+        this->available_videoformats.push_back(VideoFormatDescription(format_handler, f.desc, f.resolutions));
+    }
+
+    tcam_log(TCAM_LOG_DEBUG, "Restored %zu properties and %zu formats from device cache",
+             entry.properties.size(), entry.formats.size());
+
+    return true;
+}
+
+
+void AravisDevice::store_in_cache (device_cache_entry entry)
+{
+    for (const auto& m : handler->properties)
+    {
+        entry.properties.push_back(create_cached_property(*m.prop, 0, m.arv_ident));
+    }
+
+    for (const auto& f : available_videoformats)
+    {
+        entry.formats.push_back(create_cached_format(f));
+    }
+
+    store_device_cache("aravis", entry);
+}
+
+
 void AravisDevice::iterate_genicam (const char* feature)
 {
 
@@ -756,6 +1462,9 @@ void AravisDevice::iterate_genicam (const char* feature)
                 return;
             }
 
+            // create_property read the current value
+            m.is_valid = true;
+
             handler->properties.push_back(m);
         }
     }
@@ -19,9 +19,12 @@
 
 #include "DeviceInterface.h"
 #include "FormatHandlerInterface.h"
+#include "DeviceCache.h"
 
 #include <arv.h>
 
+#include <set>
+
 VISIBILITY_INTERNAL
 
 namespace tcam
@@ -29,10 +32,33 @@ namespace tcam
 
 class AravisDevice : public DeviceInterface
 {
+    enum register_order
+    {
+        ORDER_UNKNOWN = 0,
+        ORDER_BIG_ENDIAN,
+        ORDER_LITTLE_ENDIAN,
+    };
+
     struct property_mapping
     {
         std::shared_ptr<Property> prop;
         std::string arv_ident;
+
+        // prop contains the current device value
+        bool is_valid = false;
+
+        // value changes without being written, e.g. temperature
+        bool always_volatile = false;
+        // feature is the auto counterpart of other features
+        bool is_auto = false;
+        // index of the auto feature that controls this one; -1 if none
+        int auto_index = -1;
+
+        // address of the plain 32 bit register backing the feature; 0 if none
+        uint64_t address = 0;
+        // ORDER_UNKNOWN until register content and feature value were compared
+        register_order order = ORDER_UNKNOWN;
+        unsigned int verify_attempts = 0;
     };
 
     class AravisPropertyHandler : public PropertyImpl
@@ -79,6 +105,8 @@ public:
 
     bool get_property (Property&);
 
+    bool update_properties (const std::vector<TCAM_PROPERTY_ID>& ids);
+
     bool set_video_format (const VideoFormat&);
 
     VideoFormat get_active_video_format () const;
@@ -142,12 +170,90 @@ private:
     // found nodes that contain format information
     std::vector<ArvGcNode*> format_nodes;
 
+    // identifies the genicam description; devices with the same key share register layouts
+    std::string layout_key;
+
+    // registers of blocks the device refused to read as a whole;
+    // read on their own so that no address outside of a feature is accessed
+    std::set<uint64_t> isolated_registers;
+
     void determine_active_video_format ();
 
     void index_genicam ();
     void iterate_genicam (const char* feature);
     void index_genicam_format (ArvGcNode* /* node */ );
 
+    /**
+     * @brief Describe the device for the device cache
+     *
+     * Uses the already loaded genicam xml; no feature is read besides DeviceVersion.
+     * @return entry containing key and signature of the device
+     */
+    device_cache_entry create_cache_entry ();
+
+    /**
+     * @brief Restore properties and formats from the device cache
+     * @param entry - entry returned by create_cache_entry
+     * @return true if a valid cache entry was used; false if indexing is required
+     */
+    bool restore_from_cache (device_cache_entry entry);
+
+    void store_in_cache (device_cache_entry entry);
+
+    /**
+     * @brief Determine which features have to be reread and which can be read in blocks
+     *
+     * Has to be called after handler->properties has been filled.
+     */
+    void index_feature_access ();
+
+    /**
+     * @brief Find the plain register that backs a feature
+     * @param feature - genicam feature name
+     * @return register address; 0 if the feature can not be read as a plain register
+     */
+    uint64_t find_register_address (const std::string& feature);
+
+    bool is_auto_active (const property_mapping& m) const;
+
+    /**
+     * @return true if the cached value of m may be outdated without m having been written
+     */
+    bool is_volatile (const property_mapping& m) const;
+
+    void invalidate_feature_values ();
+
+    /**
+     * @brief Refresh the given features
+     *
+     * Features with a known register are read in blocks of adjacent registers,
+     * all other features are read individually through aravis.
+     * @return false if a feature could not be read
+     */
+    bool read_features (const std::vector<property_mapping*>& mappings);
+
+    bool read_feature (property_mapping& m);
+
+    void apply_feature_value (property_mapping& m, const struct tcam_device_property& s);
+
+    /**
+     * @brief Compare register content with the value aravis delivered
+     *
+     * The register is used for further reads once the byte order is unambiguous.
+     */
+    void verify_register (property_mapping& m, uint32_t raw);
+
+    /**
+     * @brief Read 32 bit registers with as few requests as possible
+     *
+     * Only registers at adjacent addresses share a request, no unused address
+     * is read. Registers of a block that failed are afterwards read one at a time.
+     * @param addresses - register addresses that shall be read
+     * @return map of address and register content in big endian interpretation;
+     *         registers of failed requests are missing
+     */
+    std::map<uint64_t, uint32_t> read_register_blocks (std::vector<uint64_t> addresses);
+
 }; /* class GigeCapture */
 
 } /* namespace tcam */
@@ -19,6 +19,7 @@
 #include <dlfcn.h>
 
 #include <string>
+#include <future>
 
 #include "internal.h"
 #include "devicelibrary.h"
@@ -33,7 +34,14 @@ tcam::BackendLoader& tcam::BackendLoader::getInstance ()
 
 tcam::BackendLoader::BackendLoader ()
 {
-    load_backends();
+    // libraries are opened on first use
+    // to not initialize backends the application never needs
+    backends =
+        {
+            {TCAM_DEVICE_TYPE_V4L2,    "libtcam-v4l2.so",   nullptr, false, nullptr, nullptr, nullptr},
+            {TCAM_DEVICE_TYPE_ARAVIS,  "libtcam-aravis.so", nullptr, false, nullptr, nullptr, nullptr},
+            {TCAM_DEVICE_TYPE_UNKNOWN, "none",              nullptr, false, nullptr, nullptr, nullptr}
+        };
 }
 
 
@@ -61,48 +69,64 @@ std::function<T> load(void* handle, std::string const& functionName)
 }
 
 
-void tcam::BackendLoader::load_backends ()
+tcam::BackendLoader::backend* tcam::BackendLoader::get_backend (enum TCAM_DEVICE_TYPE type)
 {
-
-    backends =
-        {
-            {TCAM_DEVICE_TYPE_V4L2,    "libtcam-v4l2.so",   nullptr, nullptr, nullptr, nullptr},
-            {TCAM_DEVICE_TYPE_ARAVIS,  "libtcam-aravis.so", nullptr, nullptr, nullptr, nullptr},
-            {TCAM_DEVICE_TYPE_UNKNOWN, "none",              nullptr, nullptr, nullptr, nullptr}
-        };
+    std::lock_guard<std::mutex> lck(mtx);
 
     for (auto& b : backends)
     {
-        if (b.type == TCAM_DEVICE_TYPE_UNKNOWN)
+        if (b.type != type || b.type == TCAM_DEVICE_TYPE_UNKNOWN)
         {
             continue;
         }
-        void* handle = dlopen(b.name.c_str(), RTLD_LAZY);
 
-        if (handle == nullptr)
+        // only try once; a missing library will not appear later on
+        if (!b.load_attempted)
         {
-            tcam_log(TCAM_LOG_INFO, "Could not load backend %s", b.name.c_str());
-            continue;
+            b.load_attempted = true;
+            load_backend(b);
         }
-        b.handle = handle;
 
-        auto i = load<struct libinfo_v1*()>(b.handle, "get_library_functions_v1");
+        if (b.handle == nullptr)
+        {
+            return nullptr;
+        }
+        return &b;
+    }
+
+    return nullptr;
+}
+
+
+void tcam::BackendLoader::load_backend (backend& b)
+{
+    void* handle = dlopen(b.name.c_str(), RTLD_LAZY);
 
-        auto info = (i)();
+    if (handle == nullptr)
+    {
+        tcam_log(TCAM_LOG_INFO, "Could not load backend %s", b.name.c_str());
+        return;
+    }
+    b.handle = handle;
 
+    auto i = load<struct libinfo_v1*()>(b.handle, "get_library_functions_v1");
 
-        auto f = std::function<tcam::DeviceInterface*(const struct tcam_device_info*)>(info->open_device);
-        b.open_device = f;
+    auto info = (i)();
 
 
-        auto fls = std::function<size_t()>(info->get_device_list_size);
-        b.get_device_list_size = fls;
+    auto f = std::function<tcam::DeviceInterface*(const struct tcam_device_info*)>(info->open_device);
+    b.open_device = f;
 
-        auto fl = std::function<size_t(struct tcam_device_info*, size_t)>(info->get_device_list);
-        b.get_device_list = fl;
 
-        delete info;
-    }
+    auto fls = std::function<size_t()>(info->get_device_list_size);
+    b.get_device_list_size = fls;
+
+    auto fl = std::function<size_t(struct tcam_device_info*, size_t)>(info->get_device_list);
+    b.get_device_list = fl;
+
+    delete info;
+
+    tcam_log(TCAM_LOG_DEBUG, "Loaded backend %s", b.name.c_str());
 }
 
 
@@ -123,93 +147,104 @@ void tcam::BackendLoader::unload_backends ()
 
 std::shared_ptr<DeviceInterface> tcam::BackendLoader::open_device (const tcam::DeviceInfo& device)
 {
+    if (device.get_device_type() == TCAM_DEVICE_TYPE_UNKNOWN)
+    {
+        throw std::runtime_error("Unsupported device");
+    }
 
-    auto search = [this] (TCAM_DEVICE_TYPE type)
-        {
-            for (auto& b : this->backends)
-            {
-                if (b.type == type)
-                    return b;
-            }
-            return this->backends.back();
-        };
-
-    auto b = search(device.get_device_type());
+    auto b = get_backend(device.get_device_type());
 
-    if (b.type == TCAM_DEVICE_TYPE_UNKNOWN)
+    if (b == nullptr)
     {
         throw std::runtime_error("Unsupported device");
     }
 
     auto dev = device.get_info();
 
-    return std::shared_ptr<DeviceInterface>(b.open_device(&dev));
+    return std::shared_ptr<DeviceInterface>(b->open_device(&dev));
 }
 
 
-std::vector<DeviceInfo> BackendLoader::get_device_list_all_backends ()
+std::vector<DeviceInfo> BackendLoader::query_backend (backend& b)
 {
     std::vector<DeviceInfo> ret;
-    for (auto& b : backends)
-    {
-        if (b.get_device_list != nullptr)
-        {
-
-            // std::vector<struct tcam_device_info> v;
-
-            size_t v_size = b.get_device_list_size();
 
-            if (v_size == 0)
-            {
-                continue;
-            }
+    // every call of a backend enumerates all devices,
+    // which means a full network discovery for aravis.
+    // Try to get along with one call and only ask for
+    // the size when the guessed capacity was too small.
+    std::vector<struct tcam_device_info> v(64);
 
+    auto copied_elements = b.get_device_list(v.data(), v.size());
 
-            struct tcam_device_info v[v_size];
-
-            // v.reserve(v_size);
+    if (copied_elements == 0)
+    {
+        size_t v_size = b.get_device_list_size();
 
-            // auto vec =
-            auto copied_elements = b.get_device_list(v, v_size);
+        if (v_size <= v.size())
+        {
+            return ret;
+        }
 
-            ret.reserve(copied_elements);
-            for (const auto& info : v)
-            {
-                ret.push_back(DeviceInfo(info));
-            }
+        v.resize(v_size);
+        copied_elements = b.get_device_list(v.data(), v.size());
+    }
 
-        }
+    ret.reserve(copied_elements);
+    for (size_t i = 0; i < copied_elements && i < v.size(); ++i)
+    {
+        ret.push_back(DeviceInfo(v[i]));
     }
 
     return ret;
 }
 
 
+std::vector<DeviceInfo> BackendLoader::get_device_list_all_backends ()
+{
+    return get_device_list({TCAM_DEVICE_TYPE_V4L2, TCAM_DEVICE_TYPE_ARAVIS});
+}
+
+
 std::vector<DeviceInfo> BackendLoader::get_device_list (enum TCAM_DEVICE_TYPE type)
 {
-    std::vector<DeviceInfo> ret;
+    auto b = get_backend(type);
 
-    for (auto& b : backends)
+    if (b == nullptr || b->get_device_list == nullptr)
     {
-        if (b.type == type && b.get_device_list != nullptr)
-        {
-            std::vector<struct tcam_device_info> v;
+        return std::vector<DeviceInfo>();
+    }
 
-            size_t v_size = 10;
+    return query_backend(*b);
+}
 
-            v.reserve(v_size);
 
+std::vector<DeviceInfo> BackendLoader::get_device_list (const std::vector<enum TCAM_DEVICE_TYPE>& types)
+{
+    if (types.size() == 1)
+    {
+        return get_device_list(types.front());
+    }
 
-            // auto vec =
-            auto copied_elements = b.get_device_list(v.data(), v.size());
+    // network discovery blocks for its timeout,
+    // usb enumeration shall not wait for it
+    std::vector<std::future<std::vector<DeviceInfo>>> queries;
 
-            ret.reserve(copied_elements);
-            for (const auto& info : v)
-            {
-                ret.push_back(DeviceInfo(info));
-            }
+    for (const auto& t : types)
+    {
+        queries.push_back(std::async(std::launch::async,
+                                     [this, t] ()
+                                     {
+                                         return this->get_device_list(t);
+                                     }));
+    }
 
-        }
+    std::vector<DeviceInfo> ret;
+
+    for (auto& q : queries)
+    {
+        auto list = q.get();
+        ret.insert(ret.end(), list.begin(), list.end());
     }
 
     return ret;
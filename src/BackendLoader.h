@@ -21,6 +21,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
 
 #include "base_types.h"
 
@@ -43,6 +44,7 @@ private:
         enum TCAM_DEVICE_TYPE type;
         std::string name;
         void* handle;
+        bool load_attempted;
 
         // std::function<std::vector<DeviceInfo>()> get_device_list;
         // std::function<std::shared_ptr<DeviceInterface>(const DeviceInfo&)> open_device;
@@ -53,11 +55,21 @@ private:
 
     std::vector<backend> backends;
 
-    void load_backends ();
+    // guards the lazy loading of backends
+    std::mutex mtx;
 
+    /**
+     * @brief Retrieve backend for device type; loads the library on first use
+     * @return pointer to the loaded backend; nullptr if not available
+     */
+    backend* get_backend (enum TCAM_DEVICE_TYPE);
+
+    void load_backend (backend&);
 
     void unload_backends ();
 
+    std::vector<DeviceInfo> query_backend (backend&);
+
 public:
 
     static BackendLoader& getInstance ();
@@ -68,6 +80,16 @@ public:
 
     std::vector<DeviceInfo> get_device_list (enum TCAM_DEVICE_TYPE);
 
+    /**
+     * @brief Enumerate devices of several backends
+     *
+     * Only the required backends are loaded.
+     * Multiple backends are queried concurrently.
+     * @param types - device types that shall be enumerated
+     * @return devices in the order of the given types
+     */
+    std::vector<DeviceInfo> get_device_list (const std::vector<enum TCAM_DEVICE_TYPE>& types);
+
 }; /* class BackendLoader*/
 
 
@@ -23,6 +23,7 @@
 #include "serialization.h"
 
 #include "CaptureDeviceImpl.h"
+#include "DeviceOpener.h"
 
 using namespace tcam;
 
@@ -73,6 +74,30 @@ std::vector<Property*> CaptureDevice::get_available_properties ()
 }
 
 
+std::vector<struct tcam_device_property> CaptureDevice::get_property_snapshot ()
+{
+    return impl->get_property_snapshot(std::vector<TCAM_PROPERTY_ID>());
+}
+
+
+std::vector<struct tcam_device_property> CaptureDevice::get_property_snapshot (const std::vector<TCAM_PROPERTY_ID>& ids)
+{
+    return impl->get_property_snapshot(ids);
+}
+
+
+bool CaptureDevice::register_property_callback (property_callback callback, void* user_data)
+{
+    return impl->register_property_callback(callback, user_data);
+}
+
+
+void CaptureDevice::remove_property_callback (property_callback callback)
+{
+    impl->remove_property_callback(callback);
+}
+
+
 Property* CaptureDevice::get_property (TCAM_PROPERTY_ID id)
 {
     auto properties = get_available_properties();
@@ -110,6 +135,8 @@ Property* CaptureDevice::get_property_by_name (const std::string& name)
 
 bool CaptureDevice::set_property (TCAM_PROPERTY_ID id, const int64_t& value)
 {
+    std::lock_guard<std::recursive_mutex> lck(impl->get_property_mutex());
+
     auto vec = get_available_properties();
 
     for (const auto& v : vec)
@@ -129,6 +156,8 @@ bool CaptureDevice::set_property (TCAM_PROPERTY_ID id, const int64_t& value)
 
 bool CaptureDevice::set_property (TCAM_PROPERTY_ID id, const double& value)
 {
+    std::lock_guard<std::recursive_mutex> lck(impl->get_property_mutex());
+
     auto vec = get_available_properties();
 
     for (const auto& v : vec)
@@ -148,6 +177,8 @@ bool CaptureDevice::set_property (TCAM_PROPERTY_ID id, const double& value)
 
 bool CaptureDevice::set_property (TCAM_PROPERTY_ID id, const bool& value)
 {
+    std::lock_guard<std::recursive_mutex> lck(impl->get_property_mutex());
+
     auto vec = get_available_properties();
 
     for (const auto& v : vec)
@@ -167,6 +198,8 @@ bool CaptureDevice::set_property (TCAM_PROPERTY_ID id, const bool& value)
 
 bool CaptureDevice::set_property (TCAM_PROPERTY_ID id, const std::string& value)
 {
+    std::lock_guard<std::recursive_mutex> lck(impl->get_property_mutex());
+
     auto vec = get_available_properties();
 
     for (const auto& v : vec)
@@ -184,6 +217,48 @@ bool CaptureDevice::set_property (TCAM_PROPERTY_ID id, const std::string& value)
 }
 
 
+bool CaptureDevice::set_property_async (TCAM_PROPERTY_ID id,
+                                        const int64_t& value,
+                                        property_write_callback callback,
+                                        void* user_data)
+{
+    tcam_device_property prop = create_empty_property(id);
+
+    prop.type = TCAM_PROPERTY_TYPE_INTEGER;
+    prop.value.i.value = value;
+
+    return impl->set_property_async(prop, callback, user_data);
+}
+
+
+bool CaptureDevice::set_property_async (TCAM_PROPERTY_ID id,
+                                        const double& value,
+                                        property_write_callback callback,
+                                        void* user_data)
+{
+    tcam_device_property prop = create_empty_property(id);
+
+    prop.type = TCAM_PROPERTY_TYPE_DOUBLE;
+    prop.value.d.value = value;
+
+    return impl->set_property_async(prop, callback, user_data);
+}
+
+
+bool CaptureDevice::set_property_async (TCAM_PROPERTY_ID id,
+                                        const bool& value,
+                                        property_write_callback callback,
+                                        void* user_data)
+{
+    tcam_device_property prop = create_empty_property(id);
+
+    prop.type = TCAM_PROPERTY_TYPE_BOOLEAN;
+    prop.value.b.value = value;
+
+    return impl->set_property_async(prop, callback, user_data);
+}
+
+
 std::vector<VideoFormatDescription> CaptureDevice::get_available_video_formats () const
 {
     return impl->get_available_video_formats();
@@ -235,3 +310,47 @@ std::shared_ptr<CaptureDevice> tcam::open_device (const std::string& serial)
 
     return nullptr;
 }
+
+
+std::future<std::shared_ptr<CaptureDevice>> tcam::open_device_async (const DeviceInfo& info)
+{
+    return DeviceOpener::get_instance().open(info);
+}
+
+
+std::future<std::shared_ptr<CaptureDevice>> tcam::open_device_async (const std::string& serial)
+{
+    return DeviceOpener::get_instance().open(serial);
+}
+
+
+std::vector<std::shared_ptr<CaptureDevice>> tcam::open_devices (const std::vector<std::string>& serials)
+{
+    std::vector<std::future<std::shared_ptr<CaptureDevice>>> futures;
+
+    for (const auto& s : serials)
+    {
+        futures.push_back(open_device_async(s));
+    }
+
+    std::vector<std::shared_ptr<CaptureDevice>> ret;
+
+    for (auto& f : futures)
+    {
+        ret.push_back(f.get());
+    }
+
+    return ret;
+}
+
+
+void tcam::set_open_device_limit (unsigned int limit)
+{
+    DeviceOpener::get_instance().set_limit(limit);
+}
+
+
+unsigned int tcam::get_open_device_limit ()
+{
+    return DeviceOpener::get_instance().get_limit();
+}
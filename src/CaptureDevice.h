@@ -28,6 +28,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <future>
 
 /**
  * @addtogroup API
@@ -86,6 +87,35 @@ public:
     std::vector<Property*> get_available_properties ();
 
 
+    /**
+     * @brief Refresh all properties from the device in one operation
+     * @return vector containing the current state of all available properties
+     */
+    std::vector<struct tcam_device_property> get_property_snapshot ();
+
+    /**
+     * @brief Refresh the selected properties from the device in one operation
+     * @param ids - properties that shall be contained in the snapshot
+     * @return vector containing the current state of the requested properties
+     */
+    std::vector<struct tcam_device_property> get_property_snapshot (const std::vector<TCAM_PROPERTY_ID>& ids);
+
+
+    /**
+     * @brief Register function that shall be called when the device changes a property on its own
+     * @param callback - function that shall be called
+     * @param user_data - pointer that shall be passed to callback
+     * @return true on success
+     */
+    bool register_property_callback (property_callback callback, void* user_data);
+
+    /**
+     * @brief Remove previously registered callback
+     * @param callback - function that shall no longer be called
+     */
+    void remove_property_callback (property_callback callback);
+
+
     Property* get_property (TCAM_PROPERTY_ID id);
     Property* get_property_by_name (const std::string& name);
 
@@ -122,6 +152,28 @@ public:
     bool set_property (TCAM_PROPERTY_ID, const bool& value);
     bool set_property (TCAM_PROPERTY_ID, const std::string& value);
 
+    /**
+     * @brief Queue a property change; the caller does not wait for the device
+     *
+     * Queued changes for the same property that have not been submitted
+     * yet are replaced, only the newest value is written.
+     * @param callback - function that shall be called once the value was submitted; may be nullptr
+     * @param user_data - pointer that shall be passed to callback
+     * @return true if the change was queued
+     */
+    bool set_property_async (TCAM_PROPERTY_ID,
+                             const int64_t& value,
+                             property_write_callback callback = nullptr,
+                             void* user_data = nullptr);
+    bool set_property_async (TCAM_PROPERTY_ID,
+                             const double& value,
+                             property_write_callback callback = nullptr,
+                             void* user_data = nullptr);
+    bool set_property_async (TCAM_PROPERTY_ID,
+                             const bool& value,
+                             property_write_callback callback = nullptr,
+                             void* user_data = nullptr);
+
     // videoformat related:
 
 
@@ -168,6 +220,39 @@ private:
 
 std::shared_ptr<CaptureDevice> open_device (const std::string& serial);
 
+
+/**
+ * @brief Open a device without blocking the caller
+ *
+ * Backend open and indexing of formats and properties happen in a worker pool.
+ * At most get_open_device_limit() devices are opened at the same time.
+ * @param info - device that shall be opened
+ * @return future delivering the open device; nullptr if the device could not be opened
+ */
+std::future<std::shared_ptr<CaptureDevice>> open_device_async (const DeviceInfo& info);
+
+/**
+ * @brief Open a device without blocking the caller
+ * @param serial - serial number of the device; the lookup happens in the worker pool
+ * @return future delivering the open device; nullptr if the device could not be opened
+ */
+std::future<std::shared_ptr<CaptureDevice>> open_device_async (const std::string& serial);
+
+/**
+ * @brief Open several devices concurrently
+ * @param serials - serial numbers of the devices that shall be opened
+ * @return devices in the order of serials; nullptr for devices that could not be opened
+ */
+std::vector<std::shared_ptr<CaptureDevice>> open_devices (const std::vector<std::string>& serials);
+
+/**
+ * @brief Define how many devices are opened at the same time
+ * @param limit - maximum number of concurrent opens; default is 8
+ */
+void set_open_device_limit (unsigned int limit);
+
+unsigned int get_open_device_limit ();
+
 } /* namespace tcam */
 
 /** @} */
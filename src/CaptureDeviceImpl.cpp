@@ -23,6 +23,7 @@
 #include "serialization.h"
 
 #include <exception>
+#include <algorithm>
 
 using namespace tcam;
 
@@ -109,10 +110,14 @@ bool CaptureDeviceImpl::open_device (const DeviceInfo& device_desc)
     pipeline = std::make_shared<PipelineManager>();
     pipeline->setSource(device);
 
-    property_handler = std::make_shared<PropertyHandler>();
+    property_handler = std::make_shared<PropertyHandler>(property_mtx);
 
     property_handler->set_properties(device->getProperties(), pipeline->getFilterProperties());
 
+    device->set_property_notification(&CaptureDeviceImpl::property_changed, this);
+
+    property_writer = std::make_shared<PropertyWriter>(property_handler, property_mtx);
+
     return true;
 }
 
@@ -143,6 +148,12 @@ bool CaptureDeviceImpl::close_device ()
 
     std::string name = open_device_info.get_name();
 
+    // backend threads may still report changes; stop them before anything is torn down
+    device->set_property_notification(nullptr, nullptr);
+
+    // submit outstanding changes while the device is still available
+    property_writer = nullptr;
+
     pipeline->destroyPipeline();
 
     open_device_info = DeviceInfo ();
@@ -173,6 +184,120 @@ std::vector<Property*> CaptureDeviceImpl::get_available_properties ()
 }
 
 
+std::vector<struct tcam_device_property> CaptureDeviceImpl::get_property_snapshot (const std::vector<TCAM_PROPERTY_ID>& ids)
+{
+    std::vector<struct tcam_device_property> snapshot;
+
+    if (!is_device_open())
+    {
+        return snapshot;
+    }
+
+    if (!device->update_properties(ids))
+    {
+        tcam_log(TCAM_LOG_WARNING, "Not all properties could be retrieved from the device.");
+    }
+
+    property_handler->sync();
+
+    for (const auto& p : property_handler->get_properties())
+    {
+        if (ids.empty() || std::find(ids.begin(), ids.end(), p->get_ID()) != ids.end())
+        {
+            snapshot.push_back(p->get_struct());
+        }
+    }
+
+    return snapshot;
+}
+
+
+bool CaptureDeviceImpl::register_property_callback (property_callback callback, void* user_data)
+{
+    if (callback == nullptr)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lck(callback_mtx);
+
+    for (const auto& entry : property_callbacks)
+    {
+        if (entry.callback == callback && entry.user_data == user_data)
+        {
+            return true;
+        }
+    }
+
+    property_callbacks.push_back({callback, user_data});
+
+    return true;
+}
+
+
+void CaptureDeviceImpl::remove_property_callback (property_callback callback)
+{
+    std::lock_guard<std::mutex> lck(callback_mtx);
+
+    property_callbacks.erase(std::remove_if(property_callbacks.begin(),
+                                            property_callbacks.end(),
+                                            [callback] (const callback_entry& entry)
+                                            {
+                                                return entry.callback == callback;
+                                            }),
+                             property_callbacks.end());
+}
+
+
+bool CaptureDeviceImpl::set_property_async (const struct tcam_device_property& prop,
+                                            property_write_callback callback,
+                                            void* user_data)
+{
+    if (!is_device_open())
+    {
+        return false;
+    }
+
+    return property_writer->write(prop, callback, user_data);
+}
+
+
+std::recursive_mutex& CaptureDeviceImpl::get_property_mutex ()
+{
+    return property_mtx;
+}
+
+
+void CaptureDeviceImpl::property_changed (const Property& prop, void* user_data)
+{
+    auto self = static_cast<CaptureDeviceImpl*>(user_data);
+
+    if (self->property_handler == nullptr)
+    {
+        return;
+    }
+
+    auto external = self->property_handler->refresh_property(prop.get_ID());
+
+    if (external == nullptr)
+    {
+        return;
+    }
+
+    // callbacks may register, remove or set properties themselves
+    std::vector<callback_entry> callbacks;
+    {
+        std::lock_guard<std::mutex> lck(self->callback_mtx);
+        callbacks = self->property_callbacks;
+    }
+
+    for (const auto& entry : callbacks)
+    {
+        entry.callback(*external, entry.user_data);
+    }
+}
+
+
 std::vector<VideoFormatDescription> CaptureDeviceImpl::get_available_video_formats () const
 {
     if (!is_device_open())
@@ -22,10 +22,12 @@
 #include "Properties.h"
 #include "PipelineManager.h"
 #include "PropertyHandler.h"
+#include "PropertyWriter.h"
 
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
 
 #include "internal.h"
 
@@ -99,6 +101,46 @@ public:
      */
     std::vector<Property*> get_available_properties ();
 
+    /**
+     * @brief Refresh properties from the device in one operation
+     * @param ids - properties that shall be contained; empty for all properties
+     * @return vector containing the current state of the requested properties
+     */
+    std::vector<struct tcam_device_property> get_property_snapshot (const std::vector<TCAM_PROPERTY_ID>& ids);
+
+    /**
+     * @brief Register function that shall be called when the device changes a property
+     * @param callback - function that shall be called
+     * @param user_data - pointer that shall be passed to callback
+     * @return true on success
+     */
+    bool register_property_callback (property_callback callback, void* user_data);
+
+    /**
+     * @brief Remove previously registered callback
+     * @param callback - function that shall be removed
+     */
+    void remove_property_callback (property_callback callback);
+
+    /**
+     * @brief Queue a property change without waiting for the device
+     * @param prop - struct containing id, type and the new value
+     * @param callback - function that shall be called once the value was submitted; may be nullptr
+     * @param user_data - pointer that shall be passed to callback
+     * @return true if request was queued
+     */
+    bool set_property_async (const struct tcam_device_property& prop,
+                             property_write_callback callback,
+                             void* user_data);
+
+    /**
+     * @brief Mutex that has to be held while property values are written
+     *
+     * Shared by the synchronous setters, the asynchronous writer and the
+     * property handler, which also serializes direct Property::set_value calls.
+     */
+    std::recursive_mutex& get_property_mutex ();
+
     // videoformat related:
 
 
@@ -141,12 +183,25 @@ private:
 
     std::shared_ptr<PipelineManager> pipeline;
     std::shared_ptr<PropertyHandler> property_handler;
+    std::shared_ptr<PropertyWriter> property_writer;
+    std::recursive_mutex property_mtx;
 
     DeviceInfo open_device_info;
     VideoFormat active_format;
 
     std::shared_ptr<DeviceInterface> device;
 
+    struct callback_entry
+    {
+        property_callback callback;
+        void* user_data;
+    };
+
+    std::mutex callback_mtx;
+    std::vector<callback_entry> property_callbacks;
+
+    static void property_changed (const Property&, void* user_data);
+
 }; /* class CaptureDeviceImpl */
 
 } /* namespace tcam */
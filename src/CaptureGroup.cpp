@@ -0,0 +1,678 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CaptureGroup.h"
+
+#include "ImageSink.h"
+#include "Properties.h"
+#include "TriggerIdTracker.h"
+
+#include "internal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace tcam;
+
+
+// default matching window; roughly a quarter frame at 60 fps
+static const uint64_t DEFAULT_TOLERANCE_NS = 4 * 1000 * 1000;
+static const size_t DEFAULT_BUFFER_NUMBER = 4;
+
+
+struct CaptureGroup::member
+{
+    CaptureGroup* group;
+
+    std::shared_ptr<CaptureDevice> device;
+    std::shared_ptr<ImageSink> sink;
+    PropertyButton* software_trigger;
+
+    // buffers are copies of the delivered images since the
+    // device reuses its own buffers once push_image returns
+    std::vector<std::unique_ptr<unsigned char[]>> memory;
+    std::vector<std::shared_ptr<MemoryBuffer>> free_buffers;
+    std::deque<pending_frame> pending;
+
+    // trigger mode the device had before the group took it over
+    bool restore_trigger_mode;
+    bool previous_trigger_mode;
+
+    uint64_t last_frame_count;
+    TriggerIdTracker trigger_ids;
+
+    uint64_t unmatched;
+    uint64_t overruns;
+};
+
+
+CaptureGroup::CaptureGroup ()
+    : matching(TCAM_GROUP_MATCH_ARRIVAL_TIME), tolerance_ns(DEFAULT_TOLERANCE_NS),
+      buffer_number(DEFAULT_BUFFER_NUMBER), callback(nullptr), user_data(nullptr),
+      is_streaming(false), set_counter(0), trigger_counter(0), trigger_failures(0)
+{}
+
+
+CaptureGroup::~CaptureGroup ()
+{
+    stop_stream();
+}
+
+
+bool CaptureGroup::add_device (std::shared_ptr<CaptureDevice> device)
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    if (is_streaming || device == nullptr || !device->is_device_open())
+    {
+        return false;
+    }
+
+    for (const auto& m : members)
+    {
+        if (m->device == device)
+        {
+            return false;
+        }
+    }
+
+    std::unique_ptr<member> m(new member());
+
+    m->group = this;
+    m->device = device;
+    m->software_trigger = nullptr;
+    m->restore_trigger_mode = false;
+    m->previous_trigger_mode = false;
+
+    members.push_back(std::move(m));
+
+    return true;
+}
+
+
+size_t CaptureGroup::get_device_count () const
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    return members.size();
+}
+
+
+bool CaptureGroup::set_matching (TCAM_GROUP_MATCHING new_matching)
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    if (is_streaming)
+    {
+        return false;
+    }
+
+    matching = new_matching;
+
+    return true;
+}
+
+
+TCAM_GROUP_MATCHING CaptureGroup::get_matching () const
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    return matching;
+}
+
+
+void CaptureGroup::set_tolerance (uint64_t tolerance)
+{
+    tolerance_ns = tolerance;
+}
+
+
+uint64_t CaptureGroup::get_tolerance () const
+{
+    return tolerance_ns;
+}
+
+
+bool CaptureGroup::set_buffer_number (size_t number)
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    if (is_streaming || number < 2)
+    {
+        return false;
+    }
+
+    buffer_number = number;
+
+    return true;
+}
+
+
+bool CaptureGroup::register_callback (frameset_callback cb, void* data)
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    if (is_streaming)
+    {
+        return false;
+    }
+
+    callback = cb;
+    user_data = data;
+
+    return true;
+}
+
+
+bool CaptureGroup::start_stream ()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (is_streaming || members.empty())
+        {
+            return false;
+        }
+
+        for (auto& m : members)
+        {
+            m->sink = std::make_shared<ImageSink>();
+            m->sink->registerCallback(&CaptureGroup::on_new_frame, m.get());
+
+            m->free_buffers.clear();
+            m->memory.clear();
+            m->pending.clear();
+            m->last_frame_count = 0;
+            m->trigger_ids.reset();
+            m->unmatched = 0;
+            m->overruns = 0;
+            m->software_trigger = nullptr;
+
+            if (matching != TCAM_GROUP_MATCH_TRIGGER)
+            {
+                continue;
+            }
+
+            auto prop = m->device->get_property(TCAM_PROPERTY_SOFTWARETRIGGER);
+
+            if (prop == nullptr || prop->get_type() != TCAM_PROPERTY_TYPE_BUTTON)
+            {
+                tcam_log(TCAM_LOG_ERROR, "Device %s has no software trigger",
+                         m->device->get_device().get_serial().c_str());
+                restore_trigger_mode();
+                return false;
+            }
+
+            auto mode = m->device->get_property(TCAM_PROPERTY_TRIGGER_MODE);
+
+            if (mode == nullptr || mode->get_type() != TCAM_PROPERTY_TYPE_BOOLEAN
+                || !m->device->set_property(TCAM_PROPERTY_TRIGGER_MODE, true))
+            {
+                tcam_log(TCAM_LOG_ERROR, "Unable to enable trigger mode for device %s",
+                         m->device->get_device().get_serial().c_str());
+                restore_trigger_mode();
+                return false;
+            }
+
+            m->previous_trigger_mode = ((PropertyBoolean*)mode)->get_value();
+            m->restore_trigger_mode = true;
+
+            m->software_trigger = (PropertyButton*)prop;
+        }
+
+        ready_sets.clear();
+        set_counter = 0;
+        trigger_counter = 0;
+        trigger_failures = 0;
+
+        is_streaming = true;
+        delivery_thread = std::thread(&CaptureGroup::deliver, this);
+    }
+
+    for (auto& m : members)
+    {
+        if (!m->device->start_stream(m->sink))
+        {
+            tcam_log(TCAM_LOG_ERROR, "Unable to start stream for device %s",
+                     m->device->get_device().get_serial().c_str());
+            stop_stream();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool CaptureGroup::stop_stream ()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (!is_streaming)
+        {
+            return true;
+        }
+    }
+
+    bool ret = true;
+
+    for (auto& m : members)
+    {
+        if (!m->device->stop_stream())
+        {
+            ret = false;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        is_streaming = false;
+    }
+    cv.notify_all();
+
+    // remaining complete sets are delivered before the thread ends
+    if (delivery_thread.joinable())
+    {
+        delivery_thread.join();
+    }
+
+    if (!restore_trigger_mode())
+    {
+        ret = false;
+    }
+
+    std::lock_guard<std::mutex> lck(mtx);
+
+    for (auto& m : members)
+    {
+        m->unmatched += m->pending.size();
+        m->pending.clear();
+        m->free_buffers.clear();
+        m->memory.clear();
+        m->sink.reset();
+    }
+
+    return ret;
+}
+
+
+uint64_t CaptureGroup::trigger ()
+{
+    std::lock_guard<std::mutex> trigger_lck(trigger_mtx);
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (!is_streaming || matching != TCAM_GROUP_MATCH_TRIGGER)
+        {
+            return 0;
+        }
+    }
+
+    // the id has to be known before the first image can arrive
+    uint64_t id = ++trigger_counter;
+
+    // one thread per additional member keeps the skew between
+    // the members down to the thread start latency instead of
+    // the accumulated round trips of all devices
+    std::vector<char> results(members.size(), 0);
+    std::vector<std::thread> threads;
+
+    for (size_t i = 1; i < members.size(); ++i)
+    {
+        threads.push_back(std::thread([this, &results, i] ()
+                                      {
+                                          results[i] = members[i]->software_trigger->activate();
+                                      }));
+    }
+
+    results[0] = members[0]->software_trigger->activate();
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    if (std::find(results.begin(), results.end(), 0) != results.end())
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        trigger_failures++;
+
+        // these members will not send a frame for this trigger
+        for (size_t i = 0; i < members.size(); ++i)
+        {
+            if (!results[i])
+            {
+                members[i]->trigger_ids.skip(id);
+            }
+        }
+
+        tcam_log(TCAM_LOG_WARNING, "Group trigger %llu did not reach all devices",
+                 (unsigned long long)id);
+    }
+
+    return id;
+}
+
+
+struct tcam_group_statistics CaptureGroup::get_statistics () const
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    struct tcam_group_statistics stats = {};
+
+    stats.framesets = set_counter;
+    stats.triggers = trigger_counter;
+    stats.trigger_failures = trigger_failures;
+
+    for (const auto& m : members)
+    {
+        stats.unmatched.push_back(m->unmatched);
+        stats.overruns.push_back(m->overruns);
+    }
+
+    return stats;
+}
+
+
+void CaptureGroup::on_new_frame (MemoryBuffer* buffer, void* user_data)
+{
+    member* m = static_cast<member*>(user_data);
+
+    m->group->receive_frame(*m, *buffer);
+}
+
+
+void CaptureGroup::receive_frame (member& m, MemoryBuffer& buffer)
+{
+    uint64_t arrival = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    struct tcam_image_buffer image = buffer.getImageBuffer();
+    pending_frame frame = {};
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (matching == TCAM_GROUP_MATCH_TRIGGER)
+        {
+            // every frame answers the next trigger that reached the
+            // device; frames the device reports as lost consume theirs
+            uint64_t lost = 0;
+            if (m.last_frame_count != 0 && image.statistics.frame_count > m.last_frame_count)
+            {
+                lost = image.statistics.frame_count - m.last_frame_count - 1;
+            }
+            m.last_frame_count = image.statistics.frame_count;
+
+            frame.trigger_id = m.trigger_ids.expected(lost);
+
+            if (frame.trigger_id > trigger_counter)
+            {
+                // image was not caused by a group trigger
+                m.unmatched++;
+                return;
+            }
+            m.trigger_ids.confirm(frame.trigger_id);
+        }
+        else if (matching == TCAM_GROUP_MATCH_CAPTURE_TIME)
+        {
+            frame.timestamp = image.statistics.capture_time_ns;
+        }
+        else
+        {
+            frame.timestamp = arrival;
+        }
+
+        if (m.free_buffers.empty() && m.memory.size() < buffer_number)
+        {
+            m.memory.push_back(std::unique_ptr<unsigned char[]>(new unsigned char[image.length]));
+
+            struct tcam_image_buffer desc = image;
+            desc.pData = m.memory.back().get();
+            desc.lock_count = 0;
+
+            m.free_buffers.push_back(std::make_shared<MemoryBuffer>(desc));
+        }
+
+        if (m.free_buffers.empty())
+        {
+            if (m.pending.empty())
+            {
+                // all buffers are waiting for the callback
+                m.overruns++;
+                return;
+            }
+            // the oldest frame did not find partners in time
+            discard_front(m);
+        }
+
+        frame.buffer = m.free_buffers.back();
+        m.free_buffers.pop_back();
+    }
+
+    // copy without holding the lock so that members do not block each other
+    struct tcam_image_buffer target = frame.buffer->getImageBuffer();
+    memcpy(target.pData, image.pData, std::min(target.length, image.length));
+    frame.buffer->set_statistics(image.statistics);
+
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        m.pending.push_back(frame);
+
+        match_frames();
+
+        notify = !ready_sets.empty();
+    }
+
+    if (notify)
+    {
+        cv.notify_one();
+    }
+}
+
+
+bool CaptureGroup::is_set_available () const
+{
+    for (const auto& m : members)
+    {
+        if (m->pending.empty())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void CaptureGroup::match_frames ()
+{
+    if (matching == TCAM_GROUP_MATCH_TRIGGER)
+    {
+        match_by_trigger();
+    }
+    else
+    {
+        match_by_time();
+    }
+}
+
+
+void CaptureGroup::match_by_trigger ()
+{
+    while (is_set_available())
+    {
+        uint64_t newest = 0;
+        for (const auto& m : members)
+        {
+            newest = std::max(newest, m->pending.front().trigger_id);
+        }
+
+        // trigger ids only grow; older frames can no longer be completed
+        bool complete = true;
+        for (auto& m : members)
+        {
+            while (!m->pending.empty() && m->pending.front().trigger_id < newest)
+            {
+                discard_front(*m);
+            }
+
+            if (m->pending.empty())
+            {
+                complete = false;
+            }
+        }
+
+        if (!complete)
+        {
+            return;
+        }
+
+        std::vector<pending_frame> set;
+        for (auto& m : members)
+        {
+            set.push_back(m->pending.front());
+            m->pending.pop_front();
+        }
+        ready_sets.push_back(std::move(set));
+    }
+}
+
+
+void CaptureGroup::match_by_time ()
+{
+    uint64_t tolerance = tolerance_ns;
+
+    while (is_set_available())
+    {
+        member* oldest = members.front().get();
+        uint64_t newest = 0;
+
+        for (const auto& m : members)
+        {
+            uint64_t t = m->pending.front().timestamp;
+
+            if (t < oldest->pending.front().timestamp)
+            {
+                oldest = m.get();
+            }
+            newest = std::max(newest, t);
+        }
+
+        // the oldest frame can only be matched with frames that are
+        // already queued; everything newer is even further apart
+        if (newest - oldest->pending.front().timestamp > tolerance)
+        {
+            discard_front(*oldest);
+            continue;
+        }
+
+        std::vector<pending_frame> set;
+        for (auto& m : members)
+        {
+            set.push_back(m->pending.front());
+            m->pending.pop_front();
+        }
+        ready_sets.push_back(std::move(set));
+    }
+}
+
+
+void CaptureGroup::discard_front (member& m)
+{
+    m.free_buffers.push_back(m.pending.front().buffer);
+    m.pending.pop_front();
+    m.unmatched++;
+}
+
+
+void CaptureGroup::deliver ()
+{
+    std::unique_lock<std::mutex> lck(mtx);
+
+    while (true)
+    {
+        cv.wait(lck, [this] { return !is_streaming || !ready_sets.empty(); });
+
+        if (ready_sets.empty())
+        {
+            break;
+        }
+
+        std::vector<pending_frame> set = std::move(ready_sets.front());
+        ready_sets.pop_front();
+
+        struct tcam_frameset frameset;
+        frameset.set_id = ++set_counter;
+        frameset.trigger_id = set.front().trigger_id;
+
+        for (auto& f : set)
+        {
+            frameset.frames.push_back(f.buffer.get());
+        }
+
+        frameset_callback cb = callback;
+        void* data = user_data;
+
+        lck.unlock();
+
+        if (cb != nullptr)
+        {
+            cb(frameset, data);
+        }
+
+        lck.lock();
+
+        release_set(set);
+    }
+}
+
+
+bool CaptureGroup::restore_trigger_mode ()
+{
+    bool ret = true;
+
+    for (auto& m : members)
+    {
+        if (!m->restore_trigger_mode)
+        {
+            continue;
+        }
+
+        if (!m->device->set_property(TCAM_PROPERTY_TRIGGER_MODE, m->previous_trigger_mode))
+        {
+            tcam_log(TCAM_LOG_ERROR, "Unable to restore trigger mode for device %s",
+                     m->device->get_device().get_serial().c_str());
+            ret = false;
+        }
+        m->restore_trigger_mode = false;
+    }
+
+    return ret;
+}
+
+
+void CaptureGroup::release_set (std::vector<pending_frame>& set)
+{
+    for (size_t i = 0; i < set.size(); ++i)
+    {
+        members[i]->free_buffers.push_back(set[i].buffer);
+    }
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TCAM_CAPTUREGROUP_H
+#define TCAM_CAPTUREGROUP_H
+
+#include "CaptureDevice.h"
+#include "MemoryBuffer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @addtogroup API
+ * @{
+ */
+
+namespace tcam
+{
+
+/**
+ * @enum TCAM_GROUP_MATCHING
+ * Criteria used to decide which frames of the group members belong together
+ */
+enum TCAM_GROUP_MATCHING
+{
+    TCAM_GROUP_MATCH_ARRIVAL_TIME = 0, /**< nearest host arrival time within the tolerance */
+    TCAM_GROUP_MATCH_CAPTURE_TIME,     /**< nearest device timestamp within the tolerance;
+                                            requires devices with a common clock */
+    TCAM_GROUP_MATCH_TRIGGER,          /**< frames caused by the same CaptureGroup::trigger call */
+};
+
+
+/**
+ * @name tcam_frameset
+ * @brief matched frames of all group members
+ */
+struct tcam_frameset
+{
+    uint64_t set_id;                   /**< running number of delivered sets */
+    uint64_t trigger_id;               /**< trigger that caused the set; 0 if matched by time */
+    std::vector<MemoryBuffer*> frames; /**< one frame per member in the order of add_device */
+};
+
+
+/**
+ * @name tcam_group_statistics
+ * @brief counters describing the matching quality
+ */
+struct tcam_group_statistics
+{
+    uint64_t framesets;               /**< number of delivered sets */
+    uint64_t triggers;                /**< number of fired group triggers */
+    uint64_t trigger_failures;        /**< triggers that could not be sent to all members */
+    std::vector<uint64_t> unmatched;  /**< per member: frames discarded without partner */
+    std::vector<uint64_t> overruns;   /**< per member: frames lost because all held buffers were in use */
+};
+
+
+typedef void (*frameset_callback)(const struct tcam_frameset&, void*);
+
+
+class CaptureGroup
+{
+
+public:
+
+    CaptureGroup ();
+
+    ~CaptureGroup ();
+
+    CaptureGroup (const CaptureGroup&) = delete;
+    CaptureGroup& operator= (const CaptureGroup&) = delete;
+
+    /**
+     * @brief Add an open device to the group
+     * @param device - device that shall be part of the group
+     * @return true on success; false if the group is streaming or the device is not open
+     */
+    bool add_device (std::shared_ptr<CaptureDevice> device);
+
+    /**
+     * @return number of devices in the group
+     */
+    size_t get_device_count () const;
+
+    /**
+     * @brief Select how frames are combined into sets
+     * @return true on success; false while streaming
+     */
+    bool set_matching (TCAM_GROUP_MATCHING matching);
+
+    TCAM_GROUP_MATCHING get_matching () const;
+
+    /**
+     * @brief Maximum time difference between frames of one set
+     * @param tolerance_ns - tolerance in nanoseconds; only used for time based matching
+     */
+    void set_tolerance (uint64_t tolerance_ns);
+
+    uint64_t get_tolerance () const;
+
+    /**
+     * @brief Number of frames that are held per member while waiting for partners
+     * @return true on success; false while streaming or for values < 2
+     */
+    bool set_buffer_number (size_t number);
+
+    /**
+     * @brief Define the function that receives complete sets
+     *
+     * The callback is executed in a thread owned by the group.
+     * The frames are only valid until the callback returns.
+     * @param callback - function that shall be called
+     * @param user_data - pointer that shall be passed to callback
+     * @return true on success; false while streaming
+     */
+    bool register_callback (frameset_callback callback, void* user_data);
+
+    /**
+     * @brief Start the stream of all members
+     *
+     * With TCAM_GROUP_MATCH_TRIGGER the members are switched into trigger mode
+     * until stop_stream() is called.
+     * If a member fails to start all members are stopped again.
+     * @return true if all members are streaming
+     */
+    bool start_stream ();
+
+    /**
+     * @brief Stop the stream of all members and discard unmatched frames
+     * @return true if all members could be stopped
+     */
+    bool stop_stream ();
+
+    /**
+     * @brief Send a software trigger to all members at the same time
+     * @return id of the trigger; 0 on error
+     */
+    uint64_t trigger ();
+
+    /**
+     * @return current matching counters
+     */
+    struct tcam_group_statistics get_statistics () const;
+
+private:
+
+    struct member;
+
+    struct pending_frame
+    {
+        std::shared_ptr<MemoryBuffer> buffer;
+        uint64_t timestamp;
+        uint64_t trigger_id;
+    };
+
+    static void on_new_frame (MemoryBuffer* buffer, void* user_data);
+
+    void receive_frame (member& m, MemoryBuffer& buffer);
+
+    bool is_set_available () const;
+
+    void match_frames ();
+
+    void match_by_trigger ();
+
+    void match_by_time ();
+
+    void discard_front (member& m);
+
+    void deliver ();
+
+    void release_set (std::vector<pending_frame>& set);
+
+    bool restore_trigger_mode ();
+
+    std::vector<std::unique_ptr<member>> members;
+
+    TCAM_GROUP_MATCHING matching;
+    std::atomic<uint64_t> tolerance_ns;
+    size_t buffer_number;
+
+    frameset_callback callback;
+    void* user_data;
+
+    bool is_streaming;
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+
+    // complete sets waiting for the delivery thread
+    std::deque<std::vector<pending_frame>> ready_sets;
+    std::thread delivery_thread;
+
+    uint64_t set_counter;
+
+    std::mutex trigger_mtx;
+    std::atomic<uint64_t> trigger_counter;
+    uint64_t trigger_failures;
+
+}; /* class CaptureGroup */
+
+} /* namespace tcam */
+
+/** @} */
+
+#endif /* TCAM_CAPTUREGROUP_H */
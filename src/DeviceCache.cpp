@@ -0,0 +1,554 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DeviceCache.h"
+
+#include "logging.h"
+#include "utils.h"
+
+#include <cctype>               /* isalnum */
+#include <cstdio>               /* rename */
+#include <cstdlib>              /* getenv */
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <mutex>
+#include <unistd.h>             /* getpid */
+#include <sys/stat.h>           /* mkdir */
+
+using namespace tcam;
+
+
+// increase whenever the layout of the cache files changes
+static const uint32_t CACHE_VERSION = 1;
+static const char CACHE_MAGIC[8] = "TCAMDC";
+
+
+// entries that were already loaded or stored by this process
+static std::mutex cache_mtx;
+static std::map<std::string, device_cache_entry> cache_entries;
+
+
+std::string tcam::get_device_cache_directory ()
+{
+    const char* setting = getenv("TCAM_DEVICE_CACHE");
+
+    if (setting != nullptr && strcmp(setting, "off") == 0)
+    {
+        return "";
+    }
+
+    const char* xdg = getenv("XDG_CACHE_HOME");
+
+    if (xdg != nullptr && xdg[0] != '\0')
+    {
+        return std::string(xdg) + "/tiscamera";
+    }
+
+    const char* home = getenv("HOME");
+
+    if (home != nullptr && home[0] != '\0')
+    {
+        return std::string(home) + "/.cache/tiscamera";
+    }
+
+    return "";
+}
+
+
+static bool create_directory (const std::string& dir)
+{
+    size_t pos = 0;
+
+    do
+    {
+        pos = dir.find('/', pos + 1);
+
+        std::string part = dir.substr(0, pos);
+
+        if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            return false;
+        }
+    }
+    while (pos != std::string::npos);
+
+    return true;
+}
+
+
+static std::string get_cache_file (const std::string& backend,
+                                   const device_cache_entry& entry)
+{
+    std::string dir = get_device_cache_directory();
+
+    if (dir.empty())
+    {
+        return "";
+    }
+
+    std::string name = backend + "-" + entry.model + "-" + entry.serial;
+
+    for (auto& c : name)
+    {
+        if (!isalnum(c) && c != '-')
+        {
+            c = '_';
+        }
+    }
+
+    return dir + "/" + name + ".cache";
+}
+
+
+static bool is_matching (const device_cache_entry& cached,
+                         const device_cache_entry& wanted)
+{
+    return cached.model == wanted.model
+        && cached.serial == wanted.serial
+        && cached.firmware == wanted.firmware
+        && cached.signature == wanted.signature;
+}
+
+
+//// file handling
+
+template<typename T>
+static void write_value (std::ofstream& out, const T& value)
+{
+    out.write((const char*)&value, sizeof(value));
+}
+
+
+template<typename T>
+static bool read_value (std::ifstream& in, T& value)
+{
+    return (bool)in.read((char*)&value, sizeof(value));
+}
+
+
+static void write_string (std::ofstream& out, const std::string& s)
+{
+    write_value(out, (uint32_t)s.size());
+    out.write(s.data(), s.size());
+}
+
+
+static bool read_string (std::ifstream& in, std::string& s)
+{
+    uint32_t size;
+
+    // the longest strings are genicam feature names
+    if (!read_value(in, size) || size > 4096)
+    {
+        return false;
+    }
+
+    s.resize(size);
+
+    return (bool)in.read(&s[0], size);
+}
+
+
+template<typename T>
+static void write_vector (std::ofstream& out, const std::vector<T>& vec)
+{
+    write_value(out, (uint32_t)vec.size());
+
+    for (const auto& v : vec)
+    {
+        write_value(out, v);
+    }
+}
+
+
+// a damaged file must not make us allocate gigabytes
+static bool read_count (std::ifstream& in, uint32_t& count)
+{
+    return read_value(in, count) && count <= 0xffff;
+}
+
+
+template<typename T>
+static bool read_vector (std::ifstream& in, std::vector<T>& vec)
+{
+    uint32_t size;
+
+    if (!read_count(in, size))
+    {
+        return false;
+    }
+
+    vec.resize(size);
+
+    for (auto& v : vec)
+    {
+        if (!read_value(in, v))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static void write_header (std::ofstream& out)
+{
+    out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    write_value(out, CACHE_VERSION);
+
+    // assure files written by builds with other struct layouts are not used
+    write_value(out, (uint32_t)sizeof(struct tcam_device_property));
+    write_value(out, (uint32_t)sizeof(struct tcam_video_format_description));
+    write_value(out, (uint32_t)sizeof(struct tcam_resolution_description));
+}
+
+
+static bool check_header (std::ifstream& in)
+{
+    char magic[sizeof(CACHE_MAGIC)];
+    uint32_t version;
+    uint32_t property_size;
+    uint32_t format_size;
+    uint32_t resolution_size;
+
+    if (!in.read(magic, sizeof(magic))
+        || !read_value(in, version)
+        || !read_value(in, property_size)
+        || !read_value(in, format_size)
+        || !read_value(in, resolution_size))
+    {
+        return false;
+    }
+
+    return memcmp(magic, CACHE_MAGIC, sizeof(magic)) == 0
+        && version == CACHE_VERSION
+        && property_size == sizeof(struct tcam_device_property)
+        && format_size == sizeof(struct tcam_video_format_description)
+        && resolution_size == sizeof(struct tcam_resolution_description);
+}
+
+
+static bool read_entry (std::ifstream& in, device_cache_entry& entry)
+{
+    if (!check_header(in)
+        || !read_string(in, entry.model)
+        || !read_string(in, entry.serial)
+        || !read_string(in, entry.firmware)
+        || !read_vector(in, entry.signature))
+    {
+        return false;
+    }
+
+    uint32_t count;
+
+    if (!read_count(in, count))
+    {
+        return false;
+    }
+
+    entry.properties.resize(count);
+
+    for (auto& p : entry.properties)
+    {
+        uint32_t mapping_count;
+
+        if (!read_value(in, p.id)
+            || !read_string(in, p.identifier)
+            || !read_value(in, p.conversion_factor)
+            || !read_value(in, p.special)
+            || !read_value(in, p.value_type)
+            || !read_value(in, p.desc)
+            || !read_count(in, mapping_count))
+        {
+            return false;
+        }
+
+        for (unsigned int i = 0; i < mapping_count; ++i)
+        {
+            std::string name;
+            int value;
+
+            if (!read_string(in, name) || !read_value(in, value))
+            {
+                return false;
+            }
+            p.mapping.emplace(name, value);
+        }
+    }
+
+    if (!read_count(in, count))
+    {
+        return false;
+    }
+
+    entry.formats.resize(count);
+
+    for (auto& f : entry.formats)
+    {
+        if (!read_value(in, f.desc) || !read_count(in, count))
+        {
+            return false;
+        }
+
+        f.resolutions.resize(count);
+
+        for (auto& r : f.resolutions)
+        {
+            if (!read_value(in, r.resolution) || !read_vector(in, r.framerates))
+            {
+                return false;
+            }
+        }
+    }
+
+    return read_vector(in, entry.fractions);
+}
+
+
+static void write_entry (std::ofstream& out, const device_cache_entry& entry)
+{
+    write_header(out);
+
+    write_string(out, entry.model);
+    write_string(out, entry.serial);
+    write_string(out, entry.firmware);
+    write_vector(out, entry.signature);
+
+    write_value(out, (uint32_t)entry.properties.size());
+
+    for (const auto& p : entry.properties)
+    {
+        write_value(out, p.id);
+        write_string(out, p.identifier);
+        write_value(out, p.conversion_factor);
+        write_value(out, p.special);
+        write_value(out, p.value_type);
+        write_value(out, p.desc);
+        write_value(out, (uint32_t)p.mapping.size());
+
+        for (const auto& m : p.mapping)
+        {
+            write_string(out, m.first);
+            write_value(out, m.second);
+        }
+    }
+
+    write_value(out, (uint32_t)entry.formats.size());
+
+    for (const auto& f : entry.formats)
+    {
+        write_value(out, f.desc);
+        write_value(out, (uint32_t)f.resolutions.size());
+
+        for (const auto& r : f.resolutions)
+        {
+            write_value(out, r.resolution);
+            write_vector(out, r.framerates);
+        }
+    }
+
+    write_vector(out, entry.fractions);
+}
+
+
+bool tcam::load_device_cache (const std::string& backend, device_cache_entry& entry)
+{
+    std::string filename = get_cache_file(backend, entry);
+
+    if (filename.empty() || entry.serial.empty())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lck(cache_mtx);
+
+    auto known = cache_entries.find(filename);
+
+    if (known != cache_entries.end() && is_matching(known->second, entry))
+    {
+        entry = known->second;
+        return true;
+    }
+
+    std::ifstream in(filename, std::ios::binary);
+
+    if (!in)
+    {
+        return false;
+    }
+
+    device_cache_entry cached = {};
+
+    if (!read_entry(in, cached))
+    {
+        tcam_log(TCAM_LOG_WARNING, "Ignoring damaged device cache '%s'", filename.c_str());
+        return false;
+    }
+
+    if (!is_matching(cached, entry))
+    {
+        tcam_log(TCAM_LOG_INFO,
+                 "Device cache '%s' is outdated (firmware '%s', now '%s')",
+                 filename.c_str(), cached.firmware.c_str(), entry.firmware.c_str());
+        return false;
+    }
+
+    tcam_log(TCAM_LOG_DEBUG, "Using device cache '%s'", filename.c_str());
+
+    cache_entries[filename] = cached;
+    entry = cached;
+
+    return true;
+}
+
+
+bool tcam::store_device_cache (const std::string& backend, const device_cache_entry& entry)
+{
+    std::string filename = get_cache_file(backend, entry);
+
+    if (filename.empty() || entry.serial.empty())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lck(cache_mtx);
+
+    cache_entries[filename] = entry;
+
+    if (!create_directory(get_device_cache_directory()))
+    {
+        tcam_log(TCAM_LOG_WARNING, "Unable to create device cache directory: %s", strerror(errno));
+        return false;
+    }
+
+    // write a temporary file and move it into place,
+    // so that other processes never read a partial file
+    std::string tmp = filename + "." + std::to_string(getpid());
+
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+
+        if (!out)
+        {
+            tcam_log(TCAM_LOG_WARNING, "Unable to write device cache '%s'", tmp.c_str());
+            return false;
+        }
+
+        write_entry(out, entry);
+
+        if (!out.flush())
+        {
+            tcam_log(TCAM_LOG_WARNING, "Unable to write device cache '%s'", tmp.c_str());
+            out.close();
+            remove(tmp.c_str());
+            return false;
+        }
+    }
+
+    if (rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+        tcam_log(TCAM_LOG_WARNING, "Unable to write device cache '%s'", filename.c_str());
+        remove(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+cached_property tcam::create_cached_property (const Property& prop,
+                                              int id,
+                                              const std::string& identifier)
+{
+    cached_property cached = {};
+
+    cached.id = id;
+    cached.identifier = identifier;
+    cached.conversion_factor = 0.0;
+    cached.special = false;
+    cached.value_type = prop.get_value_type();
+    cached.desc = prop.get_struct();
+
+    if (cached.desc.type == TCAM_PROPERTY_TYPE_ENUMERATION)
+    {
+        cached.mapping = static_cast<const PropertyEnumeration&>(prop).get_mapping();
+    }
+
+    return cached;
+}
+
+
+cached_format tcam::create_cached_format (const VideoFormatDescription& format)
+{
+    cached_format cached = {};
+
+    cached.desc = format.get_struct();
+
+    for (const auto& r : format.get_resolutions())
+    {
+        framerate_mapping m = { r, format.get_frame_rates(r) };
+        cached.resolutions.push_back(m);
+    }
+
+    return cached;
+}
+
+
+std::shared_ptr<Property> tcam::restore_cached_property (const cached_property& cached,
+                                                         std::shared_ptr<PropertyImpl> impl)
+{
+    tcam_device_property desc = cached.desc;
+
+    // generated ids are only unique within one process
+    if (is_generated_property_id(desc.id))
+    {
+        desc.id = generate_unique_property_id();
+    }
+
+    switch (desc.type)
+    {
+        case TCAM_PROPERTY_TYPE_BOOLEAN:
+        {
+            return std::make_shared<PropertyBoolean>(impl, desc, cached.value_type);
+        }
+        case TCAM_PROPERTY_TYPE_INTEGER:
+        {
+            return std::make_shared<PropertyInteger>(impl, desc, cached.value_type);
+        }
+        case TCAM_PROPERTY_TYPE_DOUBLE:
+        {
+            return std::make_shared<PropertyDouble>(impl, desc, cached.value_type);
+        }
+        case TCAM_PROPERTY_TYPE_STRING:
+        {
+            return std::make_shared<PropertyString>(impl, desc, cached.value_type);
+        }
+        case TCAM_PROPERTY_TYPE_ENUMERATION:
+        {
+            return std::make_shared<PropertyEnumeration>(impl, desc, cached.mapping, cached.value_type);
+        }
+        case TCAM_PROPERTY_TYPE_BUTTON:
+        {
+            return std::make_shared<PropertyButton>(impl, desc, cached.value_type);
+        }
+        default:
+        {
+            tcam_log(TCAM_LOG_ERROR, "Cached property '%s' has unknown type", desc.name);
+            return nullptr;
+        }
+    }
+}
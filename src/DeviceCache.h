@@ -0,0 +1,152 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TCAM_DEVICECACHE_H
+#define TCAM_DEVICECACHE_H
+
+#include "base_types.h"
+#include "Properties.h"
+#include "VideoFormatDescription.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compiler_defines.h"
+
+VISIBILITY_INTERNAL
+
+namespace tcam
+{
+
+/**
+ * @brief Property descriptor as it was created while indexing the device
+ */
+struct cached_property
+{
+    int id;                          // backend identification, e.g. v4l2 control id
+    std::string identifier;          // backend identification, e.g. genicam feature name
+    double conversion_factor;
+    bool special;                    // belongs to the special properties of the backend
+    Property::VALUE_TYPE value_type;
+    struct tcam_device_property desc;
+    std::map<std::string, int> mapping; // enumeration entries
+};
+
+
+struct cached_format
+{
+    struct tcam_video_format_description desc;
+    std::vector<framerate_mapping> resolutions;
+};
+
+
+/**
+ * v4l2 framerates are fractions
+ * they are stored to allow an exact reconstruction
+ */
+struct cached_fraction
+{
+    unsigned int numerator;
+    unsigned int denominator;
+};
+
+
+/**
+ * @brief Everything a backend learned while indexing a device
+ *
+ * model, serial and firmware identify the entry.
+ * signature is backend specific information that can be retrieved
+ * cheaply when opening the device and has to match for the entry to be used.
+ */
+struct device_cache_entry
+{
+    std::string model;
+    std::string serial;
+    std::string firmware;
+
+    std::vector<uint32_t> signature;
+
+    std::vector<cached_property> properties;
+    std::vector<cached_format> formats;
+    std::vector<cached_fraction> fractions;
+};
+
+
+/**
+ * @brief Retrieve the directory the cache files are stored in
+ * @return $XDG_CACHE_HOME/tiscamera or $HOME/.cache/tiscamera;
+ *         empty when caching is disabled via TCAM_DEVICE_CACHE=off
+ */
+std::string get_device_cache_directory ();
+
+
+/**
+ * @brief Load cached device description
+ * @param backend - name of the backend the entry belongs to, e.g. "v4l2"
+ * @param entry   - model, serial, firmware and signature have to be set;
+ *                  will be filled with the cached description
+ * @return true if a matching entry was found
+ */
+bool load_device_cache (const std::string& backend, device_cache_entry& entry);
+
+
+/**
+ * @brief Store device description
+ * @param backend - name of the backend the entry belongs to
+ * @param entry   - description that shall be stored
+ * @return true on success
+ */
+bool store_device_cache (const std::string& backend, const device_cache_entry& entry);
+
+
+/**
+ * @brief Create cache description of an existing property
+ * @param prop       - property that shall be described
+ * @param id         - backend identification
+ * @param identifier - backend identification
+ * @return filled cached_property
+ */
+cached_property create_cached_property (const Property& prop,
+                                        int id,
+                                        const std::string& identifier);
+
+
+/**
+ * @brief Create cache description of an existing format description
+ * @param format - format description that shall be described
+ * @return filled cached_format
+ */
+cached_format create_cached_format (const VideoFormatDescription& format);
+
+
+/**
+ * @brief Recreate Property from cache description
+ *
+ * Properties that were passed through with a generated id receive a new one.
+ * @param cached - description that shall be used
+ * @param impl   - shared_ptr of the responsible implementation
+ * @return shared_ptr to newly created Property; nullptr on failure
+ */
+std::shared_ptr<Property> restore_cached_property (const cached_property& cached,
+                                                   std::shared_ptr<PropertyImpl> impl);
+
+} /* namespace tcam */
+
+VISIBILITY_POP
+
+#endif /* TCAM_DEVICECACHE_H */
@@ -19,7 +19,15 @@
 #include <memory>
 #include <algorithm>
 #include <cstring>
+#include <cerrno>
+#include <chrono>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#if HAVE_UDEV
+#include <libudev.h>
+#endif
 
 #include "utils.h"
 #include "logging.h"
@@ -35,23 +43,56 @@ using namespace tcam;
 DeviceIndex::DeviceIndex ()
     : continue_thread(false),
       wait_period(2),
-      have_list(false),
+      wakeup_fd(-1),
       device_list(std::vector<DeviceInfo>()),
       callbacks(std::vector<callback_data>())
 {
-    continue_thread = true;
-    work_thread = std::thread (&DeviceIndex::run, this);
+    v4l2_source = {TCAM_DEVICE_TYPE_V4L2, false, std::vector<DeviceInfo>()};
+    gige_source = {TCAM_DEVICE_TYPE_ARAVIS, false, std::vector<DeviceInfo>()};
+
+    wakeup_fd = eventfd(0, EFD_CLOEXEC);
+
+    if (wakeup_fd == -1)
+    {
+        tcam_log(TCAM_LOG_WARNING, "Unable to create eventfd: %s", strerror(errno));
+    }
 
-    work_thread.detach();
+    continue_thread = true;
 }
 
 
 DeviceIndex::~DeviceIndex ()
 {
     continue_thread = false;
-    if (work_thread.joinable())
+
+    if (wakeup_fd != -1)
+    {
+        uint64_t one = 1;
+        if (write(wakeup_fd, &one, sizeof(one)) != sizeof(one))
+        {
+            tcam_log(TCAM_LOG_ERROR, "Unable to wake hotplug thread");
+        }
+    }
+
+    {
+        // lock to not miss the discovery thread entering its wait
+        std::lock_guard<std::mutex> lck(mtx);
+    }
+    cv.notify_all();
+
+    if (hotplug_thread.joinable())
+    {
+        hotplug_thread.join();
+    }
+
+    if (discovery_thread.joinable())
     {
-        work_thread.join();
+        discovery_thread.join();
+    }
+
+    if (wakeup_fd != -1)
+    {
+        close(wakeup_fd);
     }
 }
 
@@ -62,6 +103,10 @@ void DeviceIndex::register_device_lost (dev_callback c, void* user_data)
     mtx.lock();
     callbacks.push_back({c, user_data, ""});
     mtx.unlock();
+
+    // losses are only noticed by the source threads
+    start_source(TCAM_DEVICE_TYPE_V4L2);
+    start_source(TCAM_DEVICE_TYPE_ARAVIS);
 }
 
 
@@ -72,7 +117,24 @@ void DeviceIndex::register_device_lost (dev_callback c,
     tcam_log(TCAM_LOG_DEBUG, "Registered device lost callback for %s", serial.c_str());
     mtx.lock();
     callbacks.push_back({c, user_data, serial});
+
+    // only watch the backend of a known device; unknown ones may belong to either
+    auto type = TCAM_DEVICE_TYPE_UNKNOWN;
+    for (const auto& d : device_list)
+    {
+        if (d.get_serial() == serial)
+        {
+            type = d.get_device_type();
+            break;
+        }
+    }
     mtx.unlock();
+
+    if (type == TCAM_DEVICE_TYPE_UNKNOWN || start_source(type) == nullptr)
+    {
+        start_source(TCAM_DEVICE_TYPE_V4L2);
+        start_source(TCAM_DEVICE_TYPE_ARAVIS);
+    }
 }
 
 
@@ -116,73 +178,229 @@ void DeviceIndex::remove_device_lost (dev_callback callback, const std::string&
 }
 
 
-void DeviceIndex::update_device_list ()
+DeviceIndex::device_source* DeviceIndex::start_source (enum TCAM_DEVICE_TYPE type)
 {
-    std::vector<DeviceInfo> tmp_dev_list = std::vector<DeviceInfo>();
-    tmp_dev_list.reserve(10);
+    if (type == TCAM_DEVICE_TYPE_V4L2)
+    {
+        std::call_once(hotplug_started, [this] ()
+                       {
+                           hotplug_thread = std::thread(&DeviceIndex::run_hotplug, this);
+                       });
+        return &v4l2_source;
+    }
+    else if (type == TCAM_DEVICE_TYPE_ARAVIS)
+    {
+        std::call_once(discovery_started, [this] ()
+                       {
+                           discovery_thread = std::thread(&DeviceIndex::run_discovery, this);
+                       });
+        return &gige_source;
+    }
 
-    auto dev_list = BackendLoader::getInstance().get_device_list_all_backends();
-    if (!dev_list.empty())
-        tmp_dev_list.insert(tmp_dev_list.end(), dev_list.begin(), dev_list.end());
+    return nullptr;
+}
 
-    tcam_log(TCAM_LOG_DEBUG, "Number of found devices: %d", dev_list.size());
 
-    // check for lost devices
-    for (const auto& d : device_list)
+void DeviceIndex::update_device_list (device_source& source)
+{
+    auto found_list = BackendLoader::getInstance().get_device_list(source.type);
+
+    std::vector<DeviceInfo> lost;
+
     {
-        auto f = [&d] (const DeviceInfo& info)
+        std::lock_guard<std::mutex> lck(mtx);
+
+        // check for lost devices
+        for (const auto& d : source.devices)
+        {
+            auto f = [&d] (const DeviceInfo& info)
+                {
+                    if (d.get_serial().compare(info.get_serial()) == 0)
+                        return true;
+                    return false;
+                };
+
+            if (std::find_if(found_list.begin(), found_list.end(), f) == found_list.end())
             {
-                if (d.get_serial().compare(info.get_serial()) == 0)
-                    return true;
-                return false;
-            };
+                lost.push_back(d);
+            }
+        }
+
+        source.devices = found_list;
+        source.have_list = true;
+
+        device_list.clear();
+        device_list.reserve(v4l2_source.devices.size() + gige_source.devices.size());
+        device_list.insert(device_list.end(), v4l2_source.devices.begin(), v4l2_source.devices.end());
+        device_list.insert(device_list.end(), gige_source.devices.begin(), gige_source.devices.end());
+    }
+    cv.notify_all();
 
-        auto found = std::find_if(tmp_dev_list.begin(), tmp_dev_list.end(), f);
+    tcam_log(TCAM_LOG_DEBUG, "Number of found devices: %d", found_list.size());
+
+    for (const auto& d : lost)
+    {
+        tcam_log(TCAM_LOG_INFO, "Lost device %s. Conntacting callbacks", d.get_name().c_str());
+        fire_device_lost(d);
+    }
+}
 
-        if (found == tmp_dev_list.end())
+
+void DeviceIndex::run_hotplug ()
+{
+#if HAVE_UDEV
+    struct udev* udev = udev_new();
+    struct udev_monitor* monitor = nullptr;
+
+    // without the wakeup fd a thread blocked on udev could not be stopped
+    if (udev != nullptr && wakeup_fd != -1)
+    {
+        monitor = udev_monitor_new_from_netlink(udev, "udev");
+    }
+
+    if (monitor != nullptr)
+    {
+        udev_monitor_filter_add_match_subsystem_devtype(monitor, "video4linux", nullptr);
+        if (udev_monitor_enable_receiving(monitor) < 0)
         {
-            tcam_log(TCAM_LOG_INFO, "Lost device %s. Conntacting callbacks", d.get_name().c_str());
-            fire_device_lost(d);
+            udev_monitor_unref(monitor);
+            monitor = nullptr;
         }
     }
 
-    mtx.lock();
+    if (monitor == nullptr)
+    {
+        tcam_log(TCAM_LOG_WARNING, "Unable to monitor udev. Falling back to polling.");
+    }
+#endif /* HAVE_UDEV */
 
-    device_list.clear();
+    // initial enumeration happens after the monitor is active
+    // to not miss devices that appear in between
+    update_device_list(v4l2_source);
 
-    device_list.insert(device_list.end(), tmp_dev_list.begin(), tmp_dev_list.end());
+    struct pollfd fds[2] = {};
+    nfds_t nfds = 0;
 
-    have_list = true;
-    mtx.unlock();
+    fds[nfds].fd = wakeup_fd;
+    fds[nfds].events = POLLIN;
+    nfds++;
+
+#if HAVE_UDEV
+    if (monitor != nullptr)
+    {
+        fds[nfds].fd = udev_monitor_get_fd(monitor);
+        fds[nfds].events = POLLIN;
+        nfds++;
+    }
+#endif /* HAVE_UDEV */
+
+    // without udev the list is refreshed with the discovery cadence
+    int timeout = (nfds > 1) ? -1 : (int)wait_period * 1000;
+
+    while (continue_thread)
+    {
+        int ret = poll(fds, nfds, timeout);
+
+        if (ret == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            tcam_log(TCAM_LOG_ERROR, "Error while waiting for hotplug events: %s", strerror(errno));
+            break;
+        }
+
+        if (!continue_thread || (fds[0].revents & POLLIN))
+        {
+            break;
+        }
+
+#if HAVE_UDEV
+        if (ret > 0 && monitor != nullptr)
+        {
+            bool changed = false;
+
+            // drain all queued events; one enumeration covers all of them
+            struct udev_device* dev;
+            while ((dev = udev_monitor_receive_device(monitor)) != nullptr)
+            {
+                const char* action = udev_device_get_action(dev);
+
+                if (action != nullptr
+                    && (strcmp(action, "add") == 0 || strcmp(action, "remove") == 0))
+                {
+                    tcam_log(TCAM_LOG_DEBUG, "udev reported %s for %s",
+                             action, udev_device_get_devnode(dev));
+                    changed = true;
+                }
+                udev_device_unref(dev);
+            }
+
+            if (!changed)
+            {
+                continue;
+            }
+        }
+#endif /* HAVE_UDEV */
+
+        update_device_list(v4l2_source);
+    }
+
+#if HAVE_UDEV
+    if (monitor != nullptr)
+    {
+        udev_monitor_unref(monitor);
+    }
+    if (udev != nullptr)
+    {
+        udev_unref(udev);
+    }
+#endif /* HAVE_UDEV */
 }
 
 
-void DeviceIndex::run ()
+void DeviceIndex::run_discovery ()
 {
     while (continue_thread)
     {
-        update_device_list();
-        std::this_thread::sleep_for(std::chrono::seconds(wait_period));
+        // discovery blocks for the aravis timeout;
+        // it must not delay the hotplug handling
+        update_device_list(gige_source);
+
+        std::unique_lock<std::mutex> lck(mtx);
+        cv.wait_for(lck, std::chrono::seconds(wait_period),
+                    [this] { return !continue_thread; });
     }
 }
 
 
 void DeviceIndex::fire_device_lost (const DeviceInfo& d)
 {
+    std::vector<callback_data> to_call;
+
     mtx.lock();
-    for (auto& c : callbacks)
+    for (const auto& c : callbacks)
     {
         if (c.serial.empty() || c.serial.compare(d.get_serial()) == 0)
         {
-            c.callback(d, c.data);
+            to_call.push_back(c);
         }
     }
     mtx.unlock();
+
+    // callbacks may query the index or remove themselves
+    for (const auto& c : to_call)
+    {
+        c.callback(d, c.data);
+    }
 }
 
 
 bool DeviceIndex::fill_device_info (DeviceInfo& info) const
 {
+    std::lock_guard<std::mutex> lck(mtx);
+
     if (!info.get_serial().empty())
     {
         for (const auto& d : device_list)
@@ -211,18 +429,43 @@ bool DeviceIndex::fill_device_info (DeviceInfo& info) const
 }
 
 
-std::vector<DeviceInfo> DeviceIndex::get_device_list () const
+std::vector<DeviceInfo> DeviceIndex::get_device_list ()
+{
+    // both sources enumerate concurrently in their own threads
+    start_source(TCAM_DEVICE_TYPE_V4L2);
+    start_source(TCAM_DEVICE_TYPE_ARAVIS);
+
+    std::unique_lock<std::mutex> lck(mtx);
+
+    // wait for both sources to deliver their first list
+    // since the network discovery is a blocking function
+    // callers would retrieve an incomplete list without this
+    cv.wait(lck, [this]
+            {
+                return (v4l2_source.have_list && gige_source.have_list) || !continue_thread;
+            });
+
+    return device_list;
+}
+
+
+std::vector<DeviceInfo> DeviceIndex::get_device_list (enum TCAM_DEVICE_TYPE type)
 {
+    device_source* source = start_source(type);
 
-    // wait for work_thread to deliver first valid list
-    // since get_aravis_device_list is a blocking function
-    // our thread would retrieve an empty list without this wait loop
-    while(!have_list)
+    if (source == nullptr)
     {
-        // wait
+        return std::vector<DeviceInfo>();
     }
 
-    return device_list;
+    std::unique_lock<std::mutex> lck(mtx);
+
+    cv.wait(lck, [this, source]
+            {
+                return source->have_list || !continue_thread;
+            });
+
+    return source->devices;
 }
 
 
@@ -238,3 +481,9 @@ std::vector<DeviceInfo> tcam::get_device_list ()
 {
     return DeviceIndex::get_instance().get_device_list();
 }
+
+
+std::vector<DeviceInfo> tcam::get_device_list (enum TCAM_DEVICE_TYPE type)
+{
+    return DeviceIndex::get_instance().get_device_list(type);
+}
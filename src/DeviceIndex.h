@@ -20,6 +20,8 @@
 #include "base_types.h"
 #include "DeviceInfo.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <vector>
 #include <thread>
 #include <mutex>
@@ -39,14 +41,27 @@ class DeviceIndex
 
 public:
 
+    /**
+     * @brief Retrieve devices of all backends
+     *
+     * Waits until every backend delivered its first list.
+     */
+    std::vector<DeviceInfo> get_device_list ();
 
-    std::vector<DeviceInfo> get_device_list () const;
+    /**
+     * @brief Retrieve devices of a single backend
+     *
+     * Only the backend of the given type is loaded and monitored,
+     * e.g. asking for TCAM_DEVICE_TYPE_V4L2 never starts a network discovery.
+     * @param type - device type that shall be listed
+     */
+    std::vector<DeviceInfo> get_device_list (enum TCAM_DEVICE_TYPE type);
 
 
     /**
      * @name register_device_lost
      * @param callback - function pointer to use
-     * @brief
+     * @brief starts monitoring all device types if not yet running
      */
     void register_device_lost (dev_callback callback,
                                void* user_data);
@@ -56,7 +71,7 @@ public:
      * @param callback - function pointer to use
      * @param serial - serialnumber of the device that has to be \
      *                 lost for the callback to be called
-     * @brief
+     * @brief starts monitoring the type of the device if not yet running
      */
     void register_device_lost (dev_callback callback,
                                void* user_data,
@@ -87,13 +102,33 @@ private:
 
     ~DeviceIndex ();
 
-    bool continue_thread;
-    std::mutex mtx;
+    std::atomic<bool> continue_thread;
+    mutable std::mutex mtx;
+    mutable std::condition_variable cv;
+
+    // seconds between two network discoveries
     unsigned int wait_period;
-    std::thread work_thread;
 
-    bool have_list;
+    // eventfd used to wake the hotplug thread on shutdown
+    int wakeup_fd;
+
+    // threads are started on the first request for their device type
+    std::once_flag hotplug_started;
+    std::once_flag discovery_started;
+    std::thread hotplug_thread;
+    std::thread discovery_thread;
+
+    struct device_source
+    {
+        enum TCAM_DEVICE_TYPE type;
+        bool have_list;
+        std::vector<DeviceInfo> devices;
+    };
+
+    device_source v4l2_source;
+    device_source gige_source;
 
+    // merged list of all sources; served to callers without enumeration
     std::vector<DeviceInfo> device_list;
 
     struct callback_data
@@ -105,9 +140,26 @@ private:
 
     std::vector<callback_data> callbacks;
 
-    void update_device_list ();
+    /**
+     * @brief Start monitoring the backend of the given type
+     * @return source of the device type; nullptr for unknown types
+     */
+    device_source* start_source (enum TCAM_DEVICE_TYPE type);
 
-    void run ();
+    /**
+     * @brief Enumerate the devices of a single backend and report lost ones
+     */
+    void update_device_list (device_source& source);
+
+    /**
+     * @brief Update the V4L2 devices whenever udev reports a change
+     */
+    void run_hotplug ();
+
+    /**
+     * @brief Periodically discover network devices
+     */
+    void run_discovery ();
 
     void fire_device_lost (const DeviceInfo& d);
 
@@ -116,6 +168,8 @@ private:
 
 std::vector<DeviceInfo> get_device_list ();
 
+std::vector<DeviceInfo> get_device_list (enum TCAM_DEVICE_TYPE type);
+
 } /* namespace tcam */
 
 /** @} */
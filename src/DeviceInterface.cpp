@@ -21,10 +21,63 @@
 
 #include <algorithm>
 #include <memory>
+#include <thread>
 
 using namespace tcam;
 
 
+void DeviceInterface::set_property_notification (property_callback callback, void* user_data)
+{
+    std::unique_lock<std::mutex> lck(notification_mtx);
+
+    notification_callback = callback;
+    notification_data = user_data;
+
+    // a callback replacing itself can not wait for its own return
+    auto this_thread = std::this_thread::get_id();
+    notification_cv.wait(lck, [this, this_thread]
+                         {
+                             return std::all_of(notifying_threads.begin(), notifying_threads.end(),
+                                                [this_thread] (std::thread::id id)
+                                                {
+                                                    return id == this_thread;
+                                                });
+                         });
+}
+
+
+void DeviceInterface::notify_property_change (const Property& p)
+{
+    property_callback callback;
+    void* user_data;
+
+    {
+        std::lock_guard<std::mutex> lck(notification_mtx);
+
+        callback = notification_callback;
+        user_data = notification_data;
+
+        if (callback == nullptr)
+        {
+            return;
+        }
+        notifying_threads.push_back(std::this_thread::get_id());
+    }
+
+    // called unlocked; the callback may set properties or change the notification
+    callback(p, user_data);
+
+    {
+        std::lock_guard<std::mutex> lck(notification_mtx);
+
+        notifying_threads.erase(std::find(notifying_threads.begin(),
+                                          notifying_threads.end(),
+                                          std::this_thread::get_id()));
+    }
+    notification_cv.notify_all();
+}
+
+
 std::shared_ptr<DeviceInterface> tcam::openDeviceInterface (const DeviceInfo& device)
 {
 
@@ -29,6 +29,9 @@
 
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 #include "compiler_defines.h"
 
@@ -58,6 +61,23 @@ public:
 
     virtual bool get_property (Property&) = 0;
 
+    /**
+     * @brief Refresh the values of the given properties with one device query
+     * @param ids - properties that shall be refreshed; empty to refresh all
+     * @return true if all requested values could be retrieved; else false
+     */
+    virtual bool update_properties (const std::vector<TCAM_PROPERTY_ID>& ids) = 0;
+
+    /**
+     * @brief Define function that shall be called when the device changes properties on its own
+     * @param callback - function that shall be called; nullptr to disable notifications
+     * @param user_data - pointer that shall be passed to callback
+     *
+     * When this returns no call to the previous callback is in progress,
+     * apart from one in the calling thread. Callbacks run without any lock held.
+     */
+    void set_property_notification (property_callback callback, void* user_data);
+
     /**
      * @brief Set Format in he actual device
      * @return True on success; False on error or invalid format
@@ -105,6 +125,24 @@ public:
      */
     virtual bool stop_stream () = 0;
 
+protected:
+
+    /**
+     * @brief Inform the registered callback about a property change
+     */
+    void notify_property_change (const Property&);
+
+private:
+
+    // notifications are sent from backend threads
+    std::mutex notification_mtx;
+    std::condition_variable notification_cv;
+    property_callback notification_callback = nullptr;
+    void* notification_data = nullptr;
+
+    // threads currently inside notification_callback
+    std::vector<std::thread::id> notifying_threads;
+
 }; /* class Camera_Interface */
 
 
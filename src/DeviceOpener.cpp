@@ -0,0 +1,175 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DeviceOpener.h"
+
+#include "logging.h"
+
+using namespace tcam;
+
+
+static std::shared_ptr<CaptureDevice> open_capture_device (const DeviceInfo& info)
+{
+    try
+    {
+        auto dev = std::make_shared<CaptureDevice>(info);
+
+        if (!dev->is_device_open())
+        {
+            tcam_log(TCAM_LOG_ERROR, "Could not open device %s", info.get_serial().c_str());
+            return nullptr;
+        }
+        return dev;
+    }
+    catch (const std::exception& err)
+    {
+        tcam_log(TCAM_LOG_ERROR, "Could not open CaptureDevice. Exception:\"%s\"", err.what());
+        return nullptr;
+    }
+}
+
+
+DeviceOpener& DeviceOpener::get_instance ()
+{
+    static DeviceOpener opener;
+
+    return opener;
+}
+
+
+DeviceOpener::DeviceOpener ()
+    : is_running(true), limit(8), busy(0)
+{}
+
+
+DeviceOpener::~DeviceOpener ()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        is_running = false;
+    }
+    cv.notify_all();
+
+    for (auto& w : workers)
+    {
+        if (w.joinable())
+        {
+            w.join();
+        }
+    }
+}
+
+
+std::future<std::shared_ptr<CaptureDevice>> DeviceOpener::open (const DeviceInfo& info)
+{
+    return queue(open_task([info] ()
+                           {
+                               return open_capture_device(info);
+                           }));
+}
+
+
+std::future<std::shared_ptr<CaptureDevice>> DeviceOpener::open (const std::string& serial)
+{
+    return queue(open_task([serial] () -> std::shared_ptr<CaptureDevice>
+                           {
+                               for (const auto& d : get_device_list())
+                               {
+                                   if (d.get_serial().compare(serial) == 0)
+                                   {
+                                       return open_capture_device(d);
+                                   }
+                               }
+
+                               tcam_log(TCAM_LOG_ERROR, "Unable to find device %s", serial.c_str());
+                               return nullptr;
+                           }));
+}
+
+
+void DeviceOpener::set_limit (unsigned int new_limit)
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        limit = (new_limit == 0) ? 1 : new_limit;
+    }
+    cv.notify_all();
+}
+
+
+unsigned int DeviceOpener::get_limit () const
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    return limit;
+}
+
+
+std::future<std::shared_ptr<CaptureDevice>> DeviceOpener::queue (open_task task)
+{
+    auto future = task.get_future();
+
+    std::lock_guard<std::mutex> lck(mtx);
+
+    pending.push_back(std::move(task));
+
+    // idle workers are kept, new ones are only created
+    // while the limit allows more concurrent opens
+    if (workers.size() < limit && workers.size() < busy + pending.size())
+    {
+        workers.push_back(std::thread(&DeviceOpener::run, this));
+    }
+
+    cv.notify_one();
+
+    return future;
+}
+
+
+void DeviceOpener::run ()
+{
+    std::unique_lock<std::mutex> lck(mtx);
+
+    while (true)
+    {
+        cv.wait(lck, [this]
+                {
+                    return !is_running || (!pending.empty() && busy < limit);
+                });
+
+        if (pending.empty())
+        {
+            // only reached when shutting down
+            break;
+        }
+
+        auto task = std::move(pending.front());
+        pending.pop_front();
+        busy++;
+
+        lck.unlock();
+
+        // backend open and indexing happen here
+        task();
+
+        lck.lock();
+        busy--;
+
+        // a slot became available
+        cv.notify_one();
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TCAM_DEVICEOPENER_H
+#define TCAM_DEVICEOPENER_H
+
+#include "CaptureDevice.h"
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "compiler_defines.h"
+
+VISIBILITY_INTERNAL
+
+namespace tcam
+{
+
+/**
+ * Worker pool that opens devices in the background.
+ * Workers are created on demand; at most 'limit' devices
+ * are opened at the same time, further requests are queued.
+ */
+class DeviceOpener
+{
+public:
+
+    static DeviceOpener& get_instance ();
+
+    /**
+     * @brief Queue a device for opening
+     * @param info - device that shall be opened
+     * @return future delivering the open device; nullptr if opening failed
+     */
+    std::future<std::shared_ptr<CaptureDevice>> open (const DeviceInfo& info);
+
+    /**
+     * @brief Queue a device for opening
+     *
+     * The device list is retrieved by the worker,
+     * the caller does not wait for the enumeration.
+     * @param serial - serial number of the device that shall be opened
+     * @return future delivering the open device; nullptr if opening failed
+     */
+    std::future<std::shared_ptr<CaptureDevice>> open (const std::string& serial);
+
+    void set_limit (unsigned int limit);
+
+    unsigned int get_limit () const;
+
+private:
+
+    DeviceOpener ();
+
+    /**
+     * Waits for queued requests to finish
+     */
+    ~DeviceOpener ();
+
+    DeviceOpener (const DeviceOpener&) = delete;
+    DeviceOpener& operator= (const DeviceOpener&) = delete;
+
+    typedef std::packaged_task<std::shared_ptr<CaptureDevice>()> open_task;
+
+    bool is_running;
+
+    // number of devices that may be opened concurrently
+    unsigned int limit;
+
+    // number of workers currently opening a device
+    unsigned int busy;
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+
+    std::deque<open_task> pending;
+
+    std::vector<std::thread> workers;
+
+    std::future<std::shared_ptr<CaptureDevice>> queue (open_task task);
+
+    void run ();
+};
+
+} /* namespace tcam */
+
+VISIBILITY_POP
+
+#endif /* TCAM_DEVICEOPENER_H */
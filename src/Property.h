@@ -164,6 +164,19 @@ protected:
 
 TCAM_PROPERTY_TYPE value_type_to_ctrl_type (const Property::VALUE_TYPE& t);
 
+
+/**
+ * Callback that is used when a property value changed without user interaction
+ * e.g. when a camera adjusts exposure on its own
+ */
+typedef void (*property_callback) (const Property&, void* user_data);
+
+
+/**
+ * Callback that is used to report the result of an asynchronous property write
+ */
+typedef void (*property_write_callback) (TCAM_PROPERTY_ID id, bool success, void* user_data);
+
 } /* namespace tcam */
 
 #endif /* TCAM_PROPERTY_H */
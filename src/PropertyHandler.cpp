@@ -26,7 +26,8 @@
 using namespace tcam;
 
 
-PropertyHandler::PropertyHandler ()
+PropertyHandler::PropertyHandler (std::recursive_mutex& mtx)
+    : property_mtx(mtx)
 {}
 
 
@@ -112,7 +113,46 @@ std::vector<std::shared_ptr<Property>> PropertyHandler::get_properties ()
 
 
 void PropertyHandler::sync ()
-{}
+{
+    for (auto& m : properties)
+    {
+        auto ext_struct = m.external_property->get_struct();
+
+        ext_struct.value = m.internal_property->get_struct().value;
+
+        m.external_property->set_struct(ext_struct);
+    }
+
+    // auto values may have changed, keep dependent flags consistent
+    for (auto& p : external_properties)
+    {
+        handle_flags(p);
+    }
+}
+
+
+std::shared_ptr<Property> PropertyHandler::refresh_property (TCAM_PROPERTY_ID id)
+{
+    auto m = find_mapping_internal(id);
+
+    if (m.internal_property == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto ext_struct = m.external_property->get_struct();
+
+    ext_struct.value = m.internal_property->get_struct().value;
+
+    m.external_property->set_struct(ext_struct);
+
+    for (auto& p : external_properties)
+    {
+        handle_flags(p);
+    }
+
+    return m.external_property;
+}
 
 
 void PropertyHandler::clear ()
@@ -133,6 +173,8 @@ bool PropertyHandler::set_property (const Property& p)
     // update the (internal) representation of the exposed properties
     // check if other properties need to be changed (flags, etc).
 
+    std::lock_guard<std::recursive_mutex> lck(property_mtx);
+
     for (auto& prop : properties)
     {
         if (prop.external_property->get_ID() == p.get_ID())
@@ -21,6 +21,7 @@
 
 #include <vector>
 #include <memory>
+#include <mutex>
 
 #pragma GCC visibility push (internal)
 
@@ -30,7 +31,10 @@ namespace tcam
 class PropertyHandler : public PropertyImpl, public std::enable_shared_from_this<PropertyHandler>
 {
 public:
-    PropertyHandler ();
+    /**
+     * @param property_mtx - held while a value is written; has to outlive the handler
+     */
+    explicit PropertyHandler (std::recursive_mutex& property_mtx);
     ~PropertyHandler ();
 
     bool set_properties (std::vector<std::shared_ptr<Property>> device_properties,
@@ -44,6 +48,13 @@ public:
      */
     void sync ();
 
+    /**
+     * Copy the value of the given internal property to its external counterpart
+     * @param id - id of the internal property that changed
+     * @return the external property; nullptr if no mapping exists
+     */
+    std::shared_ptr<Property> refresh_property (TCAM_PROPERTY_ID id);
+
     /**
      * Delete all properties
      */
@@ -55,6 +66,10 @@ public:
 
 private:
 
+    // Property::set_value ends up in set_property, also when called
+    // directly on a property instead of through CaptureDevice or the writer
+    std::recursive_mutex& property_mtx;
+
     std::vector<std::shared_ptr<Property>> device_properties;
     std::vector<std::shared_ptr<Property>> emulated_properties;
 
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PropertyWriter.h"
+
+#include "logging.h"
+
+#include <cmath>
+
+using namespace tcam;
+
+
+PropertyWriter::PropertyWriter (std::shared_ptr<PropertyHandler> prop_handler,
+                                std::recursive_mutex& mtx_property)
+    : handler(prop_handler), property_mtx(mtx_property), is_running(true), is_writing(false)
+{
+    work_thread = std::thread(&PropertyWriter::run, this);
+}
+
+
+PropertyWriter::~PropertyWriter ()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        is_running = false;
+    }
+    cv.notify_all();
+
+    if (work_thread.joinable())
+    {
+        work_thread.join();
+    }
+}
+
+
+bool PropertyWriter::write (const struct tcam_device_property& prop,
+                            property_write_callback callback,
+                            void* user_data)
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    if (!is_running)
+    {
+        return false;
+    }
+
+    auto& req = pending[prop.id];
+
+    // a newer value replaces a not yet submitted one
+    // everybody waiting for the old value is informed about the new one
+    req.prop = prop;
+
+    if (callback != nullptr)
+    {
+        req.callbacks.push_back({callback, user_data});
+    }
+
+    cv.notify_one();
+
+    return true;
+}
+
+
+void PropertyWriter::flush ()
+{
+    std::unique_lock<std::mutex> lck(mtx);
+
+    cv_done.wait(lck, [this] { return pending.empty() && !is_writing; });
+}
+
+
+void PropertyWriter::run ()
+{
+    std::unique_lock<std::mutex> lck(mtx);
+
+    while (true)
+    {
+        cv.wait(lck, [this] { return !pending.empty() || !is_running; });
+
+        if (pending.empty())
+        {
+            // only reached when stopped and nothing is left to write
+            break;
+        }
+
+        std::map<TCAM_PROPERTY_ID, request> work;
+        work.swap(pending);
+        is_writing = true;
+
+        lck.unlock();
+
+        for (auto& w : work)
+        {
+            bool ret;
+            {
+                // callbacks are invoked unlocked, they may use the synchronous setters
+                std::lock_guard<std::recursive_mutex> property_lck(property_mtx);
+                ret = apply(w.second.prop);
+            }
+
+            if (!ret)
+            {
+                tcam_log(TCAM_LOG_WARNING, "Unable to write property %d", w.second.prop.id);
+            }
+
+            for (auto& c : w.second.callbacks)
+            {
+                c.callback(w.first, ret, c.user_data);
+            }
+        }
+
+        lck.lock();
+
+        is_writing = false;
+        cv_done.notify_all();
+    }
+
+    is_writing = false;
+    cv_done.notify_all();
+}
+
+
+bool PropertyWriter::apply (const struct tcam_device_property& prop)
+{
+    for (auto& p : handler->get_properties())
+    {
+        if (p->get_ID() != prop.id)
+        {
+            continue;
+        }
+
+        switch (p->get_type())
+        {
+            case TCAM_PROPERTY_TYPE_INTEGER:
+            {
+                if (prop.type == TCAM_PROPERTY_TYPE_DOUBLE)
+                {
+                    return p->set_value((int64_t)std::llround(prop.value.d.value));
+                }
+                if (prop.type == TCAM_PROPERTY_TYPE_INTEGER)
+                {
+                    return p->set_value((int64_t)prop.value.i.value);
+                }
+                break;
+            }
+            case TCAM_PROPERTY_TYPE_DOUBLE:
+            {
+                if (prop.type == TCAM_PROPERTY_TYPE_INTEGER)
+                {
+                    return p->set_value((double)prop.value.i.value);
+                }
+                if (prop.type == TCAM_PROPERTY_TYPE_DOUBLE)
+                {
+                    return p->set_value(prop.value.d.value);
+                }
+                break;
+            }
+            case TCAM_PROPERTY_TYPE_BOOLEAN:
+            {
+                if (prop.type == TCAM_PROPERTY_TYPE_BOOLEAN)
+                {
+                    return p->set_value((bool)prop.value.b.value);
+                }
+                break;
+            }
+            default:
+            {
+                if (prop.type == p->get_type())
+                {
+                    return p->set_property_from_struct(prop);
+                }
+                break;
+            }
+        }
+
+        tcam_log(TCAM_LOG_ERROR,
+                 "Unable to write value of type %d to property %s of type %d",
+                 prop.type, p->get_name().c_str(), p->get_type());
+        return false;
+    }
+
+    return false;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TCAM_PROPERTYWRITER_H
+#define TCAM_PROPERTYWRITER_H
+
+#include "Property.h"
+#include "PropertyHandler.h"
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "compiler_defines.h"
+
+VISIBILITY_INTERNAL
+
+namespace tcam
+{
+
+/**
+ * Worker that submits property changes to the device
+ * without blocking the caller. Multiple requests for the same
+ * property that have not been submitted yet are merged,
+ * only the newest value is written.
+ */
+class PropertyWriter
+{
+public:
+
+    /**
+     * @param handler      - handler containing the properties that shall be written
+     * @param property_mtx - mutex held by synchronous setters of the same device;
+     *                       has to outlive the writer
+     */
+    PropertyWriter (std::shared_ptr<PropertyHandler> handler, std::recursive_mutex& property_mtx);
+
+    PropertyWriter () = delete;
+
+    /**
+     * Submits all pending requests before returning
+     */
+    ~PropertyWriter ();
+
+    /**
+     * @brief Queue a property change
+     * @param prop - struct containing id, type and the new value
+     * @param callback - function that shall be called once the value was submitted; may be nullptr
+     * @param user_data - pointer that shall be passed to callback
+     * @return true if request was queued
+     */
+    bool write (const struct tcam_device_property& prop,
+                property_write_callback callback,
+                void* user_data);
+
+    /**
+     * @brief Block until all queued requests have been submitted
+     */
+    void flush ();
+
+private:
+
+    struct callback_entry
+    {
+        property_write_callback callback;
+        void* user_data;
+    };
+
+    struct request
+    {
+        struct tcam_device_property prop;
+        std::vector<callback_entry> callbacks;
+    };
+
+    std::shared_ptr<PropertyHandler> handler;
+
+    // serializes writes with the synchronous setters
+    std::recursive_mutex& property_mtx;
+
+    bool is_running;
+    bool is_writing;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::condition_variable cv_done;
+
+    std::map<TCAM_PROPERTY_ID, request> pending;
+
+    std::thread work_thread;
+
+    void run ();
+
+    /**
+     * @brief Write the value to the property with the same id
+     *
+     * Integer and double values are converted to the property type,
+     * all other values have to match the property type.
+     * @return true on success
+     */
+    bool apply (const struct tcam_device_property& prop);
+};
+
+} /* namespace tcam */
+
+VISIBILITY_POP
+
+#endif /* TCAM_PROPERTYWRITER_H */
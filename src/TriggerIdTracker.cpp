@@ -0,0 +1,76 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TriggerIdTracker.h"
+
+using namespace tcam;
+
+
+TriggerIdTracker::TriggerIdTracker ()
+    : last_id(0)
+{}
+
+
+void TriggerIdTracker::reset ()
+{
+    last_id = 0;
+    skipped.clear();
+}
+
+
+void TriggerIdTracker::skip (uint64_t id)
+{
+    if (id > last_id)
+    {
+        skipped.push_back(id);
+    }
+}
+
+
+uint64_t TriggerIdTracker::expected (uint64_t lost) const
+{
+    uint64_t id = last_id;
+    auto next_skipped = skipped.begin();
+
+    // the lost frames and the current one each answered
+    // one trigger that actually reached the device
+    for (uint64_t i = 0; i <= lost; ++i)
+    {
+        ++id;
+
+        while (next_skipped != skipped.end() && *next_skipped <= id)
+        {
+            if (*next_skipped == id)
+            {
+                ++id;
+            }
+            ++next_skipped;
+        }
+    }
+
+    return id;
+}
+
+
+void TriggerIdTracker::confirm (uint64_t id)
+{
+    last_id = id;
+
+    while (!skipped.empty() && skipped.front() <= id)
+    {
+        skipped.pop_front();
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TCAM_TRIGGERIDTRACKER_H
+#define TCAM_TRIGGERIDTRACKER_H
+
+#include <cstdint>
+#include <deque>
+
+namespace tcam
+{
+
+/**
+ * Assigns group trigger ids to the frames of a single device.
+ *
+ * Frames carry no trigger id, so every frame answers the next trigger
+ * the device received. Triggers that could not be sent to the device
+ * have to be announced with skip(), otherwise all following frames
+ * would be attributed to the trigger before the real one.
+ */
+class TriggerIdTracker
+{
+public:
+
+    TriggerIdTracker ();
+
+    /**
+     * @brief Forget all ids; the next frame answers trigger 1
+     */
+    void reset ();
+
+    /**
+     * @brief Announce a trigger that did not reach the device
+     * @param id - trigger id; has to be larger than all previously skipped ids
+     */
+    void skip (uint64_t id);
+
+    /**
+     * @brief Trigger id of the next frame
+     * @param lost - frames the device reported as lost since the last frame;
+     *               each of them consumed a trigger
+     * @return trigger id the frame belongs to
+     */
+    uint64_t expected (uint64_t lost) const;
+
+    /**
+     * @brief Mark all triggers up to id as answered
+     */
+    void confirm (uint64_t id);
+
+private:
+
+    uint64_t last_id;
+    std::deque<uint64_t> skipped; // ascending
+};
+
+} /* namespace tcam */
+
+#endif /* TCAM_TRIGGERIDTRACKER_H */
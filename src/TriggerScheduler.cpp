@@ -0,0 +1,451 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TriggerScheduler.h"
+
+#include "Properties.h"
+
+#include "internal.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace tcam;
+
+
+static const uint64_t NSEC_PER_SEC = 1000000000ull;
+
+// images that take longer than this are considered lost
+static const uint64_t DEFAULT_FRAME_TIMEOUT_NS = 1 * NSEC_PER_SEC;
+
+// upper bound for triggers waiting for their image
+static const size_t MAX_OUTSTANDING = 256;
+
+
+static uint64_t monotonic_now ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+
+static struct timespec to_timespec (uint64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / NSEC_PER_SEC;
+    ts.tv_nsec = ns % NSEC_PER_SEC;
+
+    return ts;
+}
+
+
+TriggerScheduler::TriggerScheduler (std::shared_ptr<CaptureDevice> dev)
+    : device(dev), software_trigger(nullptr),
+      restore_trigger_mode(false), previous_trigger_mode(false),
+      intervals(1, NSEC_PER_SEC), realtime_priority(0),
+      frame_timeout(DEFAULT_FRAME_TIMEOUT_NS), stop_fd(-1), running(false)
+{
+    reset_statistics();
+}
+
+
+TriggerScheduler::~TriggerScheduler ()
+{
+    stop();
+}
+
+
+bool TriggerScheduler::set_rate (double rate)
+{
+    if (rate <= 0.0 || is_running())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lck(mtx);
+
+    intervals.assign(1, (uint64_t)std::llround(NSEC_PER_SEC / rate));
+
+    return intervals.front() > 0;
+}
+
+
+bool TriggerScheduler::set_schedule (const std::vector<uint64_t>& intervals_ns)
+{
+    if (intervals_ns.empty() || is_running())
+    {
+        return false;
+    }
+
+    for (auto i : intervals_ns)
+    {
+        if (i == 0)
+        {
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lck(mtx);
+
+    intervals = intervals_ns;
+
+    return true;
+}
+
+
+void TriggerScheduler::set_realtime_priority (int priority)
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    realtime_priority = priority;
+}
+
+
+void TriggerScheduler::set_frame_timeout (uint64_t timeout_ns)
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    frame_timeout = timeout_ns;
+}
+
+
+bool TriggerScheduler::start ()
+{
+    if (is_running() || device == nullptr)
+    {
+        return false;
+    }
+
+    // the previous thread ended on its own
+    stop();
+
+    auto prop = device->get_property(TCAM_PROPERTY_SOFTWARETRIGGER);
+
+    if (prop == nullptr || prop->get_type() != TCAM_PROPERTY_TYPE_BUTTON)
+    {
+        tcam_log(TCAM_LOG_ERROR, "Device has no software trigger");
+        return false;
+    }
+
+    stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (stop_fd == -1)
+    {
+        tcam_log(TCAM_LOG_ERROR, "Unable to create eventfd: %s", strerror(errno));
+        return false;
+    }
+
+    auto mode = device->get_property(TCAM_PROPERTY_TRIGGER_MODE);
+
+    if (mode == nullptr || mode->get_type() != TCAM_PROPERTY_TYPE_BOOLEAN
+        || !device->set_property(TCAM_PROPERTY_TRIGGER_MODE, true))
+    {
+        tcam_log(TCAM_LOG_ERROR, "Unable to enable trigger mode");
+        close(stop_fd);
+        stop_fd = -1;
+        return false;
+    }
+
+    previous_trigger_mode = ((PropertyBoolean*)mode)->get_value();
+    restore_trigger_mode = true;
+
+    software_trigger = (PropertyButton*)prop;
+
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        outstanding.clear();
+    }
+
+    running = true;
+    work_thread = std::thread(&TriggerScheduler::run, this);
+
+    return true;
+}
+
+
+void TriggerScheduler::stop ()
+{
+    if (!work_thread.joinable())
+    {
+        return;
+    }
+
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) != sizeof(one))
+    {
+        tcam_log(TCAM_LOG_ERROR, "Unable to signal trigger thread");
+    }
+
+    work_thread.join();
+
+    close(stop_fd);
+    stop_fd = -1;
+
+    if (restore_trigger_mode)
+    {
+        if (!device->set_property(TCAM_PROPERTY_TRIGGER_MODE, previous_trigger_mode))
+        {
+            tcam_log(TCAM_LOG_ERROR, "Unable to restore trigger mode");
+        }
+        restore_trigger_mode = false;
+    }
+}
+
+
+bool TriggerScheduler::is_running () const
+{
+    return running;
+}
+
+
+void TriggerScheduler::frame_received ()
+{
+    uint64_t now = monotonic_now();
+
+    std::lock_guard<std::mutex> lck(mtx);
+
+    expire_triggers(now);
+
+    if (outstanding.empty())
+    {
+        stats.frames_unmatched++;
+        return;
+    }
+
+    uint64_t latency = now - outstanding.front();
+    outstanding.pop_front();
+
+    if (stats.frames_matched == 0 || latency < stats.latency_min)
+    {
+        stats.latency_min = latency;
+    }
+    if (latency > stats.latency_max)
+    {
+        stats.latency_max = latency;
+    }
+
+    stats.frames_matched++;
+
+    // Welford's update; the sum of squares loses all precision
+    // for nanosecond latencies long before the variance does
+    double delta = latency - latency_mean;
+    latency_mean += delta / stats.frames_matched;
+    latency_m2 += delta * (latency - latency_mean);
+}
+
+
+struct tcam_trigger_statistics TriggerScheduler::get_statistics () const
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    struct tcam_trigger_statistics ret = stats;
+
+    if (stats.triggers_sent > 0)
+    {
+        ret.issue_delay_mean = issue_delay_sum / stats.triggers_sent;
+    }
+
+    if (stats.frames_matched > 0)
+    {
+        double variance = latency_m2 / stats.frames_matched;
+
+        ret.latency_mean = (uint64_t)latency_mean;
+        ret.latency_jitter = variance > 0.0 ? (uint64_t)std::sqrt(variance) : 0;
+    }
+
+    return ret;
+}
+
+
+void TriggerScheduler::reset_statistics ()
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    memset(&stats, 0, sizeof(stats));
+    issue_delay_sum = 0;
+    latency_mean = 0.0;
+    latency_m2 = 0.0;
+}
+
+
+void TriggerScheduler::expire_triggers (uint64_t now)
+{
+    while (!outstanding.empty() && now - outstanding.front() > frame_timeout)
+    {
+        outstanding.pop_front();
+        stats.frames_lost++;
+    }
+}
+
+
+void TriggerScheduler::run ()
+{
+    std::vector<uint64_t> schedule;
+    int priority;
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        schedule = intervals;
+        priority = realtime_priority;
+    }
+
+    if (priority > 0)
+    {
+        struct sched_param param = {};
+        param.sched_priority = priority;
+
+        int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (ret != 0)
+        {
+            tcam_log(TCAM_LOG_WARNING,
+                     "Unable to use realtime scheduling for triggers: %s", strerror(ret));
+        }
+    }
+
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer_fd == -1)
+    {
+        tcam_log(TCAM_LOG_ERROR, "Unable to create timerfd: %s", strerror(errno));
+        running = false;
+        return;
+    }
+
+    struct pollfd fds[2] = {};
+    fds[0].fd = timer_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stop_fd;
+    fds[1].events = POLLIN;
+
+    // deadlines are absolute so that errors do not accumulate
+    size_t index = 0;
+    uint64_t deadline = monotonic_now() + schedule[index];
+
+    while (true)
+    {
+        struct itimerspec spec = {};
+        spec.it_value = to_timespec(deadline);
+
+        if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1)
+        {
+            tcam_log(TCAM_LOG_ERROR, "Unable to arm trigger timer: %s", strerror(errno));
+            break;
+        }
+
+        int ret = poll(fds, 2, -1);
+
+        if (ret == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            tcam_log(TCAM_LOG_ERROR, "Error while waiting for trigger timer: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            break;
+        }
+
+        if (!(fds[0].revents & POLLIN))
+        {
+            continue;
+        }
+
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+        {
+            continue;
+        }
+
+        uint64_t issue_time = monotonic_now();
+
+        // the image may arrive before activate() returns,
+        // the trigger has to be known to frame_received by then
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+
+            expire_triggers(issue_time);
+
+            if (outstanding.size() >= MAX_OUTSTANDING)
+            {
+                outstanding.pop_front();
+                stats.frames_lost++;
+            }
+            outstanding.push_back(issue_time);
+        }
+
+        bool success = software_trigger->activate();
+
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+
+            uint64_t delay = issue_time - deadline;
+
+            if (success)
+            {
+                stats.triggers_sent++;
+                issue_delay_sum += delay;
+                if (delay > stats.issue_delay_max)
+                {
+                    stats.issue_delay_max = delay;
+                }
+            }
+            else
+            {
+                stats.trigger_failures++;
+
+                // no image will follow; release the reservation unless it was already consumed
+                for (auto it = outstanding.rbegin(); it != outstanding.rend(); ++it)
+                {
+                    if (*it == issue_time)
+                    {
+                        outstanding.erase(std::next(it).base());
+                        break;
+                    }
+                }
+            }
+
+            // keep the phase of the schedule and skip
+            // deadlines that already passed
+            index = (index + 1) % schedule.size();
+            deadline += schedule[index];
+
+            uint64_t now = monotonic_now();
+            while (deadline <= now)
+            {
+                stats.missed_deadlines++;
+                index = (index + 1) % schedule.size();
+                deadline += schedule[index];
+            }
+        }
+    }
+
+    close(timer_fd);
+
+    running = false;
+}
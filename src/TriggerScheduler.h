@@ -0,0 +1,169 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TCAM_TRIGGERSCHEDULER_H
+#define TCAM_TRIGGERSCHEDULER_H
+
+#include "CaptureDevice.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @addtogroup API
+ * @{
+ */
+
+namespace tcam
+{
+
+/**
+ * @name tcam_trigger_statistics
+ * @brief timing of the issued software triggers
+ *
+ * All times are in nanoseconds.
+ * Latency is measured from issuing the trigger to the arrival
+ * of the corresponding image in frame_received.
+ */
+struct tcam_trigger_statistics
+{
+    uint64_t triggers_sent;     /**< triggers that were written to the device */
+    uint64_t trigger_failures;  /**< triggers the device did not accept */
+    uint64_t missed_deadlines;  /**< timer periods that passed without a trigger */
+    uint64_t frames_matched;    /**< images that were assigned to a trigger */
+    uint64_t frames_unmatched;  /**< images without outstanding trigger */
+    uint64_t frames_lost;       /**< triggers whose image did not arrive within the timeout */
+
+    uint64_t issue_delay_mean;  /**< time between deadline and trigger write */
+    uint64_t issue_delay_max;
+
+    uint64_t latency_min;
+    uint64_t latency_max;
+    uint64_t latency_mean;
+    uint64_t latency_jitter;    /**< standard deviation of the latency */
+};
+
+
+class TriggerScheduler
+{
+
+public:
+
+    explicit TriggerScheduler (std::shared_ptr<CaptureDevice> device);
+
+    TriggerScheduler () = delete;
+
+    ~TriggerScheduler ();
+
+    /**
+     * @brief Trigger with a fixed rate
+     * @param rate - triggers per second
+     * @return true on success; false while running or for invalid rates
+     */
+    bool set_rate (double rate);
+
+    /**
+     * @brief Trigger with a repeating sequence of intervals
+     * @param intervals_ns - time between consecutive triggers; used cyclically
+     * @return true on success; false while running or if an interval is 0
+     */
+    bool set_schedule (const std::vector<uint64_t>& intervals_ns);
+
+    /**
+     * @brief SCHED_FIFO priority for the trigger thread
+     * @param priority - 0 to keep the default scheduling policy
+     */
+    void set_realtime_priority (int priority);
+
+    /**
+     * @brief Time after which a trigger without image is counted as lost
+     */
+    void set_frame_timeout (uint64_t timeout_ns);
+
+    /**
+     * @brief Enable trigger mode and start issuing triggers
+     *
+     * The device has to be streaming already.
+     * @return true on success
+     */
+    bool start ();
+
+    /**
+     * @brief Stop issuing triggers and restore the previous trigger mode
+     */
+    void stop ();
+
+    /**
+     * @return true while triggers are issued; false after the trigger thread ended
+     */
+    bool is_running () const;
+
+    /**
+     * @brief Report the arrival of an image
+     *
+     * Has to be called by the sink callback of the device
+     * so that latencies can be determined.
+     */
+    void frame_received ();
+
+    struct tcam_trigger_statistics get_statistics () const;
+
+    void reset_statistics ();
+
+private:
+
+    void run ();
+
+    void expire_triggers (uint64_t now);
+
+    std::shared_ptr<CaptureDevice> device;
+    PropertyButton* software_trigger;
+
+    // trigger mode the device had before start()
+    bool restore_trigger_mode;
+    bool previous_trigger_mode;
+
+    std::vector<uint64_t> intervals;
+    int realtime_priority;
+    uint64_t frame_timeout;
+
+    int stop_fd;
+    std::thread work_thread;
+    std::atomic<bool> running;
+
+    mutable std::mutex mtx;
+
+    // issue times of triggers still waiting for their image
+    std::deque<uint64_t> outstanding;
+
+    struct tcam_trigger_statistics stats;
+    uint64_t issue_delay_sum;
+
+    // running mean and sum of squared deviations of the latency
+    double latency_mean;
+    double latency_m2;
+
+}; /* class TriggerScheduler */
+
+} /* namespace tcam */
+
+/** @} */
+
+#endif /* TCAM_TRIGGERSCHEDULER_H */
@@ -28,6 +28,7 @@
 #include <algorithm>
 #include <unistd.h>
 #include <fcntl.h>              /* O_RDWR O_NONBLOCK */
+#include <poll.h>
 #include <sys/mman.h>           /* mmap PROT_READ*/
 #include <linux/videodev2.h>
 #include <cstring>              /* memcpy*/
@@ -55,6 +56,8 @@ std::vector<std::shared_ptr<Property>> V4l2Device::V4L2PropertyHandler::create_p
 
 bool V4l2Device::V4L2PropertyHandler::set_property (const Property& new_property)
 {
+    std::lock_guard<std::recursive_mutex> lck(device->property_mtx);
+
     auto f = [&new_property] (const property_description& d)
         {
             return ((*d.prop).get_name().compare(new_property.get_name()) == 0);
@@ -99,6 +102,8 @@ bool V4l2Device::V4L2PropertyHandler::set_property (const Property& new_property
 
 bool V4l2Device::V4L2PropertyHandler::get_property (Property& p)
 {
+    std::lock_guard<std::recursive_mutex> lck(device->property_mtx);
+
     auto f = [&p] (const property_description& d)
         {
             return ((*d.prop).get_name().compare(p.get_name()) == 0);
@@ -134,7 +139,7 @@ std::vector<double> V4l2Device::V4L2FormatHandler::get_framerates(const struct t
 
 
 V4l2Device::V4l2Device (const DeviceInfo& device_desc)
-    : device(device_desc), emulate_bayer(false), emulated_fourcc(0),
+    : device(device_desc), is_event_loop_running(false), emulate_bayer(false), emulated_fourcc(0),
       property_handler(nullptr), is_stream_on(false)
 {
 
@@ -149,8 +154,19 @@ V4l2Device::V4l2Device (const DeviceInfo& device_desc)
 
     determine_active_video_format();
 
-    this->index_all_controls(property_handler);
-    this->index_formats();
+    auto cache = create_cache_entry();
+
+    if (!restore_from_cache(cache))
+    {
+        this->index_all_controls(property_handler);
+        this->index_formats();
+
+        store_in_cache(cache);
+    }
+
+    // control events are delivered while not streaming as well
+    is_event_loop_running = true;
+    event_thread = std::thread(&V4l2Device::event_loop, this);
 }
 
 
@@ -159,6 +175,12 @@ V4l2Device::~V4l2Device ()
     if (is_stream_on)
         stop_stream();
 
+    is_event_loop_running = false;
+    if (event_thread.joinable())
+    {
+        event_thread.join();
+    }
+
     if (this->fd != -1)
     {
         close(fd);
@@ -196,6 +218,95 @@ bool V4l2Device::get_property (Property& p)
 }
 
 
+bool V4l2Device::update_properties (const std::vector<TCAM_PROPERTY_ID>& ids)
+{
+    std::lock_guard<std::recursive_mutex> lck(property_mtx);
+
+    auto is_wanted = [&ids] (const property_description& desc)
+        {
+            if (ids.empty())
+            {
+                return true;
+            }
+            return (std::find(ids.begin(), ids.end(), desc.prop->get_ID()) != ids.end());
+        };
+
+    std::vector<property_description*> descs;
+    std::vector<struct v4l2_ext_control> controls;
+
+    for (auto& desc : property_handler->properties)
+    {
+        if (desc.id == EMULATED_PROPERTY || !is_wanted(desc))
+        {
+            continue;
+        }
+
+        TCAM_PROPERTY_TYPE type = desc.prop->get_type();
+
+        // strings are not cached and buttons have no value
+        if (type == TCAM_PROPERTY_TYPE_STRING
+            || type == TCAM_PROPERTY_TYPE_BUTTON
+            || type == TCAM_PROPERTY_TYPE_UNKNOWN
+            || desc.prop->is_write_only())
+        {
+            continue;
+        }
+
+        struct v4l2_ext_control ctrl = {};
+        ctrl.id = desc.id;
+
+        controls.push_back(ctrl);
+        descs.push_back(&desc);
+    }
+
+    if (controls.empty())
+    {
+        return true;
+    }
+
+    struct v4l2_ext_controls ctrls = {};
+
+    // ctrl_class 0 allows controls of different classes in one request
+    ctrls.ctrl_class = 0;
+    ctrls.count = controls.size();
+    ctrls.controls = controls.data();
+
+    if (tcam_xioctl(fd, VIDIOC_G_EXT_CTRLS, &ctrls) == 0)
+    {
+        for (unsigned int i = 0; i < controls.size(); ++i)
+        {
+            update_property_value(*descs.at(i), controls.at(i).value);
+        }
+        return true;
+    }
+
+    tcam_log(TCAM_LOG_WARNING,
+             "Unable to query %zu controls at once (%s). Querying them separately.",
+             controls.size(), strerror(errno));
+
+    bool ret = true;
+
+    for (unsigned int i = 0; i < controls.size(); ++i)
+    {
+        struct v4l2_control ctrl = {};
+        ctrl.id = controls.at(i).id;
+
+        if (tcam_xioctl(fd, VIDIOC_G_CTRL, &ctrl))
+        {
+            tcam_log(TCAM_LOG_ERROR,
+                     "Unable to retrieve value for %s",
+                     descs.at(i)->prop->get_name().c_str());
+            ret = false;
+            continue;
+        }
+
+        update_property_value(*descs.at(i), ctrl.value);
+    }
+
+    return ret;
+}
+
+
 bool V4l2Device::set_video_format (const VideoFormat& new_format)
 {
     if (is_stream_on == true)
@@ -742,6 +853,146 @@ std::vector<double> V4l2Device::index_framerates (const struct v4l2_frmsizeenum&
     return f;
 }
 
+device_cache_entry V4l2Device::create_cache_entry ()
+{
+    device_cache_entry entry = {};
+
+    entry.model = device.get_info().name;
+    entry.serial = device.get_info().serial_number;
+    entry.firmware = get_v4l2_firmware_version(device.get_info().identifier);
+
+    // driver updates may change the offered controls
+    struct v4l2_capability cap = {};
+
+    if (tcam_xioctl(fd, VIDIOC_QUERYCAP, &cap) == 0)
+    {
+        entry.firmware += " ";
+        entry.firmware += (char*)cap.driver;
+        entry.firmware += " " + std::to_string(cap.version);
+    }
+
+    // the format list only costs one ioctl per format,
+    // frame sizes, frame intervals and controls are what makes indexing expensive
+    struct v4l2_fmtdesc fmtdesc = {};
+
+    fmtdesc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    for (fmtdesc.index = 0; ! tcam_xioctl (fd, VIDIOC_ENUM_FMT, &fmtdesc); fmtdesc.index ++)
+    {
+        entry.signature.push_back(fmtdesc.pixelformat);
+
+        // identical to index_formats, bayer is only recognizable by the description
+        struct v4l2_fmtdesc new_desc = {};
+        emulate_bayer = checkForBayer(fmtdesc, new_desc);
+    }
+
+    return entry;
+}
+
+
+bool V4l2Device::restore_from_cache (device_cache_entry entry)
+{
+    if (!load_device_cache("v4l2", entry))
+    {
+        return false;
+    }
+
+    std::vector<property_description> props;
+    std::vector<property_description> special_props;
+
+    for (const auto& c : entry.properties)
+    {
+        property_description desc = { c.id, c.conversion_factor, restore_cached_property(c, property_handler) };
+
+        if (desc.prop == nullptr)
+        {
+            return false;
+        }
+
+        if (c.special)
+        {
+            special_props.push_back(desc);
+        }
+        else
+        {
+            props.push_back(desc);
+        }
+    }
+
+    property_handler->properties = props;
+    property_handler->special_properties = special_props;
+
+    for (const auto& desc : property_handler->properties)
+    {
+        subscribe_control_event(desc);
+    }
+
+    for (const auto& desc : property_handler->special_properties)
+    {
+        subscribe_control_event(desc);
+    }
+
+    // cached values are outdated, retrieve all of them with a single request
+    update_properties({});
+
+    create_emulated_properties();
+
+    for (const auto& f : entry.formats)
+    {
+        this->available_videoformats.push_back(VideoFormatDescription(nullptr, f.desc, f.resolutions));
+    }
+
+    for (const auto& f : entry.fractions)
+    {
+        framerate_conv c = {(double)f.denominator/f.numerator, f.numerator, f.denominator};
+        framerate_conversions.push_back(c);
+    }
+
+    tcam_log(TCAM_LOG_DEBUG, "Restored %zu properties and %zu formats from device cache",
+             entry.properties.size(), entry.formats.size());
+
+    return true;
+}
+
+
+void V4l2Device::store_in_cache (device_cache_entry entry)
+{
+    for (const auto& desc : property_handler->properties)
+    {
+        // emulated properties are recreated from the real ones
+        if (desc.id == EMULATED_PROPERTY)
+        {
+            continue;
+        }
+
+        auto c = create_cached_property(*desc.prop, desc.id, "");
+        c.conversion_factor = desc.conversion_factor;
+        entry.properties.push_back(c);
+    }
+
+    for (const auto& desc : property_handler->special_properties)
+    {
+        auto c = create_cached_property(*desc.prop, desc.id, "");
+        c.conversion_factor = desc.conversion_factor;
+        c.special = true;
+        entry.properties.push_back(c);
+    }
+
+    for (const auto& f : available_videoformats)
+    {
+        entry.formats.push_back(create_cached_format(f));
+    }
+
+    for (const auto& f : framerate_conversions)
+    {
+        cached_fraction c = { f.numerator, f.denominator };
+        entry.fractions.push_back(c);
+    }
+
+    store_device_cache("v4l2", entry);
+}
+
+
 void V4l2Device::determine_active_video_format ()
 {
 
@@ -1026,6 +1277,8 @@ int V4l2Device::index_control (struct v4l2_queryctrl* qctrl, std::shared_ptr<Pro
         property_handler->properties.push_back(desc);
     }
 
+    subscribe_control_event(desc);
+
     if (qctrl->type == V4L2_CTRL_TYPE_STRING)
     {
         free(ext_ctrl.string);
@@ -1034,6 +1287,22 @@ int V4l2Device::index_control (struct v4l2_queryctrl* qctrl, std::shared_ptr<Pro
 }
 
 
+void V4l2Device::subscribe_control_event (const property_description& desc)
+{
+    // let the driver inform us about value changes it does on its own
+    // e.g. exposure changes caused by internal auto algorithms
+    struct v4l2_event_subscription sub = {};
+
+    sub.type = V4L2_EVENT_CTRL;
+    sub.id = desc.id;
+
+    if (tcam_xioctl(fd, VIDIOC_SUBSCRIBE_EVENT, &sub) < 0)
+    {
+        tcam_log(TCAM_LOG_DEBUG, "Unable to subscribe to events for ctrl %s", desc.prop->get_name().c_str());
+    }
+}
+
+
 bool V4l2Device::changeV4L2Control (const property_description& prop_desc)
 {
 
@@ -1093,6 +1362,137 @@ bool V4l2Device::changeV4L2Control (const property_description& prop_desc)
 }
 
 
+void V4l2Device::update_property_value (property_description& desc, int32_t value)
+{
+    auto s = desc.prop->get_struct();
+
+    switch (s.type)
+    {
+        case TCAM_PROPERTY_TYPE_INTEGER:
+        case TCAM_PROPERTY_TYPE_ENUMERATION:
+        {
+            s.value.i.value = value;
+            if (desc.conversion_factor != 0.0)
+            {
+                s.value.i.value *= desc.conversion_factor;
+            }
+            break;
+        }
+        case TCAM_PROPERTY_TYPE_DOUBLE:
+        {
+            s.value.d.value = value;
+            if (desc.conversion_factor != 0.0)
+            {
+                s.value.d.value *= desc.conversion_factor;
+            }
+            break;
+        }
+        case TCAM_PROPERTY_TYPE_BOOLEAN:
+        {
+            s.value.b.value = (value != 0);
+            break;
+        }
+        default:
+        {
+            return;
+        }
+    }
+
+    desc.prop->set_struct_value(s);
+}
+
+
+void V4l2Device::handle_events ()
+{
+    struct v4l2_event ev = {};
+
+    std::vector<std::shared_ptr<Property>> changed;
+
+    std::unique_lock<std::recursive_mutex> lck(property_mtx);
+
+    do
+    {
+        if (tcam_xioctl(fd, VIDIOC_DQEVENT, &ev) < 0)
+        {
+            break;
+        }
+
+        if (ev.type != V4L2_EVENT_CTRL)
+        {
+            continue;
+        }
+
+        auto desc = std::find_if(property_handler->properties.begin(),
+                                 property_handler->properties.end(),
+                                 [&ev] (const property_description& d)
+                                 {
+                                     return d.id == (int)ev.id;
+                                 });
+
+        if (desc == property_handler->properties.end())
+        {
+            continue;
+        }
+
+        if (ev.u.ctrl.changes & V4L2_EVENT_CTRL_CH_VALUE)
+        {
+            update_property_value(*desc, ev.u.ctrl.value);
+        }
+
+        if (ev.u.ctrl.changes & V4L2_EVENT_CTRL_CH_FLAGS)
+        {
+            auto s = desc->prop->get_struct();
+            s.flags = convert_v4l2_flags(ev.u.ctrl.flags);
+            desc->prop->set_struct(s);
+        }
+
+        tcam_log(TCAM_LOG_DEBUG, "Device changed property %s", desc->prop->get_name().c_str());
+
+        changed.push_back(desc->prop);
+    }
+    while (ev.pending > 0);
+
+    // receivers may query properties themselves
+    lck.unlock();
+
+    for (const auto& p : changed)
+    {
+        notify_property_change(*p);
+    }
+}
+
+
+void V4l2Device::event_loop ()
+{
+    struct pollfd pfd = {};
+
+    pfd.fd = fd;
+    // pending v4l2 events are signaled as priority data
+    pfd.events = POLLPRI;
+
+    while (is_event_loop_running)
+    {
+        // timeout allows the loop to notice shutdown
+        int ret = poll(&pfd, 1, 500);
+
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            tcam_log(TCAM_LOG_ERROR, "Error while waiting for device events: %s", strerror(errno));
+            return;
+        }
+
+        if (ret > 0 && (pfd.revents & POLLPRI))
+        {
+            handle_events();
+        }
+    }
+}
+
+
 void V4l2Device::stream ()
 {
     current_buffer = 0;
@@ -21,9 +21,12 @@
 #include "VideoFormat.h"
 #include "VideoFormatDescription.h"
 #include "FormatHandlerInterface.h"
+#include "DeviceCache.h"
 
 #include <linux/videodev2.h>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <thread>
 
 VISIBILITY_INTERNAL
@@ -94,6 +97,8 @@ public:
 
     bool get_property (Property&);
 
+    bool update_properties (const std::vector<TCAM_PROPERTY_ID>& ids);
+
     bool set_video_format (const VideoFormat&);
 
     bool validate_video_format (const VideoFormat&) const;
@@ -124,6 +129,13 @@ private:
 
     DeviceInfo device;
 
+    // properties are changed by users and by the event thread
+    // recursive as emulated properties set other properties
+    std::recursive_mutex property_mtx;
+
+    std::atomic<bool> is_event_loop_running;
+    std::thread event_thread;
+
     int fd;
 
     VideoFormat active_video_format;
@@ -171,6 +183,25 @@ private:
 
     int index_control (struct v4l2_queryctrl* qctrl, std::shared_ptr<PropertyImpl> impl);
 
+    void subscribe_control_event (const property_description& desc);
+
+    /**
+     * @brief Describe the device for the device cache
+     *
+     * Only queries the format list; all expensive enumerations are skipped.
+     * @return entry containing key and signature of the device
+     */
+    device_cache_entry create_cache_entry ();
+
+    /**
+     * @brief Restore properties and formats from the device cache
+     * @param entry - entry returned by create_cache_entry
+     * @return true if a valid cache entry was used; false if indexing is required
+     */
+    bool restore_from_cache (device_cache_entry entry);
+
+    void store_in_cache (device_cache_entry entry);
+
     void add_control (struct v4l2_queryctrl* queryctrl,
                       struct v4l2_ext_control* ctrl,
                       std::shared_ptr<PropertyImpl> impl);
@@ -179,6 +210,18 @@ private:
 
     bool changeV4L2Control (const property_description&);
 
+    void update_property_value (property_description&, int32_t value);
+
+    /**
+     * @brief Dequeue all pending v4l2 events and apply them to the properties
+     */
+    void handle_events ();
+
+    /**
+     * @brief Wait for v4l2 events independent of the stream state
+     */
+    void event_loop ();
+
     // streaming related
 
     bool is_stream_on;
@@ -22,15 +22,11 @@
 #include "internal.h"
 
 #include <algorithm>
+#include <mutex>
 #include <vector>
 
 // gige-daemon communication
-#include <sys/ipc.h>
-#include <sys/shm.h>
-#include <sys/msg.h>
-
 #include "gige-daemon.h"
-#include "tcam-semaphores.h"
 
 using namespace tcam;
 
@@ -730,44 +726,56 @@ uint32_t tcam::fourcc2aravis (uint32_t fourcc)
 
 std::vector<DeviceInfo> tcam::get_gige_device_list ()
 {
+    // the directory stays mapped; reading it needs no system calls
+    static std::mutex directory_mtx;
+    static const struct tcam_gige_directory* directory = nullptr;
 
-    key_t shmkey = ftok("/tmp/tcam-gige-camera-list", 'G');
-    key_t sem_key = ftok("/tmp/tcam-gige-semaphore", 'S');
-    int sem_id = semaphore_create(sem_key);
+    struct tcam_gige_device_list list;
 
-    int shmid = shmget(shmkey, sizeof(struct tcam_gige_device_list), 0644 );
-    if (shmid < 0)
     {
-        // perror("shmget");
-        // exit(1);
-        tcam_log(TCAM_LOG_ERROR, "Unable to connect to gige-daemon. Using internal methods");
-        return get_aravis_device_list();
-    }
+        std::lock_guard<std::mutex> lck(directory_mtx);
 
-    semaphore_lock(sem_id);
+        if (directory != nullptr && !tcam_gige_directory_is_alive(directory))
+        {
+            // daemon was stopped or crashed; a restarted daemon creates a new segment
+            tcam_gige_directory_close(directory);
+            directory = nullptr;
+        }
 
-    struct tcam_gige_device_list* d = (struct tcam_gige_device_list*)shmat(shmid, NULL, NULL);
+        if (directory == nullptr)
+        {
+            directory = tcam_gige_directory_open();
 
-    if (d == nullptr)
-    {
-        shmdt(d);
-        semaphore_unlock(sem_id);
-        return std::vector<DeviceInfo>();
+            // a crashed daemon leaves its segment behind
+            if (directory != nullptr && !tcam_gige_directory_is_alive(directory))
+            {
+                tcam_gige_directory_close(directory);
+                directory = nullptr;
+            }
+        }
+
+        if (directory == nullptr)
+        {
+            tcam_log(TCAM_LOG_ERROR, "Unable to connect to gige-daemon. Using internal methods");
+            return get_aravis_device_list();
+        }
+
+        if (!tcam_gige_directory_read(directory, list))
+        {
+            tcam_log(TCAM_LOG_ERROR, "Unable to read camera list of gige-daemon. Using internal methods");
+            return get_aravis_device_list();
+        }
     }
 
     std::vector<DeviceInfo> ret;
 
-    ret.reserve(d->device_count);
+    ret.reserve(list.device_count);
 
-    for (unsigned int i = 0; i < d->device_count; ++i)
+    for (unsigned int i = 0; i < list.device_count; ++i)
     {
-        ret.push_back(DeviceInfo(d->devices[i]));
+        ret.push_back(DeviceInfo(list.devices[i]));
     }
 
-    shmdt(d);
-
-    semaphore_unlock(sem_id);
-
     return ret;
 }
 
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "algorithm_runner.h"
+
+#include "logging.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <cstring>
+
+using namespace tcam;
+
+
+AlgorithmRunner::AlgorithmRunner (analysis_callback cb, void* data)
+    : callback(cb), user_data(data),
+      frame_interval(1), frame_counter(0), rate(0.0),
+      is_running(false), has_snapshot(false), snapshot()
+{
+    start();
+}
+
+
+AlgorithmRunner::~AlgorithmRunner ()
+{
+    stop();
+}
+
+
+void AlgorithmRunner::start ()
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    if (is_running)
+    {
+        return;
+    }
+
+    is_running = true;
+    has_snapshot = false;
+    work_thread = std::thread(&AlgorithmRunner::run, this);
+}
+
+
+void AlgorithmRunner::stop ()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        is_running = false;
+    }
+    cv.notify_all();
+
+    if (work_thread.joinable())
+    {
+        work_thread.join();
+    }
+}
+
+
+void AlgorithmRunner::set_frame_interval (unsigned int interval)
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    frame_interval = interval > 0 ? interval : 1;
+}
+
+
+unsigned int AlgorithmRunner::get_frame_interval () const
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    return frame_interval;
+}
+
+
+void AlgorithmRunner::set_rate (double r)
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    rate = r > 0.0 ? r : 0.0;
+}
+
+
+double AlgorithmRunner::get_rate () const
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    return rate;
+}
+
+
+bool AlgorithmRunner::is_due ()
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    // worker has not picked up the previous snapshot
+    // no need to analyze another image
+    if (!is_running || has_snapshot)
+    {
+        return false;
+    }
+
+    if (rate > 0.0)
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto period = std::chrono::duration<double>(1.0 / rate);
+
+        if (now - last_analysis < period)
+        {
+            return false;
+        }
+        last_analysis = now;
+        return true;
+    }
+
+    if (++frame_counter < frame_interval)
+    {
+        return false;
+    }
+    frame_counter = 0;
+    return true;
+}
+
+
+void AlgorithmRunner::submit (const struct tcam_image_statistics& statistics)
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        snapshot = statistics;
+        has_snapshot = true;
+    }
+    cv.notify_one();
+}
+
+
+void AlgorithmRunner::run ()
+{
+    // control loops must never compete with the streaming threads
+    struct sched_param param = {};
+    int ret = pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+    if (ret != 0)
+    {
+        tcam_log(TCAM_LOG_WARNING,
+                 "Unable to lower the priority of the algorithm thread: %s",
+                 strerror(ret));
+    }
+
+    std::unique_lock<std::mutex> lck(mtx);
+
+    while (true)
+    {
+        cv.wait(lck, [this] { return has_snapshot || !is_running; });
+
+        if (!is_running)
+        {
+            break;
+        }
+
+        struct tcam_image_statistics current = snapshot;
+
+        lck.unlock();
+
+        callback(current, user_data);
+
+        lck.lock();
+
+        // only now the next snapshot may be requested
+        has_snapshot = false;
+    }
+}
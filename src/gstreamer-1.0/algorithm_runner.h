@@ -0,0 +1,116 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TCAM_ALGORITHM_RUNNER_H
+#define TCAM_ALGORITHM_RUNNER_H
+
+#include "image_statistics.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace tcam
+{
+
+/**
+ * Runs the control part of an auto algorithm on a low priority thread.
+ *
+ * The streaming thread asks is_due() for every buffer and only
+ * hands over a statistics snapshot when an analysis is wanted.
+ * While the worker is busy with a snapshot is_due() returns false,
+ * so no statistics are calculated that would only be dropped and
+ * the worker never lags behind the stream.
+ */
+class AlgorithmRunner
+{
+public:
+
+    typedef void (*analysis_callback) (const struct tcam_image_statistics& statistics,
+                                       void* user_data);
+
+    AlgorithmRunner (analysis_callback callback, void* user_data);
+
+    AlgorithmRunner () = delete;
+
+    ~AlgorithmRunner ();
+
+    /**
+     * @brief Restart the worker after stop()
+     */
+    void start ();
+
+    /**
+     * @brief Wait for the current analysis and end the worker thread
+     *
+     * No callback is invoked after this returns.
+     */
+    void stop ();
+
+    /**
+     * @brief Analyze every n-th frame; used when no rate is set
+     * @param interval - number of frames between analyses; 1 for every frame
+     */
+    void set_frame_interval (unsigned int interval);
+
+    unsigned int get_frame_interval () const;
+
+    /**
+     * @brief Analyze frames with the given frequency
+     * @param rate - analyses per second; 0 to use the frame interval
+     */
+    void set_rate (double rate);
+
+    double get_rate () const;
+
+    /**
+     * Has to be called once per frame
+     * @return true if a snapshot shall be submitted for the current frame;
+     *         always false while stopped
+     */
+    bool is_due ();
+
+    /**
+     * @brief Hand statistics to the worker thread
+     */
+    void submit (const struct tcam_image_statistics& statistics);
+
+private:
+
+    analysis_callback callback;
+    void* user_data;
+
+    unsigned int frame_interval;
+    unsigned int frame_counter;
+    double rate;
+    std::chrono::steady_clock::time_point last_analysis;
+
+    bool is_running;
+    bool has_snapshot;
+    struct tcam_image_statistics snapshot;
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+
+    std::thread work_thread;
+
+    void run ();
+};
+
+} /* namespace tcam */
+
+#endif /* TCAM_ALGORITHM_RUNNER_H */
@@ -16,13 +16,29 @@
 
 #include "auto_focus.h"
 
+#include <vector>
+#include <thread>
+
 #define max(a, b) (((a) > (b)) ? (a) : (b))
+#define min(a, b) (((a) < (b)) ? (a) : (b))
 
 namespace {
 
 const int REGION_SIZE = 128;
 const int SWEEP_SHARPNESS_THRESHOLD = 300;
 
+// below this many regions per thread, starting threads costs more than it saves
+const unsigned int MIN_REGIONS_PER_THREAD = 32;
+
+// frames that are already exposed or in transfer when the device applies a new focus value
+const uint64_t FOCUS_FRAME_LATENCY = 2;
+
+// upper limit for refinement moves after the coarse sweep
+const unsigned int MAX_REFINE_STEPS = 8;
+
+// 1 - 1/phi
+const double GOLDEN_SECTION = 0.381966;
+
 //struct RegionPos
 
 struct RegionInfo
@@ -79,81 +95,135 @@ inline TDataType* get_ptr_at ( void* region_base, int x, int y, int stride )
 }
 
 
+const unsigned int CONTRAST_LINE_COUNT = 7;
+// edge length of the two boxes that are compared
+const unsigned int CONTRAST_BOX_LENGTH = 8;
+const unsigned int CONTRAST_BOX_DEPTH = 4;
+
+
+/*
+ * Running sum over a band of CONTRAST_BOX_DEPTH lines.
+ * prefix[x] contains the sum of all columns left of x,
+ * so every box of the band is two lookups.
+ * The column loop only touches sequential memory and is vectorized by the compiler.
+ */
 template<typename TChannelType>
-static unsigned int autofocus_get_contrast_ ( const img_descriptor& image, const RegionInfo& region )
+static void sum_line_band ( const unsigned char* band_start, unsigned int stride,
+                            unsigned int width, uint32_t* prefix )
 {
-    const unsigned int LINE_COUNT = 7;
+    const TChannelType* l0 = (const TChannelType*)band_start;
+    const TChannelType* l1 = (const TChannelType*)(band_start + stride);
+    const TChannelType* l2 = (const TChannelType*)(band_start + 2 * stride);
+    const TChannelType* l3 = (const TChannelType*)(band_start + 3 * stride);
 
-    void* region_start = get_ptr_at<TChannelType>( image.pData, region.x, region.y, image.pitch );
-    unsigned int stride = image.pitch;
+    uint32_t* columns = prefix + 1;
 
-    unsigned int step_y = region.height / (LINE_COUNT + 1) + 1;
-    unsigned int step_x = region.width / (LINE_COUNT + 1) + 1;
+    for ( unsigned int x = 0; x < width; ++x )
+    {
+        columns[x] = (uint32_t)l0[x] + l1[x] + l2[x] + l3[x];
+    }
 
-    unsigned int sharpness = 0;
-    for ( unsigned int y = step_y; (y+4) < region.height; y += step_y )
+    prefix[0] = 0;
+    for ( unsigned int x = 0; x < width; ++x )
     {
-        unsigned int max_contrast = 0;
+        prefix[x + 1] += prefix[x];
+    }
+}
 
-        for ( unsigned int x = 0; (x+16) < region.width; x += 4 )
-        {
-            int a = 0;
-            for ( unsigned int i = 0; i < 8; ++i )
-                for ( unsigned int j = 0; j < 4; ++j )
-                    a += *get_ptr_at<TChannelType>( region_start, x + i, y + j, stride );
 
-            a /= 16;
+/*
+ * Highest contrast between two neighbouring boxes along a prefix sum.
+ * Boxes are moved in steps of 4 like the original sampling.
+ */
+static unsigned int max_box_contrast ( const uint32_t* prefix, unsigned int length )
+{
+    unsigned int max_contrast = 0;
 
-            int b = 0;
-            for ( unsigned int i = 8; i < 16; ++i )
-                for ( unsigned int j = 0; j< 4;++j )
-                    b += *get_ptr_at<TChannelType>( region_start, x + i, y + j, stride );
+    for ( unsigned int p = 0; (p + 2 * CONTRAST_BOX_LENGTH) < length; p += 4 )
+    {
+        int a = (prefix[p + CONTRAST_BOX_LENGTH] - prefix[p]) / 16;
+        int b = (prefix[p + 2 * CONTRAST_BOX_LENGTH] - prefix[p + CONTRAST_BOX_LENGTH]) / 16;
 
-            b /= 16;
+        unsigned int contrast = abs_(a - b);
+        max_contrast = max(contrast, max_contrast);
+    }
 
-            unsigned int contrast = abs_(a-b);
-            max_contrast = max(contrast, max_contrast);
-        }
-        sharpness += max_contrast;
+    return max_contrast;
+}
+
+
+template<typename TChannelType>
+static unsigned int autofocus_get_contrast_ ( const img_descriptor& image, const RegionInfo& region )
+{
+    const unsigned char* region_start = (const unsigned char*)get_ptr_at<TChannelType>( image.pData, region.x, region.y, image.pitch );
+    const unsigned int stride = image.pitch;
+
+    const unsigned int step_y = region.height / (CONTRAST_LINE_COUNT + 1) + 1;
+    const unsigned int step_x = region.width / (CONTRAST_LINE_COUNT + 1) + 1;
+
+    std::vector<uint32_t> prefix(max(region.width, region.height) + 1);
+
+    unsigned int sharpness = 0;
+
+    // horizontal edges: bands of lines, boxes move along x
+    for ( unsigned int y = step_y; (y + CONTRAST_BOX_DEPTH) < region.height; y += step_y )
+    {
+        sum_line_band<TChannelType>( region_start + y * stride, stride, region.width, prefix.data() );
+
+        sharpness += max_box_contrast( prefix.data(), region.width );
     }
-    for ( unsigned int x = step_x; (x+4) < region.width; x += step_x )
+
+    // vertical edges: bands of columns, boxes move along y
+    unsigned int band_x[CONTRAST_LINE_COUNT + 1];
+    unsigned int band_count = 0;
+
+    for ( unsigned int x = step_x; (x + CONTRAST_BOX_DEPTH) < region.width && band_count <= CONTRAST_LINE_COUNT; x += step_x )
     {
-        unsigned int max_contrast = 0;
+        band_x[band_count++] = x;
+    }
 
-        for ( unsigned int y = 0; (y+16) < region.height; y += 4 )
-        {
-            int a = 0;
-            for ( unsigned int i = 0; i < 8; ++i )
-                for ( unsigned int j = 0; j< 4;++j )
-                    a += *get_ptr_at<TChannelType>( region_start, x + j, y + i, stride );
+    if ( band_count == 0 )
+    {
+        return sharpness;
+    }
 
-            a /= 16;
+    // one pass over the lines fills the running sums of all column bands
+    std::vector<uint32_t> column_prefix(band_count * (region.height + 1), 0);
 
-            int b = 0;
-            for ( unsigned int i = 8; i < 16; ++i )
-                for ( unsigned int j = 0; j< 4;++j )
-                    b += *get_ptr_at<TChannelType>( region_start, x + j, y + i, stride );
+    for ( unsigned int y = 0; y < region.height; ++y )
+    {
+        const TChannelType* line = (const TChannelType*)(region_start + y * stride);
 
-            b /= 16;
+        for ( unsigned int c = 0; c < band_count; ++c )
+        {
+            const TChannelType* p = line + band_x[c];
+            uint32_t* band = &column_prefix[c * (region.height + 1)];
 
-            unsigned int contrast = abs_(a-b);
-            max_contrast = max(contrast, max_contrast);
+            band[y + 1] = band[y] + p[0] + p[1] + p[2] + p[3];
         }
-        sharpness += max_contrast;
     }
+
+    for ( unsigned int c = 0; c < band_count; ++c )
+    {
+        sharpness += max_box_contrast( &column_prefix[c * (region.height + 1)], region.height );
+    }
+
     return sharpness;
 }
 
 
 static unsigned int autofocus_get_contrast ( const img_descriptor& image, const RegionInfo& region )
 {
-    if ( image.type == FOURCC_Y16 )
-    {
-        return autofocus_get_contrast_<uint16_t>( image, region );
-    }
-    else
+    switch ( image.type )
     {
-        return autofocus_get_contrast_<uint8_t>( image, region );
+        case FOURCC_Y16:
+        case FOURCC_BGGR16:
+        case FOURCC_GBRG16:
+        case FOURCC_GRBG16:
+        case FOURCC_RGGB16:
+            return autofocus_get_contrast_<uint16_t>( image, region );
+        default:
+            return autofocus_get_contrast_<uint8_t>( image, region );
     }
 }
 
@@ -171,19 +241,49 @@ static void autofocus_get_all_regions_ ( const img_descriptor& image, RegionInfo
     unsigned int start_x = (image.dim_x - regions_x * REGION_SIZE) / 2;
     unsigned int start_y = (image.dim_y - regions_y * REGION_SIZE) / 2;
 
-    for ( unsigned int y = 0; y < regions_y; ++y )
+    // regions are independent; rows of regions are scored in parallel
+    auto score_rows = [&] ( unsigned int first_row, unsigned int row_step )
     {
-        for ( unsigned int x = 0; x < regions_x; ++x )
+        for ( unsigned int y = first_row; y < regions_y; y += row_step )
         {
-            RegionInfo& r = regions[y*regions_x + x];
-            r.x = start_x + x * REGION_SIZE;
-            r.y = start_y + y * REGION_SIZE;
-            r.width = REGION_SIZE;
-            r.height = REGION_SIZE;
-
-            r.sharpness = autofocus_get_contrast( image, r );
-            r.weighted_sharpness = 0;
+            for ( unsigned int x = 0; x < regions_x; ++x )
+            {
+                RegionInfo& r = regions[y*regions_x + x];
+                r.x = start_x + x * REGION_SIZE;
+                r.y = start_y + y * REGION_SIZE;
+                r.width = REGION_SIZE;
+                r.height = REGION_SIZE;
+
+                r.sharpness = autofocus_get_contrast( image, r );
+                r.weighted_sharpness = 0;
+            }
         }
+    };
+
+    unsigned int thread_count = std::thread::hardware_concurrency();
+
+    if ( regions_x * regions_y < MIN_REGIONS_PER_THREAD * 2 || thread_count < 2 )
+    {
+        thread_count = 1;
+    }
+    else
+    {
+        thread_count = min(thread_count, (regions_x * regions_y) / MIN_REGIONS_PER_THREAD);
+        thread_count = min(thread_count, regions_y);
+    }
+
+    std::vector<std::thread> workers;
+
+    for ( unsigned int t = 1; t < thread_count; ++t )
+    {
+        workers.push_back(std::thread(score_rows, t, thread_count));
+    }
+
+    score_rows(0, thread_count);
+
+    for ( auto& w : workers )
+    {
+        w.join();
     }
 
     for ( unsigned int y = 0; y < regions_y; ++y )
@@ -283,12 +383,12 @@ static bool is_user_roi_valid ( const img_descriptor& image, const RECT& r )
 
 
 img::auto_focus::auto_focus ()
-    : focus_applied_( 1 ), focus_min_( 0 ), focus_max_( 0 ),
-      max_time_to_wait_for_focus_change_( 1000 ), img_wait_cnt( 0 )//, min_time_to_wait_for_focus_change_( 1000 )
+    : focus_applied_( true ), applied_focus_val_( 0 ), move_pending_( false ),
+      frame_count_( 0 ), focus_effective_frame_( 0 ), focus_min_( 0 ), focus_max_( 0 ),
+      max_time_to_wait_for_focus_change_( 1000 ), min_time_to_wait_for_focus_change_( 0 )
 {
     data.state = data_holder::ended;
     data.focus_val = 0;
-    data.stepCount = 0;
     pthread_mutex_init(&this->param_mtx_, NULL);
 }
 
@@ -311,15 +411,20 @@ void img::auto_focus::run ( int focus_val, int min, int max, const RECT& roi,
     focus_min_ = min;
     focus_max_ = max;
     max_time_to_wait_for_focus_change_ = speed;
-    min_time_to_wait_for_focus_change_ = 300;
-    auto_step_divisor_ = auto_step_divisor;
+    // frame counting already covers the pipeline latency,
+    // only the lens travel time has to be waited for
+    min_time_to_wait_for_focus_change_ = 0;
+    auto_step_divisor_ = auto_step_divisor > 0 ? auto_step_divisor : 1;
     sweep_suggested_ = suggest_sweep;
 
     data.focus_val = focus_val;
 
     data.state = data_holder::init;
-    focus_applied_ = 1;
-    data.stepCount = 0;
+    focus_applied_ = false;
+    move_pending_ = false;
+    frame_count_ = 0;
+    focus_effective_frame_ = 0;
+    clock_gettime(CLOCK_MONOTONIC, &img_wait_endtime);
     user_roi_ = roi;
 
     pthread_mutex_unlock(&param_mtx_);
@@ -383,6 +488,8 @@ bool img::auto_focus::analyze_frame ( const img_descriptor& img, POINT offsets,
         return false;
     }
 
+    frame_count_++;
+
     bool rval = false;
     if ( data.state == data_holder::init )
     {
@@ -400,27 +507,26 @@ bool img::auto_focus::analyze_frame ( const img_descriptor& img, POINT offsets,
             user_roi_.right = (user_roi_.right - offsets.x) / binning_value;
         }
 
+        // the region stays fixed for the whole run,
+        // sharpness values of different regions can not be compared
         RegionInfo info;
         find_region( img, user_roi_, info );
         restart_roi( info );
 
-        if ( !sweep_suggested_ || (data.prev_sharpness > SWEEP_SHARPNESS_THRESHOLD) )
+        if ( !sweep_suggested_ && (data.prev_sharpness > SWEEP_SHARPNESS_THRESHOLD) )
         {
-            data.state = data_holder::binary_search;
-            data.sweep_step = 0;
+            // image is already reasonably sharp, only look at the surroundings
+            int range = (data.right - data.left) / auto_step_divisor_;
+
+            start_sweep( CLIP(data.focus_val - range / 2, data.left, data.right),
+                         CLIP(data.focus_val + range / 2, data.left, data.right) );
         }
         else
         {
-            data.state = data_holder::sweep_1;
-
-            if ( (data.focus_val - data.left) > (data.right - data.focus_val) )
-                data.sweep_step = -(data.right - data.left) / 20;
-            else
-                data.sweep_step = (data.right - data.left) / 20;
+            start_sweep( data.left, data.right );
         }
-        data.prev_focus = data.focus_val;
 
-        new_focus_val = calc_next_focus();
+        new_focus_val = data.sweep_focus[0];
         rval = true;
     }
     else
@@ -440,11 +546,23 @@ bool img::auto_focus::analyze_frame ( const img_descriptor& img, POINT offsets,
 
             return false;
         }
-        if ( !focus_applied_ )
+        if ( move_pending_ )
         {
-            pthread_mutex_unlock(&param_mtx_);
+            if ( !focus_applied_.exchange( false ) )
+            {
+                pthread_mutex_unlock(&param_mtx_);
 
-            return false;
+                return false;
+            }
+
+            // the frames that are currently exposed or transferred
+            // were taken before the device received the new value
+            int prev_focus = data.focus_val;
+            data.focus_val = applied_focus_val_;
+            focus_effective_frame_ = frame_count_ + FOCUS_FRAME_LATENCY;
+            arm_focus_timer( abs_(data.focus_val - prev_focus) );
+
+            move_pending_ = false;
         }
         if ( check_wait_condition() )
         {
@@ -454,8 +572,7 @@ bool img::auto_focus::analyze_frame ( const img_descriptor& img, POINT offsets,
 
     if ( rval )
     {
-        focus_applied_ = 0;
-        arm_focus_timer( abs_(data.prev_focus - new_focus_val) );
+        move_pending_ = true;
     }
     pthread_mutex_unlock(&param_mtx_);
 
@@ -465,115 +582,209 @@ bool img::auto_focus::analyze_frame ( const img_descriptor& img, POINT offsets,
 
 bool img::auto_focus::analyze_frame_ ( const img_descriptor& img, int& new_focus_val )
 {
-    data.stepCount += 1;
-    if ( (data.stepCount == 4 || data.stepCount == 8) )
+    int sq = get_sharpness( img );
+
+    if ( data.state == data_holder::coarse_sweep )
     {
-        RegionInfo newROI;
-        find_region( img, user_roi_, newROI );
-        if ( data.x != newROI.x || data.y != newROI.y )
+        data.sweep_focus[data.sweep_index] = data.focus_val;
+        data.sweep_sharpness[data.sweep_index] = sq;
+        data.sweep_index++;
+
+        if ( data.sweep_index < data.sweep_count )
+        {
+            new_focus_val = data.sweep_focus[data.sweep_index];
+            return true;
+        }
+
+        start_refine();
+
+        if ( calc_refine_focus( new_focus_val ) )
         {
-            restart_roi( newROI );
-            new_focus_val = calc_next_focus();
             return true;
         }
     }
+    else if ( data.state == data_holder::refine )
+    {
+        add_refine_sample( data.focus_val, sq );
 
-    // In sweep mode, look for the region with the highest sharpness on every frame
-    if ( (data.state == data_holder::sweep_1) || (data.state == data_holder::sweep_2) )
+        if ( calc_refine_focus( new_focus_val ) )
+        {
+            return true;
+        }
+    }
+
+    // search is done; move to the sharpest position that was seen
+    data.state = data_holder::ended;
+
+    if ( data.best != data.focus_val )
     {
-        RegionInfo newROI;
-        find_region(img, user_roi_, newROI);
-        data.x = newROI.x;
-        data.y = newROI.y;
-        data.width = newROI.width;
-        data.height = newROI.height;
+        new_focus_val = data.best;
+        return true;
     }
 
-    int sq = get_sharpness( img );
+    return false;
+}
+
 
-    if ( (data.state == data_holder::sweep_1) || (data.state == data_holder::sweep_2) )
+void img::auto_focus::start_sweep ( int left, int right )
+{
+    unsigned int count = SWEEP_POINTS;
+
+    if ( (unsigned int)(right - left) < count )
     {
-        if ( sq > SWEEP_SHARPNESS_THRESHOLD )
-        {
-            data.state = data_holder::binary_search;
+        count = right - left + 1;
+    }
 
-            if ( data.sweep_step > 0 )
-                data.left = data.focus_val - data.sweep_step;
-            else
-                data.right = data.focus_val - data.sweep_step;
+    // begin at the end that is closer to the current focus to keep the first move short
+    bool ascending = (data.focus_val - left) <= (right - data.focus_val);
 
-            data.prev_focus = data.focus_val;
-            data.prev_sharpness = sq;
-            new_focus_val = calc_next_focus();
+    for ( unsigned int i = 0; i < count; ++i )
+    {
+        int pos = count > 1 ? left + (int)(((long long)(right - left) * i) / (count - 1)) : left;
 
-            // debug_out( "SWEEP SUCCESS: focus_val = %d, sharpness = %d => state = binary_search, new_focus_val = %d\n", data.focus_val, sq, new_focus_val );
+        data.sweep_focus[ascending ? i : count - 1 - i] = pos;
+        data.sweep_sharpness[i] = 0;
+    }
 
-            return true;
-        }
-        else
+    data.sweep_count = count;
+    data.sweep_index = 0;
+    data.state = data_holder::coarse_sweep;
+}
+
+
+void img::auto_focus::start_refine ()
+{
+    unsigned int best_idx = 0;
+
+    for ( unsigned int i = 1; i < data.sweep_count; ++i )
+    {
+        if ( data.sweep_sharpness[i] > data.sweep_sharpness[best_idx] )
         {
-            new_focus_val = data.focus_val + data.sweep_step;
-            if ( new_focus_val < data.left ) new_focus_val = data.left;
-            if ( new_focus_val > data.right) new_focus_val = data.right;
+            best_idx = i;
+        }
+    }
 
-            if ( ((data.sweep_step < 0) && (new_focus_val == data.left))
-                || ((data.sweep_step > 0) && (new_focus_val == data.right)) )
-            {
-                if ( data.state == data_holder::sweep_1 )
-                {
-                    data.state = data_holder::sweep_2;
-                    data.sweep_step = -data.sweep_step;
+    // the maximum lies between the neighbours of the best sweep position
+    unsigned int lo = best_idx > 0 ? best_idx - 1 : best_idx;
+    unsigned int hi = best_idx + 1 < data.sweep_count ? best_idx + 1 : best_idx;
 
-                    // Restart from where sweep_1 was started
-                    new_focus_val = data.prev_focus;
-                }
-                else
-                {
-                    data.state = data_holder::binary_search;
+    if ( data.sweep_focus[lo] > data.sweep_focus[hi] )
+    {
+        unsigned int tmp = lo;
+        lo = hi;
+        hi = tmp;
+    }
 
-                    data.prev_focus = data.focus_val;
-                    data.prev_sharpness = sq;
-                    new_focus_val = calc_next_focus();
-                }
-            }
+    data.a = data.sweep_focus[lo];
+    data.fa = data.sweep_sharpness[lo];
+    data.best = data.sweep_focus[best_idx];
+    data.fbest = data.sweep_sharpness[best_idx];
+    data.b = data.sweep_focus[hi];
+    data.fb = data.sweep_sharpness[hi];
 
-            return true;
+    data.refine_steps = 0;
+    data.last_step_parabolic = false;
+    data.state = data_holder::refine;
+}
+
+
+void img::auto_focus::add_refine_sample ( int focus, int sharpness )
+{
+    data.refine_steps++;
+
+    if ( sharpness >= data.fbest )
+    {
+        data.last_step_parabolic = false;
+
+        if ( focus < data.best )
+        {
+            data.b = data.best;
+            data.fb = data.fbest;
         }
+        else
+        {
+            data.a = data.best;
+            data.fa = data.fbest;
+        }
+        data.best = focus;
+        data.fbest = sharpness;
     }
-
-    if ( data.state == data_holder::binary_search )
+    else
     {
-        if ( sq < data.prev_sharpness )
+        // a parabolic guess that did not improve anything is not repeated,
+        // last_step_parabolic stays set so that the next step is a golden section step
+        if ( focus < data.best )
         {
-            if ( data.focus_val < data.prev_focus )
-                data.left = data.focus_val;
-            else
-                data.right = data.focus_val;
+            data.a = focus;
+            data.fa = sharpness;
         }
-        else // sq >= prev_sharpness
+        else
         {
-            if ( data.focus_val < data.prev_focus )
-                data.right = data.prev_focus;
-            else
-                data.left = data.prev_focus;
-
-            data.prev_focus = data.focus_val;
-            data.prev_sharpness = sq;
+            data.b = focus;
+            data.fb = sharpness;
         }
+    }
+}
+
+
+bool img::auto_focus::calc_refine_focus ( int& new_focus )
+{
+    if ( (data.b - data.a) <= 2 || data.refine_steps >= MAX_REFINE_STEPS )
+    {
+        return false;
+    }
+
+    int u = data.best;
+
+    // vertex of the parabola through the three bracket points
+    if ( data.a < data.best && data.best < data.b && !data.last_step_parabolic )
+    {
+        double da = data.best - data.a;
+        double db = data.best - data.b;
+        double p = da * da * (data.fbest - data.fb) - db * db * (data.fbest - data.fa);
+        double q = da * (data.fbest - data.fb) - db * (data.fbest - data.fa);
 
-        if ( (data.right - data.left) > 2 )
+        if ( q != 0.0 )
         {
-            new_focus_val = calc_next_focus();
+            double vertex = data.best - 0.5 * p / q;
 
-            return true;
+            if ( vertex > data.a && vertex < data.b )
+            {
+                u = (int)(vertex + (vertex < 0 ? -0.5 : 0.5));
+            }
+        }
+    }
+
+    if ( u != data.best && u > data.a && u < data.b )
+    {
+        data.last_step_parabolic = true;
+    }
+    else
+    {
+        // golden section step into the larger part of the bracket
+        if ( (data.best - data.a) > (data.b - data.best) )
+        {
+            u = data.best - (int)(GOLDEN_SECTION * (data.best - data.a));
         }
         else
         {
-            data.state = data_holder::ended;
+            u = data.best + (int)(GOLDEN_SECTION * (data.b - data.best));
         }
+
+        if ( u == data.best )
+        {
+            u += (data.best - data.a) > (data.b - data.best) ? -1 : 1;
+        }
+        data.last_step_parabolic = false;
     }
 
-    return false;
+    if ( u <= data.a || u >= data.b )
+    {
+        return false;
+    }
+
+    new_focus = u;
+    return true;
 }
 
 
@@ -589,23 +800,6 @@ unsigned int img::auto_focus::get_sharpness ( const img_descriptor& img )
 }
 
 
-int img::auto_focus::calc_next_focus ()
-{
-    unsigned int dl = abs_(data.left - data.prev_focus);
-    unsigned int dr = abs_(data.right - data.prev_focus);
-
-    int div = auto_step_divisor_;
-    unsigned int lstep = dl / div;
-    unsigned int rstep = dr / div;
-    if ( !lstep ) lstep = 1;
-    if ( !rstep ) rstep = 1;
-
-    int new_focus = (dl > dr) ? (data.prev_focus - lstep) : (data.prev_focus + rstep);
-
-    return new_focus;
-}
-
-
 void img::auto_focus::restart_roi ( const RegionInfo& info )
 {
     data.x = info.x;
@@ -622,54 +816,50 @@ void img::auto_focus::restart_roi ( const RegionInfo& info )
 
 void img::auto_focus::update_focus ( int focus_val )
 {
-    int ret = pthread_mutex_trylock(&param_mtx_);
-
-    if (ret != 0)
-        return;
-
-    data.focus_val = focus_val;
-    focus_applied_ = 1;
-
-    pthread_mutex_unlock(&param_mtx_);
+    applied_focus_val_ = focus_val;
+    focus_applied_ = true;
 }
 
 
 bool img::auto_focus::check_wait_condition ()
 {
-    if ( --img_wait_cnt < 0 )
+    if ( frame_count_ <= focus_effective_frame_ )
     {
-        timespec time2;
-        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time2);
-        if (time2.tv_sec > img_wait_endtime.tv_sec)
-        {
-            return true;
-        }
+        return false;
+    }
 
-        if (time2.tv_sec == img_wait_endtime.tv_sec)
-            if (time2.tv_nsec > img_wait_endtime.tv_nsec)
-            {
-                return true;
-            }
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (now.tv_sec != img_wait_endtime.tv_sec)
+    {
+        return now.tv_sec > img_wait_endtime.tv_sec;
     }
-    return false;
+
+    return now.tv_nsec >= img_wait_endtime.tv_nsec;
 }
 
 
 void img::auto_focus::arm_focus_timer ( int diff )
 {
     int ms_to_use = 0;
-    if( diff > 0 )
+    if( diff > 0 && focus_max_ > focus_min_ )
     {
         ms_to_use = (diff * max_time_to_wait_for_focus_change_) / (focus_max_ - focus_min_);
     }
-    // we have to wait for at least n frames and at least for focus_min_move_speed_ milliseconds
     if( ms_to_use < min_time_to_wait_for_focus_change_ )
         ms_to_use = min_time_to_wait_for_focus_change_;
 
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &img_wait_endtime);
-    img_wait_endtime.tv_nsec = ms_to_use*1000*1000;
+    clock_gettime(CLOCK_MONOTONIC, &img_wait_endtime);
 
-    img_wait_cnt = 3; // at least we have to wait 2 frames due to frame latency
+    img_wait_endtime.tv_sec += ms_to_use / 1000;
+    img_wait_endtime.tv_nsec += (long)(ms_to_use % 1000) * 1000 * 1000;
+
+    if (img_wait_endtime.tv_nsec >= 1000 * 1000 * 1000)
+    {
+        img_wait_endtime.tv_sec += 1;
+        img_wait_endtime.tv_nsec -= 1000 * 1000 * 1000;
+    }
 }
 
 
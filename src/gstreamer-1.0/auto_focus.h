@@ -20,6 +20,7 @@
 #include "image_transform_base.h"
 #include <pthread.h>
 #include <ctime>
+#include <atomic>
 
 
 namespace {
@@ -46,6 +47,8 @@ public:
 
     /*
      * This must be called each time when the focus value was changed for the device.
+     * Calling it from another thread, e.g. on completion of an asynchronous write, is allowed.
+     * Frames arriving afterwards are only analyzed when they were exposed with the new value.
      */
     void update_focus ( int focus_val );
 private:
@@ -62,18 +65,23 @@ private:
     void restart_roi ( const RegionInfo& info );
     void find_region ( const img_descriptor& image, RECT roi, RegionInfo& region );
 
-    int calc_next_focus ();
+    void start_sweep ( int left, int right );
+    void start_refine ();
+    void add_refine_sample ( int focus, int sharpness );
+    bool calc_refine_focus ( int& new_focus );
 
     unsigned int get_sharpness ( const img_descriptor& img );
 
     bool check_wait_condition ();
     void arm_focus_timer ( int diff );
 
+    static const unsigned int SWEEP_POINTS = 9;
+
     struct data_holder
     {
         unsigned int x, y, width, height;
 
-        unsigned int stepCount;
+        // focus value the analyzed frames were taken with
         int focus_val;
 
         int left, right;
@@ -81,15 +89,25 @@ private:
         int prev_sharpness;
         int prev_focus;
 
-        int sweep_step;
+        // coarse sweep, positions in the order they are visited
+        int sweep_focus[SWEEP_POINTS];
+        int sweep_sharpness[SWEEP_POINTS];
+        unsigned int sweep_count;
+        unsigned int sweep_index;
+
+        // refinement bracket: a <= best <= b
+        int a, fa;
+        int best, fbest;
+        int b, fb;
+        unsigned int refine_steps;
+        bool last_step_parabolic;
 
         enum
         {
             ended = 0,
             init,
-            sweep_1,
-            sweep_2,
-            binary_search,
+            coarse_sweep,
+            refine,
         } state;
     } data;
 
@@ -99,7 +117,18 @@ private:
     unsigned int init_binning_;
     POINT init_offset_;
 
-    volatile long focus_applied_;
+    // set by update_focus, consumed by analyze_frame
+    // atomic so that the device write completion never has to wait for param_mtx_
+    std::atomic<bool> focus_applied_;
+    std::atomic<int> applied_focus_val_;
+
+    // true while a focus move was requested but not yet written to the device
+    bool move_pending_;
+
+    // number of frames analyze_frame has seen since run()
+    uint64_t frame_count_;
+    // frames with a number greater than this show the current focus value
+    uint64_t focus_effective_frame_;
 
     int focus_min_;
     int focus_max_;
@@ -112,8 +141,8 @@ private:
 
     bool sweep_suggested_;
 
+    // CLOCK_MONOTONIC time the lens is expected to have reached its position
     struct timespec img_wait_endtime;
-    int img_wait_cnt;
 
 }; // class auto_focus
 
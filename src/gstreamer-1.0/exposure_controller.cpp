@@ -0,0 +1,294 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "exposure_controller.h"
+
+#include <cmath>
+
+using namespace tcam;
+
+
+namespace
+{
+
+// histogram bins at or above this value are considered saturated
+const unsigned int CLIP_LEVEL = 250;
+
+// fraction of samples that may be saturated before the image is darkened
+const double MAX_CLIPPED_FRACTION = 0.02;
+
+// highlight protection may pull the mean at most down to this part of the reference
+const double MIN_HIGHLIGHT_MEAN = 0.5;
+
+// no change while the mean is this close to the reference
+const double DEADBAND = 5.0;
+
+// largest brightness change per step; limits the damage of a bad measurement
+const double MAX_STEP_RATIO = 8.0;
+
+// gain units that double the image brightness
+const double GAIN_STEPS_PER_DOUBLING = 30.0;
+
+// changes below these values are not worth a write
+const double MIN_EXPOSURE_CHANGE = 1.0;
+const double MIN_GAIN_CHANGE = 0.5;
+
+
+double clamp (double value, double min, double max)
+{
+    return std::fmax(min, std::fmin(value, max));
+}
+
+
+struct luminance
+{
+    double mean;
+    double clipped_fraction;
+    // brightest value that is not part of the allowed clipped fraction
+    unsigned int highlight;
+};
+
+
+luminance analyze_histogram (const struct tcam_image_statistics& statistics)
+{
+    luminance lum = {(double)statistics.brightness, 0.0, 0};
+
+    if (statistics.sample_count == 0)
+    {
+        return lum;
+    }
+
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t clipped = 0;
+
+    for (unsigned int i = 0; i < 256; ++i)
+    {
+        total += statistics.histogram[i];
+        sum += (uint64_t)i * statistics.histogram[i];
+
+        if (i >= CLIP_LEVEL)
+        {
+            clipped += statistics.histogram[i];
+        }
+    }
+
+    if (total == 0)
+    {
+        return lum;
+    }
+
+    lum.mean = (double)sum / total;
+    lum.clipped_fraction = (double)clipped / total;
+
+    uint64_t allowed = (uint64_t)(total * MAX_CLIPPED_FRACTION);
+    uint64_t above = 0;
+
+    lum.highlight = 255;
+    while (lum.highlight > 0 && above + statistics.histogram[lum.highlight] <= allowed)
+    {
+        above += statistics.histogram[lum.highlight];
+        lum.highlight--;
+    }
+
+    return lum;
+}
+
+} /* namespace */
+
+
+ExposureController::ExposureController ()
+    : reference(128), latency(2),
+      frame_count(0), settle_frame(0), pending_writes(0),
+      converged(false)
+{}
+
+
+void ExposureController::set_reference (unsigned int ref)
+{
+    reference = ref > 255 ? 255 : ref;
+}
+
+
+unsigned int ExposureController::get_reference () const
+{
+    return reference;
+}
+
+
+void ExposureController::set_latency (unsigned int frames)
+{
+    latency = frames;
+}
+
+
+unsigned int ExposureController::get_latency () const
+{
+    return latency;
+}
+
+
+bool ExposureController::new_frame ()
+{
+    uint64_t frame = ++frame_count;
+
+    return pending_writes == 0 && frame > settle_frame;
+}
+
+
+void ExposureController::change_requested (unsigned int write_count)
+{
+    pending_writes += write_count;
+}
+
+
+void ExposureController::change_applied ()
+{
+    // frames in flight while the device received the value still show the old one
+    settle_frame = frame_count + latency;
+
+    if (pending_writes > 0)
+    {
+        --pending_writes;
+    }
+}
+
+
+bool ExposureController::is_converged () const
+{
+    return converged;
+}
+
+
+bool ExposureController::evaluate (const struct tcam_image_statistics& statistics, state& values)
+{
+    if (!values.auto_exposure && !values.auto_gain)
+    {
+        return false;
+    }
+
+    const luminance lum = analyze_histogram(statistics);
+    const double ref = reference;
+
+    double ratio;
+
+    if (lum.mean < 1.0)
+    {
+        ratio = MAX_STEP_RATIO;
+    }
+    else
+    {
+        ratio = ref / lum.mean;
+    }
+
+    bool highlights_clipped = lum.clipped_fraction > MAX_CLIPPED_FRACTION;
+
+    if (lum.mean >= CLIP_LEVEL)
+    {
+        // everything is saturated, the real brightness is unknown
+        ratio = 1.0 / MAX_STEP_RATIO;
+    }
+    else if (lum.highlight > 0)
+    {
+        // scale so that the allowed highlights end up just below saturation;
+        // with too many saturated pixels their real brightness is unknown, halve it
+        double highlight_ratio = (double)(CLIP_LEVEL - 1) / lum.highlight;
+
+        if (lum.highlight >= CLIP_LEVEL)
+        {
+            highlight_ratio = 0.5;
+        }
+
+        // a small bright light source must not darken the whole image
+        ratio = std::fmin(ratio, std::fmax(highlight_ratio, MIN_HIGHLIGHT_MEAN * ref / lum.mean));
+    }
+    ratio = clamp(ratio, 1.0 / MAX_STEP_RATIO, MAX_STEP_RATIO);
+
+    state next = values;
+
+    if (std::fabs(lum.mean - ref) <= DEADBAND && !highlights_clipped)
+    {
+        // trade gain for exposure; keeps the brightness and reduces noise
+        if (values.auto_exposure && values.auto_gain
+            && values.gain > values.gain_min
+            && values.exposure > 0.0 && values.exposure < values.exposure_max)
+        {
+            double doublings = std::fmin(std::log2(values.exposure_max / values.exposure),
+                                         (values.gain - values.gain_min) / GAIN_STEPS_PER_DOUBLING);
+
+            next.exposure = values.exposure * std::pow(2.0, doublings);
+            next.gain = values.gain - doublings * GAIN_STEPS_PER_DOUBLING;
+        }
+    }
+    else
+    {
+        double remaining = ratio;
+
+        if (ratio > 1.0)
+        {
+            // brighten: exposure first, then gain
+            if (values.auto_exposure)
+            {
+                // an exposure of 0 can not be scaled, start from the smallest usable one
+                double exposure = std::fmax(values.exposure, std::fmax(values.exposure_min, MIN_EXPOSURE_CHANGE));
+
+                next.exposure = clamp(exposure * remaining,
+                                      values.exposure_min, values.exposure_max);
+                remaining *= exposure / std::fmax(next.exposure, MIN_EXPOSURE_CHANGE);
+            }
+            if (values.auto_gain)
+            {
+                next.gain = clamp(values.gain + std::log2(remaining) * GAIN_STEPS_PER_DOUBLING,
+                                  values.gain_min, values.gain_max);
+            }
+        }
+        else
+        {
+            // darken: gain first, then exposure
+            if (values.auto_gain)
+            {
+                next.gain = clamp(values.gain + std::log2(remaining) * GAIN_STEPS_PER_DOUBLING,
+                                  values.gain_min, values.gain_max);
+                remaining /= std::pow(2.0, (next.gain - values.gain) / GAIN_STEPS_PER_DOUBLING);
+            }
+            if (values.auto_exposure)
+            {
+                next.exposure = clamp(values.exposure * remaining,
+                                      values.exposure_min, values.exposure_max);
+            }
+        }
+    }
+
+    if (std::fabs(next.exposure - values.exposure) < MIN_EXPOSURE_CHANGE)
+    {
+        next.exposure = values.exposure;
+    }
+    if (std::fabs(next.gain - values.gain) < MIN_GAIN_CHANGE)
+    {
+        next.gain = values.gain;
+    }
+
+    if (next.exposure == values.exposure && next.gain == values.gain)
+    {
+        converged = true;
+        return false;
+    }
+
+    converged = false;
+    values = next;
+    return true;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef TCAM_EXPOSURE_CONTROLLER_H
+#define TCAM_EXPOSURE_CONTROLLER_H
+
+#include "image_statistics.h"
+
+#include <atomic>
+
+namespace tcam
+{
+
+/**
+ * Exposure/gain control loop working on luminance histograms.
+ *
+ * The controller does not talk to a device. It is fed with statistics
+ * and frame events and returns the values that shall be written, so
+ * recorded statistics can be replayed to measure convergence.
+ *
+ * Frames that were exposed before the last change reached the device
+ * are not evaluated: every write has to be confirmed with
+ * change_applied() and afterwards the configured number of frames
+ * is skipped.
+ */
+class ExposureController
+{
+public:
+
+    struct state
+    {
+        double exposure;
+        double exposure_min;
+        double exposure_max;
+
+        double gain;
+        double gain_min;
+        double gain_max;
+
+        bool auto_exposure;
+        bool auto_gain;
+    };
+
+    ExposureController ();
+
+    /**
+     * @brief Brightness the mean of the image shall have
+     * @param reference - 0 - 255
+     */
+    void set_reference (unsigned int reference);
+
+    unsigned int get_reference () const;
+
+    /**
+     * @brief Number of frames the camera needs until a new exposure is visible
+     * @param frames - frames that are already exposed or transferred when a change is applied
+     */
+    void set_latency (unsigned int frames);
+
+    unsigned int get_latency () const;
+
+    /**
+     * @brief Has to be called once per frame by the streaming thread
+     * @return true if the frame was taken with the current settings and may be evaluated
+     */
+    bool new_frame ();
+
+    /**
+     * @brief Calculate the next exposure and gain values
+     * @param statistics - statistics of a frame for which new_frame() returned true
+     * @param values - current values and limits; receives the new values
+     * @return true if values changed and have to be written
+     */
+    bool evaluate (const struct tcam_image_statistics& statistics, state& values);
+
+    /**
+     * @brief Announce writes that have to be confirmed before frames are evaluated again
+     */
+    void change_requested (unsigned int write_count);
+
+    /**
+     * @brief Confirm one write announced with change_requested
+     */
+    void change_applied ();
+
+    /**
+     * @return true if the last evaluation did not require changes
+     */
+    bool is_converged () const;
+
+private:
+
+    std::atomic<unsigned int> reference;
+    std::atomic<unsigned int> latency;
+
+    std::atomic<uint64_t> frame_count;
+    std::atomic<uint64_t> settle_frame;
+    std::atomic<int> pending_writes;
+
+    std::atomic<bool> converged;
+};
+
+} /* namespace tcam */
+
+#endif /* TCAM_EXPOSURE_CONTROLLER_H */
@@ -30,18 +30,16 @@
 
 #include "bayer.h"
 #include "image_sampling.h"
+#include "gsttcamstatisticsmeta.h"
+#include "algorithm_runner.h"
+#include "exposure_controller.h"
+
+#include <atomic>
+#include <mutex>
 
 GST_DEBUG_CATEGORY_STATIC (gst_tcamautoexposure_debug_category);
 #define GST_CAT_DEFAULT gst_tcamautoexposure_debug_category
 
-/* Constants */
-static const gdouble K_CONTROL  = 0.5 / 255;
-static const gdouble K_DEADBAND = 5.0;
-static const gdouble K_GAIN     = 3.0;
-static const gdouble K_ADJUST   = 4;
-static const gdouble K_SMALL    = 1e-9;
-
-
 /* prototypes */
 
 static void gst_tcamautoexposure_set_property (GObject* object,
@@ -73,6 +71,10 @@ enum
     PROP_ROI_TOP,
     PROP_ROI_WIDTH,
     PROP_ROI_HEIGHT,
+    PROP_ANALYSIS_INTERVAL,
+    PROP_ANALYSIS_RATE,
+    PROP_CONTROL_LATENCY,
+    PROP_METERING_MODE,
 };
 
 
@@ -88,6 +90,10 @@ static void gst_tcamautoexposure_get_property (GObject* object,
                                                GParamSpec* pspec);
 static void gst_tcamautoexposure_finalize (GObject* object);
 
+static gboolean gst_tcamautoexposure_start (GstBaseTransform* trans);
+
+static gboolean gst_tcamautoexposure_stop (GstBaseTransform* trans);
+
 static GstFlowReturn gst_tcamautoexposure_transform_ip (GstBaseTransform* trans, GstBuffer* buf);
 static GstCaps* gst_tcamautoexposure_transform_caps (GstBaseTransform* trans,
                                                      GstPadDirection direction,
@@ -322,6 +328,8 @@ static gboolean gst_tcamautoexposure_get_tcam_property (TcamProp* prop,
 
     GstTcamautoexposure* self = GST_TCAMAUTOEXPOSURE(prop);
 
+    std::lock_guard<std::mutex> lck(self->priv->mtx);
+
     if (g_strcmp0(name, tcamautoexposure_property_id_to_string(PROP_AUTO_EXPOSURE)) == 0)
     {
         if (value)
@@ -806,18 +814,20 @@ static gboolean gst_tcamautoexposure_get_device_info (TcamProp* self,
     return FALSE;
 }
 /* pad templates */
-
+/* only formats the image statistics can analyze are accepted */
 static GstStaticPadTemplate gst_tcamautoexposure_sink_template =
     GST_STATIC_PAD_TEMPLATE ("sink",
                              GST_PAD_SINK,
                              GST_PAD_ALWAYS,
-                             GST_STATIC_CAPS ("ANY"));
+                             GST_STATIC_CAPS ("video/x-bayer,format=(string){bggr,grbg,gbrg,rggb,bggr16,grbg16,gbrg16,rggb16,bggr16le,grbg16le,gbrg16le,rggb16le},framerate=(fraction)[0/1,MAX],width=[1,MAX],height=[1,MAX];"
+                                              "video/x-raw,format=(string){GRAY8,GRAY16_LE},framerate=(fraction)[0/1,MAX],width=[1,MAX],height=[1,MAX]"));
 
 static GstStaticPadTemplate gst_tcamautoexposure_src_template =
     GST_STATIC_PAD_TEMPLATE ("src",
                              GST_PAD_SRC,
                              GST_PAD_ALWAYS,
-                             GST_STATIC_CAPS ("ANY"));
+                             GST_STATIC_CAPS ("video/x-bayer,format=(string){bggr,grbg,gbrg,rggb,bggr16,grbg16,gbrg16,rggb16,bggr16le,grbg16le,gbrg16le,rggb16le},framerate=(fraction)[0/1,MAX],width=[1,MAX],height=[1,MAX];"
+                                              "video/x-raw,format=(string){GRAY8,GRAY16_LE},framerate=(fraction)[0/1,MAX],width=[1,MAX],height=[1,MAX]"));
 
 
 /* class initialization */
@@ -844,6 +854,8 @@ static void gst_tcamautoexposure_class_init (GstTcamautoexposureClass* klass)
     gobject_class->set_property = gst_tcamautoexposure_set_property;
     gobject_class->get_property = gst_tcamautoexposure_get_property;
     gobject_class->finalize = gst_tcamautoexposure_finalize;
+    base_transform_class->start = gst_tcamautoexposure_start;
+    base_transform_class->stop = gst_tcamautoexposure_stop;
     base_transform_class->transform_ip = gst_tcamautoexposure_transform_ip;
     // base_transform_class->transform_caps = gst_tcamautoexposure_transform_caps;
     //base_transform_class->fixate_caps = gst_tcamautoexposure_fixate_caps;
@@ -922,15 +934,65 @@ static void gst_tcamautoexposure_class_init (GstTcamautoexposureClass* klass)
                                                           "Gstreamer element that shall be manipulated",
                                                           GST_TYPE_ELEMENT,
                                                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property (gobject_class,
+                                     PROP_ANALYSIS_INTERVAL,
+                                     g_param_spec_uint ("analysis-interval",
+                                                        "Analysis Interval",
+                                                        "Analyze every n-th frame; ignored when analysis-rate is set",
+                                                        1, G_MAXUINT, 4,
+                                                        G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property (gobject_class,
+                                     PROP_ANALYSIS_RATE,
+                                     g_param_spec_double ("analysis-rate",
+                                                          "Analysis Rate",
+                                                          "Analyses per second; 0 to use analysis-interval",
+                                                          0.0, G_MAXDOUBLE, 0.0,
+                                                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property (gobject_class,
+                                     PROP_CONTROL_LATENCY,
+                                     g_param_spec_uint ("control-latency",
+                                                        "Control Latency",
+                                                        "Frames the camera needs until a new exposure or gain is visible",
+                                                        0, 16, 2,
+                                                        G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property (gobject_class,
+                                     PROP_METERING_MODE,
+                                     g_param_spec_int ("metering-mode",
+                                                       "Metering Mode",
+                                                       "0 = average, 1 = center weighted, 2 = spot; ignored when a roi is set",
+                                                       TCAM_METERING_AVERAGE, TCAM_METERING_SPOT, TCAM_METERING_AVERAGE,
+                                                       G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
 }
 
+
+static void analyze_statistics (const struct tcam_image_statistics& statistics, void* user_data);
+
+
+/* state shared with the worker thread of the runner */
+struct GstTcamautoexposurePrivate
+{
+    tcam::AlgorithmRunner* runner;
+    tcam::ExposureController* controller;
+
+    /* set when a write failed; values are read from the device again */
+    std::atomic<bool> resync_values;
+
+    std::mutex mtx; /* protects exposure, gain, auto_exposure and auto_gain */
+};
+
+
 static void gst_tcamautoexposure_init (GstTcamautoexposure *self)
 {
     self->auto_exposure = TRUE;
     self->auto_gain = TRUE;
 
-    self->frame_counter = 0;
     self->camera_src = NULL;
+
+    self->priv = new GstTcamautoexposurePrivate();
+    self->priv->controller = new tcam::ExposureController();
+    self->priv->resync_values = false;
+
+    self->priv->runner = new tcam::AlgorithmRunner(analyze_statistics, self);
 }
 
 void gst_tcamautoexposure_set_property (GObject* object,
@@ -940,6 +1002,8 @@ void gst_tcamautoexposure_set_property (GObject* object,
 {
     GstTcamautoexposure* tcamautoexposure = GST_TCAMAUTOEXPOSURE (object);
 
+    std::lock_guard<std::mutex> lck(tcamautoexposure->priv->mtx);
+
     switch (property_id)
     {
         case PROP_AUTO_EXPOSURE:
@@ -969,6 +1033,7 @@ void gst_tcamautoexposure_set_property (GObject* object,
             break;
         case PROP_BRIGHTNESS_REFERENCE:
             tcamautoexposure->brightness_reference = g_value_get_int(value);
+            tcamautoexposure->priv->controller->set_reference(tcamautoexposure->brightness_reference);
             break;
         case PROP_ROI_LEFT:
             tcamautoexposure->image_region.x0 = g_value_get_uint(value);
@@ -982,6 +1047,18 @@ void gst_tcamautoexposure_set_property (GObject* object,
         case PROP_ROI_HEIGHT:
             tcamautoexposure->image_region.y1 = g_value_get_uint(value);
             break;
+        case PROP_ANALYSIS_INTERVAL:
+            tcamautoexposure->priv->runner->set_frame_interval(g_value_get_uint(value));
+            break;
+        case PROP_ANALYSIS_RATE:
+            tcamautoexposure->priv->runner->set_rate(g_value_get_double(value));
+            break;
+        case PROP_CONTROL_LATENCY:
+            tcamautoexposure->priv->controller->set_latency(g_value_get_uint(value));
+            break;
+        case PROP_METERING_MODE:
+            tcamautoexposure->metering_mode = g_value_get_int(value);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -995,6 +1072,8 @@ void gst_tcamautoexposure_get_property (GObject* object,
 {
     GstTcamautoexposure* tcamautoexposure = GST_TCAMAUTOEXPOSURE(object);
 
+    std::lock_guard<std::mutex> lck(tcamautoexposure->priv->mtx);
+
     switch (property_id)
     {
         case PROP_AUTO_EXPOSURE:
@@ -1027,6 +1106,18 @@ void gst_tcamautoexposure_get_property (GObject* object,
         case PROP_ROI_HEIGHT:
             g_value_set_uint(value, tcamautoexposure->image_region.y1);
             break;
+        case PROP_ANALYSIS_INTERVAL:
+            g_value_set_uint(value, tcamautoexposure->priv->runner->get_frame_interval());
+            break;
+        case PROP_ANALYSIS_RATE:
+            g_value_set_double(value, tcamautoexposure->priv->runner->get_rate());
+            break;
+        case PROP_CONTROL_LATENCY:
+            g_value_set_uint(value, tcamautoexposure->priv->controller->get_latency());
+            break;
+        case PROP_METERING_MODE:
+            g_value_set_int(value, tcamautoexposure->metering_mode);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -1035,12 +1126,46 @@ void gst_tcamautoexposure_get_property (GObject* object,
 
 void gst_tcamautoexposure_finalize (GObject* object)
 {
+    GstTcamautoexposure* self = GST_TCAMAUTOEXPOSURE(object);
+
+    /* stops the worker thread */
+    delete self->priv->runner;
+    delete self->priv->controller;
+    delete self->priv;
+    self->priv = nullptr;
+
     G_OBJECT_CLASS (gst_tcamautoexposure_parent_class)->finalize (object);
 }
 
 
+static gboolean gst_tcamautoexposure_start (GstBaseTransform* trans)
+{
+    GstTcamautoexposure* self = GST_TCAMAUTOEXPOSURE(trans);
+
+    self->priv->runner->start();
+
+    return TRUE;
+}
+
+
+/*
+ * No analysis runs after this returns.
+ * Writes that are still queued hold their own reference to the element.
+ */
+static gboolean gst_tcamautoexposure_stop (GstBaseTransform* trans)
+{
+    GstTcamautoexposure* self = GST_TCAMAUTOEXPOSURE(trans);
+
+    self->priv->runner->stop();
+
+    return TRUE;
+}
+
+
 static void init_camera_resources (GstTcamautoexposure* self)
 {
+    std::lock_guard<std::mutex> lck(self->priv->mtx);
+
     /* retrieve the element name e.g. GstAravis or GstV4l2Src*/
     const char* element_name = g_type_name(gst_element_factory_get_element_type (gst_element_get_factory(self->camera_src)));
 
@@ -1090,111 +1215,59 @@ static void init_camera_resources (GstTcamautoexposure* self)
 }
 
 
-static void set_exposure (GstTcamautoexposure* self, gdouble exposure)
+/*
+ * Called by the property writer once a value reached the device.
+ * Releases the reference taken when the write was queued.
+ */
+static void value_written (TCAM_PROPERTY_ID id, bool success, void* user_data)
 {
-    GST_INFO("Setting exposure to %f", exposure);
+    GstTcamautoexposure* self = GST_TCAMAUTOEXPOSURE(user_data);
 
-    tcam::CaptureDevice* dev;
-    g_object_get(G_OBJECT(self->camera_src), "camera", &dev, NULL);
+    if (!success)
+    {
+        GST_WARNING("Unable to write %s", id == TCAM_PROPERTY_EXPOSURE ? "exposure" : "gain");
+        self->priv->resync_values = true;
+    }
+
+    self->priv->controller->change_applied();
 
-    dev->set_property(TCAM_PROPERTY_EXPOSURE, (int64_t)exposure);
+    gst_object_unref(self);
 }
 
 
-static void set_gain (GstTcamautoexposure* self, gdouble gain)
+static void write_value (GstTcamautoexposure* self, TCAM_PROPERTY_ID id, gdouble value)
 {
-    GST_INFO("Setting gain to %f", gain);
-
     tcam::CaptureDevice* dev;
     g_object_get(G_OBJECT(self->camera_src), "camera", &dev, NULL);
 
-    dev->set_property(TCAM_PROPERTY_GAIN, (int64_t)gain);
-}
-
-
-static gdouble calc_offset (unsigned int reference_val, unsigned int brightness_val)
-{
-    const gdouble r = (gdouble) reference_val;
-    const gdouble y = (gdouble) brightness_val;
-
-    return r - y;
-}
-
-
-static gdouble modify_gain (GstTcamautoexposure* self, gdouble diff)
-{
-    if (fabs(diff) < K_SMALL)
-    {
-        return 0.0;
-    }
-
-    gdouble K_GAIN_FAST = 30;
-    gdouble K_GAIN_SLOW = 0.1;
-
-    gdouble g_ref;
+    self->priv->controller->change_requested(1);
 
-    if (diff <= 40.0)
-    {
-        g_ref = self->gain.value + K_GAIN_FAST * diff;
-    }
-    else
+    // do not block the streaming thread until the device accepted the value
+    // the device may outlive the element, keep the element alive while the write is pending
+    if (!dev->set_property_async(id, (int64_t)value, value_written, gst_object_ref(self)))
     {
-        g_ref = self->gain.value + K_GAIN_SLOW * diff;
+        value_written(id, false, self);
     }
+}
 
-    gdouble new_gain = fmax(fmin(g_ref, self->gain.max), self->gain.min);
-    double percentage_new =  (new_gain / self->gain.max * 100) - (self->gain.value / self->gain.max * 100);
-
-    if (fabs(self->gain.value - new_gain) > K_SMALL)
-    {
-        GST_DEBUG("fabs(self->gain.value - new_gain) > K_SMALL == %f - %f =%f (g_ref %f diff %f)",
-                  self->gain.value, new_gain, fabs(self->gain.value - new_gain), g_ref, diff);
-
-        double percentage = self->gain.max / 100;
-        double setter = new_gain;
-        GST_DEBUG("Comparing percentage_new %f > percentage %f", percentage_new, percentage);
-        if (fabs(percentage_new) > percentage)
-        {
-            if (percentage_new > 0.0)
-            {
-                setter = self->gain.value + percentage;
-            }
-            else
-            {
-                setter = self->gain.value - percentage;
-            }
-        }
-        set_gain(self, setter);
-    }
 
-    GST_DEBUG("NEW GAIN: g_ref %f - new_gain %f / K_GAIN %f = %f",
-              g_ref, new_gain, K_GAIN, (g_ref - new_gain) / K_GAIN);
+static void set_exposure (GstTcamautoexposure* self, gdouble exposure)
+{
+    GST_INFO("Setting exposure to %f", exposure);
 
-    return (g_ref - new_gain) / K_GAIN;
+    write_value(self, TCAM_PROPERTY_EXPOSURE, exposure);
 }
 
 
-static double modify_exposure (GstTcamautoexposure* self, gdouble diff)
+static void set_gain (GstTcamautoexposure* self, gdouble gain)
 {
-    if (fabs(diff) < K_SMALL)
-    {
-        return 0;
-    }
-
-    const double e_ref = self->exposure.value * pow(2, diff);
-    const double new_exposure = fmax(fmin(e_ref, self->exposure.max), self->exposure.min);
-
-    if (fabs(self->exposure.value - new_exposure) > K_SMALL)
-    {
-        set_exposure(self, new_exposure);
-    }
-    GST_DEBUG("Returning (e_ref - new_exposure = diff) %f - %f = %f",
-              e_ref, new_exposure, (e_ref - new_exposure));
+    GST_INFO("Setting gain to %f", gain);
 
-    return e_ref - new_exposure;
+    write_value(self, TCAM_PROPERTY_GAIN, gain);
 }
 
 
+/* caller has to hold priv->mtx */
 void retrieve_current_values (GstTcamautoexposure* self)
 {
     tcam::CaptureDevice* dev = NULL;
@@ -1236,112 +1309,101 @@ void retrieve_current_values (GstTcamautoexposure* self)
 }
 
 
-static tBY8Pattern calculate_pattern_from_offset (GstTcamautoexposure* self)
+/*
+ * Runs in the streaming thread.
+ * Collects everything the control loop needs from the buffer.
+ */
+static gboolean measure_brightness (GstTcamautoexposure* self,
+                                    GstBuffer* buf,
+                                    struct tcam_image_statistics* statistics)
 {
-    tBY8Pattern ret = self->pattern;
-    // check if we need to switch between pattern lines
-    if ((self->image_region.y0 % 2) != 0)
+    struct tcam_metering metering;
+
+    if (!gst_tcam_metering_setup(self->metering_mode,
+                                 self->image_region.x0,
+                                 self->image_region.y0,
+                                 self->image_region.x1,
+                                 self->image_region.y1,
+                                 self->image_size.width,
+                                 self->image_size.height,
+                                 &metering))
     {
-        ret = next_line(self->pattern);
-    }
-
-    if ((self->image_region.x0 % 2) != 0)
-    {
-        ret = next_pixel(ret);
+        GST_WARNING("Unable to use metering mode %d", self->metering_mode);
+        return FALSE;
     }
 
-    return ret;
+    /* whole image statistics are shared with the other auto elements */
+    return gst_tcam_statistics_retrieve_metered(buf,
+                                                self->fourcc,
+                                                self->image_size.width,
+                                                self->image_size.height,
+                                                &metering,
+                                                statistics);
 }
 
 
-static image_buffer retrieve_image_region (GstTcamautoexposure* self, GstBuffer* buf)
+/*
+ * Runs in the worker thread of the AlgorithmRunner.
+ */
+static void correct_brightness (GstTcamautoexposure* self,
+                                const struct tcam_image_statistics& statistics)
 {
-    GstMapInfo info;
-
-    gst_buffer_map(buf, &info, GST_MAP_READ);
-
-    if (self->image_region.x0 == 0
-        && self->image_region.x1 == 0
-        && self->image_region.y0 == 0
-        && self->image_region.y1 == 0)
+    tcam::ExposureController::state values = {};
     {
-        self->image_region.x1 = self->image_size.width;
-        self->image_region.y1 = self->image_size.height;
-    }
+        std::lock_guard<std::mutex> lck(self->priv->mtx);
 
-    const int bytes_per_pixel = 1;
-
-    image_buffer new_buf;
-
-    new_buf.image = info.data + (self->image_region.x0 * bytes_per_pixel * self->image_region.y0);
-
-    new_buf.width = self->image_region.x1 - self->image_region.x0;
-    new_buf.height = self->image_region.y1 - self->image_region.y0;
+        /* the values the element wrote are known, only re-read them when a write went wrong */
+        if (self->priv->resync_values.exchange(false))
+        {
+            retrieve_current_values(self);
+        }
 
-    new_buf.pattern = calculate_pattern_from_offset(self);
+        values.exposure = self->exposure.value;
+        values.exposure_min = self->exposure.min;
+        values.exposure_max = self->exposure.max;
+        values.gain = self->gain.value;
+        values.gain_min = self->gain.min;
+        values.gain_max = self->gain.max;
+        values.auto_exposure = self->auto_exposure;
+        values.auto_gain = self->auto_gain;
+    }
 
-    GST_INFO("Region is from %d %d to %d %d",
-             self->image_region.x0, self->image_region.y0,
-             self->image_region.x1, self->image_region.y1);
+    const tcam::ExposureController::state previous = values;
 
-    gst_buffer_unmap(buf, &info);
+    if (!self->priv->controller->evaluate(statistics, values))
+    {
+        return;
+    }
 
-    return new_buf;
-}
+    GST_INFO("brightness = %u, gain = %f -> %f, exposure = %f -> %f",
+             statistics.brightness,
+             previous.gain, values.gain,
+             previous.exposure, values.exposure);
 
+    {
+        std::lock_guard<std::mutex> lck(self->priv->mtx);
 
-static void correct_brightness (GstTcamautoexposure* self, GstBuffer* buf)
-{
-    image_buffer buffer = retrieve_image_region(self, buf);
-    guint brightness = 0;
+        self->gain.value = values.gain;
+        self->exposure.value = values.exposure;
+    }
 
-    if (self->color_format == BAYER)
+    if (values.gain != previous.gain)
     {
-        GST_DEBUG("Calculating brightness");
-        brightness = image_brightness_bayer(&buffer);
+        set_gain(self, values.gain);
     }
-    else
+
+    if (values.exposure != previous.exposure)
     {
-        GST_DEBUG("Calculating brightness for gray");
-        brightness = buffer_brightness_gray(&buffer);
+        set_exposure(self, values.exposure);
     }
-    /* assure we have the current values */
-    retrieve_current_values (self);
-
-    /* get offset and control difference from reference */
-    const gdouble offset = calc_offset(self->brightness_reference, brightness);
+}
 
-    GST_INFO("offset = %f, gain = %f, exposure = %f", offset, self->gain.value, self->exposure.value);
 
-    /* Check if outside deadband */
-    if (fabs(offset) > K_DEADBAND)
-    {
-        /* Compute control change from offset */
-        const gdouble change = K_CONTROL * offset;
+static void analyze_statistics (const struct tcam_image_statistics& statistics, void* user_data)
+{
+    GstTcamautoexposure* self = GST_TCAMAUTOEXPOSURE(user_data);
 
-        /* Check if too bright */
-        if (change < 0.0)
-        {
-            GST_DEBUG("exposure");
-            /* Reduce gain first, then exposure */
-            modify_exposure(self, modify_gain(self, change));
-        }
-        else
-        {
-            GST_DEBUG("gain");
-            /* Increase exposure first, then gain */
-            modify_gain(self, modify_exposure(self, change));
-        }
-    }
-    else
-    {
-        /* Try swapping gain for exposure */
-        if (self->gain.value > self->gain.min && self->exposure.value < self->exposure.max)
-        {
-            GST_DEBUG("reducing gain");
-            modify_exposure(self, -modify_gain(self, -K_ADJUST));
-        }
-    }
+    correct_brightness(self, statistics);
 }
 
 
@@ -1390,6 +1452,8 @@ gboolean find_image_values (GstTcamautoexposure* self)
     gst_structure_get_fraction(structure, "framerate",
                                &self->framerate_numerator, &self->framerate_denominator);
 
+    self->fourcc = gst_tcam_statistics_fourcc_from_caps(caps);
+
     return TRUE;
 }
 
@@ -1427,29 +1491,34 @@ static GstFlowReturn gst_tcamautoexposure_transform_ip (GstBaseTransform* trans,
         return GST_FLOW_OK;
     }
 
-    if (self->frame_counter > 3)
+    /* frames taken before the last change was applied say nothing about it */
+    if (!self->priv->controller->new_frame())
     {
-        // validity checks
-        GstMapInfo info;
-
-        gst_buffer_map(buf, &info, GST_MAP_READ);
-
-        guint* data = (guint*)info.data;
-        guint length = info.size;
+        return GST_FLOW_OK;
+    }
 
-        gst_buffer_unmap(buf, &info);
+    /* buffers between analyses pass untouched */
+    if (!self->priv->runner->is_due())
+    {
+        return GST_FLOW_OK;
+    }
 
+    // validity checks
+    if (gst_buffer_get_size(buf) == 0)
+    {
+        GST_ERROR("Buffer is not valid! Ignoring buffer and trying to continue...");
+        return GST_FLOW_OK;
+    }
 
-        if (data == NULL || length == 0)
-        {
-            GST_ERROR("Buffer is not valid! Ignoring buffer and trying to continue...");
-            return GST_FLOW_OK;
-        }
+    struct tcam_image_statistics statistics;
 
-        correct_brightness(self, buf);
-        self->frame_counter = 0;
+    if (!measure_brightness(self, buf, &statistics))
+    {
+        GST_WARNING("Unable to analyze buffer");
+        return GST_FLOW_OK;
     }
-    self->frame_counter++;
+
+    self->priv->runner->submit(statistics);
 
     return GST_FLOW_OK;
 }
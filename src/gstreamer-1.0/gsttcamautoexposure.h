@@ -21,8 +21,6 @@
 #include "bayer.h"
 #include "image_sampling.h"
 
-#include "image_sampling.h"
-
 
 #ifdef __cplusplus
 extern "C"
@@ -73,6 +71,9 @@ static const gdouble steps_to_double_brightness = 30.0;
 static const char* CAMERASRC_TCAM = "GstTcam";
 
 
+typedef struct GstTcamautoexposurePrivate GstTcamautoexposurePrivate;
+
+
 typedef struct GstTcamautoexposure
 {
     GstBaseTransform base_tcamautoexposure;
@@ -94,14 +95,16 @@ typedef struct GstTcamautoexposure
     tBY8Pattern pattern;
     format color_format;
 
-    region image_region;
+    region image_region; /* x1 and y1 hold width and height of the roi */
+    gint metering_mode;
 
     gst_tcam_image_size image_size;
+    guint32 fourcc; /* format used for image statistics; 0 if unsupported */
 
     gint framerate_numerator;
     gint framerate_denominator;
 
-    gint frame_counter;
+    GstTcamautoexposurePrivate* priv;
 
 } GstTcamautoexposure;
 
@@ -23,7 +23,9 @@
 #include <ctype.h>
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
+#include <gst/video/gstvideometa.h>
 #include "gsttcamautofocus.h"
+#include "gsttcamstatisticsmeta.h"
 
 #include "tcam.h"
 
@@ -42,6 +44,7 @@ enum
     PROP_TOP,
     PROP_WIDTH,
     PROP_HEIGHT,
+    PROP_METERING_MODE,
 };
 
 
@@ -328,7 +331,7 @@ static gboolean gst_tcamautofocus_get_tcam_property (TcamProp* prop,
         if (value)
         {
             g_value_init(value, G_TYPE_INT);
-            g_value_set_int(value, self->roi_left);
+            g_value_set_int(value, self->roi_top);
         }
         if (min)
         {
@@ -594,12 +597,39 @@ static void focus_run_tcam (GstTcamAutoFocus* self)
     RECT r = {0, 0, 0, 0};
 
     /* user defined rectangle */
+    /* sums are calculated in long to not wrap around; rectangles outside the image are rejected later */
     if (self->roi_width != 0 && self->roi_height != 0)
     {
         r.left = self->roi_left;
-        r.right = self->roi_left + self->roi_width;
-        r.top = self->roi_left;
-        r.bottom = self->roi_left + self->roi_height;
+        r.right = (long)self->roi_left + self->roi_width;
+        r.top = self->roi_top;
+        r.bottom = (long)self->roi_top + self->roi_height;
+    }
+    else if (self->metering_mode != TCAM_METERING_AVERAGE)
+    {
+        /* focus on the most important region of the metering layout */
+        struct tcam_metering metering;
+
+        if (tcam::create_metering((TCAM_METERING_MODE)self->metering_mode,
+                                  self->image_width,
+                                  self->image_height,
+                                  metering))
+        {
+            const struct tcam_metering_region* region = &metering.regions[0];
+
+            for (unsigned int i = 1; i < metering.region_count; ++i)
+            {
+                if (metering.regions[i].weight > region->weight)
+                {
+                    region = &metering.regions[i];
+                }
+            }
+
+            r.left = region->x;
+            r.right = (long)region->x + region->width;
+            r.top = region->y;
+            r.bottom = (long)region->y + region->height;
+        }
     }
 
     tcam::Property* p = dev->get_property(TCAM_PROPERTY_FOCUS);
@@ -615,6 +645,10 @@ static void focus_run_tcam (GstTcamAutoFocus* self)
     int min = prop.value.i.min;
     int max = prop.value.i.max;
 
+    /* range does not change while focusing, keep it for per frame operations */
+    self->focus_min = min;
+    self->focus_max = max;
+
     /* magic number */
     int focus_auto_step_divisor = 4;
 
@@ -697,6 +731,13 @@ static void gst_tcamautofocus_class_init (GstTcamAutoFocusClass* klass)
                                                      "Height of the focus region beginning at 'top'.",
                                                      0, G_MAXINT, 0,
                                                      G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property(gobject_class,
+                                    PROP_METERING_MODE,
+                                    g_param_spec_int("metering-mode",
+                                                     "Metering Mode",
+                                                     "0 = search sharpest region, 1 = center, 2 = spot; ignored when a focus region is set",
+                                                     TCAM_METERING_AVERAGE, TCAM_METERING_SPOT, TCAM_METERING_AVERAGE,
+                                                     G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
 
 
     GST_DEBUG_CATEGORY_INIT (gst_tcamautofocus_debug_category,
@@ -711,8 +752,10 @@ static void gst_tcamautofocus_init (GstTcamAutoFocus *self)
 {
     self->focus = autofocus_create();
     self->cur_focus = 0;
+    self->focus_min = 0;
+    self->focus_max = 0;
     self->roi_left = 0;
-    self->roi_left = 0;
+    self->roi_top = 0;
     self->roi_width = 0;
     self->roi_height = 0;
     self->image_width = 0;
@@ -741,7 +784,7 @@ void gst_tcamautofocus_set_property (GObject* object,
             self->roi_left = g_value_get_int(value);
             break;
         case PROP_TOP:
-            self->roi_left = g_value_get_int(value);
+            self->roi_top = g_value_get_int(value);
             break;
         case PROP_WIDTH:
             self->roi_width = g_value_get_int(value);
@@ -749,6 +792,9 @@ void gst_tcamautofocus_set_property (GObject* object,
         case PROP_HEIGHT:
             self->roi_height = g_value_get_int(value);
             break;
+        case PROP_METERING_MODE:
+            self->metering_mode = g_value_get_int(value);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -772,7 +818,7 @@ void gst_tcamautofocus_get_property (GObject* object,
             g_value_set_int(value, self->roi_left);
             break;
         case PROP_TOP:
-            g_value_set_int(value, self->roi_left);
+            g_value_set_int(value, self->roi_top);
             break;
         case PROP_WIDTH:
             g_value_set_int(value, self->roi_width);
@@ -780,6 +826,9 @@ void gst_tcamautofocus_get_property (GObject* object,
         case PROP_HEIGHT:
             g_value_set_int(value, self->roi_height);
             break;
+        case PROP_METERING_MODE:
+            g_value_set_int(value, self->metering_mode);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -852,6 +901,8 @@ static void gst_tcamautofocus_fixate_caps (GstBaseTransform* base,
         self->image_height = height;
     }
 
+    self->fourcc = gst_tcam_statistics_fourcc_from_caps(incoming);
+
     if (gst_structure_get_field_type (ins, "format") == G_TYPE_STRING)
     {
         const char* string;
@@ -895,6 +946,50 @@ static int clip (int min, int value, int max)
 }
 
 
+/*
+ * Called by the property writer once the focus value reached the device.
+ * Releases the reference taken when the write was queued.
+ */
+static void focus_written (TCAM_PROPERTY_ID,
+                           bool success,
+                           void* user_data)
+{
+    GstTcamAutoFocus* self = GST_TCAMAUTOFOCUS(user_data);
+
+    if (!success)
+    {
+        GST_WARNING("Unable to write focus value %u", self->cur_focus);
+    }
+
+    /* release the waiting auto focus in any case, it would stall otherwise */
+    autofocus_update_focus(self->focus, clip(self->focus_min, self->cur_focus, self->focus_max));
+
+    gst_object_unref(self);
+}
+
+
+static unsigned int get_bytes_per_pixel (guint32 fourcc)
+{
+    switch (fourcc)
+    {
+        case FOURCC_Y800:
+        case FOURCC_BGGR8:
+        case FOURCC_GBRG8:
+        case FOURCC_GRBG8:
+        case FOURCC_RGGB8:
+            return 1;
+        case FOURCC_Y16:
+        case FOURCC_BGGR16:
+        case FOURCC_GBRG16:
+        case FOURCC_GRBG16:
+        case FOURCC_RGGB16:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+
 static void transform_tcam (GstTcamAutoFocus* self, GstBuffer* buf)
 {
     if (self->camera_src == nullptr)
@@ -902,51 +997,79 @@ static void transform_tcam (GstTcamAutoFocus* self, GstBuffer* buf)
         get_camera_src(GST_ELEMENT(self));
     }
 
-    tcam::CaptureDevice* dev;
-    g_object_get (G_OBJECT (self->camera_src), "camera", &dev, NULL);
-
-    gint64 min = 0;
-    gint64 max = 0;
+    unsigned int bytes_per_pixel = get_bytes_per_pixel(self->fourcc);
 
-    tcam::Property* focus_prop = dev->get_property(TCAM_PROPERTY_FOCUS);
-    struct tcam_device_property prop = focus_prop->get_struct();
+    if (bytes_per_pixel == 0)
+    {
+        GST_WARNING("Unsupported image format, skipping auto focus for this buffer");
+        return;
+    }
 
-    int focus_auto_min = prop.value.i.min;
-    max = prop.value.i.max;
+    /* padded buffers announce their real line length through the video meta */
+    GstVideoMeta* video_meta = gst_buffer_get_video_meta(buf);
+    unsigned int pitch = self->image_width * bytes_per_pixel;
 
-    /* assure we use the current focus value */
-    autofocus_update_focus(self->focus, clip(focus_auto_min, self->cur_focus, max));
+    if (video_meta != NULL)
+    {
+        pitch = video_meta->stride[0];
+    }
 
+    /* sharpness needs every line of the roi; the sparse shared statistics are not used */
     GstMapInfo info = {};
-    gst_buffer_make_writable(buf);
+    gst_buffer_map(buf, &info, GST_MAP_READ);
 
-    gst_buffer_map(buf, &info, GST_MAP_WRITE);
+    if (info.size < (gsize)pitch * self->image_height)
+    {
+        GST_WARNING("Buffer is smaller than the negotiated image, skipping auto focus");
+        gst_buffer_unmap(buf, &info);
+        return;
+    }
 
     img_descriptor img =
         {
             info.data,
             info.size,
-            FOURCC_GRBG, /* TODO: DYNAMICALLY FIND FORMAT */
+            self->fourcc,
             self->image_width,
             self->image_height,
-            self->image_width
+            pitch
         };
 
     int new_focus_value;
     POINT p = {0, 0};
 
+    /* the roi is given in image coordinates, no binning has to be applied */
     bool ret = autofocus_analyze_frame(self->focus,
                                        img,
                                        p,
-                                       500,
+                                       1,
                                        &new_focus_value);
 
     if (ret)
     {
         GST_DEBUG("Setting focus %d", new_focus_value);
 
-        focus_prop->set_value((int64_t)new_focus_value);
+        tcam::CaptureDevice* dev = nullptr;
+        g_object_get (G_OBJECT (self->camera_src), "camera", &dev, NULL);
+
         self->cur_focus = new_focus_value;
+
+        /* frames are only analyzed again once focus_written tagged the move */
+        /* the device may outlive the element, keep the element alive while the write is pending */
+        if (dev == nullptr
+            || !dev->set_property_async(TCAM_PROPERTY_FOCUS,
+                                        (int64_t)new_focus_value,
+                                        focus_written,
+                                        gst_object_ref(self)))
+        {
+            autofocus_update_focus(self->focus, new_focus_value);
+
+            /* the write was not queued, focus_written will not be called */
+            if (dev != nullptr)
+            {
+                gst_object_unref(self);
+            }
+        }
     }
 
     gst_buffer_unmap(buf, &info);
@@ -964,6 +1087,8 @@ gboolean find_image_values (GstTcamAutoFocus* self)
 
     gst_structure_get_fraction(structure, "framerate", &self->framerate_numerator, &self->framerate_denominator);
 
+    self->fourcc = gst_tcam_statistics_fourcc_from_caps(caps);
+
     return TRUE;
 }
 
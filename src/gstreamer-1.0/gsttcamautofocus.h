@@ -50,6 +50,7 @@ typedef struct GstTcamAutoFocus
 
     unsigned int image_width;
     unsigned int image_height;
+    guint32 fourcc;
 
     unsigned int roi_width;
     unsigned int roi_height;
@@ -63,8 +64,11 @@ typedef struct GstTcamAutoFocus
     AutoFocus* focus;
 
     guint cur_focus;
+    gint focus_min;
+    gint focus_max;
     guint roi_left;
     guint roi_top;
+    gint metering_mode;
 
 } GstTcamAutoFocus;
 
@@ -689,9 +689,17 @@ static gboolean gst_tcambin_create_elements (GstTcamBin* self)
         self->exposure = gst_element_factory_make("tcamautoexposure", "tcambin-exposure");
         gst_bin_add(GST_BIN(self), self->exposure);
 
-        pipeline_description += " ! tcamautoexposure";
-        gst_element_link(previous_element, self->exposure);
-        previous_element = self->exposure;
+        if (gst_element_link(previous_element, self->exposure))
+        {
+            pipeline_description += " ! tcamautoexposure";
+            previous_element = self->exposure;
+        }
+        else
+        {
+            GST_WARNING("Image format is not supported by tcamautoexposure. Continuing without it.");
+            gst_bin_remove(GST_BIN(self), self->exposure);
+            self->exposure = nullptr;
+        }
     }
 
     if (tcam_prop_get_tcam_property_type(TCAM_PROP(self->src), "Focus") != nullptr
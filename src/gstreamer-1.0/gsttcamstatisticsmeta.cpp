@@ -0,0 +1,316 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gsttcamstatisticsmeta.h"
+
+#include <gst/video/gstvideometa.h>
+#include <cstring>
+
+/*
+ * This file is compiled into every auto algorithm element.
+ * The type is registered by whichever element is loaded first,
+ * all others look it up by name.
+ */
+static const char* META_API_NAME = "GstTcamStatisticsMetaAPI";
+static const char* META_IMPL_NAME = "GstTcamStatisticsMeta";
+
+
+GType gst_tcam_statistics_meta_api_get_type (void)
+{
+    static volatile GType type = 0;
+    static const gchar* tags[] = { NULL };
+
+    if (g_once_init_enter(&type))
+    {
+        GType t = g_type_from_name(META_API_NAME);
+
+        if (t == 0)
+        {
+            t = gst_meta_api_type_register(META_API_NAME, tags);
+        }
+        g_once_init_leave(&type, t);
+    }
+    return type;
+}
+
+
+static gboolean gst_tcam_statistics_meta_init (GstMeta* meta,
+                                               gpointer params,
+                                               GstBuffer* buffer)
+{
+    GstTcamStatisticsMeta* m = (GstTcamStatisticsMeta*)meta;
+
+    memset(&m->statistics, 0, sizeof(m->statistics));
+
+    return TRUE;
+}
+
+
+static gboolean gst_tcam_statistics_meta_transform (GstBuffer* dest,
+                                                    GstMeta* meta,
+                                                    GstBuffer* buffer,
+                                                    GQuark type,
+                                                    gpointer data)
+{
+    GstTcamStatisticsMeta* m = (GstTcamStatisticsMeta*)meta;
+
+    if (GST_META_TRANSFORM_IS_COPY(type))
+    {
+        GstMetaTransformCopy* copy = (GstMetaTransformCopy*)data;
+
+        /* statistics describe the whole image */
+        if (!copy->region)
+        {
+            gst_buffer_add_tcam_statistics_meta(dest, &m->statistics);
+        }
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+const GstMetaInfo* gst_tcam_statistics_meta_get_info (void)
+{
+    static const GstMetaInfo* meta_info = NULL;
+
+    if (g_once_init_enter((GstMetaInfo**)&meta_info))
+    {
+        const GstMetaInfo* mi = gst_meta_get_info(META_IMPL_NAME);
+
+        if (mi == NULL)
+        {
+            mi = gst_meta_register(GST_TCAM_STATISTICS_META_API_TYPE,
+                                   META_IMPL_NAME,
+                                   sizeof(GstTcamStatisticsMeta),
+                                   gst_tcam_statistics_meta_init,
+                                   NULL,
+                                   gst_tcam_statistics_meta_transform);
+        }
+        g_once_init_leave((GstMetaInfo**)&meta_info, (GstMetaInfo*)mi);
+    }
+    return meta_info;
+}
+
+
+GstTcamStatisticsMeta* gst_buffer_add_tcam_statistics_meta (GstBuffer* buffer,
+                                                            const struct tcam_image_statistics* statistics)
+{
+    g_return_val_if_fail(GST_IS_BUFFER(buffer), NULL);
+
+    GstTcamStatisticsMeta* meta = (GstTcamStatisticsMeta*)gst_buffer_add_meta(buffer,
+                                                                              GST_TCAM_STATISTICS_META_INFO,
+                                                                              NULL);
+
+    if (meta != NULL && statistics != NULL)
+    {
+        meta->statistics = *statistics;
+    }
+
+    return meta;
+}
+
+
+guint32 gst_tcam_statistics_fourcc_from_caps (const GstCaps* caps)
+{
+    if (caps == NULL || gst_caps_get_size(caps) == 0)
+    {
+        return 0;
+    }
+
+    GstStructure* structure = gst_caps_get_structure(caps, 0);
+    const char* format = gst_structure_get_string(structure, "format");
+
+    if (format == NULL)
+    {
+        return 0;
+    }
+
+    if (gst_structure_has_name(structure, "video/x-bayer"))
+    {
+        if (g_strcmp0(format, "bggr") == 0)
+            return FOURCC_BGGR8;
+        if (g_strcmp0(format, "gbrg") == 0)
+            return FOURCC_GBRG8;
+        if (g_strcmp0(format, "grbg") == 0)
+            return FOURCC_GRBG8;
+        if (g_strcmp0(format, "rggb") == 0)
+            return FOURCC_RGGB8;
+
+        /* 16 bit little endian containers; older gstreamer versions omit the suffix */
+        if (g_strcmp0(format, "bggr16") == 0 || g_strcmp0(format, "bggr16le") == 0)
+            return FOURCC_BGGR16;
+        if (g_strcmp0(format, "gbrg16") == 0 || g_strcmp0(format, "gbrg16le") == 0)
+            return FOURCC_GBRG16;
+        if (g_strcmp0(format, "grbg16") == 0 || g_strcmp0(format, "grbg16le") == 0)
+            return FOURCC_GRBG16;
+        if (g_strcmp0(format, "rggb16") == 0 || g_strcmp0(format, "rggb16le") == 0)
+            return FOURCC_RGGB16;
+    }
+    else if (gst_structure_has_name(structure, "video/x-raw"))
+    {
+        if (g_strcmp0(format, "GRAY8") == 0)
+            return FOURCC_Y800;
+        if (g_strcmp0(format, "GRAY16_LE") == 0)
+            return FOURCC_Y16;
+    }
+
+    return 0;
+}
+
+
+void gst_tcam_statistics_invalidate (GstBuffer* buffer)
+{
+    GstTcamStatisticsMeta* meta = gst_buffer_get_tcam_statistics_meta(buffer);
+
+    if (meta != NULL)
+    {
+        gst_buffer_remove_meta(buffer, (GstMeta*)meta);
+    }
+}
+
+
+static struct tcam_image_buffer describe_buffer (GstBuffer* buffer,
+                                                const GstMapInfo* info,
+                                                guint32 fourcc,
+                                                guint width,
+                                                guint height)
+{
+    struct tcam_image_buffer image = {};
+
+    image.pData = info->data;
+    image.length = info->size;
+    image.format.fourcc = fourcc;
+    image.format.width = width;
+    image.format.height = height;
+
+    GstVideoMeta* video_meta = gst_buffer_get_video_meta(buffer);
+
+    if (video_meta != NULL)
+    {
+        image.pitch = video_meta->stride[0];
+    }
+
+    return image;
+}
+
+
+gboolean gst_tcam_statistics_retrieve (GstBuffer* buffer,
+                                       guint32 fourcc,
+                                       guint width,
+                                       guint height,
+                                       struct tcam_image_statistics* statistics)
+{
+    GstTcamStatisticsMeta* meta = gst_buffer_get_tcam_statistics_meta(buffer);
+
+    if (meta != NULL
+        && meta->statistics.fourcc == fourcc
+        && meta->statistics.width == width
+        && meta->statistics.height == height)
+    {
+        *statistics = meta->statistics;
+        return TRUE;
+    }
+
+    if (!tcam::is_statistics_format_supported(fourcc))
+    {
+        return FALSE;
+    }
+
+    GstMapInfo info;
+
+    if (!gst_buffer_map(buffer, &info, GST_MAP_READ))
+    {
+        return FALSE;
+    }
+
+    struct tcam_image_buffer image = describe_buffer(buffer, &info, fourcc, width, height);
+
+    gboolean ret = tcam::calculate_image_statistics(image, *statistics);
+
+    gst_buffer_unmap(buffer, &info);
+
+    /* buffers we are not allowed to touch are only analyzed */
+    if (ret && gst_buffer_is_writable(buffer))
+    {
+        if (meta != NULL)
+        {
+            meta->statistics = *statistics;
+        }
+        else
+        {
+            gst_buffer_add_tcam_statistics_meta(buffer, statistics);
+        }
+    }
+
+    return ret;
+}
+
+
+gboolean gst_tcam_metering_setup (gint mode,
+                                  guint roi_x,
+                                  guint roi_y,
+                                  guint roi_width,
+                                  guint roi_height,
+                                  guint width,
+                                  guint height,
+                                  struct tcam_metering* metering)
+{
+    if (roi_width == 0 || roi_height == 0)
+    {
+        return tcam::create_metering((TCAM_METERING_MODE)mode, width, height, *metering);
+    }
+
+    memset(metering, 0, sizeof(*metering));
+
+    struct tcam_metering_region region = { roi_x, roi_y, roi_width, roi_height, 1 };
+
+    return tcam::add_metering_region(*metering, region);
+}
+
+
+gboolean gst_tcam_statistics_retrieve_metered (GstBuffer* buffer,
+                                               guint32 fourcc,
+                                               guint width,
+                                               guint height,
+                                               const struct tcam_metering* metering,
+                                               struct tcam_image_statistics* statistics)
+{
+    if (metering == NULL || tcam::is_full_image_metering(*metering, width, height))
+    {
+        return gst_tcam_statistics_retrieve(buffer, fourcc, width, height, statistics);
+    }
+
+    if (!tcam::is_statistics_format_supported(fourcc))
+    {
+        return FALSE;
+    }
+
+    GstMapInfo info;
+
+    if (!gst_buffer_map(buffer, &info, GST_MAP_READ))
+    {
+        return FALSE;
+    }
+
+    struct tcam_image_buffer image = describe_buffer(buffer, &info, fourcc, width, height);
+
+    gboolean ret = tcam::calculate_region_statistics(image, *metering, *statistics);
+
+    gst_buffer_unmap(buffer, &info);
+
+    return ret;
+}
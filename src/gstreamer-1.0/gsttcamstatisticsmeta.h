@@ -0,0 +1,142 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TCAM_GSTTCAMSTATISTICSMETA_H
+#define TCAM_GSTTCAMSTATISTICSMETA_H
+
+#include <gst/gst.h>
+
+#include "image_statistics.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+G_BEGIN_DECLS
+
+/**
+ * Image statistics that are attached to a buffer by the first
+ * auto algorithm that analyzes it. Following elements reuse them
+ * instead of scanning the image again.
+ */
+typedef struct GstTcamStatisticsMeta
+{
+    GstMeta meta;
+
+    struct tcam_image_statistics statistics;
+} GstTcamStatisticsMeta;
+
+
+GType gst_tcam_statistics_meta_api_get_type (void);
+#define GST_TCAM_STATISTICS_META_API_TYPE (gst_tcam_statistics_meta_api_get_type())
+
+const GstMetaInfo* gst_tcam_statistics_meta_get_info (void);
+#define GST_TCAM_STATISTICS_META_INFO (gst_tcam_statistics_meta_get_info())
+
+#define gst_buffer_get_tcam_statistics_meta(b) \
+    ((GstTcamStatisticsMeta*)gst_buffer_get_meta((b), GST_TCAM_STATISTICS_META_API_TYPE))
+
+
+GstTcamStatisticsMeta* gst_buffer_add_tcam_statistics_meta (GstBuffer* buffer,
+                                                            const struct tcam_image_statistics* statistics);
+
+
+/**
+ * @name gst_tcam_statistics_fourcc_from_caps
+ * @param caps - caps describing the buffers
+ * @return fourcc usable for statistics; 0 if format is not supported
+ */
+guint32 gst_tcam_statistics_fourcc_from_caps (const GstCaps* caps);
+
+
+/**
+ * @name gst_tcam_statistics_retrieve
+ * @param buffer - buffer that shall be analyzed
+ * @param fourcc - format of buffer as returned by gst_tcam_statistics_fourcc_from_caps
+ * @param width - image width in pixel
+ * @param height - image height in pixel
+ * @param statistics - struct that shall be filled
+ * @return TRUE on success
+ * @brief reuse statistics attached to buffer or calculate and attach them
+ */
+gboolean gst_tcam_statistics_retrieve (GstBuffer* buffer,
+                                       guint32 fourcc,
+                                       guint width,
+                                       guint height,
+                                       struct tcam_image_statistics* statistics);
+
+
+/**
+ * @name gst_tcam_statistics_invalidate
+ * @param buffer - writable buffer whose pixels have been modified
+ * @brief remove attached statistics; following elements analyze the modified image
+ */
+void gst_tcam_statistics_invalidate (GstBuffer* buffer);
+
+
+/**
+ * @name gst_tcam_metering_setup
+ * @param mode - TCAM_METERING_MODE that shall be used
+ * @param roi_x - left edge of user region
+ * @param roi_y - top edge of user region
+ * @param roi_width - width of user region; 0 to use mode
+ * @param roi_height - height of user region; 0 to use mode
+ * @param width - image width in pixel
+ * @param height - image height in pixel
+ * @param metering - struct that shall be filled
+ * @return TRUE on success
+ * @brief a user region replaces the regions of the metering mode
+ */
+gboolean gst_tcam_metering_setup (gint mode,
+                                  guint roi_x,
+                                  guint roi_y,
+                                  guint roi_width,
+                                  guint roi_height,
+                                  guint width,
+                                  guint height,
+                                  struct tcam_metering* metering);
+
+
+/**
+ * @name gst_tcam_statistics_retrieve_metered
+ * @param buffer - buffer that shall be analyzed
+ * @param fourcc - format of buffer as returned by gst_tcam_statistics_fourcc_from_caps
+ * @param width - image width in pixel
+ * @param height - image height in pixel
+ * @param metering - regions that shall be analyzed
+ * @param statistics - struct that shall be filled
+ * @return TRUE on success
+ * @brief like gst_tcam_statistics_retrieve, but only the metering regions are analyzed
+ *
+ * Whole image metering reuses the attached statistics.
+ * Statistics of other regions are not attached to the buffer.
+ */
+gboolean gst_tcam_statistics_retrieve_metered (GstBuffer* buffer,
+                                               guint32 fourcc,
+                                               guint width,
+                                               guint height,
+                                               const struct tcam_metering* metering,
+                                               struct tcam_image_statistics* statistics);
+
+G_END_DECLS
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCAM_GSTTCAMSTATISTICSMETA_H */
@@ -37,8 +37,11 @@
 #include "gsttcamwhitebalance.h"
 #include "tcamprop.h"
 #include "image_sampling.h"
+#include "gsttcamstatisticsmeta.h"
+#include "algorithm_runner.h"
 #include <stdlib.h>
 #include <cstring>
+#include <mutex>
 
 #include "tcam.h"
 
@@ -54,6 +57,13 @@ enum
     PROP_AUTO_ENABLED,
     PROP_WHITEBALANCE_ENABLED,
     PROP_CAMERA_WB,
+    PROP_ANALYSIS_INTERVAL,
+    PROP_ANALYSIS_RATE,
+    PROP_METERING_MODE,
+    PROP_ROI_LEFT,
+    PROP_ROI_TOP,
+    PROP_ROI_WIDTH,
+    PROP_ROI_HEIGHT,
 };
 
 
@@ -676,9 +686,69 @@ static void gst_tcamwhitebalance_class_init (GstTcamWhitebalanceClass* klass)
                                                          "Disable entire module",
                                                          TRUE,
                                                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property(gobject_class,
+                                    PROP_ANALYSIS_INTERVAL,
+                                    g_param_spec_uint("analysis-interval",
+                                                      "Analysis Interval",
+                                                      "Analyze every n-th frame; ignored when analysis-rate is set",
+                                                      1, G_MAXUINT, 1,
+                                                      G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property(gobject_class,
+                                    PROP_ANALYSIS_RATE,
+                                    g_param_spec_double("analysis-rate",
+                                                        "Analysis Rate",
+                                                        "Analyses per second; 0 to use analysis-interval",
+                                                        0.0, G_MAXDOUBLE, 0.0,
+                                                        G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property(gobject_class,
+                                    PROP_METERING_MODE,
+                                    g_param_spec_int("metering-mode",
+                                                     "Metering Mode",
+                                                     "0 = average, 1 = center weighted, 2 = spot; ignored when a roi is set",
+                                                     TCAM_METERING_AVERAGE, TCAM_METERING_SPOT, TCAM_METERING_AVERAGE,
+                                                     G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property(gobject_class,
+                                    PROP_ROI_LEFT,
+                                    g_param_spec_uint("roi-left",
+                                                      "Left boundary of ROI",
+                                                      "Left boundary of ROI",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property(gobject_class,
+                                    PROP_ROI_TOP,
+                                    g_param_spec_uint("roi-top",
+                                                      "Top boundary of ROI",
+                                                      "Top boundary of ROI",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property(gobject_class,
+                                    PROP_ROI_WIDTH,
+                                    g_param_spec_uint("roi-width",
+                                                      "Width of ROI",
+                                                      "Width of ROI starting at 'roi-left'; 0 to use metering-mode",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+    g_object_class_install_property(gobject_class,
+                                    PROP_ROI_HEIGHT,
+                                    g_param_spec_uint("roi-height",
+                                                      "Height of ROI",
+                                                      "Height of ROI starting at 'roi-top'; 0 to use metering-mode",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
 }
 
 
+static void analyze_statistics (const struct tcam_image_statistics& statistics, void* user_data);
+
+
+/* state shared with the worker thread of the runner */
+struct _GstTcamWhitebalancePrivate
+{
+    tcam::AlgorithmRunner* runner;
+    std::mutex mtx; /* protects rgb, red, green, blue and res */
+};
+
+
 static void init_wb_values (GstTcamWhitebalance* self)
 {
     self->rgb = (rgb_tripel){WB_IDENTITY, WB_IDENTITY, WB_IDENTITY};
@@ -697,6 +767,9 @@ static void gst_tcamwhitebalance_init (GstTcamWhitebalance* self)
 
     self->image_size.width = 0;
     self->image_size.height = 0;
+
+    self->priv = new GstTcamWhitebalancePrivate();
+    self->priv->runner = new tcam::AlgorithmRunner(analyze_statistics, self);
 }
 
 
@@ -707,6 +780,8 @@ void gst_tcamwhitebalance_set_property (GObject* object,
 {
     GstTcamWhitebalance* tcamwhitebalance = GST_TCAMWHITEBALANCE(object);
 
+    std::lock_guard<std::mutex> lck(tcamwhitebalance->priv->mtx);
+
     switch (property_id)
     {
         case PROP_GAIN_RED:
@@ -727,6 +802,27 @@ void gst_tcamwhitebalance_set_property (GObject* object,
         case PROP_CAMERA_WB:
             tcamwhitebalance->force_hardware_wb = g_value_get_boolean(value);
             break;
+        case PROP_ANALYSIS_INTERVAL:
+            tcamwhitebalance->priv->runner->set_frame_interval(g_value_get_uint(value));
+            break;
+        case PROP_ANALYSIS_RATE:
+            tcamwhitebalance->priv->runner->set_rate(g_value_get_double(value));
+            break;
+        case PROP_METERING_MODE:
+            tcamwhitebalance->metering_mode = g_value_get_int(value);
+            break;
+        case PROP_ROI_LEFT:
+            tcamwhitebalance->roi_left = g_value_get_uint(value);
+            break;
+        case PROP_ROI_TOP:
+            tcamwhitebalance->roi_top = g_value_get_uint(value);
+            break;
+        case PROP_ROI_WIDTH:
+            tcamwhitebalance->roi_width = g_value_get_uint(value);
+            break;
+        case PROP_ROI_HEIGHT:
+            tcamwhitebalance->roi_height = g_value_get_uint(value);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -741,6 +837,8 @@ void gst_tcamwhitebalance_get_property (GObject* object,
 {
     GstTcamWhitebalance *tcamwhitebalance = GST_TCAMWHITEBALANCE(object);
 
+    std::lock_guard<std::mutex> lck(tcamwhitebalance->priv->mtx);
+
     switch (property_id)
     {
         case PROP_GAIN_RED:
@@ -761,6 +859,27 @@ void gst_tcamwhitebalance_get_property (GObject* object,
         case PROP_CAMERA_WB:
             g_value_set_boolean(value, tcamwhitebalance->force_hardware_wb);
             break;
+        case PROP_ANALYSIS_INTERVAL:
+            g_value_set_uint(value, tcamwhitebalance->priv->runner->get_frame_interval());
+            break;
+        case PROP_ANALYSIS_RATE:
+            g_value_set_double(value, tcamwhitebalance->priv->runner->get_rate());
+            break;
+        case PROP_METERING_MODE:
+            g_value_set_int(value, tcamwhitebalance->metering_mode);
+            break;
+        case PROP_ROI_LEFT:
+            g_value_set_uint(value, tcamwhitebalance->roi_left);
+            break;
+        case PROP_ROI_TOP:
+            g_value_set_uint(value, tcamwhitebalance->roi_top);
+            break;
+        case PROP_ROI_WIDTH:
+            g_value_set_uint(value, tcamwhitebalance->roi_width);
+            break;
+        case PROP_ROI_HEIGHT:
+            g_value_set_uint(value, tcamwhitebalance->roi_height);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -770,19 +889,30 @@ void gst_tcamwhitebalance_get_property (GObject* object,
 
 void gst_tcamwhitebalance_finalize (GObject* object)
 {
+    GstTcamWhitebalance* self = GST_TCAMWHITEBALANCE(object);
+
+    /* stops the worker thread */
+    delete self->priv->runner;
+    delete self->priv;
+    self->priv = nullptr;
+
     G_OBJECT_CLASS(gst_tcamwhitebalance_parent_class)->finalize (object);
 }
 
 
-static gboolean gst_tcamwhitebalance_device_set_whiteblance (GstTcamWhitebalance* self)
+/*
+ * Takes the resources by value so the worker thread does not
+ * have to hold the element lock during device communication.
+ */
+static gboolean gst_tcamwhitebalance_device_set_whiteblance (struct device_resources res)
 {
     GST_INFO("Applying white balance to device with values: R:%d G:%d B:%d",
-             self->res.color.rgb.R,
-             self->res.color.rgb.G,
-             self->res.color.rgb.B);
+             res.color.rgb.R,
+             res.color.rgb.G,
+             res.color.rgb.B);
 
     tcam::CaptureDevice* dev;
-    g_object_get(G_OBJECT(self->res.source_element), "camera", &dev, NULL);
+    g_object_get(G_OBJECT(res.source_element), "camera", &dev, NULL);
 
 
     tcam::Property* p = dev->get_property(TCAM_PROPERTY_GAIN_RED);
@@ -792,7 +922,7 @@ static gboolean gst_tcamwhitebalance_device_set_whiteblance (GstTcamWhitebalance
         GST_ERROR("Unable to retrieve gain red property");
     }
 
-    if (p->set_value((int64_t)self->res.color.rgb.R))
+    if (p->set_value((int64_t)res.color.rgb.R))
     {
         return FALSE;
     }
@@ -804,7 +934,7 @@ static gboolean gst_tcamwhitebalance_device_set_whiteblance (GstTcamWhitebalance
         GST_ERROR("Unable to retrieve gain green property");
     }
 
-    if (p->set_value((int64_t)self->res.color.rgb.G))
+    if (p->set_value((int64_t)res.color.rgb.G))
     {
         return FALSE;
     }
@@ -816,7 +946,7 @@ static gboolean gst_tcamwhitebalance_device_set_whiteblance (GstTcamWhitebalance
         GST_ERROR("Unable to retrieve gain blue property");
     }
 
-    if (p->set_value((int64_t)self->res.color.rgb.B))
+    if (p->set_value((int64_t)res.color.rgb.B))
     {
         return FALSE;
     }
@@ -1143,6 +1273,9 @@ static void	wb_image_c (GstTcamWhitebalance* self, GstBuffer* buf, byte wb_r, by
     }
 
     gst_buffer_unmap(buf, &info);
+
+    /* attached statistics describe the image before white balance */
+    gst_tcam_statistics_invalidate(buf);
 }
 
 
@@ -1154,42 +1287,171 @@ void apply_wb_by8_c ( GstTcamWhitebalance* self, GstBuffer* buf, byte wb_r, byte
 }
 
 
-static void whitebalance_buffer (GstTcamWhitebalance* self, GstBuffer* buf)
+/*
+ * Runs in the streaming thread.
+ * Collects the sampling points for the worker thread.
+ */
+static void measure_colors (GstTcamWhitebalance* self,
+                            GstBuffer* buf,
+                            struct tcam_image_statistics* statistics)
 {
-    rgb_tripel rgb = self->rgb;
+    struct tcam_metering metering;
+
+    if (gst_tcam_metering_setup(self->metering_mode,
+                                self->roi_left,
+                                self->roi_top,
+                                self->roi_width,
+                                self->roi_height,
+                                self->image_size.width,
+                                self->image_size.height,
+                                &metering)
+        && gst_tcam_statistics_retrieve_metered(buf,
+                                                self->fourcc,
+                                                self->image_size.width,
+                                                self->image_size.height,
+                                                &metering,
+                                                statistics))
+    {
+        return;
+    }
 
-    /* we prefer to set our own values */
-    if (self->auto_wb == FALSE)
+    /* format has no shared statistics; hand over a subset of the classic sampling points */
+    memset(statistics, 0, sizeof(*statistics));
+
+    auto_sample_points points = {};
+    get_sampling_points (buf, &points, self->pattern, self->image_size);
+
+    guint step = points.cnt / ARRAYSIZE(statistics->tiles) + 1;
+    guint t = 0;
+
+    guint i;
+    for (i = 0; i < points.cnt && t < ARRAYSIZE(statistics->tiles); i += step)
+    {
+        statistics->tiles[t].r = points.samples[i].r;
+        statistics->tiles[t].g = points.samples[i].g;
+        statistics->tiles[t].b = points.samples[i].b;
+        statistics->tiles[t].sample_count = 1;
+        t++;
+    }
+}
+
+
+/* use the tile means of the statistics as sampling points */
+static gboolean statistics_to_sampling_points (const struct tcam_image_statistics& statistics,
+                                               auto_sample_points* points)
+{
+    points->cnt = 0;
+
+    guint i;
+    for (i = 0; i < ARRAYSIZE(statistics.tiles) && points->cnt < ARRAYSIZE(points->samples); ++i)
     {
-        rgb.R = self->red;
-        rgb.G = self->green;
-        rgb.B = self->blue;
+        if (statistics.tiles[i].sample_count == 0)
+        {
+            continue;
+        }
+
+        points->samples[points->cnt].r = (byte)statistics.tiles[i].r;
+        points->samples[points->cnt].g = (byte)statistics.tiles[i].g;
+        points->samples[points->cnt].b = (byte)statistics.tiles[i].b;
+        points->cnt++;
     }
-    else /* update the permanent values to represent the current adjustments */
+
+    return points->cnt > 0;
+}
+
+
+/*
+ * Runs in the worker thread of the AlgorithmRunner.
+ * Updates the permanent values to represent the current adjustments.
+ */
+static void analyze_statistics (const struct tcam_image_statistics& statistics, void* user_data)
+{
+    GstTcamWhitebalance* self = GST_TCAMWHITEBALANCE(user_data);
+
+    auto_sample_points points = {};
+
+    if (!statistics_to_sampling_points(statistics, &points))
     {
-        auto_sample_points points = {};
+        return;
+    }
 
-        get_sampling_points (buf, &points, self->pattern, self->image_size);
+    rgb_tripel rgb;
+    {
+        std::lock_guard<std::mutex> lck(self->priv->mtx);
+        rgb = self->rgb;
+    }
+
+    guint resulting_brightness = 0;
+    auto_whitebalance(&points, &rgb, &resulting_brightness);
 
-        guint resulting_brightness = 0;
-        auto_whitebalance(&points, &rgb, &resulting_brightness);
+    struct device_resources res;
+    {
+        std::lock_guard<std::mutex> lck(self->priv->mtx);
 
         self->red = rgb.R;
         self->green = rgb.G;
         self->blue = rgb.B;
 
         self->rgb = rgb;
+
+        self->res.color.rgb = rgb;
+        res = self->res;
     }
 
-    if (self->res.color.has_whitebalance)
+    if (res.color.has_whitebalance)
     {
-        self->res.color.rgb = rgb;
-        gst_tcamwhitebalance_device_set_whiteblance(self);
+        gst_tcamwhitebalance_device_set_whiteblance(res);
+    }
+}
+
+
+static void whitebalance_buffer (GstTcamWhitebalance* self, GstBuffer* buf)
+{
+    rgb_tripel rgb;
+
+    /* we prefer to set our own values */
+    if (self->auto_wb == FALSE)
+    {
+        struct device_resources res;
+        {
+            std::lock_guard<std::mutex> lck(self->priv->mtx);
+
+            rgb.R = self->red;
+            rgb.G = self->green;
+            rgb.B = self->blue;
+
+            self->res.color.rgb = rgb;
+            res = self->res;
+        }
+
+        if (res.color.has_whitebalance)
+        {
+            gst_tcamwhitebalance_device_set_whiteblance(res);
+            return;
+        }
     }
     else
     {
-        apply_wb_by8_c(self, buf, rgb.R, rgb.G, rgb.B);
+        if (self->priv->runner->is_due())
+        {
+            struct tcam_image_statistics statistics;
+
+            measure_colors(self, buf, &statistics);
+            self->priv->runner->submit(statistics);
+        }
+
+        std::lock_guard<std::mutex> lck(self->priv->mtx);
+
+        /* the device is updated by the worker thread */
+        if (self->res.color.has_whitebalance)
+        {
+            return;
+        }
+
+        rgb = self->rgb;
     }
+
+    apply_wb_by8_c(self, buf, rgb.R, rgb.G, rgb.B);
 }
 
 
@@ -1360,11 +1622,16 @@ static gboolean extract_resolution (GstTcamWhitebalance* self)
         return FALSE;
     }
 
+    self->fourcc = gst_tcam_statistics_fourcc_from_caps(caps);
+
     // we only handle bayer 8 bit -> 1 byte
     int bytes_per_pixel = 1;
     self->expected_buffer_size = self->image_size.height * self->image_size.width * bytes_per_pixel;
 
-    self->res = find_source(GST_ELEMENT(self));
+    struct device_resources res = find_source(GST_ELEMENT(self));
+
+    std::lock_guard<std::mutex> lck(self->priv->mtx);
+    self->res = res;
 
     return TRUE;
 }
@@ -1383,6 +1650,8 @@ static GstFlowReturn gst_tcamwhitebalance_transform_ip (GstBaseTransform* trans,
             return GST_FLOW_ERROR;
         }
 
+        std::lock_guard<std::mutex> lck(self->priv->mtx);
+
         if (self->force_hardware_wb)
         {
             self->res.color.has_whitebalance = TRUE;
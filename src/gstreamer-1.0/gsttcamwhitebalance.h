@@ -35,6 +35,7 @@ extern "C"
 #define GST_IS_TCAMWHITEBALANCE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_TCAMWHITEBALANCE))
 
 typedef struct _GstTcamWhitebalance GstTcamWhitebalance;
+typedef struct _GstTcamWhitebalancePrivate GstTcamWhitebalancePrivate;
 typedef struct _GstTcamWhitebalanceClass GstTcamWhitebalanceClass;
 
 
@@ -104,6 +105,7 @@ struct _GstTcamWhitebalance {
     gst_tcam_image_size image_size;
     gdouble        framerate;
     tBY8Pattern    pattern;
+    guint32        fourcc; /* format used for image statistics */
     guint expected_buffer_size;
 
 
@@ -118,6 +120,15 @@ struct _GstTcamWhitebalance {
     gboolean auto_enabled;
     gboolean force_hardware_wb;
     struct device_resources res;
+
+    /* analyzed image area */
+    gint metering_mode;
+    guint roi_left;
+    guint roi_top;
+    guint roi_width;
+    guint roi_height;
+
+    GstTcamWhitebalancePrivate* priv;
 };
 
 struct _GstTcamWhitebalanceClass {
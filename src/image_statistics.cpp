@@ -0,0 +1,576 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "image_statistics.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace tcam;
+
+
+namespace
+{
+
+// number of lines (bayer: line pairs) that are analyzed per image
+// every pixel of these lines is used
+const unsigned int STATISTICS_LINES = 64;
+
+// smallest edge length of a spot metering region
+const uint32_t SPOT_MIN_SIZE = 64;
+
+
+struct format_info
+{
+    bool is_bayer;
+    unsigned int bit_depth;
+    unsigned int bytes_per_sample;
+
+    // position of the color channels in a 2x2 bayer block
+    // 0 = top left, 1 = top right, 2 = bottom left, 3 = bottom right
+    unsigned int r;
+    unsigned int g0;
+    unsigned int g1;
+    unsigned int b;
+};
+
+
+bool get_format_info (uint32_t fourcc, format_info& info)
+{
+    static const format_info bggr = {true, 8, 1, 3, 1, 2, 0};
+    static const format_info gbrg = {true, 8, 1, 2, 0, 3, 1};
+    static const format_info grbg = {true, 8, 1, 1, 0, 3, 2};
+    static const format_info rggb = {true, 8, 1, 0, 1, 2, 3};
+
+    auto with_depth = [] (format_info fi, unsigned int depth)
+    {
+        fi.bit_depth = depth;
+        fi.bytes_per_sample = depth > 8 ? 2 : 1;
+        return fi;
+    };
+
+    switch (fourcc)
+    {
+        case FOURCC_Y800:
+            info = {false, 8, 1, 0, 0, 0, 0};
+            return true;
+        case FOURCC_Y16:
+            info = {false, 16, 2, 0, 0, 0, 0};
+            return true;
+        case FOURCC_BGGR8:   info = bggr; return true;
+        case FOURCC_GBRG8:   info = gbrg; return true;
+        case FOURCC_GRBG8:   info = grbg; return true;
+        case FOURCC_RGGB8:   info = rggb; return true;
+        case FOURCC_BGGR10:  info = with_depth(bggr, 10); return true;
+        case FOURCC_GBRG10:  info = with_depth(gbrg, 10); return true;
+        case FOURCC_GRBG10:  info = with_depth(grbg, 10); return true;
+        case FOURCC_RGGB10:  info = with_depth(rggb, 10); return true;
+        case FOURCC_BGGR12:  info = with_depth(bggr, 12); return true;
+        case FOURCC_GBRG12:  info = with_depth(gbrg, 12); return true;
+        case FOURCC_GRBG12:  info = with_depth(grbg, 12); return true;
+        case FOURCC_RGGB12:  info = with_depth(rggb, 12); return true;
+        case FOURCC_BGGR16:  info = with_depth(bggr, 16); return true;
+        case FOURCC_GBRG16:  info = with_depth(gbrg, 16); return true;
+        case FOURCC_GRBG16:  info = with_depth(grbg, 16); return true;
+        case FOURCC_RGGB16:  info = with_depth(rggb, 16); return true;
+        default:
+            return false;
+    }
+}
+
+
+struct tile_accumulator
+{
+    uint64_t r;
+    uint64_t g;
+    uint64_t b;
+    uint64_t sharpness;
+    uint64_t count;
+};
+
+
+/*
+ * Part of the image that is analyzed.
+ * Coordinates are absolute so that the tile grid of the whole image can be used.
+ */
+struct region_view
+{
+    unsigned int x0;
+    unsigned int y0;
+    unsigned int x1;
+    unsigned int y1;
+    uint32_t weight;
+};
+
+
+inline unsigned int to_8bit (unsigned int value, unsigned int shift)
+{
+    value >>= shift;
+    return value > 255 ? 255 : value;
+}
+
+
+inline unsigned int abs_diff (unsigned int a, unsigned int b)
+{
+    return a > b ? a - b : b - a;
+}
+
+
+/*
+ * Tiles are processed as contiguous runs of a line
+ * so that the inner loops only touch sequential memory.
+ * Only lines and columns of the region are read.
+ */
+template<typename TSample>
+void analyze_bayer (const tcam_image_buffer& buffer,
+                    const format_info& info,
+                    const region_view& region,
+                    tcam_image_statistics& stats,
+                    tile_accumulator* acc)
+{
+    const unsigned int shift = info.bit_depth - 8;
+    const unsigned int height = buffer.format.height & ~1u;
+    const unsigned int blocks_x = (buffer.format.width & ~1u) / 2;
+
+    // the bayer pattern has to stay aligned
+    const unsigned int y0 = region.y0 & ~1u;
+    const unsigned int y1 = region.y1 & ~1u;
+    const unsigned int block0 = region.x0 / 2;
+    const unsigned int block1 = region.x1 / 2;
+
+    unsigned int line_step = ((y1 - y0) / STATISTICS_LINES) & ~1u;
+    if (line_step < 2)
+    {
+        line_step = 2;
+    }
+
+    unsigned int tile_start[TCAM_STATISTICS_TILES_X + 1];
+    for (unsigned int t = 0; t <= TCAM_STATISTICS_TILES_X; ++t)
+    {
+        tile_start[t] = blocks_x * t / TCAM_STATISTICS_TILES_X;
+    }
+
+    for (unsigned int y = y0; y + 1 < y1; y += line_step)
+    {
+        const unsigned int tile_y = y * TCAM_STATISTICS_TILES_Y / height;
+
+        const TSample* line0 = (const TSample*)(buffer.pData + y * buffer.pitch);
+        const TSample* line1 = (const TSample*)(buffer.pData + (y + 1) * buffer.pitch);
+
+        for (unsigned int tx = 0; tx < TCAM_STATISTICS_TILES_X; ++tx)
+        {
+            const unsigned int start = std::max(tile_start[tx], block0);
+            const unsigned int end = std::min(tile_start[tx + 1], block1);
+
+            if (start >= end)
+            {
+                continue;
+            }
+
+            tile_accumulator& tile = acc[tile_y * TCAM_STATISTICS_TILES_X + tx];
+
+            uint32_t sum_r = 0;
+            uint32_t sum_g = 0;
+            uint32_t sum_b = 0;
+            uint32_t sharpness = 0;
+            unsigned int prev_g = 0;
+
+            for (unsigned int block = start; block < end; ++block)
+            {
+                const unsigned int v[4] = { to_8bit(line0[2 * block], shift),
+                                            to_8bit(line0[2 * block + 1], shift),
+                                            to_8bit(line1[2 * block], shift),
+                                            to_8bit(line1[2 * block + 1], shift) };
+
+                const unsigned int r = v[info.r];
+                const unsigned int g = (v[info.g0] + v[info.g1]) >> 1;
+                const unsigned int b = v[info.b];
+
+                sum_r += r;
+                sum_g += g;
+                sum_b += b;
+
+                if (block != start)
+                {
+                    sharpness += abs_diff(g, prev_g);
+                }
+                prev_g = g;
+
+                stats.histogram[(r + 2 * g + b) >> 2] += region.weight;
+            }
+
+            tile.r += (uint64_t)sum_r * region.weight;
+            tile.g += (uint64_t)sum_g * region.weight;
+            tile.b += (uint64_t)sum_b * region.weight;
+            tile.sharpness += (uint64_t)sharpness * region.weight;
+            tile.count += (uint64_t)(end - start) * region.weight;
+        }
+    }
+}
+
+
+template<typename TSample>
+void analyze_mono (const tcam_image_buffer& buffer,
+                   const format_info& info,
+                   const region_view& region,
+                   tcam_image_statistics& stats,
+                   tile_accumulator* acc)
+{
+    const unsigned int shift = info.bit_depth - 8;
+    const unsigned int width = buffer.format.width;
+    const unsigned int height = buffer.format.height;
+
+    unsigned int line_step = (region.y1 - region.y0) / STATISTICS_LINES;
+    if (line_step < 1)
+    {
+        line_step = 1;
+    }
+
+    unsigned int tile_start[TCAM_STATISTICS_TILES_X + 1];
+    for (unsigned int t = 0; t <= TCAM_STATISTICS_TILES_X; ++t)
+    {
+        tile_start[t] = width * t / TCAM_STATISTICS_TILES_X;
+    }
+
+    for (unsigned int y = region.y0; y < region.y1; y += line_step)
+    {
+        const unsigned int tile_y = y * TCAM_STATISTICS_TILES_Y / height;
+
+        const TSample* line = (const TSample*)(buffer.pData + y * buffer.pitch);
+
+        for (unsigned int tx = 0; tx < TCAM_STATISTICS_TILES_X; ++tx)
+        {
+            const unsigned int start = std::max(tile_start[tx], region.x0);
+            const unsigned int end = std::min(tile_start[tx + 1], region.x1);
+
+            if (start >= end)
+            {
+                continue;
+            }
+
+            tile_accumulator& tile = acc[tile_y * TCAM_STATISTICS_TILES_X + tx];
+
+            uint32_t sum = 0;
+            uint32_t sharpness = 0;
+            unsigned int prev = 0;
+
+            for (unsigned int x = start; x < end; ++x)
+            {
+                const unsigned int v = to_8bit(line[x], shift);
+
+                sum += v;
+
+                if (x != start)
+                {
+                    sharpness += abs_diff(v, prev);
+                }
+                prev = v;
+
+                stats.histogram[v] += region.weight;
+            }
+
+            tile.r += (uint64_t)sum * region.weight;
+            tile.g += (uint64_t)sum * region.weight;
+            tile.b += (uint64_t)sum * region.weight;
+            tile.sharpness += (uint64_t)sharpness * region.weight;
+            tile.count += (uint64_t)(end - start) * region.weight;
+        }
+    }
+}
+
+
+bool prepare_image (const tcam_image_buffer& buffer,
+                    format_info& info,
+                    tcam_image_buffer& image)
+{
+    if (buffer.pData == nullptr || !get_format_info(buffer.format.fourcc, info))
+    {
+        return false;
+    }
+
+    image = buffer;
+
+    if (image.pitch == 0)
+    {
+        image.pitch = image.format.width * info.bytes_per_sample;
+    }
+
+    if (image.format.width < 2 || image.format.height < 2
+        || image.pitch < image.format.width * info.bytes_per_sample
+        || image.length < image.pitch * image.format.height)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+
+bool clip_region (const tcam_image_buffer& image,
+                  const tcam_metering_region& in,
+                  region_view& out)
+{
+    if (in.weight == 0 || in.x >= image.format.width || in.y >= image.format.height)
+    {
+        return false;
+    }
+
+    // in.x + in.width may wrap around, compare against the remaining space instead
+    out.x0 = in.x;
+    out.y0 = in.y;
+    out.x1 = in.x + std::min(in.width, image.format.width - in.x);
+    out.y1 = in.y + std::min(in.height, image.format.height - in.y);
+    out.weight = in.weight;
+
+    // bayer blocks need at least 2x2 pixel
+    return (out.x1 - out.x0) >= 2 && (out.y1 - out.y0) >= 2;
+}
+
+
+void analyze_region (const tcam_image_buffer& image,
+                     const format_info& info,
+                     const region_view& region,
+                     tcam_image_statistics& stats,
+                     tile_accumulator* acc)
+{
+    if (info.is_bayer)
+    {
+        if (info.bytes_per_sample == 1)
+        {
+            analyze_bayer<uint8_t>(image, info, region, stats, acc);
+        }
+        else
+        {
+            analyze_bayer<uint16_t>(image, info, region, stats, acc);
+        }
+    }
+    else
+    {
+        if (info.bytes_per_sample == 1)
+        {
+            analyze_mono<uint8_t>(image, info, region, stats, acc);
+        }
+        else
+        {
+            analyze_mono<uint16_t>(image, info, region, stats, acc);
+        }
+    }
+}
+
+
+void finalize_statistics (const tile_accumulator* acc, tcam_image_statistics& stats)
+{
+    uint64_t r = 0;
+    uint64_t g = 0;
+    uint64_t b = 0;
+    uint64_t count = 0;
+
+    for (unsigned int i = 0; i < TCAM_STATISTICS_TILES_X * TCAM_STATISTICS_TILES_Y; ++i)
+    {
+        auto& tile = stats.tiles[i];
+
+        tile.sample_count = acc[i].count;
+        tile.sharpness = acc[i].sharpness;
+
+        if (acc[i].count != 0)
+        {
+            tile.r = acc[i].r / acc[i].count;
+            tile.g = acc[i].g / acc[i].count;
+            tile.b = acc[i].b / acc[i].count;
+        }
+
+        r += acc[i].r;
+        g += acc[i].g;
+        b += acc[i].b;
+        count += acc[i].count;
+        stats.sharpness += acc[i].sharpness;
+    }
+
+    stats.sample_count = count;
+
+    if (count != 0)
+    {
+        stats.r = r / count;
+        stats.g = g / count;
+        stats.b = b / count;
+    }
+
+    stats.brightness = (stats.r + stats.g + stats.b) / 3;
+}
+
+
+void init_statistics (const tcam_image_buffer& image,
+                      const format_info& info,
+                      tcam_image_statistics& stats)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    stats.fourcc = image.format.fourcc;
+    stats.width = image.format.width;
+    stats.height = image.format.height;
+    stats.bit_depth = info.bit_depth;
+}
+
+} /* namespace */
+
+
+bool tcam::is_statistics_format_supported (uint32_t fourcc)
+{
+    format_info info;
+
+    return get_format_info(fourcc, info);
+}
+
+
+bool tcam::calculate_image_statistics (const struct tcam_image_buffer& buffer,
+                                       struct tcam_image_statistics& stats)
+{
+    format_info info;
+    tcam_image_buffer image;
+
+    if (!prepare_image(buffer, info, image))
+    {
+        return false;
+    }
+
+    init_statistics(image, info, stats);
+
+    const region_view full = { 0, 0, image.format.width, image.format.height, 1 };
+
+    tile_accumulator acc[TCAM_STATISTICS_TILES_X * TCAM_STATISTICS_TILES_Y] = {};
+
+    analyze_region(image, info, full, stats, acc);
+
+    finalize_statistics(acc, stats);
+
+    return true;
+}
+
+
+bool tcam::create_metering (TCAM_METERING_MODE mode,
+                            uint32_t width,
+                            uint32_t height,
+                            struct tcam_metering& metering)
+{
+    memset(&metering, 0, sizeof(metering));
+
+    if (width == 0 || height == 0)
+    {
+        return false;
+    }
+
+    const tcam_metering_region full = { 0, 0, width, height, 1 };
+
+    switch (mode)
+    {
+        case TCAM_METERING_AVERAGE:
+        {
+            return add_metering_region(metering, full);
+        }
+        case TCAM_METERING_CENTER_WEIGHTED:
+        {
+            // center half of the image counts four times as much as the border
+            const tcam_metering_region center = { width / 4, height / 4, width / 2, height / 2, 3 };
+
+            return add_metering_region(metering, full) && add_metering_region(metering, center);
+        }
+        case TCAM_METERING_SPOT:
+        {
+            uint32_t w = std::max(width / 10, std::min(width, SPOT_MIN_SIZE));
+            uint32_t h = std::max(height / 10, std::min(height, SPOT_MIN_SIZE));
+
+            const tcam_metering_region spot = { (width - w) / 2, (height - h) / 2, w, h, 1 };
+
+            return add_metering_region(metering, spot);
+        }
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+
+bool tcam::add_metering_region (struct tcam_metering& metering,
+                                const struct tcam_metering_region& region)
+{
+    if (metering.region_count >= TCAM_METERING_MAX_REGIONS
+        || region.width == 0 || region.height == 0 || region.weight == 0)
+    {
+        return false;
+    }
+
+    metering.regions[metering.region_count++] = region;
+
+    return true;
+}
+
+
+bool tcam::is_full_image_metering (const struct tcam_metering& metering,
+                                   uint32_t width,
+                                   uint32_t height)
+{
+    if (metering.region_count != 1)
+    {
+        return false;
+    }
+
+    const tcam_metering_region& r = metering.regions[0];
+
+    return r.x == 0 && r.y == 0 && r.width >= width && r.height >= height;
+}
+
+
+bool tcam::calculate_region_statistics (const struct tcam_image_buffer& buffer,
+                                        const struct tcam_metering& metering,
+                                        struct tcam_image_statistics& stats)
+{
+    format_info info;
+    tcam_image_buffer image;
+
+    if (!prepare_image(buffer, info, image))
+    {
+        return false;
+    }
+
+    init_statistics(image, info, stats);
+
+    tile_accumulator acc[TCAM_STATISTICS_TILES_X * TCAM_STATISTICS_TILES_Y] = {};
+
+    bool has_region = false;
+
+    for (unsigned int i = 0; i < metering.region_count && i < TCAM_METERING_MAX_REGIONS; ++i)
+    {
+        region_view region;
+
+        if (!clip_region(image, metering.regions[i], region))
+        {
+            continue;
+        }
+
+        analyze_region(image, info, region, stats, acc);
+        has_region = true;
+    }
+
+    if (!has_region)
+    {
+        return false;
+    }
+
+    finalize_statistics(acc, stats);
+
+    return true;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TCAM_IMAGE_STATISTICS_H
+#define TCAM_IMAGE_STATISTICS_H
+
+#include "base_types.h"
+
+/**
+ * @addtogroup API
+ * @{
+ */
+
+#define TCAM_STATISTICS_TILES_X        16
+#define TCAM_STATISTICS_TILES_Y        16
+#define TCAM_STATISTICS_HISTOGRAM_SIZE 256
+
+
+/**
+ * @struct tcam_statistics_tile
+ * @brief statistics of a rectangular image area
+ */
+struct tcam_statistics_tile
+{
+    uint32_t r;             /**< mean of red channel; 8 bit scale */
+    uint32_t g;             /**< mean of green channel; 8 bit scale */
+    uint32_t b;             /**< mean of blue channel; 8 bit scale */
+    uint32_t sample_count;  /**< number of analyzed pixels/bayer blocks */
+    uint64_t sharpness;     /**< sum of absolute horizontal gradients */
+};
+
+
+/**
+ * @struct tcam_image_statistics
+ * @brief result of a single image analysis shared by all auto algorithms
+ *
+ * Mono images report identical values for r, g and b.
+ * Tiles are stored line by line, starting top left.
+ */
+struct tcam_image_statistics
+{
+    uint32_t fourcc;        /**< format of the analyzed image */
+    uint32_t width;
+    uint32_t height;
+    uint32_t bit_depth;     /**< significant bits per sample of the analyzed image */
+
+    uint32_t r;             /**< mean of red channel; 8 bit scale */
+    uint32_t g;             /**< mean of green channel; 8 bit scale */
+    uint32_t b;             /**< mean of blue channel; 8 bit scale */
+    uint32_t brightness;    /**< mean brightness; 8 bit scale */
+    uint64_t sharpness;     /**< sum of all tile sharpness values */
+    uint32_t sample_count;
+
+    uint32_t histogram[TCAM_STATISTICS_HISTOGRAM_SIZE]; /**< luminance histogram; 8 bit scale */
+
+    struct tcam_statistics_tile tiles[TCAM_STATISTICS_TILES_X * TCAM_STATISTICS_TILES_Y];
+};
+
+
+#define TCAM_METERING_MAX_REGIONS 8
+
+
+/**
+ * @enum TCAM_METERING_MODE
+ * @brief predefined region layouts for image analysis
+ */
+enum TCAM_METERING_MODE
+{
+    TCAM_METERING_AVERAGE = 0,      /**< whole image, equally weighted */
+    TCAM_METERING_CENTER_WEIGHTED,  /**< whole image with emphasis on the center */
+    TCAM_METERING_SPOT,             /**< small area in the image center */
+};
+
+
+/**
+ * @struct tcam_metering_region
+ * @brief rectangle in image coordinates that shall be analyzed
+ */
+struct tcam_metering_region
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t weight;    /**< relative weight of the contained pixels; 0 disables the region */
+};
+
+
+/**
+ * @struct tcam_metering
+ * @brief set of weighted regions; overlapping regions add up their weights
+ */
+struct tcam_metering
+{
+    uint32_t region_count;
+    struct tcam_metering_region regions[TCAM_METERING_MAX_REGIONS];
+};
+
+/** @} */
+
+namespace tcam
+{
+
+/**
+ * @brief Check if image statistics can be calculated for the given format
+ * @param fourcc - pixel format that shall be checked
+ * @return true if format is supported
+ */
+bool is_statistics_format_supported (uint32_t fourcc);
+
+
+/**
+ * @brief Analyze an image in a single pass
+ *
+ * Supported are 8 bit and 16 bit container formats for mono and bayer images.
+ * 10/12 bit bayer data is expected to be stored lsb aligned in 16 bit.
+ * @param buffer - image that shall be analyzed; a pitch of 0 describes lines without padding
+ * @param statistics - struct that shall be filled
+ * @return true on success; false if format is not supported
+ */
+bool calculate_image_statistics (const struct tcam_image_buffer& buffer,
+                                 struct tcam_image_statistics& statistics);
+
+
+/**
+ * @brief Fill metering with the regions of a predefined mode
+ * @param mode - layout that shall be used
+ * @param width - image width in pixel
+ * @param height - image height in pixel
+ * @param metering - struct that shall be filled
+ * @return true on success
+ */
+bool create_metering (TCAM_METERING_MODE mode,
+                      uint32_t width,
+                      uint32_t height,
+                      struct tcam_metering& metering);
+
+
+/**
+ * @brief Append a custom region
+ * @return false if region is empty or no more regions can be added
+ */
+bool add_metering_region (struct tcam_metering& metering,
+                          const struct tcam_metering_region& region);
+
+
+/**
+ * @return true if metering consists of a single region covering the whole image
+ */
+bool is_full_image_metering (const struct tcam_metering& metering,
+                             uint32_t width,
+                             uint32_t height);
+
+
+/**
+ * @brief Analyze only the regions of an image
+ *
+ * Pixels are addressed through the pitch of the buffer,
+ * so the cost depends on the size of the regions, not of the image.
+ * Tiles refer to the grid of the whole image; tiles outside of
+ * all regions have a sample_count of 0.
+ * @param buffer - image that shall be analyzed; a pitch of 0 describes lines without padding
+ * @param metering - regions that shall be analyzed; clipped to the image
+ * @param statistics - struct that shall be filled
+ * @return true on success; false if format is not supported or no region is valid
+ */
+bool calculate_region_statistics (const struct tcam_image_buffer& buffer,
+                                  const struct tcam_metering& metering,
+                                  struct tcam_image_statistics& statistics);
+
+} /* namespace tcam */
+
+#endif /* TCAM_IMAGE_STATISTICS_H */
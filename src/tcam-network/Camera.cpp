@@ -17,6 +17,7 @@
 #include "Camera.h"
 #include "utils.h"
 #include "Firmware.h"
+#include "RequestQueue.h"
 
 #include <thread>
 #include <future>
@@ -85,6 +86,8 @@ Camera::Camera (const Packet::ACK_DISCOVERY& _packet,
 
     this->requestID = 1;
     this->isControlled = false;
+    this->capabilitiesKnown = false;
+    this->gvcpCapabilities = 0;
 }
 
 
@@ -99,6 +102,8 @@ Camera::Camera (const Packet::ACK_DISCOVERY& _packet,
 
     this->requestID = 1;
     this->isControlled = false;
+    this->capabilitiesKnown = false;
+    this->gvcpCapabilities = 0;
 }
 
 
@@ -142,6 +147,9 @@ int Camera::resetCounter ()
 void Camera::updateCamera (std::shared_ptr<Camera> cam)
 {
     this->packet = cam->packet;
+
+    // the camera may have been updated in the meantime
+    this->capabilitiesKnown = false;
 }
 
 
@@ -173,9 +181,11 @@ bool Camera::setUserDefinedName (const std::string& name)
 {
     if (getControl())
     {
-        char buf[16];
+        char buf[16] = {};
         strcpy(buf, name.substr(0,15).c_str());
-        return sendWriteMemory(Register::USER_DEFINED_NAME_REGISTER, sizeof(buf), &buf);
+        bool retv = sendWriteMemory({ { Register::USER_DEFINED_NAME_REGISTER, sizeof(buf), buf } });
+        abandonControl();
+        return retv;
     }
     else
     {
@@ -463,19 +473,7 @@ bool Camera::forceIP (const std::string& ip, const std::string& subnet, const st
     uint32_t _subnet = ip2int(subnet);
     uint32_t _gateway = ip2int(gateway);
 
-    bool returnVal = true;
-
-    this->sendForceIP(_ip, _subnet, _gateway);
-
-    // we want to reset to ip configuration
-    // and will not get an ack paket
-    // assume everything is ok
-    if ( _ip == 0 && _subnet == 0 && _gateway == 0 )
-    {
-        returnVal = true;
-    }
-
-    return returnVal;
+    return this->sendForceIP(_ip, _subnet, _gateway);
 }
 
 
@@ -511,6 +509,18 @@ std::string Camera::getInterfaceName ()
 }
 
 
+std::shared_ptr<NetworkInterface> Camera::getNetworkInterface ()
+{
+    return interface;
+}
+
+
+const Packet::ACK_DISCOVERY& Camera::getDiscoveryPacket () const
+{
+    return packet;
+}
+
+
 bool Camera::getControl ()
 {
     bool retv = false;
@@ -688,7 +698,365 @@ bool Camera::sendWriteMemory (const uint32_t address, const size_t size, void* d
 }
 
 
-void Camera::sendForceIP (const uint32_t ip, const uint32_t subnet, const uint32_t gateway)
+bool Camera::sendReadMemory (const std::vector<MemoryTransfer>& transfers,
+                             unsigned int window,
+                             unsigned int timeout_in_ms)
+{
+    return sendMemoryRequests(false, transfers, window, timeout_in_ms);
+}
+
+
+bool Camera::sendWriteMemory (const std::vector<MemoryTransfer>& transfers,
+                              unsigned int window,
+                              unsigned int timeout_in_ms)
+{
+    return sendMemoryRequests(true, transfers, window, timeout_in_ms);
+}
+
+
+bool Camera::sendMemoryRequests (bool write,
+                                 const std::vector<MemoryTransfer>& transfers,
+                                 unsigned int window,
+                                 unsigned int timeout_in_ms)
+{
+    for (const auto& t : transfers)
+    {
+        if ((t.size % 4) != 0 || t.size == 0 || t.size > GVCP_MAX_MEMORY_PAYLOAD)
+        {
+            return false;
+        }
+    }
+
+    // flash writes may take longer than a register access; devices that announce
+    // this with a PENDING_ACK extend the timeout themselves
+    RequestQueue queue(window, timeout_in_ms);
+
+    for (const auto& t : transfers)
+    {
+        std::vector<uint8_t> command;
+
+        if (write)
+        {
+            command.resize(sizeof(Packet::COMMAND_HEADER) + sizeof(uint32_t) + t.size);
+            auto packet = (Packet::CMD_WRITEMEM*)command.data();
+
+            packet->header.magic = 0x42;
+            packet->header.flag = Flags::NEEDACK;
+            packet->header.command = htons(Commands::WRITEMEM_CMD);
+            packet->header.length = htons(t.size + sizeof(uint32_t));
+            packet->address = htonl(t.address);
+            memcpy(&packet->data, t.data, t.size);
+        }
+        else
+        {
+            command.resize(sizeof(Packet::CMD_READMEM));
+            auto packet = (Packet::CMD_READMEM*)command.data();
+
+            packet->header.magic = 0x42;
+            packet->header.flag = Flags::NEEDACK;
+            packet->header.command = htons(Commands::READMEM_CMD);
+            packet->header.length = htons(sizeof(Packet::CMD_READMEM) - sizeof(Packet::COMMAND_HEADER));
+            packet->address = htonl(t.address);
+            packet->reserved = 0;
+            packet->count = htons(t.size);
+        }
+
+        queue.push(socket, getCurrentIP(), std::move(command),
+                   [&t, write] (const Packet::ACK_HEADER* ack, size_t size)
+                   {
+                       if (ack == nullptr || ntohs(ack->status) != Status::SUCCESS)
+                       {
+                           return false;
+                       }
+
+                       if (!write)
+                       {
+                           if (size < sizeof(Packet::ACK_READMEM) + t.size)
+                           {
+                               return false;
+                           }
+                           memcpy(t.data, ((const Packet::ACK_READMEM*)ack)->data, t.size);
+                       }
+                       return true;
+                   });
+    }
+
+    return queue.run() == 0;
+}
+
+
+void Camera::queueReadRegisters (RequestQueue& queue,
+                                 const std::vector<uint32_t>& addresses,
+                                 std::function<void(bool, const std::vector<uint32_t>&)> callback)
+{
+    if (addresses.size() <= 1 || capabilitiesKnown)
+    {
+        size_t maxCount = (gvcpCapabilities & Register::GVCP_SUPPORTS_CONCATENATION) ? GVCP_MAX_READREG_COUNT : 1;
+        queueReadRegisterChunks(queue, addresses, maxCount, callback);
+        return;
+    }
+
+    // the capabilities decide whether the registers may share a READREG;
+    // cameras without concatenation get one request per register
+    queueReadRegisterChunks(queue, { Register::GVCP_SUPPORTED_COMMANDS_REGISTER }, 1,
+                            [this, &queue, addresses, callback] (bool ok, const std::vector<uint32_t>& v)
+                            {
+                                capabilitiesKnown = ok;
+                                gvcpCapabilities = ok ? v.at(0) : 0;
+
+                                size_t maxCount = (gvcpCapabilities & Register::GVCP_SUPPORTS_CONCATENATION)
+                                    ? GVCP_MAX_READREG_COUNT : 1;
+                                queueReadRegisterChunks(queue, addresses, maxCount, callback);
+                            });
+}
+
+
+void Camera::queueReadRegisterChunks (RequestQueue& queue,
+                                      const std::vector<uint32_t>& addresses,
+                                      size_t maxCount,
+                                      std::function<void(bool, const std::vector<uint32_t>&)> callback)
+{
+    // shared by all chunks; the callback runs once the last chunk is answered
+    struct result
+    {
+        std::vector<uint32_t> values;
+        size_t pending;
+        bool success;
+    };
+    auto res = std::make_shared<result>();
+    res->values.resize(addresses.size());
+    res->pending = (addresses.size() + maxCount - 1) / maxCount;
+    res->success = true;
+
+    if (addresses.empty())
+    {
+        callback(true, res->values);
+        return;
+    }
+
+    for (size_t offset = 0; offset < addresses.size(); offset += maxCount)
+    {
+        size_t count = std::min<size_t>(addresses.size() - offset, maxCount);
+
+        std::vector<uint8_t> command(sizeof(Packet::COMMAND_HEADER) + count * sizeof(uint32_t));
+        auto packet = (Packet::CMD_READREG*)command.data();
+
+        packet->header.magic = 0x42;
+        packet->header.flag = Flags::NEEDACK;
+        packet->header.command = htons(Commands::READREG_CMD);
+        packet->header.length = htons(count * sizeof(uint32_t));
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            packet->address[i] = htonl(addresses.at(offset + i));
+        }
+
+        queue.push(socket, getCurrentIP(), std::move(command),
+                   [res, offset, count, callback] (const Packet::ACK_HEADER* ack, size_t size)
+                   {
+                       bool ok = ack != nullptr
+                           && ntohs(ack->status) == Status::SUCCESS
+                           && size >= sizeof(Packet::ACK_HEADER) + count * sizeof(uint32_t);
+
+                       if (ok)
+                       {
+                           auto data = ((const Packet::ACK_READREG*)ack)->data;
+                           for (size_t i = 0; i < count; ++i)
+                           {
+                               res->values.at(offset + i) = ntohl(data[i]);
+                           }
+                       }
+
+                       res->success = res->success && ok;
+
+                       if (--res->pending == 0)
+                       {
+                           callback(res->success, res->values);
+                       }
+                       return ok;
+                   });
+    }
+}
+
+
+bool Camera::supportsConcatenation ()
+{
+    if (!capabilitiesKnown)
+    {
+        std::vector<uint32_t> values;
+
+        // a single register never needs the capabilities itself
+        if (sendReadRegisters({ Register::GVCP_SUPPORTED_COMMANDS_REGISTER }, values))
+        {
+            capabilitiesKnown = true;
+            gvcpCapabilities = values.at(0);
+        }
+    }
+
+    return gvcpCapabilities & Register::GVCP_SUPPORTS_CONCATENATION;
+}
+
+
+bool Camera::sendReadRegisters (const std::vector<uint32_t>& addresses, std::vector<uint32_t>& values)
+{
+    RequestQueue queue;
+    bool success = false;
+
+    queueReadRegisters(queue, addresses,
+                       [&success, &values] (bool ok, const std::vector<uint32_t>& v)
+                       {
+                           success = ok;
+                           values = v;
+                       });
+    queue.run();
+
+    return success;
+}
+
+
+// order of the registers read by queueIPConfiguration
+static const std::vector<uint32_t> IP_CONFIGURATION_REGISTERS =
+{
+    Register::CURRENT_IPCFG_REGISTER,
+    Register::CURRENT_IPADDRESS_REGISTER,
+    Register::CURRENT_SUBNETMASK_REGISTER,
+    Register::CURRENT_DEFAULTGATEWAY_REGISTER,
+    Register::PERSISTANT_IPADDRESS_REGISTER,
+    Register::PERSISTANT_SUBNETMASK_REGISTER,
+    Register::PERSISTANT_DEFAULTGATEWAY_REGISTER,
+};
+
+
+void Camera::queueIPConfiguration (RequestQueue& queue,
+                                   std::function<void(bool, const IPConfiguration&)> callback)
+{
+    queueReadRegisters(queue, IP_CONFIGURATION_REGISTERS,
+                       [callback] (bool ok, const std::vector<uint32_t>& v)
+                       {
+                           IPConfiguration config = {};
+
+                           if (ok)
+                           {
+                               const int static_ip_bit = 0x00;
+                               const int dhcp_bit      = 0x01;
+
+                               config.staticIP = v.at(0) & (1 << static_ip_bit);
+                               config.dhcp = v.at(0) & (1 << dhcp_bit);
+                               config.currentIP = int2ip(v.at(1));
+                               config.currentSubnet = int2ip(v.at(2));
+                               config.currentGateway = int2ip(v.at(3));
+                               config.persistentIP = int2ip(v.at(4));
+                               config.persistentSubnet = int2ip(v.at(5));
+                               config.persistentGateway = int2ip(v.at(6));
+                           }
+                           callback(ok, config);
+                       });
+}
+
+
+bool Camera::getIPConfiguration (IPConfiguration& config)
+{
+    RequestQueue queue;
+    bool success = false;
+
+    queueIPConfiguration(queue,
+                         [&success, &config] (bool ok, const IPConfiguration& c)
+                         {
+                             success = ok;
+                             config = c;
+                         });
+    queue.run();
+
+    return success;
+}
+
+
+bool Camera::setIPConfiguration (const IPConfiguration& config)
+{
+    if (!getControl())
+    {
+        return false;
+    }
+
+    const int static_ip_bit = 0x00;
+    const int dhcp_bit      = 0x01;
+    const int lla_bit       = 0x02;
+
+    uint32_t flags = ntohl(this->packet.IPConfigCurrent);
+
+    flags |= (0x01 << lla_bit);  // always on
+    flags = config.dhcp ? (flags | (0x01 << dhcp_bit)) : (flags & ~(0x01 << dhcp_bit));
+    flags = config.staticIP ? (flags | (0x01 << static_ip_bit)) : (flags & ~(0x01 << static_ip_bit));
+
+    // ip2int already returns network byte order
+    const std::vector<Packet::CMD_WRITEREG_OP> ops =
+        {
+            { htonl(Register::PERSISTANT_IPADDRESS_REGISTER), (uint32_t)ip2int(config.persistentIP) },
+            { htonl(Register::PERSISTANT_SUBNETMASK_REGISTER), (uint32_t)ip2int(config.persistentSubnet) },
+            { htonl(Register::PERSISTANT_DEFAULTGATEWAY_REGISTER), (uint32_t)ip2int(config.persistentGateway) },
+            { htonl(Register::CURRENT_IPCFG_REGISTER), htonl(flags) },
+        };
+
+    // cameras without concatenation get one WRITEREG per register;
+    // a window of one keeps them in order so that the flags are written last
+    bool concatenate = supportsConcatenation();
+    size_t opsPerCommand = concatenate ? ops.size() : 1;
+
+    bool success = true;
+
+    RequestQueue queue(concatenate ? 16 : 1);
+
+    for (size_t offset = 0; offset < ops.size(); offset += opsPerCommand)
+    {
+        size_t count = std::min(opsPerCommand, ops.size() - offset);
+
+        std::vector<uint8_t> command(sizeof(Packet::COMMAND_HEADER) + count * sizeof(Packet::CMD_WRITEREG_OP));
+        auto packet = (Packet::CMD_WRITEREG*)command.data();
+
+        packet->header.magic = 0x42;
+        packet->header.flag = Flags::NEEDACK;
+        packet->header.command = htons(Commands::WRITEREG_CMD);
+        packet->header.length = htons(count * sizeof(Packet::CMD_WRITEREG_OP));
+        memcpy(packet->ops, &ops.at(offset), count * sizeof(Packet::CMD_WRITEREG_OP));
+
+        queue.push(socket, getCurrentIP(), std::move(command),
+                   [&success] (const Packet::ACK_HEADER* ack, size_t /* size */)
+                   {
+                       bool ok = ack != nullptr && ntohs(ack->status) == Status::SUCCESS;
+                       success = success && ok;
+                       return ok;
+                   });
+    }
+
+    queue.run();
+
+    abandonControl();
+
+    return success;
+}
+
+
+void getIPConfigurations (const camera_list& cameras,
+                          std::function<void(std::shared_ptr<Camera>, bool, const IPConfiguration&)> callback)
+{
+    // a single queue keeps all cameras busy at once,
+    // also those that share the socket of their interface
+    RequestQueue queue;
+
+    for (const auto& cam : cameras)
+    {
+        cam->queueIPConfiguration(queue,
+                                  [cam, callback] (bool ok, const IPConfiguration& config)
+                                  {
+                                      callback(cam, ok, config);
+                                  });
+    }
+
+    queue.run();
+}
+
+
+bool Camera::sendForceIP (const uint32_t ip, const uint32_t subnet, const uint32_t gateway)
 {
     unsigned short id = generateRequestID();
     auto s = getSocket();
@@ -699,7 +1067,7 @@ void Camera::sendForceIP (const uint32_t ip, const uint32_t subnet, const uint32
     packet.header.flag = Flags::NEEDACK;
     packet.header.command = htons(Commands::FORCEIP_CMD);
     packet.header.length = htons(sizeof(Packet::CMD_FORCEIP) - sizeof(Packet::COMMAND_HEADER));
-    packet.header.req_id = id;
+    packet.header.req_id = htons(id);
 
     packet.DeviceMACHigh = this->packet.DeviceMACHigh;
     packet.DeviceMACLow = this->packet.DeviceMACLow;
@@ -708,14 +1076,50 @@ void Camera::sendForceIP (const uint32_t ip, const uint32_t subnet, const uint32
     packet.StaticSubnetMask = subnet;
     packet.StaticGateway = gateway;
 
-    try
+    // we want to reset to ip configuration
+    // and will not get an ack paket
+    // assume everything is ok
+    if (ip == 0 && subnet == 0 && gateway == 0)
     {
-        s->sendAndReceive("255.255.255.255", &packet, sizeof(packet), NULL, true);
+        try
+        {
+            s->sendAndReceive("255.255.255.255", &packet, sizeof(packet), NULL, true);
+        }
+        catch (SocketSendToException& e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+        return true;
     }
-    catch (SocketSendToException& e)
+
+    bool acknowledged = false;
+
+    auto callback_function = [id, &acknowledged] (void* msg) -> int
     {
-        std::cerr << e.what() << std::endl;
+        auto ack = (Packet::ACK_HEADER*) msg;
+
+        if (ntohs(ack->answer) == Commands::FORCEIP_ACK && ntohs(ack->ack_id) == id)
+        {
+            acknowledged = true;
+            return Socket::SendAndReceiveSignals::END;
+        }
+        return Socket::SendAndReceiveSignals::CONTINUE;
+    };
+
+    // the broadcast is easily lost; resend it until the camera confirms
+    for (int attempt = 0; attempt < 3 && !acknowledged; ++attempt)
+    {
+        try
+        {
+            s->sendAndReceive("255.255.255.255", &packet, sizeof(packet), callback_function, true);
+        }
+        catch (SocketSendToException& e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
     }
+
+    return acknowledged;
 }
 
 } /* namespace tis */
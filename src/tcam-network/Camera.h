@@ -19,6 +19,7 @@
 
 #include "gigevision.h"
 #include "NetworkInterface.h"
+#include <functional>
 #include <string>
 #include <vector>
 #include <memory>
@@ -26,6 +27,7 @@
 namespace tis
 {
     class Camera;
+    class RequestQueue;
     typedef std::vector<std::shared_ptr<Camera>> camera_list;
 
     enum camera_ident
@@ -43,6 +45,41 @@ namespace tis
     std::shared_ptr<Camera> getCameraFromList (const camera_list cameras, const std::string& identifier, camera_ident id_type = CAMERA_SERIAL);
 
 
+    /// @struct MemoryTransfer
+    /// @brief single READMEM/WRITEMEM request of a pipelined transfer
+    struct MemoryTransfer
+    {
+        uint32_t address;
+        uint32_t size;      // multiple of 4; at most GVCP_MAX_MEMORY_PAYLOAD
+        void* data;         // source for writes, target for reads
+    };
+
+
+    /// @struct IPConfiguration
+    /// @brief ip related registers of a camera; read with a single request
+    struct IPConfiguration
+    {
+        bool dhcp;
+        bool staticIP;
+
+        std::string currentIP;
+        std::string currentSubnet;
+        std::string currentGateway;
+
+        std::string persistentIP;
+        std::string persistentSubnet;
+        std::string persistentGateway;
+    };
+
+
+    /// @name getIPConfigurations
+    /// @param cameras - cameras that shall be queried
+    /// @param callback - called for every camera; bool is false if the camera did not answer
+    /// @brief queries all cameras concurrently; returns when every camera was handled
+    void getIPConfigurations (const camera_list& cameras,
+                              std::function<void(std::shared_ptr<Camera>, bool, const IPConfiguration&)> callback);
+
+
 class Camera
 {
 private:
@@ -68,6 +105,10 @@ private:
     // default value from constructor
     int timeoutCounterDefault;
 
+    // GVCP_SUPPORTED_COMMANDS_REGISTER; read on first use
+    bool capabilitiesKnown;
+    uint32_t gvcpCapabilities;
+
 public:
 
     Camera (const Packet::ACK_DISCOVERY& packet, std::shared_ptr<NetworkInterface> _interface, int timeoutIntervals = 3);
@@ -156,7 +197,7 @@ public:
     /// @param ip - address to be used
     /// @param subnet - subnet address to be used
     /// @param gateway - gateway to be used
-    /// @return true on success
+    /// @return true if the camera acknowledged the new address; always true for 0.0.0.0
     bool forceIP (const std::string& ip, const std::string& subnet, const std::string& gateway);
 
     /// @name getFirmwareVersion
@@ -176,6 +217,14 @@ public:
     /// @return name of interface used for communication
     std::string getInterfaceName ();
 
+    /// @name getNetworkInterface
+    /// @return interface used for communication
+    std::shared_ptr<NetworkInterface> getNetworkInterface ();
+
+    /// @name getDiscoveryPacket
+    /// @return discovery acknowledge this camera was created from
+    const Packet::ACK_DISCOVERY& getDiscoveryPacket () const;
+
     /// checks if camera is reachable from interface
     bool isReachable();
 
@@ -208,13 +257,89 @@ public:
     /// @return int containing the return value of write attempt
     bool sendWriteMemory (const uint32_t address, const size_t size, void* data);
 
+    /// @name supportsConcatenation
+    /// @return true if the camera accepts several registers in one READREG/WRITEREG
+    /// @brief reads GVCP_SUPPORTED_COMMANDS_REGISTER on first use; false if that fails
+    bool supportsConcatenation ();
+
+    /// @name sendReadRegisters
+    /// @param addresses - registers that shall be read
+    /// @param values - receives the register values in host byte order
+    /// @return true if every register was read
+    /// @brief Reads all registers with as few READREG requests as the camera allows
+    bool sendReadRegisters (const std::vector<uint32_t>& addresses, std::vector<uint32_t>& values);
+
+    /// @name queueReadRegisters
+    /// @param queue - queue the READREG requests are added to
+    /// @param addresses - registers that shall be read
+    /// @param callback - called with the values in host byte order once queue has run
+    /// @brief concatenates the registers into one READREG only if the camera supports it;
+    ///        queue and camera have to stay alive until queue has run
+    void queueReadRegisters (RequestQueue& queue,
+                             const std::vector<uint32_t>& addresses,
+                             std::function<void(bool, const std::vector<uint32_t>&)> callback);
+
+    /// @name getIPConfiguration
+    /// @param config - receives the current ip configuration
+    /// @return true on success
+    /// @brief Reads all ip related registers in a single round trip if the camera supports concatenation
+    bool getIPConfiguration (IPConfiguration& config);
+
+    /// @name setIPConfiguration
+    /// @param config - persistent addresses and dhcp/static flags; current values are ignored
+    /// @return true on success
+    /// @brief Writes all ip related registers with a single request if the camera supports concatenation
+    bool setIPConfiguration (const IPConfiguration& config);
+
+    /// @name queueIPConfiguration
+    /// @param queue - queue the request is added to
+    /// @param callback - called with the ip configuration once queue has run
+    void queueIPConfiguration (RequestQueue& queue,
+                               std::function<void(bool, const IPConfiguration&)> callback);
+
+    /// @name sendReadMemory
+    /// @param transfers - blocks that shall be read
+    /// @param window - maximum number of unacknowledged requests
+    /// @param timeout_in_ms - time a request may stay unanswered before it is resent
+    /// @return true if every block was read
+    /// @brief Keeps up to window READMEM requests in flight and resends only unanswered ones
+    bool sendReadMemory (const std::vector<MemoryTransfer>& transfers,
+                         unsigned int window = 16,
+                         unsigned int timeout_in_ms = 500);
+
+    /// @name sendWriteMemory
+    /// @param transfers - blocks that shall be written
+    /// @param window - maximum number of unacknowledged requests
+    /// @param timeout_in_ms - time a request may stay unanswered before it is resent
+    /// @return true if every block was acknowledged
+    /// @brief Keeps up to window WRITEMEM requests in flight and resends only unanswered ones
+    bool sendWriteMemory (const std::vector<MemoryTransfer>& transfers,
+                          unsigned int window = 16,
+                          unsigned int timeout_in_ms = 500);
+
 private:
 
+    /// @name queueReadRegisterChunks
+    /// @param maxCount - largest number of registers per READREG
+    /// @brief splits addresses into READREG requests of at most maxCount registers
+    void queueReadRegisterChunks (RequestQueue& queue,
+                                  const std::vector<uint32_t>& addresses,
+                                  size_t maxCount,
+                                  std::function<void(bool, const std::vector<uint32_t>&)> callback);
+
+    /// @name sendMemoryRequests
+    /// @brief shared implementation of the pipelined READMEM/WRITEMEM transfers
+    bool sendMemoryRequests (bool write,
+                             const std::vector<MemoryTransfer>& transfers,
+                             unsigned int window,
+                             unsigned int timeout_in_ms);
+
     /// @name sendForceIP
     /// @param ip - ip address camera shall use
     /// @param netmask - netmask camera shall use
     /// @param gateway - gateway camera shall use
-    void sendForceIP (const uint32_t ip, const uint32_t subnet, const uint32_t gateway);
+    /// @return true if the camera acknowledged
+    bool sendForceIP (const uint32_t ip, const uint32_t subnet, const uint32_t gateway);
 
 };
 
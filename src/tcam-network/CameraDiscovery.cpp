@@ -26,7 +26,11 @@
 
 #include <thread>
 #include <algorithm>
+#include <chrono>
+#include <mutex>
 #include <errno.h>
+#include <sys/epoll.h>
+#include <arpa/inet.h>
 
 namespace tis
 {
@@ -75,91 +79,243 @@ std::vector<std::shared_ptr<NetworkInterface>> detectNetworkInterfaces ()
 }
 
 
-void discoverCameras (std::function<void (std::shared_ptr<Camera>)> const & discover_call)
+namespace
+{
+
+struct discovery_cache_entry
 {
+    std::chrono::steady_clock::time_point time;
+    std::vector<std::string> interfaces;
     std::vector<std::shared_ptr<Camera>> cameras;
-    auto interfaces = detectNetworkInterfaces();
+};
 
-    if (interfaces.empty())
-    {
-        return;
-    }
+std::mutex discovery_cache_mutex;
+std::vector<discovery_cache_entry> discovery_cache;
 
-    std::vector<std::thread> thread_list;
-    // allocate whole in one step
-    thread_list.reserve(interfaces.size());
 
-    for (auto& inf : interfaces)
+bool isValidDiscoveryAck (const char* msg, ssize_t size)
+{
+    if (size < (ssize_t)sizeof(Packet::ACK_DISCOVERY))
     {
-        std::shared_ptr<NetworkInterface> ni = inf;
-        thread_list.push_back(std::thread( [inf, discover_call] () { sendDiscovery(inf, discover_call); } ));
+        return false;
     }
 
-    for (auto& thr : thread_list)
-    {
-        thr.join();
-    }
+    auto ack = (const Packet::ACK_DISCOVERY*) msg;
+
+    return ntohs(ack->header.answer) == Commands::DISCOVERY_ACK
+        && ntohs(ack->header.status) == Status::SUCCESS;
 }
 
 
-void discoverCameras (std::vector<std::string> selectected_interfaces,
-                      std::function<void (std::shared_ptr<Camera>)> const & discover_call)
+size_t runDiscovery (const std::vector<std::shared_ptr<NetworkInterface>>& interfaces,
+                     const DiscoveryOptions& options,
+                     std::function<void (std::shared_ptr<Camera>)> const & discover_call,
+                     std::vector<std::shared_ptr<Camera>>& found)
 {
-    std::vector<std::shared_ptr<Camera>> cameras;
-    auto interfaces = detectNetworkInterfaces();
+    Packet::CMD_DISCOVERY discovery_packet;
+    discovery_packet.header.command = htons( Commands::DISCOVERY_CMD );
+    discovery_packet.header.flag    = Flags::NEEDACK;
+    discovery_packet.header.length  = htons( 0 );
+    discovery_packet.header.magic   = 0x42;
+    discovery_packet.header.req_id  = htons( 1 );
 
-    if (interfaces.empty())
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1)
     {
-        return;
+        std::cerr << "Unable to create epoll instance: " << strerror(errno) << std::endl;
+        return 0;
     }
 
-    std::vector<std::thread> thread_list;
-    // allocate whole in one step
-    thread_list.reserve(interfaces.size());
+    std::vector<std::shared_ptr<Socket>> sockets(interfaces.size());
 
-    for (auto& inf : interfaces)
+    // send all requests before waiting for any answer
+    // so that all interfaces share one deadline
+    for (unsigned int i = 0; i < interfaces.size(); ++i)
     {
-        if (std::find(selectected_interfaces.begin(), selectected_interfaces.end(), inf->getInterfaceName()) != selectected_interfaces.end())
+        try
+        {
+            auto s = interfaces.at(i)->createSocket();
+            s->sendTo("255.255.255.255", &discovery_packet, sizeof(discovery_packet), true);
+
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.u32 = i;
+
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->getFileDescriptor(), &ev) == 0)
+            {
+                sockets.at(i) = s;
+            }
+        }
+        catch (std::exception& e)
         {
-            std::shared_ptr<NetworkInterface> ni = inf;
-            thread_list.push_back(std::thread( [inf, discover_call] () { sendDiscovery(inf, discover_call); } ));
+            std::cerr << interfaces.at(i)->getInterfaceName() << ": " << e.what() << std::endl;
         }
     }
 
-    for (auto& thr : thread_list)
+    // the same camera can answer on multiple interfaces; report it once
+    std::vector<uint64_t> seen_macs;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeout_ms);
+
+    while (!options.complete || !options.complete(found))
     {
-        thr.join();
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+
+        if (remaining <= 0)
+        {
+            break;
+        }
+
+        struct epoll_event events[8];
+        int n = epoll_wait(epoll_fd, events, 8, (int)remaining);
+
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+
+        for (int e = 0; e < n; ++e)
+        {
+            unsigned int index = events[e].data.u32;
+            auto& s = sockets.at(index);
+
+            char msg[1024];
+            ssize_t size;
+
+            while ((size = recv(s->getFileDescriptor(), msg, sizeof(msg), MSG_DONTWAIT)) >= 0)
+            {
+                if (!isValidDiscoveryAck(msg, size))
+                {
+                    continue;
+                }
+
+                auto ack = (const Packet::ACK_DISCOVERY*) msg;
+                uint64_t mac = ((uint64_t)ntohs(ack->DeviceMACHigh) << 32) | ntohl(ack->DeviceMACLow);
+
+                if (std::find(seen_macs.begin(), seen_macs.end(), mac) != seen_macs.end())
+                {
+                    continue;
+                }
+                seen_macs.push_back(mac);
+
+                auto cam = std::shared_ptr<Camera>(new Camera(*ack, interfaces.at(index), s));
+                found.push_back(cam);
+                discover_call(cam);
+            }
+        }
     }
+
+    close(epoll_fd);
+
+    return found.size();
 }
 
+} /* namespace */
 
-void sendDiscovery (std::shared_ptr<NetworkInterface> interface, std::function<void (std::shared_ptr<Camera>)> const & discover_call)
+
+size_t discoverCameras (const DiscoveryOptions& options,
+                        std::function<void (std::shared_ptr<Camera>)> const & discover_call)
 {
-    Packet::CMD_DISCOVERY discovery_packet;
-    discovery_packet.header.command = htons( Commands::DISCOVERY_CMD );
-    discovery_packet.header.flag    = Flags::NEEDACK;
-    discovery_packet.header.length  = htons( 0 );
-    discovery_packet.header.magic   = 0x42;
-    discovery_packet.header.req_id  = htons( 1 );
+    std::vector<std::string> selection = options.interfaces;
+    std::sort(selection.begin(), selection.end());
 
-    auto s = interface->createSocket();
+    if (options.cache_lifetime_ms > 0)
+    {
+        std::vector<std::shared_ptr<Camera>> cached;
+        bool hit = false;
+        {
+            std::lock_guard<std::mutex> lck(discovery_cache_mutex);
+
+            auto now = std::chrono::steady_clock::now();
+
+            for (const auto& entry : discovery_cache)
+            {
+                if (entry.interfaces == selection
+                    && now - entry.time < std::chrono::milliseconds(options.cache_lifetime_ms))
+                {
+                    cached = entry.cameras;
+                    hit = true;
+                    break;
+                }
+            }
+        }
 
-    auto callback = [&interface, &discover_call, &s] (void* msg)
+        if (hit)
         {
-            Packet::ACK_DISCOVERY* ack = (Packet::ACK_DISCOVERY*) msg;
-            auto cam = std::shared_ptr<Camera>(new Camera(*ack, interface, s));
-            discover_call(cam);
-            return Socket::SendAndReceiveSignals::CONTINUE;
-        };
+            for (auto& cam : cached)
+            {
+                discover_call(cam);
+            }
+            return cached.size();
+        }
+    }
+
+    auto interfaces = detectNetworkInterfaces();
+
+    if (!selection.empty())
+    {
+        auto not_selected = [&selection] (const std::shared_ptr<NetworkInterface>& inf)
+            {
+                return !std::binary_search(selection.begin(), selection.end(), inf->getInterfaceName());
+            };
+
+        interfaces.erase(std::remove_if(interfaces.begin(), interfaces.end(), not_selected),
+                         interfaces.end());
+    }
 
-    try
+    if (interfaces.empty())
     {
-        s->sendAndReceive("255.255.255.255", &discovery_packet, sizeof(discovery_packet), callback, true);
+        return 0;
     }
-    catch (SocketSendToException& e)
+
+    std::vector<std::shared_ptr<Camera>> found;
+    runDiscovery(interfaces, options, discover_call, found);
+
+    // an early ended run may be incomplete and is not cached
+    if (!options.complete)
     {
-        std::cerr << e.what() << std::endl;
+        std::lock_guard<std::mutex> lck(discovery_cache_mutex);
+
+        auto same_selection = [&selection] (const discovery_cache_entry& entry)
+            {
+                return entry.interfaces == selection;
+            };
+
+        discovery_cache.erase(std::remove_if(discovery_cache.begin(), discovery_cache.end(), same_selection),
+                              discovery_cache.end());
+        discovery_cache.push_back({std::chrono::steady_clock::now(), selection, found});
     }
+
+    return found.size();
+}
+
+
+void discoverCameras (std::function<void (std::shared_ptr<Camera>)> const & discover_call)
+{
+    discoverCameras(DiscoveryOptions(), discover_call);
+}
+
+
+void discoverCameras (std::vector<std::string> selectected_interfaces,
+                      std::function<void (std::shared_ptr<Camera>)> const & discover_call)
+{
+    DiscoveryOptions options;
+    options.interfaces = selectected_interfaces;
+
+    discoverCameras(options, discover_call);
+}
+
+
+void sendDiscovery (std::shared_ptr<NetworkInterface> interface, std::function<void (std::shared_ptr<Camera>)> const & discover_call)
+{
+    std::vector<std::shared_ptr<Camera>> found;
+
+    runDiscovery({interface}, DiscoveryOptions(), discover_call, found);
 }
 
 void sendIpRecovery (const std::string mac, const uint32_t ip, const uint32_t netmask, const uint32_t gateway)
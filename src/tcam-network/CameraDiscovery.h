@@ -31,6 +31,36 @@ namespace tis
     /// @return vector containing all usable network interfaces and a corresponding socket; empty on error
     std::vector<std::shared_ptr<NetworkInterface>> detectNetworkInterfaces ();
 
+    /// @struct DiscoveryOptions
+    /// @brief parameters of a discovery run
+    struct DiscoveryOptions
+    {
+        /// names of the interfaces that shall be queried; empty for all
+        std::vector<std::string> interfaces;
+
+        /// time in ms after which the discovery ends
+        unsigned int timeout_ms;
+
+        /// called with all cameras found so far; the discovery ends as soon as it
+        /// returns true, e.g. when every wanted serial answered; empty to wait for the timeout
+        std::function<bool (const std::vector<std::shared_ptr<Camera>>&)> complete;
+
+        /// age in ms up to which a previous result is reused; 0 to always query
+        unsigned int cache_lifetime_ms;
+
+        DiscoveryOptions ()
+            : interfaces(), timeout_ms(1000), complete(), cache_lifetime_ms(0)
+        {}
+    };
+
+    /// @name discoverCameras
+    /// @param options - interfaces, deadline and cache settings
+    /// @param discover_call - function to call on discovery of a camera; called as answers arrive
+    /// @return number of reported cameras
+    /// @brief queries all selected interfaces concurrently from the calling thread
+    size_t discoverCameras (const DiscoveryOptions& options,
+                            std::function<void (std::shared_ptr<Camera>)> const & discover_call);
+
     /// @name discoverCameras
     /// @param discover_call - function to call on discovery of a camera
     void discoverCameras (const std::function<void(std::shared_ptr<Camera>)> &discover_call);
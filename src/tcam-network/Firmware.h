@@ -74,7 +74,38 @@ public:
         /* } */
     }
 
+    virtual size_t maxTransferSize ()
+    {
+        // largest multiple of the flash page size that fits into a GVCP packet
+        return 512;
+    }
+
+
+    virtual bool writeBlocks (const std::vector<FirmwareUpdate::MemoryBlock>& blocks, unsigned int timeout_in_ms = 2000)
+    {
+        return device_itf_.sendWriteMemory(toTransfers(blocks), 16, timeout_in_ms);
+    }
+
+
+    virtual bool readBlocks (const std::vector<FirmwareUpdate::MemoryBlock>& blocks, unsigned int timeout_in_ms = 2000)
+    {
+        return device_itf_.sendReadMemory(toTransfers(blocks), 16, timeout_in_ms);
+    }
+
 private:
+
+    static std::vector<MemoryTransfer> toTransfers (const std::vector<FirmwareUpdate::MemoryBlock>& blocks)
+    {
+        std::vector<MemoryTransfer> transfers;
+        transfers.reserve(blocks.size());
+
+        for (const auto& b : blocks)
+        {
+            transfers.push_back({ b.address, (uint32_t)b.size, b.data });
+        }
+        return transfers;
+    }
+
     Camera& device_itf_;
 
 }; /* class FwdFirmwareWriter */
@@ -0,0 +1,436 @@
+/*
+ * Copyright 2013 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FirmwareFleet.h"
+
+#include "Camera.h"
+#include "CameraDiscovery.h"
+#include "Firmware.h"
+#include "GigE3Package.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace tis
+{
+
+namespace
+{
+
+const char* statusToString (FirmwareUpdate::Status status)
+{
+    using FirmwareUpdate::Status;
+
+    switch (status)
+    {
+        case Status::Success:
+            return "success";
+        case Status::SuccessDisconnectRequired:
+            return "success, reconnect required";
+        case Status::SuccessNoActionRequired:
+            return "firmware already up to date";
+        case Status::DeviceNotRecognized:
+            return "device not recognized";
+        case Status::DeviceSupportsFwOnly:
+            return "device only supports plain firmware files";
+        case Status::InvalidFile:
+            return "invalid firmware file";
+        case Status::NoMatchFoundInPackage:
+            return "no matching firmware in package";
+        case Status::WriteError:
+            return "write error";
+        case Status::WriteVerificationError:
+            return "verification error";
+        case Status::DeviceAccessFailed:
+            return "device access failed";
+        case Status::MotorFirmwareUpdateFailed:
+            return "motor firmware update failed";
+        case Status::FocusTableUpdateFailed:
+            return "focus table update failed";
+        case Status::MachXO2UpdateFailed:
+            return "MachXO2 update failed";
+    }
+    return "unknown";
+}
+
+
+/// @return FNV-1a hash of the file content as hex string; empty if unreadable
+std::string firmwareHash (const std::string& fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+
+    if (!in)
+    {
+        return "";
+    }
+
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (std::istreambuf_iterator<char> it(in), end; it != end; ++it)
+    {
+        h = (h ^ (uint8_t)*it) * 0x100000001b3ULL;
+    }
+
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+
+    return buf;
+}
+
+
+/// Append only record of camera results.
+/// Every line contains "<serial>\t<firmware hash>\t<state>"; the last line
+/// of a serial and firmware is valid, so a run with another firmware
+/// updates all cameras again.
+/// Lines are synced before an update starts and after it ends so that an
+/// interrupted run knows which cameras were left unfinished.
+class Journal
+{
+public:
+
+    Journal (const std::string& path, const std::string& firmware)
+        : fd(-1), firmware_hash(firmware)
+    {
+        if (path.empty())
+        {
+            return;
+        }
+
+        std::ifstream in(path);
+        std::string line;
+
+        // lines of earlier versions lack the hash and never match
+        while (std::getline(in, line))
+        {
+            auto pos = line.rfind('\t');
+            if (pos != std::string::npos)
+            {
+                states[line.substr(0, pos)] = line.substr(pos + 1);
+            }
+        }
+
+        fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+
+        if (fd == -1)
+        {
+            throw std::runtime_error("Unable to open journal " + path);
+        }
+    }
+
+    ~Journal ()
+    {
+        if (fd != -1)
+        {
+            close(fd);
+        }
+    }
+
+    bool hasSucceeded (const std::string& serial) const
+    {
+        auto iter = states.find(serial + "\t" + firmware_hash);
+
+        return iter != states.end()
+            && iter->second == fleetStateToString(FLEET_SUCCEEDED);
+    }
+
+    void record (const std::string& serial, FleetState state)
+    {
+        if (fd == -1)
+        {
+            return;
+        }
+
+        std::string line = serial + "\t" + firmware_hash + "\t" + fleetStateToString(state) + "\n";
+
+        std::lock_guard<std::mutex> lck(mtx);
+
+        if (write(fd, line.c_str(), line.size()) == (ssize_t)line.size())
+        {
+            fsync(fd);
+        }
+    }
+
+private:
+
+    int fd;
+    std::string firmware_hash;
+    std::mutex mtx;
+    // "<serial>\t<firmware hash>" -> state
+    std::map<std::string, std::string> states;
+};
+
+} /* namespace */
+
+
+const char* fleetStateToString (FleetState state)
+{
+    switch (state)
+    {
+        case FLEET_PENDING:
+            return "pending";
+        case FLEET_UPDATING:
+            return "updating";
+        case FLEET_SUCCEEDED:
+            return "succeeded";
+        case FLEET_FAILED:
+            return "failed";
+        case FLEET_SKIPPED:
+            return "skipped";
+        case FLEET_NOT_FOUND:
+            return "not-found";
+    }
+    return "unknown";
+}
+
+
+size_t updateFleet (const FleetUpdateOptions& options,
+                    std::function<void(const FleetUpdateEvent&)> report)
+{
+    if (options.serials.empty() && options.model.empty())
+    {
+        throw std::invalid_argument("No cameras selected for update.");
+    }
+
+    if (access(options.firmware.c_str(), R_OK) != 0)
+    {
+        throw std::invalid_argument("Unable to read firmware file " + options.firmware);
+    }
+
+    Journal journal(options.journal, firmwareHash(options.firmware));
+
+    // GigE3 packages are parsed once and shared by all workers;
+    // other firmware files are small and read per camera
+    std::unique_ptr<FirmwareUpdate::GigE3::Package> package;
+
+    const std::string ending = ".fwpack";
+    if (options.firmware.size() > ending.size()
+        && options.firmware.compare(options.firmware.size() - ending.size(), ending.size(), ending) == 0)
+    {
+        package.reset(new FirmwareUpdate::GigE3::Package());
+
+        if (FirmwareUpdate::failed(package->Load(options.firmware)))
+        {
+            // packages of older devices have no manifest
+            package.reset();
+        }
+    }
+
+    std::mutex report_mtx;
+    auto send = [&report, &report_mtx] (const FleetUpdateEvent& event)
+    {
+        std::lock_guard<std::mutex> lck(report_mtx);
+        report(event);
+    };
+
+    DiscoveryOptions discovery;
+    discovery.timeout_ms = 3000;
+
+    // other cameras on the network answer as well; only the wanted serials end the search early
+    if (!options.serials.empty())
+    {
+        discovery.complete = [&options] (const std::vector<std::shared_ptr<Camera>>& found)
+            {
+                for (const auto& serial : options.serials)
+                {
+                    auto has_serial = [&serial] (const std::shared_ptr<Camera>& cam)
+                        {
+                            return cam->getSerialNumber() == serial;
+                        };
+
+                    if (std::none_of(found.begin(), found.end(), has_serial))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            };
+    }
+
+    camera_list cameras;
+    discoverCameras(discovery, [&cameras] (std::shared_ptr<Camera> c)
+                    {
+                        cameras.push_back(c);
+                    });
+
+    size_t failures = 0;
+
+    // cameras per interface in the order they shall be updated
+    std::map<std::string, std::deque<std::shared_ptr<Camera>>> queues;
+
+    auto enqueue = [&] (std::shared_ptr<Camera> cam)
+    {
+        auto serial = cam->getSerialNumber();
+
+        if (journal.hasSucceeded(serial))
+        {
+            send({ serial, cam->getInterfaceName(), FLEET_SKIPPED, 100, "updated in an earlier run" });
+            return;
+        }
+
+        send({ serial, cam->getInterfaceName(), FLEET_PENDING, 0, "" });
+        queues[cam->getInterfaceName()].push_back(cam);
+    };
+
+    if (!options.serials.empty())
+    {
+        for (const auto& serial : options.serials)
+        {
+            auto cam = getCameraFromList(cameras, serial, CAMERA_SERIAL);
+
+            if (cam != nullptr)
+            {
+                enqueue(cam);
+            }
+            else if (journal.hasSucceeded(serial))
+            {
+                // probably still rebooting from the earlier run
+                send({ serial, "", FLEET_SKIPPED, 100, "updated in an earlier run" });
+            }
+            else
+            {
+                send({ serial, "", FLEET_NOT_FOUND, 0, "camera not found" });
+                failures++;
+            }
+        }
+    }
+    else
+    {
+        for (auto& cam : cameras)
+        {
+            if (cam->getModelName() == options.model)
+            {
+                enqueue(cam);
+            }
+        }
+    }
+
+    std::mutex queue_mtx;
+
+    auto worker = [&] (const std::string& interface)
+    {
+        while (true)
+        {
+            std::shared_ptr<Camera> discovered;
+            {
+                std::lock_guard<std::mutex> lck(queue_mtx);
+
+                auto& queue = queues[interface];
+                if (queue.empty())
+                {
+                    return;
+                }
+                discovered = queue.front();
+                queue.pop_front();
+            }
+
+            auto serial = discovered->getSerialNumber();
+
+            journal.record(serial, FLEET_UPDATING);
+            send({ serial, interface, FLEET_UPDATING, 0, "" });
+
+            FleetState state;
+            std::string message;
+
+            // socket errors of one camera must not end the other updates
+            try
+            {
+                // discovered cameras share the socket of their interface;
+                // concurrent updates need one socket per camera
+                auto cam = std::make_shared<Camera>(discovered->getDiscoveryPacket(),
+                                                    discovered->getNetworkInterface());
+
+                int last_progress = 0;
+                auto progress = [&] (int pct)
+                {
+                    if (pct != last_progress)
+                    {
+                        last_progress = pct;
+                        send({ serial, interface, FLEET_UPDATING, pct, "" });
+                    }
+                };
+
+                FwdFirmwareWriter writer(*cam);
+                FirmwareUpdate::Status status;
+
+                if (package)
+                {
+                    status = FirmwareUpdate::upgradeFirmware(writer, cam->getDiscoveryPacket(),
+                                                             options.firmware, *package,
+                                                             options.overrideModelName, progress);
+                }
+                else
+                {
+                    status = FirmwareUpdate::upgradeFirmware(writer, cam->getDiscoveryPacket(),
+                                                             options.firmware,
+                                                             options.overrideModelName, progress);
+                }
+
+                state = FirmwareUpdate::succeeded(status) ? FLEET_SUCCEEDED : FLEET_FAILED;
+                message = statusToString(status);
+            }
+            catch (const std::exception& e)
+            {
+                state = FLEET_FAILED;
+                message = std::string("device access failed: ") + e.what();
+            }
+
+            journal.record(serial, state);
+            send({ serial, interface, state, 100, message });
+
+            if (state == FLEET_FAILED)
+            {
+                std::lock_guard<std::mutex> lck(queue_mtx);
+                failures++;
+            }
+        }
+    };
+
+    unsigned int parallel = std::max(options.parallelPerInterface, 1u);
+
+    // determined up front; the queues shrink as soon as the first worker runs
+    std::vector<std::string> slots;
+    for (const auto& q : queues)
+    {
+        size_t count = std::min<size_t>(parallel, q.second.size());
+
+        slots.insert(slots.end(), count, q.first);
+    }
+
+    std::vector<std::thread> workers;
+    for (const auto& interface : slots)
+    {
+        workers.push_back(std::thread(worker, interface));
+    }
+
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+
+    return failures;
+}
+
+} /* namespace tis */
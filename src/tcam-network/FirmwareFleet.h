@@ -0,0 +1,100 @@
+/*
+ * Copyright 2013 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FIRMWAREFLEET_H_
+#define _FIRMWAREFLEET_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace tis
+{
+
+    /// @enum FleetState
+    /// @brief update state of a single camera
+    enum FleetState
+    {
+        FLEET_PENDING = 0,  // waiting for a free slot on its interface
+        FLEET_UPDATING,
+        FLEET_SUCCEEDED,
+        FLEET_FAILED,
+        FLEET_SKIPPED,      // already updated with this firmware according to the journal
+        FLEET_NOT_FOUND,    // requested serial did not answer the discovery
+    };
+
+
+    /// @name fleetStateToString
+    /// @return lower case name of state as used in the journal
+    const char* fleetStateToString (FleetState state);
+
+
+    /// @struct FleetUpdateOptions
+    /// @brief selection and limits of a fleet update
+    struct FleetUpdateOptions
+    {
+        /// firmware file that shall be uploaded
+        std::string firmware;
+
+        /// serial numbers of the cameras that shall be updated
+        std::vector<std::string> serials;
+
+        /// update all cameras of this model; only used when serials is empty
+        std::string model;
+
+        /// model name passed to the update; empty to use the model of each camera
+        std::string overrideModelName;
+
+        /// number of cameras that are updated at the same time on one interface
+        unsigned int parallelPerInterface;
+
+        /// file recording the result of every camera; empty to disable
+        /// cameras that succeeded in an earlier run with the same firmware file content are skipped
+        std::string journal;
+
+        FleetUpdateOptions ()
+            : parallelPerInterface(4)
+        {}
+    };
+
+
+    /// @struct FleetUpdateEvent
+    /// @brief state change or progress of a single camera
+    struct FleetUpdateEvent
+    {
+        std::string serial;
+        std::string interface;
+        FleetState state;
+
+        /// percentage of the update; 100 for finished cameras
+        int progress;
+
+        /// result description of finished cameras
+        std::string message;
+    };
+
+
+    /// @name updateFleet
+    /// @param options - cameras and firmware that shall be used
+    /// @param report - called for every event; calls are serialized
+    /// @return number of cameras that were not updated
+    /// @brief parses the firmware once and updates the selected cameras concurrently
+    size_t updateFleet (const FleetUpdateOptions& options,
+                        std::function<void(const FleetUpdateEvent&)> report);
+
+} /* namespace tis */
+
+#endif /* _FIRMWAREFLEET_H_ */
@@ -18,64 +18,350 @@
 
 #include <zip.h>
 
+#include <algorithm>
+#include <cctype>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace FirmwareUpdate;
+
+
 namespace
 {
-	template<typename TContainer>
-	void internalExtractFile (const std::string& packageFileName,
-                              const std::string& fileName,
-                              TContainer& dest)
-	{
-        int err = 0;
-        zip* z = zip_open(packageFileName.c_str(), 0, &err);
-
-		if (!z)
+    // zip format constants; see APPNOTE.TXT of PKWARE
+    const uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+    const uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+    const uint32_t END_OF_CENTRAL_DIR_SIGNATURE = 0x06054b50;
+
+    const size_t LOCAL_HEADER_SIZE = 30;
+    const size_t CENTRAL_HEADER_SIZE = 46;
+    const size_t END_OF_CENTRAL_DIR_SIZE = 22;
+
+    const uint16_t METHOD_STORED = 0;
+
+    uint16_t le16 (const uint8_t* p)
+    {
+        return p[0] | (p[1] << 8);
+    }
+
+    uint32_t le32 (const uint8_t* p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    std::string toLower (std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), [] (unsigned char c) { return std::tolower(c); });
+        return s;
+    }
+
+
+    std::mutex cacheMutex;
+
+    // (size, content hash) -> archive
+    std::map<std::pair<size_t, uint64_t>, std::weak_ptr<const FirmwarePackage::Archive>> cache;
+
+    // keeps the last package alive between independent calls,
+    // e.g. a model lookup followed by the actual update
+    std::shared_ptr<const FirmwarePackage::Archive> lastArchive;
+}
+
+
+FirmwarePackage::Archive::Archive (const std::string& packageFileName)
+    : packageFileName_(packageFileName), map_(nullptr), mapSize_(0), zip_(nullptr)
+{}
+
+
+FirmwarePackage::Archive::~Archive ()
+{
+    if (zip_)
+    {
+        zip_discard(zip_);
+    }
+    if (map_)
+    {
+        munmap((void*)map_, mapSize_);
+    }
+}
+
+
+bool FirmwarePackage::Archive::map ()
+{
+    int fd = ::open(packageFileName_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)END_OF_CENTRAL_DIR_SIZE)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (m == MAP_FAILED)
+    {
+        return false;
+    }
+
+    map_ = (const uint8_t*)m;
+    mapSize_ = st.st_size;
+
+    return true;
+}
+
+
+uint64_t FirmwarePackage::Archive::hash () const
+{
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < mapSize_; ++i)
+    {
+        h = (h ^ map_[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+
+bool FirmwarePackage::Archive::readIndex ()
+{
+    // the end of central directory record is followed by a comment of up to 64k
+    size_t minPos = mapSize_ > END_OF_CENTRAL_DIR_SIZE + 0xFFFF ? mapSize_ - END_OF_CENTRAL_DIR_SIZE - 0xFFFF : 0;
+    size_t pos = mapSize_ - END_OF_CENTRAL_DIR_SIZE;
+
+    while (le32(map_ + pos) != END_OF_CENTRAL_DIR_SIGNATURE)
+    {
+        if (pos == minPos)
+        {
+            return false;
+        }
+        pos--;
+    }
+
+    const uint8_t* eocd = map_ + pos;
+    uint16_t count = le16(eocd + 10);
+    uint32_t dirSize = le32(eocd + 12);
+    uint32_t dirOffset = le32(eocd + 16);
+
+    // zip64 archives are not used for firmware packages
+    if ((uint64_t)dirOffset + dirSize > pos)
+    {
+        return false;
+    }
+
+    const uint8_t* p = map_ + dirOffset;
+    const uint8_t* end = p + dirSize;
+
+    for (uint16_t i = 0; i < count; ++i)
+    {
+        if (p + CENTRAL_HEADER_SIZE > end || le32(p) != CENTRAL_HEADER_SIGNATURE)
+        {
+            return false;
+        }
+
+        Entry entry = {};
+        entry.index = i;
+        entry.method = le16(p + 10);
+        entry.compressedSize = le32(p + 20);
+        entry.size = le32(p + 24);
+
+        uint16_t nameLength = le16(p + 28);
+        uint16_t extraLength = le16(p + 30);
+        uint16_t commentLength = le16(p + 32);
+        uint32_t localOffset = le32(p + 42);
+
+        if (p + CENTRAL_HEADER_SIZE + nameLength > end
+            || (uint64_t)localOffset + LOCAL_HEADER_SIZE > mapSize_)
         {
-            return;
+            return false;
         }
 
-        struct zip_stat st;
-        zip_stat_init(&st);
-        zip_stat(z, fileName.c_str(), 0, &st);
+        std::string name((const char*)p + CENTRAL_HEADER_SIZE, nameLength);
 
-        //Alloc memory for its uncompressed contents
-        char contents [st.size];
+        const uint8_t* local = map_ + localOffset;
+        if (le32(local) != LOCAL_HEADER_SIGNATURE)
+        {
+            return false;
+        }
+
+        // the local header may carry a different extra field than the central one
+        entry.dataOffset = localOffset + LOCAL_HEADER_SIZE + le16(local + 26) + le16(local + 28);
+
+        if ((uint64_t)entry.dataOffset + entry.compressedSize > mapSize_)
+        {
+            return false;
+        }
+
+        // stored entries are handed out directly from the mapping with their size
+        if (entry.method == METHOD_STORED && entry.size != entry.compressedSize)
+        {
+            return false;
+        }
+
+        entries_.insert({toLower(name), entry});
+
+        p += CENTRAL_HEADER_SIZE + nameLength + extraLength + commentLength;
+    }
+
+    return true;
+}
+
+
+bool FirmwarePackage::Archive::find (const std::string& name, FileView& view) const
+{
+    auto it = entries_.find(toLower(name));
+    if (it == entries_.end())
+    {
+        return false;
+    }
+
+    const Entry& entry = it->second;
+
+    if (entry.method == METHOD_STORED)
+    {
+        view.data = map_ + entry.dataOffset;
+        view.size = entry.size;
+        return true;
+    }
+
+    return inflate(entry, view);
+}
+
+
+bool FirmwarePackage::Archive::inflate (const Entry& entry, FileView& view) const
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+
+    auto cached = inflated_.find(entry.index);
+    if (cached == inflated_.end())
+    {
+        if (!zip_)
+        {
+            // libzip reads from the existing mapping instead of the file
+            zip_error_t error;
+            zip_error_init(&error);
+
+            zip_source_t* source = zip_source_buffer_create(map_, mapSize_, 0, &error);
+            if (source)
+            {
+                zip_ = zip_open_from_source(source, 0, &error);
+                if (!zip_)
+                {
+                    zip_source_free(source);
+                }
+            }
+            zip_error_fini(&error);
+
+            if (!zip_)
+            {
+                return false;
+            }
+        }
 
-        //Read the compressed file
-        zip_file *f = zip_fopen(z, fileName.c_str(), 0);
+        zip_file* f = zip_fopen_index(zip_, entry.index, 0);
         if (f == nullptr)
         {
-            return;
+            return false;
+        }
+
+        std::vector<uint8_t> data(entry.size);
+        auto ret = zip_fread(f, data.data(), data.size());
+        zip_fclose(f);
+
+        if (ret != (decltype(ret))data.size())
+        {
+            return false;
         }
-        int ret = zip_fread(f, contents, st.size);
 
-        if (ret != st.size)
+        cached = inflated_.insert({entry.index, std::move(data)}).first;
+    }
+
+    view.data = cached->second.data();
+    view.size = cached->second.size();
+
+    return true;
+}
+
+
+std::shared_ptr<const FirmwarePackage::Archive> FirmwarePackage::open (const std::string& packageFileName)
+{
+    std::shared_ptr<Archive> archive(new Archive(packageFileName));
+
+    if (!archive->map())
+    {
+        return nullptr;
+    }
+
+    auto key = std::make_pair(archive->mapSize_, archive->hash());
+
+    std::lock_guard<std::mutex> lck(cacheMutex);
+
+    for (auto it = cache.begin(); it != cache.end();)
+    {
+        if (it->second.expired())
         {
-            return;
+            it = cache.erase(it);
         }
+        else
+        {
+            ++it;
+        }
+    }
+
+    auto it = cache.find(key);
+    if (it != cache.end())
+    {
+        // the new mapping is released; its content is identical
+        lastArchive = it->second.lock();
+        return lastArchive;
+    }
 
-        std::copy(contents, contents + st.size, std::back_inserter(dest));
+    if (!archive->readIndex())
+    {
+        return nullptr;
+    }
 
-        zip_close(z);
-	}
+    cache[key] = archive;
+    lastArchive = archive;
+
+    return archive;
 }
 
 
 std::vector<uint8_t> FirmwareUpdate::FirmwarePackage::extractFile (const std::string& packageFileName,
                                                                    const std::string& fileName)
 {
-	std::vector<uint8_t> data;
-	internalExtractFile(packageFileName, fileName, data);
+    FileView view;
+    auto archive = open(packageFileName);
+
+    if (!archive || !archive->find(fileName, view))
+    {
+        return std::vector<uint8_t>();
+    }
 
-	return data;
+    return view.copy();
 }
 
 
 std::string FirmwareUpdate::FirmwarePackage::extractTextFile (const std::string& packageFileName,
                                                               const std::string& fileName)
 {
-	std::string data;
-	internalExtractFile(packageFileName, fileName, data);
-	data.push_back('\0');
+    FileView view;
+    auto archive = open(packageFileName);
+
+    std::string data;
+    if (archive && archive->find(fileName, view))
+    {
+        data = view.str();
+    }
+    data.push_back('\0');
 
-	return data;
+    return data;
 }
@@ -14,9 +14,17 @@
  * limitations under the License.
  */
 
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 
+struct zip;
+
 namespace FirmwareUpdate
 {
 
@@ -25,6 +33,80 @@ namespace FirmwarePackage
 
 bool isPackageFile (const std::string& fileName);
 
+
+/// Read only content of a file inside a package.
+/// Valid as long as the Archive it was taken from exists.
+struct FileView
+{
+    const uint8_t* data;
+    size_t size;
+
+    bool empty () const { return size == 0; }
+
+    std::vector<uint8_t> copy () const { return std::vector<uint8_t>(data, data + size); }
+    std::string str () const { return std::string((const char*)data, size); }
+};
+
+
+/// Memory mapped package with an index of all contained files.
+/// Uncompressed entries are served directly from the mapping,
+/// compressed entries are decompressed once and kept.
+class Archive
+{
+public:
+    ~Archive ();
+
+    Archive (const Archive&) = delete;
+    Archive& operator= (const Archive&) = delete;
+
+    const std::string& fileName () const { return packageFileName_; }
+
+    /// @param name - file inside the package; compared case insensitive
+    /// @param view - receives the uncompressed content
+    /// @return false if the file does not exist or can not be decompressed
+    bool find (const std::string& name, FileView& view) const;
+
+private:
+    friend std::shared_ptr<const Archive> open (const std::string& packageFileName);
+
+    struct Entry
+    {
+        uint64_t index;
+        uint16_t method;
+        uint32_t dataOffset;
+        uint32_t compressedSize;
+        uint32_t size;
+    };
+
+    Archive (const std::string& packageFileName);
+
+    bool map ();
+    bool readIndex ();
+    uint64_t hash () const;
+
+    bool inflate (const Entry& entry, FileView& view) const;
+
+    std::string packageFileName_;
+
+    const uint8_t* map_;
+    size_t mapSize_;
+
+    // lower case name -> entry
+    std::map<std::string, Entry> entries_;
+
+    // guards everything below; find is called by several update threads
+    mutable std::mutex mtx_;
+    mutable zip* zip_;
+    mutable std::map<uint64_t, std::vector<uint8_t>> inflated_;
+}; /* class Archive */
+
+
+/// @return the package or nullptr if it can not be read
+/// Packages with identical content share one Archive
+/// so that repeated lookups neither map nor decompress again.
+std::shared_ptr<const Archive> open (const std::string& packageFileName);
+
+
 std::vector<uint8_t> extractFile (const std::string& packageFileName,
                                   const std::string& fileName);
 
@@ -22,11 +22,12 @@
 #include <unistd.h>
 #include <regex.h>
 
-#include <zip.h>
 #include <tinyxml.h>
 
 #include "FirmwareUpgrade.h"
+#include "FirmwarePackage.h"
 #include "GigE3Update.h"
+#include "GigE3Package.h"
 
 
 namespace
@@ -134,36 +135,6 @@ bool isPackageFile (const std::string& fileName)
 }
 
 
-std::vector<byte> extractFileFromPackage (const std::string& packageFileName, const std::string& fileName)
-{
-    std::vector<unsigned char> result;
-
-    //Open the ZIP archive
-    int err = 0;
-    zip *z = zip_open(packageFileName.c_str(), 0, &err);
-
-    //Search for the file of given name
-    struct zip_stat st;
-    zip_stat_init(&st);
-    zip_stat(z, fileName.c_str(), 0, &st);
-
-    //Alloc memory for its uncompressed contents
-    char contents [st.size];
-
-    //Read the compressed file
-    zip_file *f = zip_fopen(z, fileName.c_str(), 0);
-    zip_fread(f, contents, st.size);
-
-    std::copy ( contents, contents + st.size, std::back_inserter(result));
-    // zip_fclose(f);
-
-    //And close the archive
-    zip_close(z);
-
-    return result;
-}
-
-
 bool rebootCamera (FirmwareUpdate::IFirmwareWriter& dev)
 {
     return dev.write( 0xEF000004, 0xB007B007 );
@@ -214,18 +185,17 @@ Status upgradeBlackfinFirmware (IFirmwareWriter& dev, const std::string& fileNam
 }
 
 
-Status findFirmwareInPackage (const std::string& fileName, const std::string& modelName, std::string& firmwareName, std::string& FPGAConfigurationName, unsigned int& requiredFPGAVersion)
+Status findFirmwareInPackage (const FirmwarePackage::Archive& package, const std::string& modelName, std::string& firmwareName, std::string& FPGAConfigurationName, unsigned int& requiredFPGAVersion)
 {
-    // assure we find the index.xml even if it is differently capitalized
-    std::vector<unsigned char> xmlData = extractFileFromPackage( fileName, "index.xml" );
-    if (xmlData.empty())
+    // names are compared case insensitive; index.xml is sometimes capitalized
+    FirmwarePackage::FileView index;
+    if (!package.find("index.xml", index))
     {
-        xmlData = extractFileFromPackage( fileName, "Index.xml" );
+        return Status::InvalidFile;
     }
-    xmlData.push_back( 0 );
 
     TiXmlDocument xdoc;
-    xdoc.Parse( (char*)&xmlData[0] );
+    xdoc.Parse( index.str().c_str() );
     if( xdoc.Error() )
     {
         return Status::InvalidFile;
@@ -258,39 +228,76 @@ Status findFirmwareInPackage (const std::string& fileName, const std::string& mo
 }
 
 
-Status uploadAndVerify (IFirmwareWriter& dev, unsigned int address, unsigned char* block, unsigned int blockSize)
+Status uploadAndVerify (IFirmwareWriter& dev,
+                        uint32_t address,
+                        const uint8_t* data,
+                        size_t size,
+                        size_t transferSize,
+                        size_t verifySize,
+                        unsigned int maxRewrites,
+                        std::function<void(int)> progressFunc)
 {
-    int retry = 5;
-    bool success = true;
-    do
+    transferSize = std::min(transferSize, dev.maxTransferSize());
+    verifySize = std::max(verifySize, transferSize);
+
+    std::vector<byte> verificationBuf;
+
+    for (size_t segment = 0; segment < size; segment += verifySize)
     {
-        success = dev.write( address, block, blockSize, 3000 );
-        if( success )
+        size_t segmentSize = std::min(verifySize, size - segment);
+        uint32_t segmentAddress = address + segment;
+
+        std::vector<MemoryBlock> blocks;
+        for (size_t offset = 0; offset < segmentSize; offset += transferSize)
         {
-            std::vector<byte> verificationBuf( blockSize );
-            unsigned int bytesRead;
+            blocks.push_back({ (uint32_t)(segmentAddress + offset),
+                               (void*)(data + segment + offset),
+                               std::min(transferSize, segmentSize - offset) });
+        }
 
-            success = dev.read( address, blockSize, &verificationBuf[0], bytesRead, 3000 );
-            if( success )
+        verificationBuf.resize(segmentSize);
+
+        unsigned int rewrites = 0;
+        while (!blocks.empty())
+        {
+            if (!dev.writeBlocks(blocks, 3000))
             {
-                if( memcmp( block, &verificationBuf[0], blockSize ) != 0 )
+                return Status::WriteVerificationError;
+            }
+
+            // read back everything that was just written with one batch
+            std::vector<MemoryBlock> readBlocks = blocks;
+            for (auto& b : readBlocks)
+            {
+                b.data = &verificationBuf[b.address - segmentAddress];
+            }
+
+            if (!dev.readBlocks(readBlocks, 3000))
+            {
+                return Status::WriteVerificationError;
+            }
+
+            std::vector<MemoryBlock> mismatches;
+            for (const auto& b : blocks)
+            {
+                if (memcmp(b.data, &verificationBuf[b.address - segmentAddress], b.size) != 0)
                 {
-                    if( retry-- > 0 )
-                    {
-                        continue;
-                    }
-                    else
-                    {
-                        // failed
-                        success = false;
-                    }
+                    mismatches.push_back(b);
                 }
             }
+
+            if (!mismatches.empty() && rewrites++ >= maxRewrites)
+            {
+                return Status::WriteVerificationError;
+            }
+
+            blocks.swap(mismatches);
         }
+
+        progressFunc((int)((segment + segmentSize) * 100 / size));
     }
-    while( false );
 
-    return success ? Status::Success : Status::WriteVerificationError;
+    return Status::Success;
 }
 
 
@@ -304,15 +311,9 @@ Status uploadGigEFPGAFirmware (IFirmwareWriter& dev, std::vector<unsigned char>&
     }
 
     unsigned int base = 0xEE000000;
-    Status status = Status::Success;
-    for( unsigned int offset = 0; offset < data.size() && succeeded(status); offset += 128 )
-    {
-        unsigned int blockSize = std::min( 128u, (unsigned int)data.size() - offset );
-
-        status = uploadAndVerify( dev, base + offset, &data[0] + offset, blockSize );
 
-        progressFunc( (offset * 100) / data.size() );
-    }
+    // keep the request size these devices were always written with
+    Status status = uploadAndVerify(dev, base, &data[0], data.size(), 128, 0x1000, 5, progressFunc);
 
     dev.write( 0xEF000000, 0x0 ); // lock
 
@@ -350,15 +351,9 @@ Status uploadFPGAConfiguration (IFirmwareWriter& dev, std::vector<byte>& data, s
 
     progressFunc( 0 );
 
-    Status status = Status::Success;
-    for (unsigned int offset = 0; offset < data.size() && succeeded(status); offset += 256)
-    {
-        unsigned int blockSize = std::min(256u, (unsigned int)data.size() - offset);
-
-        status = uploadAndVerify(dev, base + offset, &data[0] + offset, blockSize);
-
-        progressFunc((offset * 100) / data.size());
-    }
+    // keep the request size these devices were always written with;
+    // the flash was erased above, so a block that reads back wrong cannot be rewritten
+    Status status = uploadAndVerify(dev, base, &data[0], data.size(), 256, 0x10000, 0, progressFunc);
 
     dev.write(0xC1000000, 0x0); // lock
 
@@ -373,10 +368,16 @@ Status uploadFPGAConfiguration (IFirmwareWriter& dev, std::vector<byte>& data, s
 
 Status upgradeFPGAFirmwareFromPackage (IFirmwareWriter& dev, const std::string& fileName, const std::string& modelName, std::function<void(int)> progressFunc)
 {
+    auto package = FirmwarePackage::open(fileName);
+    if (!package)
+    {
+        return Status::InvalidFile;
+    }
+
     std::string firmwareName;
     std::string fpgaConfigurationName;
     unsigned int requiredFPGAVersion;
-    Status status = findFirmwareInPackage(fileName, modelName, firmwareName, fpgaConfigurationName, requiredFPGAVersion);
+    Status status = findFirmwareInPackage(*package, modelName, firmwareName, fpgaConfigurationName, requiredFPGAVersion);
     if (failed(status))
     {
         return status;
@@ -391,19 +392,25 @@ Status upgradeFPGAFirmwareFromPackage (IFirmwareWriter& dev, const std::string&
     // Just for debugging
     //fpgaUpgradeRequired = true;
 
-    std::vector<byte> fpgaData = extractFileFromPackage(fileName, fpgaConfigurationName);
-    std::vector<byte> fwData = extractFileFromPackage(fileName, firmwareName);
-    if (fpgaUpgradeRequired && fpgaData.size() == 0)
+    FirmwarePackage::FileView fpgaFile = {};
+    FirmwarePackage::FileView fwFile = {};
+    package->find(fpgaConfigurationName, fpgaFile);
+    package->find(firmwareName, fwFile);
+
+    if (fpgaUpgradeRequired && fpgaFile.empty())
     {
         return Status::InvalidFile;
     }
-    if (fwData.size() != 0xB000)
+    if (fwFile.size != 0xB000)
     {
         return Status::InvalidFile;
     }
 
+    std::vector<byte> fwData = fwFile.copy();
+
     if (fpgaUpgradeRequired)
     {
+        std::vector<byte> fpgaData = fpgaFile.copy();
         status = uploadFPGAConfiguration( dev, fpgaData, progressFunc );
         if (failed(status))
         {
@@ -472,11 +479,12 @@ Status upgradeFPGAFirmware (IFirmwareWriter& dev, const std::string& fileName, c
 }
 
 
-Status upgradeFirmware (IFirmwareWriter& dev,
-                        const Packet::ACK_DISCOVERY& disc,
-                        const std::string& fileName,
-                        const std::string& overrideModelName,
-                        std::function<void(int)> progressFunc)
+static Status upgradeFirmware (IFirmwareWriter& dev,
+                               const Packet::ACK_DISCOVERY& disc,
+                               const std::string& fileName,
+                               GigE3::Package* package,
+                               const std::string& overrideModelName,
+                               std::function<void(int)> progressFunc)
 {
     int typeId;
     std::string cameraModelName;
@@ -505,11 +513,39 @@ Status upgradeFirmware (IFirmwareWriter& dev,
                 {
                     progressFunc(i);
                 };
-            rval = GigE3::upgradeFirmware(dev, fileName, modelName, cameraModelName, func);
+            if (package != nullptr)
+            {
+                rval = GigE3::upgradeFirmware(dev, *package, modelName, cameraModelName, func);
+            }
+            else
+            {
+                rval = GigE3::upgradeFirmware(dev, fileName, modelName, cameraModelName, func);
+            }
             break;
     }
 
     return rval;
 }
 
+
+Status upgradeFirmware (IFirmwareWriter& dev,
+                        const Packet::ACK_DISCOVERY& disc,
+                        const std::string& fileName,
+                        const std::string& overrideModelName,
+                        std::function<void(int)> progressFunc)
+{
+    return upgradeFirmware(dev, disc, fileName, nullptr, overrideModelName, progressFunc);
+}
+
+
+Status upgradeFirmware (IFirmwareWriter& dev,
+                        const Packet::ACK_DISCOVERY& disc,
+                        const std::string& fileName,
+                        GigE3::Package& package,
+                        const std::string& overrideModelName,
+                        std::function<void(int)> progressFunc)
+{
+    return upgradeFirmware(dev, disc, fileName, &package, overrideModelName, progressFunc);
+}
+
 } /* namespace FirmwareUpdate */
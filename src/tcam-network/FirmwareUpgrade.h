@@ -19,6 +19,7 @@
 #include <functional>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "gigevision.h"
 
@@ -30,6 +31,16 @@ typedef std::function<void(int, const std::string&)> tReportProgressFunc;
 namespace FirmwareUpdate
 {
 
+/// @struct MemoryBlock
+/// @brief single block of a batched memory transfer
+struct MemoryBlock
+{
+    uint32_t address;
+    void* data;         // source for writes, target for reads
+    size_t size;        // multiple of 4; at most IFirmwareWriter::maxTransferSize
+};
+
+
 /// @class IFirmwareWriter
 /// @brief base class for actual firmware writer
 class IFirmwareWriter
@@ -72,6 +83,49 @@ public:
     /// @brief pure virtual function to connect firmware functions with reading methods of device
     virtual bool read (uint32_t addr, unsigned int data_size, void* pData, unsigned int& read_count, unsigned int timeout_in_ms = 2000) = 0;
 
+    /// @name maxTransferSize
+    /// @return largest block size accepted by writeBlocks and readBlocks
+    virtual size_t maxTransferSize ()
+    {
+        return 512;
+    }
+
+    /// @name writeBlocks
+    /// @param blocks - blocks that shall be written
+    /// @param timeout_in_ms - maximum waiting time per block
+    /// @return true if all blocks were written
+    /// @brief writes one block after another; writers that can keep several requests in flight override this
+    virtual bool writeBlocks (const std::vector<MemoryBlock>& blocks, unsigned int timeout_in_ms = 2000)
+    {
+        for (const auto& b : blocks)
+        {
+            if (!write(b.address, b.data, b.size, timeout_in_ms))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @name readBlocks
+    /// @param blocks - blocks that shall be read
+    /// @param timeout_in_ms - maximum waiting time per block
+    /// @return true if all blocks were read completely
+    /// @brief reads one block after another; writers that can keep several requests in flight override this
+    virtual bool readBlocks (const std::vector<MemoryBlock>& blocks, unsigned int timeout_in_ms = 2000)
+    {
+        for (const auto& b : blocks)
+        {
+            unsigned int read_count = 0;
+            if (!read(b.address, (unsigned int)b.size, b.data, read_count, timeout_in_ms)
+                || read_count != b.size)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
 }; /* class IFirmwareWriter */
 
 
@@ -98,6 +152,32 @@ enum class Status
 inline bool succeeded (Status status) { return (int)status >= 0; }
 inline bool failed (Status status) { return !succeeded(status); }
 
+/// @name uploadAndVerify
+/// @param dev - device that shall be written
+/// @param address - target address of data
+/// @param data - data that shall be written
+/// @param size - size of data; multiple of 4
+/// @param transferSize - maximum size of a single write request
+/// @param verifySize - amount of data that is written before it is read back and compared
+/// @param maxRewrites - how often blocks whose read back differs are written again;
+///                      0 for flash, where a rewrite without erase cannot fix a block
+/// @param progressFunc - callback function for current progress; int the current percentage
+/// @return Status::Success or Status::WriteVerificationError
+/// @brief Writes data in batches and retransmits only the blocks whose read back differs
+Status uploadAndVerify (IFirmwareWriter& dev,
+                        uint32_t address,
+                        const uint8_t* data,
+                        size_t size,
+                        size_t transferSize,
+                        size_t verifySize,
+                        unsigned int maxRewrites,
+                        std::function<void(int)> progressFunc);
+
+namespace GigE3
+{
+class Package;
+}
+
 /// @name upgradeFirmware
 /// @param dev -
 /// @param disc - discovery acknowledge packet describing the camera
@@ -110,4 +190,19 @@ Status upgradeFirmware (IFirmwareWriter& dev,
                         const std::string& overrideModelName,
                         std::function<void(int)> progressFunc);
 
+/// @name upgradeFirmware
+/// @param dev - device that shall be updated
+/// @param disc - discovery acknowledge packet describing the camera
+/// @param fileName - firmware file package was loaded from; used for devices that are not GigE3
+/// @param package - GigE3 package already loaded from fileName
+/// @param progressFunc - callback function for current progress; int the current percentage
+/// @return Status describing the success of the upgrade
+/// @brief allows updating many devices while the package is only parsed once
+Status upgradeFirmware (IFirmwareWriter& dev,
+                        const Packet::ACK_DISCOVERY& disc,
+                        const std::string& fileName,
+                        GigE3::Package& package,
+                        const std::string& overrideModelName,
+                        std::function<void(int)> progressFunc);
+
 } /* namespace FirmwareUpdate */
@@ -118,28 +118,20 @@ FirmwareUpdate::Status GigE3::DevicePortFlashMemory::UploadItems (IFirmwareWrite
         auto data = PadData(i.Data, 4);
         auto offset = i.Params.at("Offset");
 
-        auto writeProgress = mapProgress(uploadItemsProgress, 0, 50);
-
-        auto status = WriteDeviceMemory(dev, baseAddress_ + offset, data, writeProgress);
+        auto itemProgress = [&uploadItemsProgress] (int pct)
+            {
+                uploadItemsProgress(pct, std::string());
+            };
+
+        // verified per flash block; the blocks were erased above and flash bits can
+        // only be cleared by another erase, so a mismatch is reported, not rewritten
+        auto status = uploadAndVerify(dev, baseAddress_ + offset, data.data(), data.size(),
+                                      dev.maxTransferSize(), blockSize_, 0, itemProgress);
         if (failed(status))
         {
             return status;
         }
 
-        auto readProgress = mapProgress(uploadItemsProgress, 50, 100);
-
-        std::vector<uint8_t> verifyBuffer(data.size());
-        status = ReadDeviceMemory(dev, baseAddress_ + offset, verifyBuffer, readProgress);
-        if (failed(status))
-        {
-            return status;
-        }
-
-        if (data != verifyBuffer)
-        {
-            return Status::WriteVerificationError;
-        }
-
         uploadItemsProgress.NextItem();
     }
 
@@ -171,74 +163,3 @@ void GigE3::DevicePortFlashMemory::AddEraseRequests (const GigE3::UploadItem& it
         }
     }
 }
-
-
-FirmwareUpdate::Status GigE3::DevicePortFlashMemory::WriteDeviceMemory (IFirmwareWriter& dev,
-                                                                        uint32_t address,
-                                                                        const std::vector<uint8_t>& data,
-                                                                        tReportProgressFunc progressFunc)
-{
-    //const size_t StepSize = 1024 * 16;
-    const size_t StepSize = 512;
-    size_t totalBytes = data.size();
-    size_t bytesRemaining = totalBytes;
-    size_t bytesWritten = 0;
-
-    while (bytesRemaining > 0)
-    {
-        size_t stepBytes = std::min( bytesRemaining, StepSize );
-
-        if (!dev.write((uint32_t)(address + bytesWritten),
-                       (uint32_t*)(data.data() + bytesWritten),
-                       (size_t) stepBytes, 0))
-        {
-            return Status::WriteError;
-        }
-
-        bytesWritten += stepBytes;
-        bytesRemaining -= stepBytes;
-
-        progressFunc((int)(bytesWritten * 100 / totalBytes), std::string());
-    }
-
-    return Status::Success;
-}
-
-
-FirmwareUpdate::Status GigE3::DevicePortFlashMemory::ReadDeviceMemory (IFirmwareWriter& dev,
-                                                                       uint32_t address,
-                                                                       std::vector<uint8_t>& buffer,
-                                                                       tReportProgressFunc progressFunc)
-{
-    //const size_t StepSize = 1024 * 16;
-    const size_t StepSize = 512;
-    size_t totalBytes = buffer.size();
-    size_t bytesRemaining = totalBytes;
-    size_t bytesRead = 0;
-
-    while (bytesRemaining > 0)
-    {
-        size_t stepBytes = std::min( bytesRemaining, StepSize );
-
-        unsigned int stepBytesRead = 0;
-        if (!dev.read((uint32_t)(address + bytesRead),
-                      (uint32_t)stepBytes,
-                      buffer.data() + bytesRead,
-                      stepBytesRead))
-        {
-            return Status::WriteError;
-        }
-
-        if (stepBytesRead != stepBytes)
-        {
-            return Status::WriteError;
-        }
-
-        bytesRead += stepBytes;
-        bytesRemaining -= stepBytes;
-
-        progressFunc((int)(bytesRead * 100 / totalBytes), std::string());
-    }
-
-    return Status::Success;
-}
@@ -50,16 +50,6 @@ public:
 private:
     void AddEraseRequests (const UploadItem& item, std::set<uint32_t>& requests);
 
-    Status WriteDeviceMemory (IFirmwareWriter& dev,
-                              uint32_t address,
-                              const std::vector<uint8_t>& data,
-                              tReportProgressFunc progressFunc);
-
-    Status ReadDeviceMemory (IFirmwareWriter& dev,
-                             uint32_t address,
-                             std::vector<uint8_t>& buffer,
-                             tReportProgressFunc progressFunc);
-
 }; /* class DevicePortFlashMemory */
 
 } /* namespace GigE3 */
@@ -34,10 +34,17 @@ std::vector<std::string> GigE3::Package::FindModelNames (const std::string& pack
 {
     std::vector<std::string> result;
 
-    auto xmlManifestData = FirmwarePackage::extractTextFile(packageFileName, "Manifest.xml");
+    // the archive is cached; a following Load does not read it again
+    auto archive = FirmwarePackage::open(packageFileName);
+    FirmwarePackage::FileView manifest;
+
+    if (!archive || !archive->find("manifest.xml", manifest))
+    {
+        return result;
+    }
 
     TiXmlDocument xdoc;
-    xdoc.Parse(xmlManifestData.c_str());
+    xdoc.Parse(manifest.str().c_str());
     if (xdoc.Error())
     {
         return result;
@@ -86,10 +93,16 @@ FirmwareUpdate::Status GigE3::Package::Load (const std::string& packageFileName)
 {
     packageFileName_ = packageFileName;
 
-    auto xmlManifestData = FirmwarePackage::extractTextFile(packageFileName_, "manifest.xml");
+    archive_ = FirmwarePackage::open(packageFileName_);
+    FirmwarePackage::FileView manifest;
+
+    if (!archive_ || !archive_->find("manifest.xml", manifest))
+    {
+        return Status::InvalidFile;
+    }
 
     TiXmlDocument xdoc;
-    xdoc.Parse(xmlManifestData.c_str());
+    xdoc.Parse(manifest.str().c_str());
 
     if (xdoc.Error())
     {
@@ -291,10 +304,11 @@ FirmwareUpdate::Status GigE3::Package::ReadUploadItem (const TiXmlElement& uploa
             {
                 return Status::InvalidFile; // No two "data" elements allowed
             }
-            item.Data = FirmwarePackage::extractFile(packageFileName_, attr->Value());
-            if (item.Data.empty())
+            // a missing file leaves the item empty, as extracting it always did
+            FirmwarePackage::FileView file;
+            if (archive_->find(attr->Value(), file))
             {
-                int a = 0;
+                item.Data = file.copy();
             }
         }
         else if (attr->Name() == std::string("String"))
@@ -20,6 +20,7 @@
 #include "GigE3UploadGroup.h"
 
 #include "FirmwareUpgrade.h"
+#include "FirmwarePackage.h"
 
 #include <memory>
 #include <vector>
@@ -48,6 +49,7 @@ public:
 
 private:
     std::string packageFileName_;
+    std::shared_ptr<const FirmwarePackage::Archive> archive_;
 
     int firmwareVersion_;
     int manifestVersion_;
@@ -62,6 +62,16 @@ Status GigE3::upgradeFirmware (IFirmwareWriter& dev,
         return status;
     }
 
+    return upgradeFirmware(dev, package, modelName, originalModelName, progressFunc);
+}
+
+
+Status GigE3::upgradeFirmware (IFirmwareWriter& dev,
+                               Package& package,
+                               const std::string& modelName,
+                               const std::string& originalModelName,
+                               tReportProgressFunc progressFunc)
+{
     auto modelUploadGroups = package.find_upload_groups(modelName);
     if (!modelUploadGroups)
     {
@@ -87,7 +97,7 @@ Status GigE3::upgradeFirmware (IFirmwareWriter& dev,
     {
         groupItemProgress( 0, "Updating " + group.Name );
 
-        status = group.DestionationPort->UploadItems(dev, group.Items, groupItemProgress);
+        auto status = group.DestionationPort->UploadItems(dev, group.Items, groupItemProgress);
         if (failed(status))
             return status;
 
@@ -32,6 +32,15 @@ Status upgradeFirmware (IFirmwareWriter& dev,
                         const std::string& originalModelName,
                         tReportProgressFunc progressFunc);
 
+class Package;
+
+/// upload a package that was already loaded; the package is only read
+Status upgradeFirmware (IFirmwareWriter& dev,
+                        Package& package,
+                        const std::string& modelName,
+                        const std::string& originalModelName,
+                        tReportProgressFunc progressFunc);
+
 std::vector<std::string> getModelNamesFromPackage (const std::string& fileName);
 
 } /* namespace GigE3 */
@@ -0,0 +1,676 @@
+/*
+ * Copyright 2013 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "IPProvisioning.h"
+
+#include "Camera.h"
+#include "CameraDiscovery.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+namespace tis
+{
+
+namespace
+{
+
+/// splits a line at whitespace; double quotes group words and are removed
+std::vector<std::string> splitLine (const std::string& line)
+{
+    std::vector<std::string> tokens;
+    std::string current;
+    bool quoted = false;
+    bool inToken = false;
+
+    for (char c : line)
+    {
+        if (c == '"')
+        {
+            quoted = !quoted;
+            inToken = true;
+        }
+        else if (!quoted && c == '#')
+        {
+            break;
+        }
+        else if (!quoted && isspace((unsigned char)c))
+        {
+            if (inToken)
+            {
+                tokens.push_back(current);
+                current.clear();
+                inToken = false;
+            }
+        }
+        else
+        {
+            current += c;
+            inToken = true;
+        }
+    }
+
+    if (quoted)
+    {
+        throw std::invalid_argument("unterminated quote");
+    }
+
+    if (inToken)
+    {
+        tokens.push_back(current);
+    }
+
+    return tokens;
+}
+
+
+bool parseSwitch (const std::string& value)
+{
+    if (value == "on")
+    {
+        return true;
+    }
+    if (value == "off")
+    {
+        return false;
+    }
+    throw std::invalid_argument("expected on or off instead of \"" + value + "\"");
+}
+
+
+std::string parseAddress (const std::string& value)
+{
+    if (!isValidIpAddress(value))
+    {
+        throw std::invalid_argument("\"" + value + "\" is not a valid address");
+    }
+    return value;
+}
+
+
+/// settings a camera shall have once it was written
+struct Expectation
+{
+    IPConfiguration config;
+
+    bool checkName;
+    std::string name;
+};
+
+
+/// @return empty string on success, else a description of the failure
+std::string configureCamera (std::shared_ptr<Camera> discovered,
+                             const ProvisioningEntry& entry,
+                             bool apply,
+                             Expectation& expected)
+{
+    // discovered cameras share the socket of their interface;
+    // concurrent workers need one socket per camera
+    auto cam = std::shared_ptr<Camera>(new Camera(discovered->getDiscoveryPacket(),
+                                                  discovered->getNetworkInterface()));
+
+    if (!cam->isReachable())
+    {
+        if (entry.ip.empty() || entry.subnet.empty())
+        {
+            return "not reachable from " + cam->getInterfaceName()
+                + "; ip and subnet are required to force an address";
+        }
+
+        std::string gateway = entry.gateway.empty() ? "0.0.0.0" : entry.gateway;
+
+        if (!cam->forceIP(entry.ip, entry.subnet, gateway))
+        {
+            return "not reachable from " + cam->getInterfaceName() + " and forcing " + entry.ip + " failed";
+        }
+
+        // the camera now answers on the forced address
+        Packet::ACK_DISCOVERY packet = discovered->getDiscoveryPacket();
+        packet.CurrentIP = ip2int(entry.ip);
+        packet.CurrentSubnetMask = ip2int(entry.subnet);
+        packet.DefaultGateway = ip2int(gateway);
+
+        cam = std::shared_ptr<Camera>(new Camera(packet, discovered->getNetworkInterface()));
+
+        if (!cam->isReachable())
+        {
+            return entry.ip + " is not reachable from " + cam->getInterfaceName();
+        }
+    }
+
+    IPConfiguration config = {};
+    if (!cam->getIPConfiguration(config))
+    {
+        return "unable to read ip configuration";
+    }
+
+    if (!entry.ip.empty())
+    {
+        config.persistentIP = entry.ip;
+    }
+    if (!entry.subnet.empty())
+    {
+        config.persistentSubnet = entry.subnet;
+    }
+    if (!entry.gateway.empty())
+    {
+        config.persistentGateway = entry.gateway;
+    }
+    if (entry.setDHCP)
+    {
+        config.dhcp = entry.dhcp;
+    }
+    if (entry.setStatic)
+    {
+        config.staticIP = entry.staticIP;
+    }
+    else if (!entry.ip.empty())
+    {
+        config.staticIP = true;
+    }
+
+    expected.config = config;
+    expected.checkName = entry.setName;
+    expected.name = entry.name.substr(0, 15);
+
+    if (entry.setName && !cam->setUserDefinedName(entry.name))
+    {
+        return "unable to set name";
+    }
+
+    if (!cam->setIPConfiguration(config))
+    {
+        return "unable to write ip configuration";
+    }
+
+    if (apply)
+    {
+        if (config.staticIP)
+        {
+            // takes effect at once and, unlike a reset, is acknowledged
+            if (!cam->forceIP(config.persistentIP, config.persistentSubnet, config.persistentGateway))
+            {
+                return "unable to activate " + config.persistentIP;
+            }
+        }
+        else
+        {
+            // the camera restarts dhcp/lla; the new address is not known in advance
+            cam->resetIP();
+        }
+    }
+
+    return "";
+}
+
+
+/// @return empty string if the discovery answer matches, else the difference
+std::string compareDiscovery (std::shared_ptr<Camera> cam, const Expectation& expected, bool apply)
+{
+    if (expected.checkName && cam->getUserDefinedName() != expected.name)
+    {
+        return "name is \"" + cam->getUserDefinedName() + "\"";
+    }
+
+    // persistent addresses only become active after a reconfiguration
+    if (apply && expected.config.staticIP)
+    {
+        if (cam->getCurrentIP() != expected.config.persistentIP)
+        {
+            return "current ip is " + cam->getCurrentIP();
+        }
+        if (cam->getCurrentSubnet() != expected.config.persistentSubnet)
+        {
+            return "current subnet is " + cam->getCurrentSubnet();
+        }
+    }
+
+    return "";
+}
+
+
+/// @return empty string if the registers match, else the difference
+std::string compareConfiguration (const IPConfiguration& config, const Expectation& expected)
+{
+    if (config.dhcp != expected.config.dhcp)
+    {
+        return std::string("dhcp is ") + (config.dhcp ? "on" : "off");
+    }
+    if (config.staticIP != expected.config.staticIP)
+    {
+        return std::string("static ip is ") + (config.staticIP ? "on" : "off");
+    }
+    if (config.persistentIP != expected.config.persistentIP)
+    {
+        return "persistent ip is " + config.persistentIP;
+    }
+    if (config.persistentSubnet != expected.config.persistentSubnet)
+    {
+        return "persistent subnet is " + config.persistentSubnet;
+    }
+    if (config.persistentGateway != expected.config.persistentGateway)
+    {
+        return "persistent gateway is " + config.persistentGateway;
+    }
+
+    return "";
+}
+
+} /* namespace */
+
+
+const char* provisionStateToString (ProvisionState state)
+{
+    switch (state)
+    {
+        case PROVISION_PENDING:
+            return "pending";
+        case PROVISION_WRITING:
+            return "writing";
+        case PROVISION_WRITTEN:
+            return "written";
+        case PROVISION_VERIFIED:
+            return "verified";
+        case PROVISION_FAILED:
+            return "failed";
+        case PROVISION_NOT_FOUND:
+            return "not-found";
+    }
+    return "unknown";
+}
+
+
+std::vector<ProvisioningEntry> readProvisioningFile (const std::string& filename)
+{
+    std::ifstream in(filename);
+
+    if (!in)
+    {
+        throw std::invalid_argument("Unable to read mapping file " + filename);
+    }
+
+    std::vector<ProvisioningEntry> entries;
+    std::string line;
+    unsigned int line_number = 0;
+
+    while (std::getline(in, line))
+    {
+        line_number++;
+
+        try
+        {
+            auto tokens = splitLine(line);
+
+            if (tokens.empty())
+            {
+                continue;
+            }
+
+            ProvisioningEntry entry;
+            entry.serial = tokens.at(0);
+            entry.line = line_number;
+
+            for (size_t i = 1; i < tokens.size(); ++i)
+            {
+                const auto& token = tokens.at(i);
+                auto pos = token.find('=');
+
+                if (pos == std::string::npos)
+                {
+                    throw std::invalid_argument("expected key=value instead of \"" + token + "\"");
+                }
+
+                std::string key = token.substr(0, pos);
+                std::string value = token.substr(pos + 1);
+
+                if (key == "ip")
+                {
+                    entry.ip = parseAddress(value);
+                }
+                else if (key == "subnet")
+                {
+                    entry.subnet = parseAddress(value);
+                }
+                else if (key == "gateway")
+                {
+                    entry.gateway = parseAddress(value);
+                }
+                else if (key == "dhcp")
+                {
+                    entry.setDHCP = true;
+                    entry.dhcp = parseSwitch(value);
+                }
+                else if (key == "static")
+                {
+                    entry.setStatic = true;
+                    entry.staticIP = parseSwitch(value);
+                }
+                else if (key == "name")
+                {
+                    if (value.size() > 15)
+                    {
+                        throw std::invalid_argument("name \"" + value + "\" is longer than 15 characters");
+                    }
+                    entry.setName = true;
+                    entry.name = value;
+                }
+                else
+                {
+                    throw std::invalid_argument("unknown key \"" + key + "\"");
+                }
+            }
+
+            entries.push_back(entry);
+        }
+        catch (std::invalid_argument& exc)
+        {
+            throw std::invalid_argument(filename + ":" + std::to_string(line_number) + ": " + exc.what());
+        }
+    }
+
+    return entries;
+}
+
+
+size_t provisionCameras (const ProvisioningOptions& options,
+                         std::function<void(const ProvisioningEvent&)> report)
+{
+    if (options.entries.empty())
+    {
+        throw std::invalid_argument("No cameras selected for provisioning.");
+    }
+
+    // conflicts are reported before any camera is touched
+    std::set<std::string> serials;
+    std::set<std::string> addresses;
+    for (const auto& entry : options.entries)
+    {
+        if (!serials.insert(entry.serial).second)
+        {
+            throw std::invalid_argument("Camera " + entry.serial + " is listed more than once.");
+        }
+        if (!entry.ip.empty() && !addresses.insert(entry.ip).second)
+        {
+            throw std::invalid_argument("Address " + entry.ip + " is assigned more than once.");
+        }
+    }
+
+    std::mutex report_mtx;
+    auto send = [&report, &report_mtx] (const ProvisioningEvent& event)
+    {
+        std::lock_guard<std::mutex> lck(report_mtx);
+        report(event);
+    };
+
+    camera_list cameras;
+
+    // other cameras answer as well; only the listed serials end a discovery early
+    auto all_found = [&options, &cameras] (const std::vector<std::shared_ptr<Camera>>& /* found */)
+    {
+        for (const auto& entry : options.entries)
+        {
+            if (getCameraFromList(cameras, entry.serial, CAMERA_SERIAL) == nullptr)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    DiscoveryOptions discovery;
+    discovery.timeout_ms = 3000;
+    discovery.complete = all_found;
+
+    auto collect = [&cameras] (std::shared_ptr<Camera> c)
+    {
+        if (getCameraFromList(cameras, c->getSerialNumber(), CAMERA_SERIAL) == nullptr)
+        {
+            cameras.push_back(c);
+        }
+    };
+
+    discoverCameras(discovery, collect);
+
+    // single discovery answers get lost on busy networks; ask again for the missing ones
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        if (all_found(cameras))
+        {
+            break;
+        }
+
+        discovery.timeout_ms = 1000;
+        discoverCameras(discovery, collect);
+    }
+
+    size_t failures = 0;
+
+    std::deque<std::pair<std::shared_ptr<Camera>, const ProvisioningEntry*>> queue;
+
+    for (const auto& entry : options.entries)
+    {
+        auto cam = getCameraFromList(cameras, entry.serial, CAMERA_SERIAL);
+
+        if (cam == nullptr)
+        {
+            send({ entry.serial, PROVISION_NOT_FOUND, "camera not found" });
+            failures++;
+            continue;
+        }
+
+        send({ entry.serial, PROVISION_PENDING, "" });
+        queue.push_back({ cam, &entry });
+    }
+
+    std::mutex queue_mtx;
+
+    // serial -> settings of written cameras that still have to be verified
+    std::map<std::string, Expectation> written;
+
+    auto worker = [&] ()
+    {
+        while (true)
+        {
+            std::shared_ptr<Camera> cam;
+            const ProvisioningEntry* entry;
+            {
+                std::lock_guard<std::mutex> lck(queue_mtx);
+
+                if (queue.empty())
+                {
+                    return;
+                }
+                cam = queue.front().first;
+                entry = queue.front().second;
+                queue.pop_front();
+            }
+
+            send({ entry->serial, PROVISION_WRITING, "" });
+
+            Expectation expected;
+            std::string error;
+
+            try
+            {
+                error = configureCamera(cam, *entry, options.apply, expected);
+            }
+            catch (std::exception& exc)
+            {
+                error = exc.what();
+            }
+
+            std::lock_guard<std::mutex> lck(queue_mtx);
+
+            if (error.empty())
+            {
+                written[entry->serial] = expected;
+                send({ entry->serial, PROVISION_WRITTEN, "" });
+            }
+            else
+            {
+                failures++;
+                send({ entry->serial, PROVISION_FAILED, error });
+            }
+        }
+    };
+
+    unsigned int parallel = std::min<size_t>(std::max(options.parallel, 1u), queue.size());
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < parallel; ++i)
+    {
+        workers.push_back(std::thread(worker));
+    }
+
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+
+    // cameras need some time to come back after re-running their ip configuration;
+    // keep discovering until all of them answer with the wanted settings
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.verify_timeout_ms);
+
+    // serial -> last difference found
+    std::map<std::string, std::string> differences;
+
+    while (!written.empty())
+    {
+        auto round_start = std::chrono::steady_clock::now();
+
+        // serials of written cameras that answered in this round
+        std::set<std::string> answered;
+
+        DiscoveryOptions rediscovery;
+        rediscovery.timeout_ms = 1000;
+        rediscovery.complete = [&written, &answered] (const std::vector<std::shared_ptr<Camera>>& /* found */)
+            {
+                for (const auto& w : written)
+                {
+                    if (answered.count(w.first) == 0)
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            };
+
+        camera_list candidates;
+        discoverCameras(rediscovery, [&] (std::shared_ptr<Camera> c)
+                        {
+                            auto iter = written.find(c->getSerialNumber());
+                            if (iter == written.end())
+                            {
+                                return;
+                            }
+                            answered.insert(iter->first);
+
+                            std::string difference = compareDiscovery(c, iter->second, options.apply);
+                            if (difference.empty())
+                            {
+                                candidates.push_back(c);
+                            }
+                            else
+                            {
+                                differences[iter->first] = difference;
+                            }
+                        });
+
+        camera_list reachable;
+        for (const auto& c : candidates)
+        {
+            if (c->isReachable())
+            {
+                reachable.push_back(c);
+            }
+            else if (written.count(c->getSerialNumber()) > 0)
+            {
+                // moved into a network we can not talk to; the discovery has to suffice
+                send({ c->getSerialNumber(), PROVISION_VERIFIED, "verified by discovery only" });
+                written.erase(c->getSerialNumber());
+            }
+        }
+
+        getIPConfigurations(reachable, [&] (std::shared_ptr<Camera> c, bool ok, const IPConfiguration& config)
+                            {
+                                auto serial = c->getSerialNumber();
+
+                                // cameras answering on several interfaces are handled once
+                                auto iter = written.find(serial);
+                                if (iter == written.end())
+                                {
+                                    return;
+                                }
+
+                                if (!ok)
+                                {
+                                    differences[serial] = "ip configuration not readable";
+                                    return;
+                                }
+
+                                std::string difference = compareConfiguration(config, iter->second);
+                                if (difference.empty())
+                                {
+                                    send({ serial, PROVISION_VERIFIED, "current ip " + c->getCurrentIP() });
+                                }
+                                else
+                                {
+                                    // persistent registers do not change by themselves
+                                    failures++;
+                                    send({ serial, PROVISION_FAILED, difference });
+                                }
+                                written.erase(serial);
+                            });
+
+        if (written.empty())
+        {
+            break;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+        {
+            for (const auto& w : written)
+            {
+                auto iter = differences.find(w.first);
+                failures++;
+                send({ w.first, PROVISION_FAILED,
+                       iter != differences.end() ? iter->second : "not found after reconfiguration" });
+            }
+            break;
+        }
+
+        // do not flood the network when all cameras answered early
+        if (now - round_start < std::chrono::milliseconds(500))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+    }
+
+    return failures;
+}
+
+} /* namespace tis */
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2013 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _IPPROVISIONING_H_
+#define _IPPROVISIONING_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace tis
+{
+
+    /// @enum ProvisionState
+    /// @brief provisioning state of a single camera
+    enum ProvisionState
+    {
+        PROVISION_PENDING = 0,  // waiting for a free worker
+        PROVISION_WRITING,
+        PROVISION_WRITTEN,      // settings written; waiting for verification
+        PROVISION_VERIFIED,     // rediscovered with the wanted settings
+        PROVISION_FAILED,
+        PROVISION_NOT_FOUND,    // requested serial did not answer the discovery
+    };
+
+
+    /// @name provisionStateToString
+    /// @return lower case name of state
+    const char* provisionStateToString (ProvisionState state);
+
+
+    /// @struct ProvisioningEntry
+    /// @brief wanted settings of a single camera; empty or unset values are kept
+    struct ProvisioningEntry
+    {
+        std::string serial;
+
+        std::string ip;
+        std::string subnet;
+        std::string gateway;
+
+        bool setDHCP;
+        bool dhcp;
+
+        /// static ip is enabled when ip is given and static is not set explicitly
+        bool setStatic;
+        bool staticIP;
+
+        bool setName;
+        std::string name;
+
+        /// line in the mapping file; used for messages
+        unsigned int line;
+
+        ProvisioningEntry ()
+            : setDHCP(false), dhcp(false), setStatic(false), staticIP(false), setName(false), line(0)
+        {}
+    };
+
+
+    /// @name readProvisioningFile
+    /// @param filename - mapping file; one camera per line
+    /// @return entries in the order of the file
+    /// @brief every line is "<serial> [ip=X.X.X.X] [subnet=X.X.X.X] [gateway=X.X.X.X]
+    ///        [dhcp=on|off] [static=on|off] [name="xyz"]"; '#' starts a comment
+    /// throws std::invalid_argument with the offending line on malformed input
+    std::vector<ProvisioningEntry> readProvisioningFile (const std::string& filename);
+
+
+    /// @struct ProvisioningOptions
+    /// @brief cameras and limits of a provisioning run
+    struct ProvisioningOptions
+    {
+        std::vector<ProvisioningEntry> entries;
+
+        /// number of cameras that are configured at the same time
+        unsigned int parallel;
+
+        /// make the cameras re-run their ip configuration so that the
+        /// settings become active without a power cycle
+        bool apply;
+
+        /// time in ms the cameras have to show up with the new settings
+        unsigned int verify_timeout_ms;
+
+        ProvisioningOptions ()
+            : entries(), parallel(8), apply(true), verify_timeout_ms(30000)
+        {}
+    };
+
+
+    /// @struct ProvisioningEvent
+    /// @brief state change of a single camera
+    struct ProvisioningEvent
+    {
+        std::string serial;
+        ProvisionState state;
+
+        /// result description of finished cameras
+        std::string message;
+    };
+
+
+    /// @name provisionCameras
+    /// @param options - cameras and settings that shall be used
+    /// @param report - called for every event; calls are serialized
+    /// @return number of cameras that were not verified
+    /// @brief writes the settings of all cameras concurrently and verifies them by rediscovery
+    size_t provisionCameras (const ProvisioningOptions& options,
+                             std::function<void(const ProvisioningEvent&)> report);
+
+} /* namespace tis */
+
+#endif /* _IPPROVISIONING_H_ */
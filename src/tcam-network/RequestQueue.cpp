@@ -0,0 +1,391 @@
+/*
+ * Copyright 2013 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RequestQueue.h"
+
+#include "Socket.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+
+namespace tis
+{
+
+static const unsigned int MAX_ATTEMPTS = 5;
+
+// first wait before a command answered with BUSY is sent again; doubled per attempt
+static const auto BUSY_BACKOFF = std::chrono::milliseconds(20);
+
+
+RequestQueue::RequestQueue (unsigned int window, unsigned int timeout_in_ms)
+    : maxWindow(std::max(window, 1u)), timeout(timeout_in_ms), requestID(0), unfinished(0)
+{}
+
+
+size_t RequestQueue::findDevice (std::shared_ptr<Socket> socket, const std::string& ip)
+{
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        if (devices.at(i).socket == socket && devices.at(i).ip == ip)
+        {
+            return i;
+        }
+    }
+
+    device d;
+    d.socket = socket;
+    d.ip = ip;
+    d.address = inet_addr(ip.c_str());
+    d.inFlight = 0;
+    d.window = maxWindow;
+    d.cancelled = false;
+
+    devices.push_back(d);
+
+    return devices.size() - 1;
+}
+
+
+unsigned short RequestQueue::nextRequestID ()
+{
+    // 0 is not a valid GVCP request id
+    if (++requestID == 0)
+    {
+        ++requestID;
+    }
+    return requestID;
+}
+
+
+void RequestQueue::push (std::shared_ptr<Socket> socket,
+                         const std::string& ip,
+                         std::vector<uint8_t> command,
+                         ack_callback callback)
+{
+    request r;
+    r.device = findDevice(socket, ip);
+    r.command = std::move(command);
+    r.callback = callback;
+    r.id = 0;
+    r.attempts = 0;
+
+    requests.push_back(std::move(r));
+    devices.at(requests.back().device).queue.push_back(requests.size() - 1);
+
+    unfinished++;
+}
+
+
+size_t RequestQueue::cancel (size_t device_index)
+{
+    device& d = devices.at(device_index);
+
+    d.cancelled = true;
+
+    // callbacks may push to the queue while it is being cancelled
+    std::deque<size_t> cancelled;
+    cancelled.swap(d.queue);
+
+    for (auto index : cancelled)
+    {
+        unfinished--;
+        requests.at(index).callback(nullptr, 0);
+    }
+
+    return cancelled.size();
+}
+
+
+size_t RequestQueue::run ()
+{
+    size_t failed = 0;
+
+    // (socket, sender, request id) -> request index
+    std::map<std::tuple<int, uint32_t, unsigned short>, size_t> inFlight;
+
+    auto finish = [&] (size_t index, const Packet::ACK_HEADER* ack, size_t size)
+    {
+        request& r = requests.at(index);
+        device& d = devices.at(r.device);
+
+        d.inFlight--;
+        unfinished--;
+
+        if (d.cancelled)
+        {
+            // already reported as failed
+            r.callback(nullptr, 0);
+            failed++;
+            return;
+        }
+
+        if (!r.callback(ack, size) || ack == nullptr)
+        {
+            failed++;
+            failed += cancel(r.device);
+        }
+    };
+
+    while (unfinished > 0)
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < devices.size(); ++i)
+        {
+            device& d = devices.at(i);
+
+            // commands pushed by callbacks after the device was cancelled
+            if (d.cancelled && !d.queue.empty())
+            {
+                failed += cancel(i);
+            }
+
+            while (!d.queue.empty() && d.inFlight < d.window)
+            {
+                size_t index = d.queue.front();
+                request& r = requests.at(index);
+
+                // keep the order; later commands wait behind a busy one
+                if (r.notBefore > now)
+                {
+                    break;
+                }
+
+                d.queue.pop_front();
+
+                // a resent request keeps its id so that a late answer still counts
+                if (r.attempts == 0)
+                {
+                    r.id = nextRequestID();
+                    ((Packet::COMMAND_HEADER*)r.command.data())->req_id = htons(r.id);
+                }
+                r.attempts++;
+                r.deadline = now + timeout;
+
+                d.inFlight++;
+                inFlight[std::make_tuple(d.socket->getFileDescriptor(), d.address, r.id)] = index;
+
+                try
+                {
+                    d.socket->sendTo(d.ip, r.command.data(), r.command.size());
+                }
+                catch (SocketSendToException& exc)
+                {
+                    std::cerr << exc.what() << std::endl;
+                }
+            }
+        }
+
+        if (unfinished == 0)
+        {
+            break;
+        }
+
+        auto nextDeadline = now + timeout;
+        for (const auto& f : inFlight)
+        {
+            nextDeadline = std::min(nextDeadline, requests.at(f.second).deadline);
+        }
+        for (const auto& d : devices)
+        {
+            if (!d.queue.empty() && d.inFlight < d.window)
+            {
+                nextDeadline = std::min(nextDeadline, requests.at(d.queue.front()).notBefore);
+            }
+        }
+
+        int waitTime = 0;
+        if (nextDeadline > now)
+        {
+            waitTime = std::chrono::duration_cast<std::chrono::milliseconds>(nextDeadline - now).count() + 1;
+        }
+
+        // devices may have been added by callbacks
+        std::vector<pollfd> pfds;
+        for (const auto& d : devices)
+        {
+            int fd = d.socket->getFileDescriptor();
+
+            auto same_fd = [fd] (const pollfd& p)
+                {
+                    return p.fd == fd;
+                };
+
+            if (std::none_of(pfds.begin(), pfds.end(), same_fd))
+            {
+                pfds.push_back({ fd, POLLIN, 0 });
+            }
+        }
+
+        int ret = poll(pfds.data(), pfds.size(), waitTime);
+
+        if (ret < 0 && errno != EINTR)
+        {
+            std::cerr << "Unable to wait for acknowledges: " << strerror(errno) << std::endl;
+
+            // nothing can be received anymore; every open command fails
+            auto open = inFlight;
+            inFlight.clear();
+
+            for (const auto& f : open)
+            {
+                finish(f.second, nullptr, 0);
+            }
+            // failure callbacks may push follow-up commands
+            while (unfinished > 0)
+            {
+                for (size_t i = 0; i < devices.size(); ++i)
+                {
+                    failed += cancel(i);
+                }
+            }
+            break;
+        }
+
+        for (const auto& p : pfds)
+        {
+            if (ret <= 0 || !(p.revents & POLLIN))
+            {
+                continue;
+            }
+
+            while (true)
+            {
+                uint8_t msg[1024];
+                sockaddr_in sender = {};
+                socklen_t sender_size = sizeof(sender);
+
+                ssize_t received = recvfrom(p.fd, msg, sizeof(msg), MSG_DONTWAIT,
+                                            (sockaddr*)&sender, &sender_size);
+
+                if (received < 0)
+                {
+                    break;
+                }
+
+                if (received < (ssize_t)sizeof(Packet::ACK_HEADER))
+                {
+                    continue;
+                }
+
+                auto header = (const Packet::ACK_HEADER*)msg;
+
+                auto iter = inFlight.find(std::make_tuple(p.fd, sender.sin_addr.s_addr, ntohs(header->ack_id)));
+                if (iter == inFlight.end())
+                {
+                    // duplicate answer of a resent request or traffic of someone else
+                    continue;
+                }
+
+                size_t index = iter->second;
+                request& r = requests.at(index);
+
+                // the device is still working on the command, e.g. a slow flash write;
+                // wait for the real acknowledge instead of resending
+                if (ntohs(header->answer) == Commands::PENDING_ACK)
+                {
+                    if (received >= (ssize_t)sizeof(Packet::ACK_PENDING))
+                    {
+                        auto pending = (const Packet::ACK_PENDING*)msg;
+                        auto completion = std::chrono::milliseconds(ntohs(pending->time_to_completion));
+
+                        r.deadline = std::max(r.deadline,
+                                              std::chrono::steady_clock::now() + completion + timeout);
+                    }
+                    continue;
+                }
+
+                // the acknowledge has to belong to the sent command
+                if (ntohs(header->answer) != ntohs(((Packet::COMMAND_HEADER*)r.command.data())->command) + 1)
+                {
+                    continue;
+                }
+
+                inFlight.erase(iter);
+
+                device& d = devices.at(r.device);
+
+                // BUSY counts as an attempt; the device gets more time with every one
+                if (ntohs(header->status) == Status::BUSY
+                    && r.attempts < MAX_ATTEMPTS && !d.cancelled)
+                {
+                    r.notBefore = std::chrono::steady_clock::now() + BUSY_BACKOFF * (1 << (r.attempts - 1));
+
+                    d.inFlight--;
+                    d.queue.push_front(index);
+                    continue;
+                }
+
+                finish(index, header, received);
+
+                if (d.window < maxWindow)
+                {
+                    d.window++;
+                }
+            }
+        }
+
+        // devices that handle only one request at a time let the others time out;
+        // shrinking the window on timeouts keeps them from being flooded
+        now = std::chrono::steady_clock::now();
+        for (auto iter = inFlight.begin(); iter != inFlight.end();)
+        {
+            size_t index = iter->second;
+            request& r = requests.at(index);
+
+            if (r.deadline > now)
+            {
+                ++iter;
+                continue;
+            }
+
+            iter = inFlight.erase(iter);
+
+            device& d = devices.at(r.device);
+            d.window = std::max(d.window / 2, 1u);
+
+            if (r.attempts >= MAX_ATTEMPTS || d.cancelled)
+            {
+                finish(index, nullptr, 0);
+            }
+            else
+            {
+                d.inFlight--;
+                d.queue.push_front(index);
+            }
+        }
+    }
+
+    requests.clear();
+    unfinished = 0;
+    for (auto& d : devices)
+    {
+        d.inFlight = 0;
+        d.cancelled = false;
+        d.window = maxWindow;
+    }
+
+    return failed;
+}
+
+} /* namespace tis */
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2013 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _REQUESTQUEUE_H_
+#define _REQUESTQUEUE_H_
+
+#include "gigevision.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tis
+{
+
+class Socket;
+
+
+/// @class RequestQueue
+/// @brief sends GVCP commands to any number of devices and matches the
+///        acknowledges by sender and request id
+///
+/// Commands to one device are pipelined up to a window that shrinks when
+/// requests time out. Commands to different devices are in flight at the
+/// same time, also when the devices share a socket.
+///
+/// Callbacks may push follow-up commands; they are sent by the same run.
+class RequestQueue
+{
+public:
+
+    /// @param ack - acknowledge of the command; nullptr if the device did not answer
+    /// @param size - size of ack in bytes
+    /// @return false to cancel all remaining commands to the same device
+    typedef std::function<bool(const Packet::ACK_HEADER* ack, size_t size)> ack_callback;
+
+    /// @param window - maximum number of unacknowledged commands per device
+    /// @param timeout_in_ms - time a command may stay unanswered before it is sent again
+    explicit RequestQueue (unsigned int window = 16, unsigned int timeout_in_ms = 500);
+
+    RequestQueue (const RequestQueue&) = delete;
+    RequestQueue& operator= (const RequestQueue&) = delete;
+
+    /// @name push
+    /// @param socket - socket used for sending and receiving
+    /// @param ip - address of the device
+    /// @param command - complete GVCP command; the request id is assigned by the queue
+    /// @param callback - called once with the acknowledge of the command
+    void push (std::shared_ptr<Socket> socket,
+               const std::string& ip,
+               std::vector<uint8_t> command,
+               ack_callback callback);
+
+    /// @name run
+    /// @return number of commands that failed or were cancelled
+    /// @brief sends all queued commands and returns when every one was answered or given up;
+    ///        every callback is called exactly once, also when receiving fails
+    size_t run ();
+
+private:
+
+    struct request
+    {
+        size_t device;
+        std::vector<uint8_t> command;
+        ack_callback callback;
+
+        unsigned short id;
+        unsigned int attempts;
+        std::chrono::steady_clock::time_point deadline;
+        std::chrono::steady_clock::time_point notBefore; // set while backing off from BUSY
+    };
+
+    struct device
+    {
+        std::shared_ptr<Socket> socket;
+        std::string ip;
+        uint32_t address;           // network byte order
+
+        std::deque<size_t> queue;   // requests that still have to be sent
+        unsigned int inFlight;
+        unsigned int window;
+        bool cancelled;
+    };
+
+    size_t findDevice (std::shared_ptr<Socket> socket, const std::string& ip);
+
+    unsigned short nextRequestID ();
+
+    /// @return number of cancelled commands
+    size_t cancel (size_t device_index);
+
+    unsigned int maxWindow;
+    std::chrono::milliseconds timeout;
+
+    unsigned short requestID;
+
+    // commands pushed but not yet finished
+    size_t unfinished;
+
+    // deques keep references valid when callbacks push more commands
+    std::deque<request> requests;
+    std::deque<device> devices;
+
+}; /* class RequestQueue */
+
+} /* namespace tis */
+
+#endif /* _REQUESTQUEUE_H_ */
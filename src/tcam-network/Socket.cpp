@@ -96,7 +96,13 @@ bool Socket::setBroadcast (bool enable)
 }
 
 
-void Socket::sendAndReceive (const std::string& destination_address, void* data, size_t size, std::function<int(void*)> callback, const bool broadcast)
+int Socket::getFileDescriptor () const
+{
+    return fd;
+}
+
+
+void Socket::sendTo (const std::string& destination_address, void* data, size_t size, const bool broadcast)
 {
     sockaddr_in destAddr = fillAddr(destination_address, STANDARD_GVCP_PORT);
     setBroadcast(broadcast);
@@ -106,39 +112,43 @@ void Socket::sendAndReceive (const std::string& destination_address, void* data,
     {
         throw SocketSendToException();
     }
-    else
+}
+
+
+void Socket::sendAndReceive (const std::string& destination_address, void* data, size_t size, std::function<int(void*)> callback, const bool broadcast)
+{
+    sendTo(destination_address, data, size, broadcast);
+
+    // we have nothing to wait for end just end here
+    if (callback == NULL)
     {
-        // we have nothing to wait for end just end here
-        if (callback == NULL)
-        {
-            return;
-        }
+        return;
+    }
 
-        timeval timeout;
-        timeout.tv_sec = 3;
-        timeout.tv_usec = 0;
+    timeval timeout;
+    timeout.tv_sec = 3;
+    timeout.tv_usec = 0;
 
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
 
-        while (select(fd+1, &fds, NULL, NULL, &timeout) > 0)
-        {
-            char msg[1024];
+    while (select(fd+1, &fds, NULL, NULL, &timeout) > 0)
+    {
+        char msg[1024];
 
-            struct sockaddr_storage sender = sockaddr_storage();
-            socklen_t sendsize = 0;
+        struct sockaddr_storage sender = sockaddr_storage();
+        socklen_t sendsize = 0;
 
-            if (recvfrom(fd, msg, sizeof(msg), 0, (sockaddr*)&sender, &sendsize) >= 0)
+        if (recvfrom(fd, msg, sizeof(msg), 0, (sockaddr*)&sender, &sendsize) >= 0)
+        {
+            if (callback(msg) == SendAndReceiveSignals::END)
             {
-                if (callback(msg) == SendAndReceiveSignals::END)
-                {
-                    return;
-                }
-
-                // not working due to gcc bug
-                //auto cam = std::make_shared<Camera>(ack, interfaces.at(i).socket, interfaces.at(i).name);
+                return;
             }
+
+            // not working due to gcc bug
+            //auto cam = std::make_shared<Camera>(ack, interfaces.at(i).socket, interfaces.at(i).name);
         }
     }
 }
@@ -88,6 +88,17 @@ public :
     /// @return true on success
     bool setBroadcast (bool enable);
 
+    /// @name getFileDescriptor
+    /// @return file descriptor of the socket; meant for polling only
+    int getFileDescriptor () const;
+
+    /// @name sendTo
+    /// @param destination_address - address that shall receive data
+    /// @param data - information that shall be sent
+    /// @param size - size of data
+    /// @param broadcast - wether this shall be broadcasted or not
+    void sendTo (const std::string& destination_address, void* data, size_t size, const bool broadcast = false);
+
     /// @name sendAndReceive
     /// @param destination_address - address that shall receive data
     /// @param data - information that shall be sent
@@ -25,6 +25,12 @@
 
 #define STANDARD_GVCP_PORT 3956
 
+// largest data block of a READMEM/WRITEMEM that fits into a GVCP packet
+#define GVCP_MAX_MEMORY_PAYLOAD 536
+
+// largest number of addresses in a single READREG
+#define GVCP_MAX_READREG_COUNT (GVCP_MAX_MEMORY_PAYLOAD / 4)
+
 namespace Commands
 {
 
@@ -46,6 +52,7 @@ namespace Commands
     static const unsigned int EVENT_ACK        = 0xC1;
     static const unsigned int EVENTDATA_CMD    = 0xC2;
     static const unsigned int EVENTDATA_ACK    = 0xC3;
+    static const unsigned int PENDING_ACK      = 0x89;
     static const unsigned int INVALID_COMMAND  = 0xFF;
 
 } /* namespace Commands */
@@ -276,6 +283,17 @@ namespace Packet
     } ACK_WRITEREG;
 
 
+    // sent in place of the acknowledge when a command takes longer than usual
+    typedef struct ACK_PENDING
+    {
+        ACK_HEADER  header;
+
+        uint16_t    reserved;
+        uint16_t    time_to_completion; // in ms
+
+    } ACK_PENDING;
+
+
     typedef struct
     {
         ACK_HEADER  header;
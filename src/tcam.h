@@ -25,6 +25,8 @@
 
 #include "base_types.h"
 #include "CaptureDevice.h"
+#include "CaptureGroup.h"
+#include "TriggerScheduler.h"
 #include "Properties.h"
 #include "MemoryBuffer.h"
 #include "DeviceInfo.h"
@@ -33,6 +35,7 @@
 #include "ImageSink.h"
 #include "serialization.h"
 #include "public_utils.h"
+#include "image_statistics.h"
 
 /** @} */
 
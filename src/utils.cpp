@@ -19,6 +19,7 @@
 #include "internal.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <sys/ioctl.h>
 #include <errno.h>
@@ -306,10 +307,16 @@ bool tcam::is_smaller(const tcam_image_size &s1, const tcam_image_size &s2)
 
 TCAM_PROPERTY_ID tcam::generate_unique_property_id ()
 {
-    static unsigned int id_to_use;
+    // devices may be opened concurrently
+    static std::atomic<unsigned int> id_to_use(0);
     static unsigned int id_prefix = 0x199f0000;
 
-    TCAM_PROPERTY_ID new_id = id_prefix ^ id_to_use;
-    id_to_use++;
+    TCAM_PROPERTY_ID new_id = id_prefix ^ id_to_use++;
     return new_id;
 }
+
+
+bool tcam::is_generated_property_id (TCAM_PROPERTY_ID id)
+{
+    return (id & 0xffff0000) == 0x199f0000;
+}
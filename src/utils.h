@@ -161,6 +161,14 @@ bool is_smaller (const tcam_image_size& s1, const tcam_image_size& s2);
  */
 TCAM_PROPERTY_ID generate_unique_property_id ();
 
+
+/**
+ * @brief Check if id was created by generate_unique_property_id
+ * @param id - property id that shall be checked
+ * @return true if id is a generated one
+ */
+bool is_generated_property_id (TCAM_PROPERTY_ID id);
+
 } /* namespace tcam */
 
 VISIBILITY_POP
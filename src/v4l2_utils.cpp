@@ -28,6 +28,7 @@
 #endif
 
 #include <glob.h>
+#include <sys/stat.h>
 
 #include <vector>
 #include <algorithm>
@@ -563,6 +564,46 @@ std::shared_ptr<Property> tcam::create_property (int fd,
 }
 
 
+std::string tcam::get_v4l2_firmware_version (const std::string& devnode)
+{
+    std::string version;
+
+#if HAVE_UDEV
+    struct stat st;
+
+    if (stat(devnode.c_str(), &st) != 0)
+    {
+        return version;
+    }
+
+    struct udev* udev = udev_new();
+    if (!udev)
+    {
+        return version;
+    }
+
+    struct udev_device* dev = udev_device_new_from_devnum(udev, 'c', st.st_rdev);
+
+    if (dev)
+    {
+        // parent is owned by dev and must not be unref'ed
+        struct udev_device* parent_device = udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
+
+        if (parent_device && udev_device_get_sysattr_value(parent_device, "bcdDevice") != NULL)
+        {
+            version = udev_device_get_sysattr_value(parent_device, "bcdDevice");
+        }
+
+        udev_device_unref(dev);
+    }
+
+    udev_unref(udev);
+#endif
+
+    return version;
+}
+
+
 std::vector<DeviceInfo> tcam::get_v4l2_device_list ()
 {
     std::vector<DeviceInfo> device_list;
@@ -47,6 +47,14 @@ std::shared_ptr<Property> create_property (int fd,
                                           std::shared_ptr<PropertyImpl> impl);
 
 
+/**
+ * @brief Retrieve the firmware version of the usb device behind a device node
+ * @param devnode - device node, e.g. /dev/video0
+ * @return bcdDevice of the usb device; empty if not available
+ */
+std::string get_v4l2_firmware_version (const std::string& devnode);
+
+
 /**
  * @name get_v4l2_device_list
  * @brief lists all supported v4l2 devices
@@ -0,0 +1,342 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "exposure_controller.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace tcam;
+
+
+// exposure at which a scene has its nominal brightness
+static const double REFERENCE_EXPOSURE = 10000.0;
+
+// gain units that double the image brightness; matches the controller
+static const double GAIN_STEPS_PER_DOUBLING = 30.0;
+
+// brightness of a light source relative to the scene
+static const double HIGHLIGHT_FACTOR = 8.0;
+
+
+struct scene
+{
+    unsigned int frames;
+    double brightness;
+    double highlights;
+};
+
+
+struct settings
+{
+    unsigned int latency = 2;
+    unsigned int reference = 128;
+
+    double exposure_min = 100.0;
+    double exposure_max = 33333.0;
+    double gain_min = 0.0;
+    double gain_max = 480.0;
+
+    double exposure = 1000.0;
+    double gain = 0.0;
+
+    bool verbose = false;
+};
+
+
+/// @name printHelp
+/// @brief prints complete overview over possible actions
+void printHelp ()
+{
+    std::cout << "\nae-replay - measures the convergence of the auto exposure with a simulated camera"
+              << "\n\nusage: ae-replay <scene file | -> [parameter]...\n\n"
+
+              << "Available parameter:\n"
+              << "    latency=N                - frames until a new value is visible; default 2\n"
+              << "    reference=N              - brightness the image mean shall have; default 128\n"
+              << "    exposure=MIN:MAX         - exposure range; default 100:33333\n"
+              << "    gain=MIN:MAX             - gain range; default 0:480\n"
+              << "    start=EXPOSURE:GAIN      - values before the first frame; default 1000:0\n"
+              << "    verbose=1                - print every frame\n"
+              << std::endl;
+
+    std::cout << "Scene file, one scene per line:\n\n"
+              << "    <frames> <brightness at exposure 10000 and gain 0> [<fraction covered by highlights>]\n"
+              << std::endl;
+}
+
+
+static void parseRange (const std::string& value, double& min, double& max)
+{
+    if (sscanf(value.c_str(), "%lf:%lf", &min, &max) != 2 || min > max)
+    {
+        throw std::invalid_argument("Invalid range \"" + value + "\"");
+    }
+}
+
+
+static std::vector<scene> readScenes (std::istream& in)
+{
+    std::vector<scene> scenes;
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream s(line);
+        scene sc = {0, 0.0, 0.0};
+
+        if (!(s >> sc.frames >> sc.brightness))
+        {
+            throw std::invalid_argument("Invalid scene \"" + line + "\"");
+        }
+        s >> sc.highlights;
+
+        scenes.push_back(sc);
+    }
+
+    return scenes;
+}
+
+
+/**
+ * Statistics of the simulated image.
+ * The scene is spread evenly between half and one and a half of its mean.
+ */
+static void simulateFrame (const scene& sc,
+                           double exposure,
+                           double gain,
+                           struct tcam_image_statistics& stats)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    const double factor = exposure / REFERENCE_EXPOSURE * std::pow(2.0, gain / GAIN_STEPS_PER_DOUBLING);
+    const double mean = sc.brightness * factor;
+
+    const uint64_t samples = 100000;
+    const uint64_t highlight_samples = (uint64_t)(samples * sc.highlights);
+    const uint64_t scene_samples = samples - highlight_samples;
+
+    uint64_t sum = 0;
+
+    for (uint64_t i = 0; i < scene_samples; ++i)
+    {
+        double v = mean * (0.5 + (double)i / scene_samples);
+        unsigned int bin = v >= 255.0 ? 255 : (unsigned int)v;
+
+        stats.histogram[bin]++;
+        sum += bin;
+    }
+
+    double highlight = mean * HIGHLIGHT_FACTOR;
+    unsigned int highlight_bin = highlight >= 255.0 ? 255 : (unsigned int)highlight;
+
+    stats.histogram[highlight_bin] += highlight_samples;
+    sum += highlight_bin * highlight_samples;
+
+    stats.sample_count = samples;
+    stats.brightness = (unsigned int)(sum / samples);
+}
+
+
+struct pending_write
+{
+    uint64_t visible_frame;
+    double exposure;
+    double gain;
+};
+
+
+int main (int argc, char* argv[])
+{
+    if (argc < 2 || strcmp(argv[1], "help") == 0 || strcmp(argv[1], "-h") == 0)
+    {
+        printHelp();
+        return 0;
+    }
+
+    settings set;
+    std::vector<scene> scenes;
+
+    try
+    {
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            size_t pos = arg.find('=');
+
+            if (pos == std::string::npos)
+            {
+                throw std::invalid_argument("Unknown parameter \"" + arg + "\"");
+            }
+
+            std::string key = arg.substr(0, pos);
+            std::string value = arg.substr(pos + 1);
+
+            if (key == "latency")
+            {
+                set.latency = std::stoul(value);
+            }
+            else if (key == "reference")
+            {
+                set.reference = std::stoul(value);
+            }
+            else if (key == "exposure")
+            {
+                parseRange(value, set.exposure_min, set.exposure_max);
+            }
+            else if (key == "gain")
+            {
+                parseRange(value, set.gain_min, set.gain_max);
+            }
+            else if (key == "start")
+            {
+                if (sscanf(value.c_str(), "%lf:%lf", &set.exposure, &set.gain) != 2)
+                {
+                    throw std::invalid_argument("Invalid start values \"" + value + "\"");
+                }
+            }
+            else if (key == "verbose")
+            {
+                set.verbose = value != "0";
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown parameter \"" + arg + "\"");
+            }
+        }
+
+        if (strcmp(argv[1], "-") == 0)
+        {
+            scenes = readScenes(std::cin);
+        }
+        else
+        {
+            std::ifstream file(argv[1]);
+
+            if (!file)
+            {
+                throw std::invalid_argument(std::string("Unable to open ") + argv[1]);
+            }
+            scenes = readScenes(file);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    ExposureController controller;
+    controller.set_latency(set.latency);
+    controller.set_reference(set.reference);
+
+    ExposureController::state values = {};
+    values.exposure = set.exposure;
+    values.exposure_min = set.exposure_min;
+    values.exposure_max = set.exposure_max;
+    values.gain = set.gain;
+    values.gain_min = set.gain_min;
+    values.gain_max = set.gain_max;
+    values.auto_exposure = true;
+    values.auto_gain = true;
+
+    // values the simulated sensor currently uses
+    double sensor_exposure = set.exposure;
+    double sensor_gain = set.gain;
+
+    std::deque<pending_write> in_flight;
+    uint64_t frame = 0;
+    int ret = 0;
+
+    struct tcam_image_statistics stats;
+
+    for (size_t s = 0; s < scenes.size(); ++s)
+    {
+        const scene& sc = scenes[s];
+        long converged_frame = -1;
+
+        for (unsigned int f = 0; f < sc.frames; ++f)
+        {
+            ++frame;
+
+            while (!in_flight.empty() && in_flight.front().visible_frame <= frame)
+            {
+                sensor_exposure = in_flight.front().exposure;
+                sensor_gain = in_flight.front().gain;
+                in_flight.pop_front();
+            }
+
+            simulateFrame(sc, sensor_exposure, sensor_gain, stats);
+
+            bool changed = false;
+
+            if (controller.new_frame())
+            {
+                changed = controller.evaluate(stats, values);
+
+                if (changed)
+                {
+                    // the device accepts both values before the next frame is exposed
+                    controller.change_requested(2);
+                    controller.change_applied();
+                    controller.change_applied();
+
+                    in_flight.push_back({frame + set.latency + 1, values.exposure, values.gain});
+                    converged_frame = -1;
+                }
+                else if (converged_frame < 0)
+                {
+                    converged_frame = f;
+                }
+            }
+
+            if (set.verbose)
+            {
+                printf("%6lu  brightness %3u  exposure %9.1f  gain %6.1f%s\n",
+                       (unsigned long)frame, stats.brightness,
+                       sensor_exposure, sensor_gain,
+                       changed ? "  -> new values" : "");
+            }
+        }
+
+        if (converged_frame < 0)
+        {
+            printf("scene %zu: not converged within %u frames (brightness %u)\n",
+                   s + 1, sc.frames, stats.brightness);
+            ret = 1;
+        }
+        else
+        {
+            printf("scene %zu: converged after %ld frames (brightness %u, exposure %.1f, gain %.1f)\n",
+                   s + 1, converged_frame, stats.brightness, sensor_exposure, sensor_gain);
+        }
+    }
+
+    return ret;
+}
@@ -17,15 +17,20 @@
 #include "ConsoleManager.h"
 #include "CameraDiscovery.h"
 #include "Camera.h"
+#include "FirmwareFleet.h"
+#include "IPProvisioning.h"
 #include "utils.h"
 #include <algorithm>
 #include <unistd.h>
 #include <stdlib.h>
 #include <limits.h>
 
+#include <chrono>
 #include <thread>
 #include <mutex>
 #include <exception>
+#include <map>
+#include <sstream>
 
 namespace tis
 {
@@ -119,7 +124,7 @@ std::shared_ptr<Camera> findCamera (const std::vector<std::string>& args)
 }
 
 
-void listCameras ()
+void listCameras (bool details)
 {
     camera_list cameras = getCameraList();
 
@@ -129,6 +134,34 @@ void listCameras ()
         return;
     }
 
+    // serial -> additional columns
+    std::map<std::string, std::string> ipConfigs;
+
+    if (details)
+    {
+        // one request per camera; all cameras are queried at once
+        getIPConfigurations(cameras,
+                            [&ipConfigs] (std::shared_ptr<Camera> cam, bool ok, const IPConfiguration& config)
+                            {
+                                std::ostringstream columns;
+
+                                if (ok)
+                                {
+                                    columns << std::setw(3)  << " - "
+                                            << std::setw(4)  << (config.dhcp ? "on" : "off")
+                                            << std::setw(3)  << " - "
+                                            << std::setw(6)  << (config.staticIP ? "on" : "off")
+                                            << std::setw(3)  << " - "
+                                            << std::setw(15) << config.persistentIP;
+                                }
+                                else
+                                {
+                                    columns << std::setw(3) << " - " << "not reachable";
+                                }
+                                ipConfigs[cam->getSerialNumber()] = columns.str();
+                            });
+    }
+
     // header for table
     std::cout << "\n" << std::setw(12) << "Model"
               << std::setw(3)  << " - "
@@ -140,8 +173,18 @@ void listCameras ()
               << std::setw(3)  << " - "
               << std::setw(15) << "Current Netmask"
               << std::setw(3)  << " - "
-              << std::setw(15) << "Current Gateway"
-              << std::endl;
+              << std::setw(15) << "Current Gateway";
+
+    if (details)
+    {
+        std::cout << std::setw(3)  << " - "
+                  << std::setw(4)  << "DHCP"
+                  << std::setw(3)  << " - "
+                  << std::setw(6)  << "Static"
+                  << std::setw(3)  << " - "
+                  << std::setw(15) << "Persistent IP";
+    }
+    std::cout << std::endl;
 
     for (const auto& cam : cameras)
     {
@@ -156,6 +199,7 @@ void listCameras ()
                   << std::setw(15) << cam->getCurrentSubnet()
                   << std::setw(3)  << " - "
                   << std::setw(15) << cam->getCurrentGateway()
+                  << ipConfigs[cam->getSerialNumber()]
                   << std::endl;
     }
     std::cout << std::endl;
@@ -193,15 +237,24 @@ void printCameraInformation (const std::vector<std::string>& args)
               << "\n\nMAC Address:        " << camera->getMAC()
               << "\nCurrent IP:         " << camera->getCurrentIP()
               << "\nCurrent Subnet:     " << camera->getCurrentSubnet()
-              << "\nCurrent Gateway:    " << camera->getCurrentGateway()
-              << "\n\nDHCP is:   " << (camera->isDHCPactive() ? "enabled" : "disabled")
-              << "\nStatic is: " << (camera->isStaticIPactive() ? "enabled" : "disabled") << std::endl;
+              << "\nCurrent Gateway:    " << camera->getCurrentGateway();
+
+    // all registers are read with a single request where the camera allows it
+    IPConfiguration config = {};
+    if (!camera->getIPConfiguration(config))
+    {
+        std::cout << "\n\nUnable to read the IP configuration." << std::endl;
+        return;
+    }
+
+    std::cout << "\n\nDHCP is:   " << (config.dhcp ? "enabled" : "disabled")
+              << "\nStatic is: " << (config.staticIP ? "enabled" : "disabled") << std::endl;
 
     if (reachable)
     {
-        std::cout << "\n\nPersistent IP:      " << camera->getPersistentIP()
-                  << "\nPersistent Subnet:  " << camera->getPersistentSubnet()
-                  << "\nPersistent Gateway: " << camera->getPersistentGateway() << "\n" <<  std::endl;
+        std::cout << "\n\nPersistent IP:      " << config.persistentIP
+                  << "\nPersistent Subnet:  " << config.persistentSubnet
+                  << "\nPersistent Gateway: " << config.persistentGateway << "\n" <<  std::endl;
     }
 }
 
@@ -503,6 +556,165 @@ Please reconnect your camera to assure full functionality.\n";
 }
 
 
+static std::string jsonString (const std::string& value)
+{
+    std::string ret = "\"";
+
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            ret += '\\';
+            ret += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            ret += ' ';
+        }
+        else
+        {
+            ret += c;
+        }
+    }
+
+    return ret + "\"";
+}
+
+
+void upgradeFleet (const std::vector<std::string>& args)
+{
+    FleetUpdateOptions options;
+
+    options.firmware = getArgumentValue(args, "firmware", "");
+    if (options.firmware.empty())
+    {
+        std::cout << "Please specify a valid firmware file." << std::endl;
+        return;
+    }
+
+    std::string serials = getArgumentValue(args, "serials", "");
+    std::stringstream serial_stream(serials);
+    std::string serial;
+    while (std::getline(serial_stream, serial, ','))
+    {
+        if (!serial.empty())
+        {
+            options.serials.push_back(serial);
+        }
+    }
+
+    options.model = getArgumentValue(args, "model", "");
+    options.overrideModelName = getArgumentValue(args, "overrideModelName", "");
+    options.journal = getArgumentValue(args, "journal", "");
+
+    std::string parallel = getArgumentValue(args, "parallel", "");
+    if (!parallel.empty())
+    {
+        options.parallelPerInterface = std::stoi(parallel);
+    }
+
+    // one object per line so that scripts can follow the rollout
+    auto report = [] (const FleetUpdateEvent& event)
+        {
+            std::cout << "{\"serial\": " << jsonString(event.serial)
+                      << ", \"interface\": " << jsonString(event.interface)
+                      << ", \"state\": " << jsonString(fleetStateToString(event.state))
+                      << ", \"progress\": " << event.progress
+                      << ", \"message\": " << jsonString(event.message)
+                      << "}" << std::endl;
+        };
+
+    size_t failures = updateFleet(options, report);
+
+    if (failures > 0)
+    {
+        exit(1);
+    }
+}
+
+
+void provision (const std::vector<std::string>& args)
+{
+    std::string file = getArgumentValue(args, "file", "");
+    if (file.empty())
+    {
+        std::cout << "Please specify a mapping file." << std::endl;
+        return;
+    }
+
+    ProvisioningOptions options;
+    options.entries = readProvisioningFile(file);
+
+    std::string parallel = getArgumentValue(args, "parallel", "");
+    if (!parallel.empty())
+    {
+        options.parallel = std::stoi(parallel);
+    }
+
+    std::string wait = getArgumentValue(args, "wait", "");
+    if (!wait.empty())
+    {
+        options.verify_timeout_ms = std::stoi(wait) * 1000;
+    }
+
+    std::string apply = getArgumentValue(args, "apply", "");
+    if (!apply.empty())
+    {
+        if (apply.compare("on") != 0 && apply.compare("off") != 0)
+        {
+            throw std::invalid_argument("Unable to interpret apply argument as value: " + apply);
+        }
+        options.apply = (apply.compare("on") == 0);
+    }
+
+    // serial -> final event
+    std::map<std::string, ProvisioningEvent> results;
+
+    auto report = [&results] (const ProvisioningEvent& event)
+        {
+            std::cout << std::setw(16) << event.serial
+                      << std::setw(3)  << " - "
+                      << std::setw(9)  << provisionStateToString(event.state);
+            if (!event.message.empty())
+            {
+                std::cout << " - " << event.message;
+            }
+            std::cout << std::endl;
+
+            results[event.serial] = event;
+        };
+
+    auto start = std::chrono::steady_clock::now();
+
+    size_t failures = provisionCameras(options, report);
+
+    auto duration = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start);
+
+    std::cout << "\nProvisioned " << options.entries.size() - failures
+              << " of " << options.entries.size() << " cameras in "
+              << duration.count() << " s." << std::endl;
+
+    if (failures > 0)
+    {
+        std::cout << "\nFailed cameras:\n";
+        for (const auto& entry : options.entries)
+        {
+            const auto& result = results[entry.serial];
+            if (result.state != PROVISION_VERIFIED)
+            {
+                std::cout << std::setw(16) << entry.serial
+                          << std::setw(3)  << " - "
+                          << file << ":" << entry.line
+                          << " - " << result.message << "\n";
+            }
+        }
+        std::cout << std::endl;
+        exit(1);
+    }
+    std::cout << std::endl;
+}
+
+
 void rescue (std::vector<std::string> args)
 {
     std::string mac = getArgumentValue(args, "--mac", "-m");
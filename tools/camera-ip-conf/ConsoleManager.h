@@ -44,8 +44,9 @@ namespace tis
     std::shared_ptr<Camera> findCamera (const std::vector<std::string>& args);
 
     /// @name listCameras
+    /// @param details - also query dhcp, static and persistent ip of every camera
     /// prints overview over detected cameras
-    void listCameras ();
+    void listCameras (bool details = false);
 
     /// @name printCameraInformation
     /// @param args - vector containing camera serial for which information shall be printed
@@ -75,6 +76,16 @@ namespace tis
     /// checks for newer firmware in given file and uploads it to camera
     void upgradeFirmware (const std::vector<std::string>& args);
 
+    /// @name upgradeFleet
+    /// @param args - vector containing camera selection, filepath to firmware and limits
+    /// updates several cameras concurrently and prints one JSON object per event
+    void upgradeFleet (const std::vector<std::string>& args);
+
+    /// @name provision
+    /// @param args - vector containing the mapping file and limits
+    /// configures all cameras of the mapping file concurrently and verifies them by rediscovery
+    void provision (const std::vector<std::string>& args);
+
     void rescue (std::vector<std::string> args);
 
 } /* namespace tis */
@@ -107,12 +107,23 @@ void MainWindow::displayCamera()
     ui->editName->setText(QString(cam->getUserDefinedName().c_str()));
 
     // settings tab
-    ui->editSettingsIP->setText(QString(cam->getPersistentIP().c_str()));
-    ui->editSettingsNetmask->setText(QString(cam->getPersistentSubnet().c_str()));
-    ui->editSettingsGateway->setText(QString(cam->getPersistentGateway().c_str()));
+    IPConfiguration config = {};
+    bool configRead = cam->getIPConfiguration(config);
+
+    // saving would overwrite the camera settings with empty values
+    ui->buttonSaveSettings->setEnabled(configRead);
+    if (!configRead)
+    {
+        QString s = "Unable to read the IP configuration.";
+        box.showMessage(s);
+    }
+
+    ui->editSettingsIP->setText(QString(config.persistentIP.c_str()));
+    ui->editSettingsNetmask->setText(QString(config.persistentSubnet.c_str()));
+    ui->editSettingsGateway->setText(QString(config.persistentGateway.c_str()));
 
 
-    if (cam->isDHCPactive())
+    if (config.dhcp)
     {
         ui->checkBoxDHCP->setChecked(true);
     }
@@ -121,7 +132,7 @@ void MainWindow::displayCamera()
         ui->checkBoxDHCP->setChecked(false);
     }
 
-    if (cam->isStaticIPactive())
+    if (config.staticIP)
     {
         ui->checkBoxStatic->setChecked(true);
         // enable persistent config fields
@@ -16,6 +16,7 @@
 
 #include "ConsoleManager.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -40,6 +41,8 @@ void printHelp ()
               << "    forceip  - force ip onto camera\n"
               << "    rescue   - broadcasts to MAC given settings\n"
               << "    upload   - upload new firmware to camera\n"
+              << "    fleet-upload - upload new firmware to several cameras at once\n"
+              << "    provision - configure several cameras from a mapping file\n"
               << "    help     - print this text\n"
               << std::endl;
 
@@ -47,6 +50,7 @@ void printHelp ()
               << "    -h                       - same as help\n"
               << "    -i                       - same as info\n"
               << "    -l                       - same as list\n"
+              << "    -d, --details            - list: also show dhcp, static and persistent ip\n"
               << "    ip=X.X.X.X               - specifiy persistent ip that camera shall use\n"
               << "    subnet=X.X.X.X           - specifiy persistent subnetmask that camera shall use\n"
               << "    gateway=X.X.X.X          - specifiy persistent gateway that camera shall use\n"
@@ -54,6 +58,15 @@ void printHelp ()
               << "    static=on/off            - toggle static ip state\n"
               << "    name=\"xyz\"             - set name for camera; maximum 15 characters\n"
               << "    firmware=firmware.zip    - file containing new firmware\n"
+              << "    serials=A,B,C            - cameras for fleet-upload\n"
+              << "    model=\"xyz\"              - fleet-upload to all cameras of this model\n"
+              << "    parallel=N               - fleet-upload: cameras updated at once per interface; default 4\n"
+              << "    journal=file             - fleet-upload: record results; a rerun skips updated cameras\n"
+              << "    file=mapping.txt         - provision: one line per camera:\n"
+              << "                               <serial> ip=.. subnet=.. gateway=.. dhcp=on/off static=on/off name=..\n"
+              << "    parallel=N               - provision: cameras configured at once; default 8\n"
+              << "    wait=S                   - provision: seconds the cameras have to come back; default 30\n"
+              << "    apply=on/off             - provision: activate settings without power cycle; default on\n"
               << std::endl;
 
     std::cout << "Camera identification is possible via:\n"
@@ -65,7 +78,9 @@ void printHelp ()
     std::cout << "Examples:\n\n"
 
               << "    tis_network set gateway=192.168.0.1 -s 46210199\n"
-              << "    tis_network forceip ip=192.168.0.100 subnet=255.255.255.0 gateway=192.168.0.1 -s 46210199\n\n"
+              << "    tis_network forceip ip=192.168.0.100 subnet=255.255.255.0 gateway=192.168.0.1 -s 46210199\n"
+              << "    tis_network fleet-upload firmware=update.fwpack model=\"DFK 33GP1300\" journal=rollout.log\n"
+              << "    tis_network provision file=line3.txt parallel=16\n\n"
               << std::endl;
 }
 
@@ -93,7 +108,9 @@ void handleCommandlineArguments (const int argc, char* argv[])
             }
             else if ((arg.compare("list") == 0) || (arg.compare("-l") == 0))
             {
-                listCameras();
+                bool details = std::find(args.begin(), args.end(), "-d") != args.end()
+                    || std::find(args.begin(), args.end(), "--details") != args.end();
+                listCameras(details);
                 break;
             }
             else if ((arg.compare("info") == 0) || arg.compare("-i") == 0)
@@ -126,6 +143,16 @@ void handleCommandlineArguments (const int argc, char* argv[])
                 upgradeFirmware(args);
                 break;
             }
+            else if (arg.compare("fleet-upload") == 0)
+            {
+                upgradeFleet(args);
+                break;
+            }
+            else if (arg.compare("provision") == 0)
+            {
+                provision(args);
+                break;
+            }
             else if (arg.compare("rescue") == 0)
             {
                 rescue(args);
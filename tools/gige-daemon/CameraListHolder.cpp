@@ -18,45 +18,62 @@
 
 #include "CameraDiscovery.h"
 
-#include "tcam-semaphores.h"
-
-#include <sys/sem.h>     /* semaphore functions and structs.     */
-#include <sys/ipc.h>
-#include <sys/shm.h>
-#include <sys/msg.h>
-
 #include "gige-daemon.h"
 
 #include <stdlib.h>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
+#include <iostream>
 
 #include <sys/types.h>   /* various type definitions.            */
-#include <sys/ipc.h>     /* general SysV IPC structures          */
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 
 using namespace tis;
 
 
 CameraListHolder::CameraListHolder ()
-    : continue_loop(true), data(nullptr)
+    : continue_loop(true), shm_fd(-1), directory(nullptr), published(),
+      server(tcam_gige_daemon_socket_paths())
 {
-    // to understand shared memory use this guide:
-    // http://beej.us/guide/bgipc/output/html/multipage/shm.html
+    shm_fd = shm_open(TCAM_GIGE_DIRECTORY_NAME, O_RDWR | O_CREAT, 0644);
 
-    shmkey = ftok("/tmp/tcam-gige-camera-list", 'G');
+    if (shm_fd == -1)
+    {
+        throw std::runtime_error("Unable to create shared memory for camera list");
+    }
 
     /* the daemon should work as a system daemon,
-       thus we require the same rights for all users to prevent 'permission denied'
-       errors due to server/client being run by different users. */
-    shmid = shmget(shmkey, sizeof(struct tcam_gige_device_list), 0666 | IPC_CREAT);
+       clients of all users have to be able to read the list
+       regardless of the umask the daemon was started with */
+    fchmod(shm_fd, 0644);
 
-    if (shmid == -1)
+    if (ftruncate(shm_fd, sizeof(struct tcam_gige_directory)) == -1)
     {
-        throw;
+        close(shm_fd);
+        throw std::runtime_error("Unable to size shared memory for camera list");
     }
 
-    semaphore_key = ftok("/tmp/tcam-gige-semaphore", 'S');
-    semaphore_id = tcam::semaphore_create(semaphore_key);
+    void* ptr = mmap(nullptr, sizeof(struct tcam_gige_directory),
+                     PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+
+    if (ptr == MAP_FAILED)
+    {
+        close(shm_fd);
+        throw std::runtime_error("Unable to map shared memory for camera list");
+    }
+
+    directory = (struct tcam_gige_directory*)ptr;
+
+    memset(&directory->list, 0, sizeof(directory->list));
+    directory->version = TCAM_GIGE_DIRECTORY_VERSION;
+    directory->sequence = 0;
+    directory->generation = 0;
+    directory->pid = getpid();
+    tcam_gige_directory_heartbeat(directory);
+    directory->state = TCAM_GIGE_DIRECTORY_ACTIVE;
 
     work_thread = std::thread(&CameraListHolder::index_loop, this);
 }
@@ -64,19 +81,7 @@ CameraListHolder::CameraListHolder ()
 
 CameraListHolder::~CameraListHolder ()
 {
-    continue_loop = false;
-    if (work_thread.joinable())
-    {
-        work_thread.join();
-    }
-
-    struct tcam_gige_device_list* d = (struct tcam_gige_device_list*)shmat(shmid, NULL, NULL);
-    d->device_count = 0;
-    memset(d->devices, 0, sizeof(struct tcam_gige_device_list) * TCAM_DEVICE_LIST_MAX);
-    shmdt(d);
-
-    shmctl(shmid, IPC_RMID, NULL);
-
+    stop();
 }
 
 
@@ -90,25 +95,26 @@ CameraListHolder& CameraListHolder::get_instance ()
 
 std::vector<DeviceInfo> CameraListHolder::get_camera_list () const
 {
-    tcam::semaphore_lock(semaphore_id);
-    struct tcam_gige_device_list* d = (struct tcam_gige_device_list*)shmat(shmid, NULL, NULL);
+    std::vector<DeviceInfo> ret;
 
-    if (d == nullptr)
+    if (directory == nullptr)
     {
-        tcam::semaphore_unlock(semaphore_id);
+        return ret;
+    }
 
-        return std::vector<DeviceInfo>();
+    struct tcam_gige_device_list list;
+    if (!tcam_gige_directory_read(directory, list))
+    {
+        return ret;
     }
 
-    std::vector<DeviceInfo> ret(d->device_count);
+    ret.reserve(list.device_count);
 
-    for (unsigned int i = 0; i < d->device_count; ++i)
+    for (unsigned int i = 0; i < list.device_count; ++i)
     {
-        ret.push_back(DeviceInfo(d->devices[i]));
+        ret.push_back(DeviceInfo(list.devices[i]));
     }
 
-    tcam::semaphore_unlock(semaphore_id);
-
     return ret;
 }
 
@@ -126,9 +132,21 @@ void CameraListHolder::set_interface_list (std::vector<std::string> interfaces)
 }
 
 
-void CameraListHolder::run ()
+bool CameraListHolder::run ()
 {
-    data = shmat(shmid, nullptr, 0);
+    if (!server.start())
+    {
+        std::cerr << "Unable to serve camera list on " << TCAM_GIGE_DAEMON_SOCKET
+                  << " or in $XDG_RUNTIME_DIR" << std::endl;
+        return false;
+    }
+
+    if (server.get_socket_path() != TCAM_GIGE_DAEMON_SOCKET)
+    {
+        std::cout << "Serving camera list on " << server.get_socket_path() << std::endl;
+    }
+
+    return true;
 }
 
 
@@ -138,13 +156,56 @@ void CameraListHolder::stop ()
     mtx.lock();
     cv.notify_all();
     mtx.unlock();
-    shmctl(shmid, IPC_RMID, NULL);
-    data = nullptr;
 
     if (this->work_thread.joinable())
     {
         this->work_thread.join();
     }
+
+    server.stop();
+
+    if (directory == nullptr)
+    {
+        return;
+    }
+
+    // wake waiting clients so that they notice the shutdown
+    directory->state = TCAM_GIGE_DIRECTORY_CLOSED;
+    tcam_gige_directory_write(directory, tcam_gige_device_list());
+
+    munmap(directory, sizeof(struct tcam_gige_directory));
+    directory = nullptr;
+
+    close(shm_fd);
+    shm_fd = -1;
+
+    shm_unlink(TCAM_GIGE_DIRECTORY_NAME);
+}
+
+
+void CameraListHolder::publish (const std::vector<struct tcam_device_info>& devices)
+{
+    struct tcam_gige_device_list list = {};
+
+    list.device_count = devices.size();
+    std::copy(devices.begin(), devices.end(), list.devices);
+
+    // discovery reports cameras in order of their answers;
+    // sorting prevents reordering from looking like a change
+    std::sort(list.devices, list.devices + list.device_count,
+              [] (const struct tcam_device_info& a, const struct tcam_device_info& b)
+              {
+                  return strcmp(a.serial_number, b.serial_number) < 0;
+              });
+
+    if (memcmp(&list, &published, sizeof(list)) == 0)
+    {
+        return;
+    }
+
+    published = list;
+
+    tcam_gige_directory_write(directory, list);
 }
 
 
@@ -180,18 +241,16 @@ camera_list getCameraList (std::vector<std::string> interfaces)
 }
 
 
-std::vector<struct tcam_device_info> get_gige_device_list (std::vector<std::string> interfaces)
+std::vector<struct tcam_device_info> get_gige_device_list (const camera_list& l)
 {
-    // out of the tcam-network lib
-    auto l = getCameraList(interfaces);
-
     std::vector<struct tcam_device_info> ret;
 
     ret.reserve(l.size());
 
     for (const auto& c : l)
     {
-        struct tcam_device_info info;
+        // zeroed so that unchanged lists compare equal
+        struct tcam_device_info info = {};
 
         info.type = TCAM_DEVICE_TYPE_ARAVIS;
 
@@ -209,8 +268,46 @@ std::vector<struct tcam_device_info> get_gige_device_list (std::vector<std::stri
 }
 
 
+std::vector<camera_record> get_camera_records (const camera_list& l)
+{
+    std::vector<camera_record> ret;
+
+    ret.reserve(l.size());
+
+    // all values stem from the discovery acknowledge;
+    // none of these calls causes network traffic
+    for (const auto& c : l)
+    {
+        camera_record rec;
+
+        rec.serial = c->getSerialNumber();
+        rec.model = c->getModelName();
+        rec.vendor = c->getVendorName();
+        rec.user_name = c->getUserDefinedName();
+        rec.mac = c->getMAC();
+        rec.ip = c->getCurrentIP();
+        rec.subnet = c->getCurrentSubnet();
+        rec.gateway = c->getCurrentGateway();
+        rec.firmware = c->getFirmwareVersion();
+        rec.interface = c->getInterfaceName();
+
+        ret.push_back(rec);
+    }
+
+    std::sort(ret.begin(), ret.end(),
+              [] (const camera_record& a, const camera_record& b)
+              {
+                  return a.serial < b.serial;
+              });
+
+    return ret;
+}
+
+
 void CameraListHolder::loop_function ()
 {
+    tcam_gige_directory_heartbeat(directory);
+
     std::unique_lock<std::mutex> lck(mtx);
 
     auto res = cv.wait_for(lck, std::chrono::seconds(2));
@@ -221,33 +318,26 @@ void CameraListHolder::loop_function ()
         return;
     }
 
-    std::vector<struct tcam_device_info> aravis_list = get_gige_device_list(interface_list);
+    // out of the tcam-network lib
+    auto cameras = getCameraList(interface_list);
+
+    std::vector<struct tcam_device_info> aravis_list = get_gige_device_list(cameras);
 
     if (aravis_list.size() > TCAM_DEVICE_LIST_MAX)
     {
-        return;
-    }
-
-    tcam::semaphore_lock(semaphore_id);
-
-    struct tcam_gige_device_list* tmp_ptr = (struct tcam_gige_device_list*) shmat(shmid, NULL, NULL);
+        // warn once per change instead of every discovery cycle
+        static size_t reported_size = 0;
 
-    tmp_ptr->device_count = aravis_list.size();
-
-    struct tcam_device_info* ptr = tmp_ptr->devices;
-    for (const auto dev : aravis_list)
-    {
-        memcpy(ptr, &dev, sizeof(struct tcam_device_info));
-        ++ptr;
+        if (aravis_list.size() != reported_size)
+        {
+            std::cerr << "Found " << aravis_list.size() << " cameras. Only the first "
+                      << TCAM_DEVICE_LIST_MAX << " are published." << std::endl;
+            reported_size = aravis_list.size();
+        }
+        aravis_list.resize(TCAM_DEVICE_LIST_MAX);
     }
 
-    // force update to change time
-    struct shmid_ds ds = {};
-    shmctl(shmid, IPC_STAT, &ds);
-    shmctl(shmid, IPC_SET, &ds);
-
-    // release dataptr
-    shmdt(tmp_ptr);
+    publish(aravis_list);
 
-    tcam::semaphore_unlock(semaphore_id);
+    server.update(get_camera_records(cameras));
 }
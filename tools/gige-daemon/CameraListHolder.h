@@ -22,6 +22,8 @@
 #include <condition_variable>
 
 #include "tcam.h"
+#include "gige-daemon.h"
+#include "DaemonServer.h"
 
 using namespace tcam;
 
@@ -39,7 +41,11 @@ public:
 
     void set_interface_list (std::vector<std::string>);
 
-    void run ();
+    /**
+     * @brief Start serving the camera list on the daemon socket
+     * @return false if no socket could be created
+     */
+    bool run ();
 
     void stop ();
 
@@ -62,11 +68,15 @@ private:
     std::mutex real_mutex;
     std::condition_variable cv;
 
-    // memory sharing keys
-    int shmid;
-    key_t shmkey;
-    void* data;
+    // shared memory containing the published list
+    int shm_fd;
+    struct tcam_gige_directory* directory;
 
-    key_t semaphore_key;
-    int semaphore_id;
+    // last list written to the directory
+    struct tcam_gige_device_list published;
+
+    void publish (const std::vector<struct tcam_device_info>& devices);
+
+    // answers queries of local clients
+    DaemonServer server;
 };
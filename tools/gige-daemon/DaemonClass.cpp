@@ -133,16 +133,9 @@ std::string LockFile::get_file_content () const
 }
 
 
-DaemonClass::DaemonClass (const std::string lock_file,
-                          bool open_ports)
-    : lock_file(LockFile(lock_file)), is_port_open(false)
-{
-    if (open_ports)
-    {
-        open_port();
-        is_port_open = true;
-    }
-}
+DaemonClass::DaemonClass (const std::string lock_file)
+    : lock_file(LockFile(lock_file))
+{}
 
 
 DaemonClass::~DaemonClass ()
@@ -151,9 +144,6 @@ DaemonClass::~DaemonClass ()
     {
         lock_file.unlock();
     }
-
-    close_port();
-    is_port_open = false;
 }
 
 
@@ -283,30 +273,3 @@ int DaemonClass::get_daemon_pid ()
 
     return -1;
 }
-
-
-void DaemonClass::open_port ()
-{
-
-    listenfd = socket(AF_INET, SOCK_STREAM, 0);
-    memset(&serv_addr, '0', sizeof(serv_addr));
-    memset(sendBuff, '0', sizeof(sendBuff));
-
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    serv_addr.sin_port = htons(5000);
-
-
-    listenfd = socket(AF_INET, SOCK_STREAM, 0);
-    memset(&serv_addr, '0', sizeof(serv_addr));
-    memset(sendBuff, '0', sizeof(sendBuff));
-
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    serv_addr.sin_port = htons(5000);
-
-}
-
-
-void DaemonClass::close_port ()
-{}
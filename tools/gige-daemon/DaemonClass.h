@@ -16,10 +16,6 @@
 
 #include <fstream> // filebuf
 
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-
 class LockFile
 {
 public:
@@ -58,8 +54,7 @@ class DaemonClass
 {
 public:
 
-    DaemonClass (const std::string lock_file,
-                bool open_ports=true);
+    DaemonClass (const std::string lock_file);
 
     ~DaemonClass ();
 
@@ -91,18 +86,5 @@ private:
 
     static void handle_signal (int sig);
 
-    void open_port ();
-
-    void close_port ();
-
     LockFile lock_file;
-
-    // socket related member
-    bool is_port_open;
-
-    int listenfd = 0, connfd = 0;
-    struct sockaddr_in serv_addr;
-
-    char sendBuff[1025];
-    time_t ticks;
 };
@@ -0,0 +1,755 @@
+/*
+ * Copyright 2016 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DaemonServer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+// clients that do not read their events are disconnected
+// instead of letting the daemon buffer without limit
+static const size_t MAX_OUTPUT_SIZE = 1024 * 1024;
+
+static const size_t MAX_REQUEST_SIZE = 4096;
+
+static const size_t MAX_CLIENTS = 128;
+
+
+bool operator== (const camera_record& a, const camera_record& b)
+{
+    return a.serial == b.serial
+        && a.model == b.model
+        && a.vendor == b.vendor
+        && a.user_name == b.user_name
+        && a.mac == b.mac
+        && a.ip == b.ip
+        && a.subnet == b.subnet
+        && a.gateway == b.gateway
+        && a.firmware == b.firmware
+        && a.interface == b.interface;
+}
+
+
+bool operator!= (const camera_record& a, const camera_record& b)
+{
+    return !(a == b);
+}
+
+
+/* user defined names are set by users; keep them from breaking the line format */
+static std::string field (const std::string& value)
+{
+    std::string ret = value;
+
+    for (auto& c : ret)
+    {
+        if (c == '\t' || c == '\n' || c == '\r')
+        {
+            c = ' ';
+        }
+    }
+
+    return ret;
+}
+
+
+static std::string camera_line (const std::string& tag, const camera_record& cam)
+{
+    return tag + "\t" + field(cam.serial)
+        + "\t" + field(cam.model)
+        + "\t" + field(cam.ip)
+        + "\t" + field(cam.mac)
+        + "\t" + field(cam.interface) + "\n";
+}
+
+
+/*
+ * Create the directory containing the socket or verify an existing one.
+ * Only the daemon may be able to create entries in it, otherwise
+ * another user could replace the socket between unlink and bind.
+ */
+static bool prepare_socket_directory (const std::string& socket_path)
+{
+    size_t pos = socket_path.find_last_of('/');
+
+    if (pos == std::string::npos || pos == 0)
+    {
+        return true;
+    }
+
+    std::string dir = socket_path.substr(0, pos);
+
+    if (mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST)
+    {
+        std::cerr << "Unable to create " << dir << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st = {};
+
+    if (lstat(dir.c_str(), &st) == -1)
+    {
+        std::cerr << "Unable to access " << dir << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)))
+    {
+        std::cerr << dir << " is not a directory exclusively owned by the daemon" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+DaemonServer::DaemonServer (const std::vector<std::string>& paths)
+    : socket_paths(paths), listen_fd(-1), epoll_fd(-1), wake_fd(-1), running(false)
+{}
+
+
+DaemonServer::~DaemonServer ()
+{
+    stop();
+}
+
+
+bool DaemonServer::open_socket (const std::string& path)
+{
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "Socket path is too long: " << path << std::endl;
+        return false;
+    }
+
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    if (!prepare_socket_directory(path))
+    {
+        return false;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (listen_fd == -1)
+    {
+        std::cerr << "Unable to create socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // a previous instance that was killed leaves its socket behind;
+    // the lock file already guarantees that we are the only daemon
+    // and nobody else can create entries in the socket directory
+    unlink(path.c_str());
+
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1
+        || listen(listen_fd, 16) == -1)
+    {
+        std::cerr << "Unable to listen on " << path << ": " << strerror(errno) << std::endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    // clients of all users have to be able to connect
+    chmod(path.c_str(), 0666);
+
+    socket_path = path;
+
+    return true;
+}
+
+
+bool DaemonServer::start ()
+{
+    if (work_thread.joinable())
+    {
+        return false;
+    }
+
+    // e.g. a daemon without root rights cannot create its directory in /run
+    for (const auto& path : socket_paths)
+    {
+        if (open_socket(path))
+        {
+            break;
+        }
+    }
+
+    if (listen_fd == -1)
+    {
+        return false;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (epoll_fd == -1 || wake_fd == -1)
+    {
+        std::cerr << "Unable to create event loop: " << strerror(errno) << std::endl;
+        stop();
+        return false;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+
+    ev.data.fd = listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+    ev.data.fd = wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+    running = true;
+    work_thread = std::thread(&DaemonServer::run, this);
+
+    return true;
+}
+
+
+void DaemonServer::stop ()
+{
+    if (work_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            running = false;
+        }
+
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) != sizeof(one))
+        {
+            std::cerr << "Unable to wake server thread" << std::endl;
+        }
+
+        work_thread.join();
+    }
+
+    for (auto& c : clients)
+    {
+        close(c.first);
+    }
+    clients.clear();
+
+    if (listen_fd != -1)
+    {
+        close(listen_fd);
+        listen_fd = -1;
+        unlink(socket_path.c_str());
+        socket_path.clear();
+    }
+
+    if (wake_fd != -1)
+    {
+        close(wake_fd);
+        wake_fd = -1;
+    }
+
+    if (epoll_fd != -1)
+    {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+}
+
+
+std::string DaemonServer::get_socket_path () const
+{
+    return socket_path;
+}
+
+
+void DaemonServer::update (const std::vector<camera_record>& new_cameras)
+{
+    std::lock_guard<std::mutex> lck(mtx);
+
+    bool changed = false;
+
+    for (const auto& cam : cameras)
+    {
+        auto iter = std::find_if(new_cameras.begin(), new_cameras.end(),
+                                 [&cam] (const camera_record& c)
+                                 {
+                                     return c.serial == cam.serial;
+                                 });
+
+        if (iter == new_cameras.end())
+        {
+            events.push_back("REMOVED\t" + field(cam.serial) + "\n");
+            changed = true;
+        }
+    }
+
+    for (const auto& cam : new_cameras)
+    {
+        auto iter = std::find_if(cameras.begin(), cameras.end(),
+                                 [&cam] (const camera_record& c)
+                                 {
+                                     return c.serial == cam.serial;
+                                 });
+
+        if (iter == cameras.end())
+        {
+            events.push_back(camera_line("ADDED", cam));
+            changed = true;
+        }
+        else if (*iter != cam)
+        {
+            events.push_back(camera_line("CHANGED", cam));
+            changed = true;
+        }
+    }
+
+    cameras = new_cameras;
+
+    if (changed && wake_fd != -1)
+    {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) != sizeof(one))
+        {
+            std::cerr << "Unable to wake server thread" << std::endl;
+        }
+    }
+}
+
+
+void DaemonServer::run ()
+{
+    const int max_events = 16;
+    struct epoll_event ev[max_events];
+
+    while (true)
+    {
+        int count = epoll_wait(epoll_fd, ev, max_events, -1);
+
+        if (count == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "Error while waiting for clients: " << strerror(errno) << std::endl;
+            return;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            int fd = ev[i].data.fd;
+
+            if (fd == wake_fd)
+            {
+                uint64_t value;
+                if (read(wake_fd, &value, sizeof(value)) != sizeof(value))
+                {
+                    continue;
+                }
+
+                std::vector<std::string> pending;
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+
+                    if (!running)
+                    {
+                        return;
+                    }
+                    pending.swap(events);
+                }
+
+                dispatch_events(pending);
+            }
+            else if (fd == listen_fd)
+            {
+                accept_clients();
+            }
+            else
+            {
+                auto iter = clients.find(fd);
+
+                if (iter == clients.end())
+                {
+                    // already dropped while handling an earlier event
+                    continue;
+                }
+
+                bool keep = true;
+
+                if (ev[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                {
+                    keep = read_client(iter->second);
+                }
+
+                if (keep && (ev[i].events & EPOLLOUT))
+                {
+                    keep = write_client(iter->second);
+                }
+
+                if (!keep)
+                {
+                    drop_client(fd);
+                }
+            }
+        }
+    }
+}
+
+
+void DaemonServer::accept_clients ()
+{
+    while (true)
+    {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (fd == -1)
+        {
+            return;
+        }
+
+        if (clients.size() >= MAX_CLIENTS)
+        {
+            close(fd);
+            continue;
+        }
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+        {
+            close(fd);
+            continue;
+        }
+
+        client c = {};
+        c.fd = fd;
+        c.subscribed = false;
+
+        clients[fd] = c;
+    }
+}
+
+
+bool DaemonServer::read_client (client& c)
+{
+    char buffer[1024];
+
+    while (true)
+    {
+        ssize_t ret = recv(c.fd, buffer, sizeof(buffer), 0);
+
+        if (ret == 0)
+        {
+            return false;
+        }
+
+        if (ret == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        c.input.append(buffer, ret);
+
+        size_t pos;
+        while ((pos = c.input.find('\n')) != std::string::npos)
+        {
+            std::string line = c.input.substr(0, pos);
+            c.input.erase(0, pos + 1);
+
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            handle_request(c, line);
+
+            if (c.fd == -1)
+            {
+                return false;
+            }
+        }
+
+        if (c.input.size() > MAX_REQUEST_SIZE)
+        {
+            return false;
+        }
+    }
+}
+
+
+bool DaemonServer::write_client (client& c)
+{
+    while (!c.output.empty())
+    {
+        ssize_t ret = send(c.fd, c.output.data(), c.output.size(), MSG_NOSIGNAL);
+
+        if (ret == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            return false;
+        }
+
+        c.output.erase(0, ret);
+    }
+
+    struct epoll_event ev = {};
+    ev.events = c.output.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+    ev.data.fd = c.fd;
+
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &ev) == 0;
+}
+
+
+bool DaemonServer::queue (client& c, const std::string& data)
+{
+    if (c.fd == -1)
+    {
+        return false;
+    }
+
+    bool was_empty = c.output.empty();
+
+    c.output += data;
+
+    if (c.output.size() > MAX_OUTPUT_SIZE)
+    {
+        // the fd is released by the caller through drop_client
+        c.fd = -1;
+        return false;
+    }
+
+    // try to send directly; EPOLLOUT is only needed for slow readers
+    if (was_empty && !write_client(c))
+    {
+        c.fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+
+void DaemonServer::handle_request (client& c, const std::string& line)
+{
+    std::string command = line.substr(0, line.find(' '));
+    std::string argument;
+
+    if (command.size() < line.size())
+    {
+        argument = line.substr(command.size() + 1);
+    }
+
+    if (command == "list")
+    {
+        std::string answer;
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+
+            for (const auto& cam : cameras)
+            {
+                answer += camera_line("CAMERA", cam);
+            }
+        }
+
+        queue(c, answer + "OK\n");
+    }
+    else if (command == "info")
+    {
+        std::string answer;
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+
+            for (const auto& cam : cameras)
+            {
+                if (cam.serial != argument)
+                {
+                    continue;
+                }
+
+                answer = "serial\t" + field(cam.serial) + "\n"
+                    + "model\t" + field(cam.model) + "\n"
+                    + "vendor\t" + field(cam.vendor) + "\n"
+                    + "user-defined-name\t" + field(cam.user_name) + "\n"
+                    + "mac\t" + field(cam.mac) + "\n"
+                    + "ip\t" + field(cam.ip) + "\n"
+                    + "subnet\t" + field(cam.subnet) + "\n"
+                    + "gateway\t" + field(cam.gateway) + "\n"
+                    + "firmware\t" + field(cam.firmware) + "\n"
+                    + "interface\t" + field(cam.interface) + "\n";
+                break;
+            }
+        }
+
+        if (answer.empty())
+        {
+            queue(c, "ERROR unknown camera\n");
+        }
+        else
+        {
+            queue(c, answer + "OK\n");
+        }
+    }
+    else if (command == "interfaces")
+    {
+        // interface -> serials in order of first appearance
+        std::vector<std::pair<std::string, std::string>> interfaces;
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+
+            for (const auto& cam : cameras)
+            {
+                auto iter = std::find_if(interfaces.begin(), interfaces.end(),
+                                         [&cam] (const std::pair<std::string, std::string>& p)
+                                         {
+                                             return p.first == cam.interface;
+                                         });
+
+                if (iter == interfaces.end())
+                {
+                    interfaces.push_back({cam.interface, field(cam.serial)});
+                }
+                else
+                {
+                    iter->second += "," + field(cam.serial);
+                }
+            }
+        }
+
+        std::string answer;
+        for (const auto& i : interfaces)
+        {
+            answer += "INTERFACE\t" + field(i.first) + "\t" + i.second + "\n";
+        }
+
+        queue(c, answer + "OK\n");
+    }
+    else if (command == "subscribe")
+    {
+        subscribe(c);
+    }
+    else
+    {
+        queue(c, "ERROR unknown request\n");
+    }
+}
+
+
+void DaemonServer::subscribe (client& c)
+{
+    if (c.subscribed)
+    {
+        queue(c, "OK\n");
+        return;
+    }
+
+    std::vector<std::string> pending;
+    std::string answer;
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+
+        // events that are not dispatched yet are already part of the
+        // snapshot; hand them to the existing subscribers first so that
+        // the new one does not receive them twice
+        pending.swap(events);
+
+        for (const auto& cam : cameras)
+        {
+            answer += camera_line("ADDED", cam);
+        }
+    }
+
+    dispatch_events(pending);
+
+    if (c.fd == -1)
+    {
+        return;
+    }
+
+    c.subscribed = true;
+
+    queue(c, answer + "OK\n");
+}
+
+
+void DaemonServer::dispatch_events (const std::vector<std::string>& pending)
+{
+    if (pending.empty())
+    {
+        return;
+    }
+
+    std::string data;
+    for (const auto& e : pending)
+    {
+        data += e;
+    }
+
+    std::vector<int> dropped;
+
+    for (auto& entry : clients)
+    {
+        client& c = entry.second;
+
+        if (c.subscribed && !queue(c, data))
+        {
+            dropped.push_back(entry.first);
+        }
+    }
+
+    for (int fd : dropped)
+    {
+        drop_client(fd);
+    }
+}
+
+
+void DaemonServer::drop_client (int fd)
+{
+    auto iter = clients.find(fd);
+
+    if (iter == clients.end())
+    {
+        return;
+    }
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+
+    clients.erase(iter);
+}
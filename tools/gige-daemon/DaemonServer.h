@@ -0,0 +1,142 @@
+/*
+ * Copyright 2016 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TCAM_GIGE_DAEMONSERVER_H
+#define TCAM_GIGE_DAEMONSERVER_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Line based protocol served on the unix socket.
+ * Every request is a single line, every answer ends with "OK" or "ERROR <reason>".
+ * Fields are separated by tabs.
+ *
+ * list               -> CAMERA <serial> <model> <ip> <mac> <interface>
+ * info <serial>      -> <key> <value> for every known property
+ * interfaces         -> INTERFACE <name> <serial>,<serial>,...
+ * subscribe          -> ADDED lines for all current cameras, then
+ *                       ADDED/CHANGED (same fields as CAMERA) and REMOVED <serial>
+ *                       whenever the camera list changes
+ */
+
+struct camera_record
+{
+    std::string serial;
+    std::string model;
+    std::string vendor;
+    std::string user_name;
+    std::string mac;
+    std::string ip;
+    std::string subnet;
+    std::string gateway;
+    std::string firmware;
+    std::string interface;
+};
+
+
+bool operator== (const camera_record& a, const camera_record& b);
+bool operator!= (const camera_record& a, const camera_record& b);
+
+
+class DaemonServer
+{
+public:
+
+    /**
+     * @param socket_paths - paths to serve on; the first usable one is taken
+     */
+    explicit DaemonServer (const std::vector<std::string>& socket_paths);
+
+    ~DaemonServer ();
+
+    DaemonServer (const DaemonServer&) = delete;
+    DaemonServer& operator= (const DaemonServer&) = delete;
+
+    /**
+     * @brief Create the socket and start serving clients
+     * @return true on success; false if no socket path could be used
+     */
+    bool start ();
+
+    /**
+     * @return path of the socket that is served; empty when not started
+     */
+    std::string get_socket_path () const;
+
+    /**
+     * @brief Disconnect all clients and remove the socket
+     */
+    void stop ();
+
+    /**
+     * @brief Replace the served camera list and notify subscribers about differences
+     */
+    void update (const std::vector<camera_record>& cameras);
+
+private:
+
+    struct client
+    {
+        int fd;
+        bool subscribed;
+        std::string input;
+        std::string output;
+    };
+
+    bool open_socket (const std::string& path);
+
+    void run ();
+
+    void accept_clients ();
+
+    bool read_client (client& c);
+
+    bool write_client (client& c);
+
+    void handle_request (client& c, const std::string& line);
+
+    void subscribe (client& c);
+
+    void dispatch_events (const std::vector<std::string>& events);
+
+    bool queue (client& c, const std::string& data);
+
+    void drop_client (int fd);
+
+    std::vector<std::string> socket_paths;
+    std::string socket_path;
+
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+
+    bool running;
+    std::thread work_thread;
+
+    // guards cameras and events; shared with the discovery thread
+    std::mutex mtx;
+    std::vector<camera_record> cameras;
+    std::vector<std::string> events;
+
+    // only used by the server thread
+    std::map<int, client> clients;
+};
+
+#endif /* TCAM_GIGE_DAEMONSERVER_H */
@@ -19,9 +19,49 @@
 
 #include <tcam.h>
 
-#include <sys/msg.h>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
 
-static const size_t TCAM_DEVICE_LIST_MAX = 10;
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const size_t TCAM_DEVICE_LIST_MAX = 64;
+
+/* name of the POSIX shared memory object containing the camera directory */
+static const char* TCAM_GIGE_DIRECTORY_NAME = "/tcam-gige-camera-list";
+
+/* unix socket serving camera queries and change subscriptions; see DaemonServer.h
+   the containing directory is created by the daemon and only writable by it */
+static const char* TCAM_GIGE_DAEMON_SOCKET = "/run/tcam-gige-daemon/socket";
+
+/* socket below $XDG_RUNTIME_DIR; used when the daemon may not create TCAM_GIGE_DAEMON_SOCKET */
+static const char* TCAM_GIGE_DAEMON_RUNTIME_SOCKET = "/tcam-gige-daemon/socket";
+
+/* changed whenever the layout of tcam_gige_directory changes */
+static const uint32_t TCAM_GIGE_DIRECTORY_VERSION = 2;
+
+/* seconds without heartbeat after which the daemon is considered dead */
+static const uint64_t TCAM_GIGE_DIRECTORY_HEARTBEAT_TIMEOUT = 30;
+
+/* copies a reader attempts while the daemon is writing before it gives up */
+static const unsigned int TCAM_GIGE_DIRECTORY_READ_ATTEMPTS = 1000;
+
+enum TCAM_GIGE_DIRECTORY_STATE
+{
+    TCAM_GIGE_DIRECTORY_CLOSED = 0, /* daemon is not running; reopen later */
+    TCAM_GIGE_DIRECTORY_ACTIVE = 1,
+};
 
 struct tcam_gige_device_list
 {
@@ -30,4 +70,217 @@ struct tcam_gige_device_list
     struct tcam_device_info devices[TCAM_DEVICE_LIST_MAX];
 };
 
+/*
+ * Camera list published by the gige-daemon.
+ *
+ * The daemon is the only writer. Readers never lock; they copy the list
+ * and retry when sequence was odd or changed during the copy (seqlock).
+ * generation is incremented after every change and can be waited on
+ * with a futex to get notified about changes.
+ * A crashed daemon leaves the segment ACTIVE; readers detect this
+ * through pid and heartbeat.
+ */
+struct tcam_gige_directory
+{
+    uint32_t version;
+    std::atomic<uint32_t> state;
+    std::atomic<uint32_t> generation;
+    std::atomic<uint32_t> sequence;
+
+    uint32_t pid;                     /* process id of the daemon */
+    std::atomic<uint64_t> heartbeat;  /* CLOCK_MONOTONIC seconds of the last daemon iteration */
+
+    struct tcam_gige_device_list list;
+};
+
+
+/**
+ * @return socket paths the daemon may serve on, in the order it tries them
+ */
+inline std::vector<std::string> tcam_gige_daemon_socket_paths ()
+{
+    std::vector<std::string> paths = {TCAM_GIGE_DAEMON_SOCKET};
+
+    const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+
+    if (runtime_dir != nullptr && runtime_dir[0] == '/')
+    {
+        paths.push_back(std::string(runtime_dir) + TCAM_GIGE_DAEMON_RUNTIME_SOCKET);
+    }
+
+    return paths;
+}
+
+
+inline uint64_t tcam_gige_directory_now ()
+{
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec;
+}
+
+
+/**
+ * @brief Map the directory of a running daemon read-only
+ * @return pointer to the directory; nullptr if no compatible daemon runs
+ */
+inline const struct tcam_gige_directory* tcam_gige_directory_open ()
+{
+    int fd = shm_open(TCAM_GIGE_DIRECTORY_NAME, O_RDONLY, 0);
+
+    if (fd == -1)
+    {
+        return nullptr;
+    }
+
+    void* ptr = mmap(nullptr, sizeof(struct tcam_gige_directory), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (ptr == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    auto dir = (const struct tcam_gige_directory*)ptr;
+
+    if (dir->version != TCAM_GIGE_DIRECTORY_VERSION)
+    {
+        munmap(ptr, sizeof(struct tcam_gige_directory));
+        return nullptr;
+    }
+
+    return dir;
+}
+
+
+inline void tcam_gige_directory_close (const struct tcam_gige_directory* dir)
+{
+    if (dir != nullptr)
+    {
+        munmap((void*)dir, sizeof(struct tcam_gige_directory));
+    }
+}
+
+
+/**
+ * @brief Check that the daemon owning the directory is still running
+ * @return false if the daemon stopped, crashed or hangs
+ */
+inline bool tcam_gige_directory_is_alive (const struct tcam_gige_directory* dir)
+{
+    if (dir->state.load(std::memory_order_acquire) != TCAM_GIGE_DIRECTORY_ACTIVE)
+    {
+        return false;
+    }
+
+    // EPERM: process exists but belongs to another user
+    if (kill(dir->pid, 0) == -1 && errno != EPERM)
+    {
+        return false;
+    }
+
+    uint64_t heartbeat = dir->heartbeat.load(std::memory_order_acquire);
+
+    return tcam_gige_directory_now() <= heartbeat + TCAM_GIGE_DIRECTORY_HEARTBEAT_TIMEOUT;
+}
+
+
+/**
+ * @brief Copy a consistent snapshot of the camera list
+ * @param dir - mapped directory
+ * @param list - target of the copy
+ * @param generation - receives the generation of the copied list; may be nullptr
+ * @return false if no consistent copy could be made, e.g. the daemon died while writing
+ */
+inline bool tcam_gige_directory_read (const struct tcam_gige_directory* dir,
+                                      struct tcam_gige_device_list& list,
+                                      uint32_t* generation = nullptr)
+{
+    for (unsigned int i = 0; i < TCAM_GIGE_DIRECTORY_READ_ATTEMPTS; ++i)
+    {
+        uint32_t begin = dir->sequence.load(std::memory_order_acquire);
+
+        if (begin & 1)
+        {
+            // writer is active; the update only takes a memcpy
+            // unless the writer was preempted or died in between
+            sched_yield();
+            continue;
+        }
+
+        uint32_t gen = dir->generation.load(std::memory_order_relaxed);
+        memcpy(&list, &dir->list, sizeof(list));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (dir->sequence.load(std::memory_order_relaxed) == begin)
+        {
+            if (list.device_count > TCAM_DEVICE_LIST_MAX)
+            {
+                list.device_count = TCAM_DEVICE_LIST_MAX;
+            }
+            if (generation != nullptr)
+            {
+                *generation = gen;
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief Block until the list differs from the given generation
+ * @param dir - mapped directory
+ * @param generation - generation the caller already knows
+ * @param timeout - maximum time to wait; nullptr to wait forever
+ * @return true if the generation changed
+ */
+inline bool tcam_gige_directory_wait (const struct tcam_gige_directory* dir,
+                                      uint32_t generation,
+                                      const struct timespec* timeout)
+{
+    if (dir->generation.load(std::memory_order_acquire) != generation)
+    {
+        return true;
+    }
+
+    // the directory is shared between processes, thus no FUTEX_PRIVATE_FLAG
+    syscall(SYS_futex, &dir->generation, FUTEX_WAIT, generation, timeout, nullptr, 0);
+
+    return dir->generation.load(std::memory_order_acquire) != generation;
+}
+
+
+/**
+ * @brief Announce that the daemon is still running; daemon side only
+ */
+inline void tcam_gige_directory_heartbeat (struct tcam_gige_directory* dir)
+{
+    dir->heartbeat.store(tcam_gige_directory_now(), std::memory_order_release);
+}
+
+
+/**
+ * @brief Replace the published list; daemon side only
+ */
+inline void tcam_gige_directory_write (struct tcam_gige_directory* dir,
+                                       const struct tcam_gige_device_list& list)
+{
+    uint32_t seq = dir->sequence.load(std::memory_order_relaxed);
+
+    dir->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(&dir->list, &list, sizeof(list));
+
+    dir->sequence.store(seq + 2, std::memory_order_release);
+
+    dir->generation.fetch_add(1, std::memory_order_release);
+    syscall(SYS_futex, &dir->generation, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
 #endif /* TCAM_GIGE_DAEMON_H */
@@ -15,23 +15,19 @@
  */
 
 
-#include <sys/ipc.h>
-#include <sys/shm.h>
-#include <sys/msg.h>
-
-
 #include <stdio.h>
 #include <iostream>
 #include <cstring>
 #include <csignal>
 
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "CameraListHolder.h"
 #include "DaemonClass.h"
 
 #include "gige-daemon.h"
-#include "tcam-semaphores.h"
 
 static const std::string RUNNING_DIR = "/";
 static const std::string LOCK_FILE = "/var/lock/gige-daemon.lock";
@@ -42,43 +38,27 @@ DaemonClass daemon_instance (LOCK_FILE);
 
 std::vector<struct tcam_device_info> get_camera_list ()
 {
+    const struct tcam_gige_directory* dir = tcam_gige_directory_open();
 
-    key_t shmkey = ftok("/tmp/tcam-gige-camera-list", 'G');
-    key_t sem_key = ftok("/tmp/tcam-gige-semaphore", 'S');
-
-    int sem_id = tcam::semaphore_create(sem_key);
-
-    int shmid;
-    if ((shmid = shmget(shmkey, sizeof(struct tcam_gige_device_list), 0644 | IPC_CREAT)) == -1)
-    {
-        perror("shmget");
-        exit(1);
-    }
-
-    tcam::semaphore_lock(sem_id);
-
-    struct tcam_gige_device_list* d = (struct tcam_gige_device_list*)shmat(shmid, NULL, NULL);
-
-    if (d == nullptr)
+    if (dir == nullptr || !tcam_gige_directory_is_alive(dir))
     {
-        shmdt(d);
+        tcam_gige_directory_close(dir);
+        std::cerr << "gige-daemon is not running" << std::endl;
         return std::vector<struct tcam_device_info>();
     }
 
-    std::vector<struct tcam_device_info> ret;
+    struct tcam_gige_device_list list;
+    bool ret = tcam_gige_directory_read(dir, list);
 
-    ret.reserve(d->device_count);
+    tcam_gige_directory_close(dir);
 
-    for (unsigned int i = 0; i < d->device_count; ++i)
+    if (!ret)
     {
-        ret.push_back(d->devices[i]);
+        std::cerr << "Unable to read camera list of gige-daemon" << std::endl;
+        return std::vector<struct tcam_device_info>();
     }
 
-    shmdt(d);
-
-    tcam::semaphore_unlock(sem_id);
-
-    return ret;
+    return std::vector<struct tcam_device_info>(list.devices, list.devices + list.device_count);
 }
 
 
@@ -104,15 +84,118 @@ void print_camera_list_long ()
 }
 
 
-void print_help (const char* prog_name)
+int connect_daemon ()
+{
+    // same order the daemon uses when creating its socket
+    for (const auto& path : tcam_gige_daemon_socket_paths())
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        if (fd == -1)
+        {
+            return -1;
+        }
+
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0)
+        {
+            return fd;
+        }
+
+        close(fd);
+    }
+
+    return -1;
+}
+
+
+/**
+ * @brief Send a request to the daemon and print every answer line
+ * @param request - request line without line break
+ * @param follow - continue printing after the final OK; used for subscriptions
+ * @return true if the daemon answered with OK
+ */
+bool print_daemon_request (const std::string& request, bool follow)
 {
-    std::cout << sizeof(struct tcam_gige_device_list) << std::endl;
+    int fd = connect_daemon();
+
+    if (fd == -1)
+    {
+        std::cerr << "gige-daemon is not running" << std::endl;
+        return false;
+    }
+
+    std::string line = request + "\n";
+
+    if (send(fd, line.c_str(), line.size(), MSG_NOSIGNAL) != (ssize_t)line.size())
+    {
+        close(fd);
+        return false;
+    }
+
+    bool ret = false;
+    std::string buffer;
+    char tmp[1024];
+
+    while (true)
+    {
+        ssize_t size = recv(fd, tmp, sizeof(tmp), 0);
 
+        if (size <= 0)
+        {
+            break;
+        }
+
+        buffer.append(tmp, size);
+
+        size_t pos;
+        while ((pos = buffer.find('\n')) != std::string::npos)
+        {
+            std::string answer = buffer.substr(0, pos);
+            buffer.erase(0, pos + 1);
+
+            if (answer == "OK")
+            {
+                ret = true;
+
+                if (!follow)
+                {
+                    close(fd);
+                    return ret;
+                }
+                continue;
+            }
+
+            if (answer.compare(0, 5, "ERROR") == 0)
+            {
+                std::cerr << answer << std::endl;
+                close(fd);
+                return false;
+            }
+
+            std::cout << answer << std::endl;
+        }
+    }
+
+    close(fd);
+
+    return ret;
+}
+
+
+void print_help (const char* prog_name)
+{
     std::cout << prog_name <<" - GigE Indexing daemon\n"
               << "\n"
               << "Usage:\n"
               << "\t" << prog_name << " list      - list camera names\n"
               << "\t" << prog_name << " list-long - list camera names, ip, mac\n"
+              << "\t" << prog_name << " info <serial> - print details of a camera\n"
+              << "\t" << prog_name << " interfaces - list cameras per network interface\n"
+              << "\t" << prog_name << " watch     - print camera list changes until interrupted\n"
               << "\t" << prog_name << " start     - start daemon and fork\n"
               << "\t\t" << " --no-fork            - run daemon without forking\n"
               << "\t" << prog_name << " stop      - stop daemon\n"
@@ -145,7 +228,7 @@ void signal_handler (int sig)
 
 int main (int argc, char *argv[])
 {
-    for (unsigned int i = 1; i < argc; ++i)
+    for (int i = 1; i < argc; ++i)
     {
         if (strcmp("list", argv[i]) == 0)
         {
@@ -157,11 +240,29 @@ int main (int argc, char *argv[])
             print_camera_list_long();
             return 0;
         }
+        else if (strcmp("info", argv[i]) == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "No serial given" << std::endl;
+                return 1;
+            }
+
+            return print_daemon_request(std::string("info ") + argv[i + 1], false) ? 0 : 1;
+        }
+        else if (strcmp("interfaces", argv[i]) == 0)
+        {
+            return print_daemon_request("interfaces", false) ? 0 : 1;
+        }
+        else if (strcmp("watch", argv[i]) == 0)
+        {
+            return print_daemon_request("subscribe", true) ? 0 : 1;
+        }
         else if (strcmp("start", argv[i]) == 0)
         {
             bool daemonize = true;
 
-            for (unsigned int j = 1; j < argc; ++j)
+            for (int j = 1; j < argc; ++j)
             {
                 if (strcmp("--no-fork", argv[j]) == 0)
                 {
@@ -185,7 +286,7 @@ int main (int argc, char *argv[])
             }
 
             std::vector<std::string> interfaces;
-            for (unsigned int x = (i + 1); x < argc; ++x)
+            for (int x = (i + 1); x < argc; ++x)
             {
                 if (strcmp("--no-fork", argv[x]) == 0)
                 {
@@ -195,7 +296,12 @@ int main (int argc, char *argv[])
                 interfaces.push_back(argv[x]);
             }
             CameraListHolder::get_instance().set_interface_list(interfaces);
-            CameraListHolder::get_instance().run();
+            if (!CameraListHolder::get_instance().run())
+            {
+                CameraListHolder::get_instance().stop();
+                daemon_instance.stop_daemon();
+                return 1;
+            }
 
             // we now suspend this thread and wait until a SIGTERM arrives
             sigset_t mask;
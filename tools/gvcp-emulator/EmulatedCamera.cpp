@@ -0,0 +1,604 @@
+/*
+ * Copyright 2013 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "EmulatedCamera.h"
+
+#include "gigevision.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <arpa/inet.h>
+
+namespace tis
+{
+
+// writing one of these values restarts the device; see FirmwareUpgrade.cpp
+static const uint32_t REBOOT_REGISTER = 0xEF000004;
+static const uint32_t REBOOT_WARM = 0xB007B007;
+static const uint32_t REBOOT_COLD = 0xC07DB007;
+
+
+EmulatedCamera::EmulatedCamera (const CameraIdentity& _identity, const std::vector<FlashRegion>& _flash)
+    : identity(_identity), flash(_flash), flashUnlocked(_flash.size(), false)
+{
+    storeRegister(Register::VERSION_REGISTER, 0x00010002);
+    storeRegister(Register::DEVICEMODE_REGISTER, Register::DEVICEMODE_BIGENDIAN);
+    storeRegister(Register::MAC_HI_REGISTER, (uint32_t)(identity.mac >> 32));
+    storeRegister(Register::MAC_LO_REGISTER, (uint32_t)identity.mac);
+    storeRegister(Register::SUPPORTED_IPCFG_REGISTER,
+                  Register::IPCFG_LLA | Register::IPCFG_DHCP | Register::IPCFG_PERSISTANT);
+    storeRegister(Register::CURRENT_IPCFG_REGISTER, Register::IPCFG_LLA | Register::IPCFG_DHCP);
+
+    storeString(Register::MANUFACTURER_NAME_REGISTER, identity.vendor, 32);
+    storeString(Register::MODEL_NAME_REGISTER, identity.model, 32);
+    storeString(Register::DEVICE_VERSION_REGISTER, identity.version, 32);
+    storeString(Register::MANUFACTURER_INFO_REGISTER, identity.manufacturerInfo, 48);
+    storeString(Register::SERIAL_NUMBER_REGISTER, identity.serial, 16);
+    storeString(Register::USER_DEFINED_NAME_REGISTER, identity.userName, 16);
+
+    storeRegister(Register::PERSISTANT_IPADDRESS_REGISTER, identity.ip);
+    storeRegister(Register::PERSISTANT_SUBNETMASK_REGISTER, identity.subnet);
+    storeRegister(Register::PERSISTANT_DEFAULTGATEWAY_REGISTER, identity.gateway);
+
+    storeRegister(Register::NUM_NETWORK_INTERFACES_REGISTER, 1);
+    storeRegister(Register::NUM_MESSAGE_CHANNELS_REGISTER, 0);
+    storeRegister(Register::NUM_STREAM_CHANNELS_REGISTER, 1);
+    storeRegister(Register::GVCP_SUPPORTED_COMMANDS_REGISTER,
+                  Register::GVCP_SUPPORTS_WRITEMEM | Register::GVCP_SUPPORTS_CONCATENATION);
+    storeRegister(Register::HEARTBEAT_TIMEOUT_REGISTER, 3000);
+
+    reboot();
+}
+
+
+uint32_t EmulatedCamera::getCurrentIP () const
+{
+    return currentIP;
+}
+
+
+uint64_t EmulatedCamera::getMAC () const
+{
+    return identity.mac;
+}
+
+
+const std::string& EmulatedCamera::getSerialNumber () const
+{
+    return identity.serial;
+}
+
+
+void EmulatedCamera::reboot ()
+{
+    // forced configurations do not survive a restart
+    currentIP = readRegister(Register::PERSISTANT_IPADDRESS_REGISTER);
+    currentSubnet = readRegister(Register::PERSISTANT_SUBNETMASK_REGISTER);
+    currentGateway = readRegister(Register::PERSISTANT_DEFAULTGATEWAY_REGISTER);
+
+    storeRegister(Register::CURRENT_IPADDRESS_REGISTER, currentIP);
+    storeRegister(Register::CURRENT_SUBNETMASK_REGISTER, currentSubnet);
+    storeRegister(Register::CURRENT_DEFAULTGATEWAY_REGISTER, currentGateway);
+    storeRegister(Register::CONTROLCHANNEL_PRIVELEGE_REGISTER, 0);
+
+    std::fill(flashUnlocked.begin(), flashUnlocked.end(), false);
+}
+
+
+CommandResult EmulatedCamera::handleCommand (const uint8_t* data, size_t size)
+{
+    if (size < sizeof(Packet::COMMAND_HEADER))
+    {
+        return CommandResult();
+    }
+
+    auto header = (const Packet::COMMAND_HEADER*)data;
+
+    if (header->magic != 0x42)
+    {
+        return CommandResult();
+    }
+
+    uint16_t command = ntohs(header->command);
+    uint16_t req_id = ntohs(header->req_id);
+
+    CommandResult result;
+
+    switch (command)
+    {
+        case Commands::DISCOVERY_CMD:
+            result = handleDiscovery(req_id);
+            break;
+        case Commands::FORCEIP_CMD:
+            result = handleForceIP(data, size, req_id);
+            break;
+        case Commands::READREG_CMD:
+            result = handleReadReg(data, size, req_id);
+            break;
+        case Commands::WRITEREG_CMD:
+            result = handleWriteReg(data, size, req_id);
+            break;
+        case Commands::READMEM_CMD:
+            result = handleReadMem(data, size, req_id);
+            break;
+        case Commands::WRITEMEM_CMD:
+            result = handleWriteMem(data, size, req_id);
+            break;
+        default:
+            result.ack = ackHeader(Status::INVALID_HEADER, command + 1, 0, req_id);
+            result.processingTime_ms = 0;
+            result.reboot = false;
+            break;
+    }
+
+    if (!(header->flag & Flags::NEEDACK))
+    {
+        result.ack.clear();
+    }
+
+    return result;
+}
+
+
+CommandResult EmulatedCamera::handleDiscovery (uint16_t req_id)
+{
+    CommandResult result = {};
+
+    result.ack.resize(sizeof(Packet::ACK_DISCOVERY));
+
+    auto ack = (Packet::ACK_DISCOVERY*)result.ack.data();
+
+    ack->header.status = htons(Status::SUCCESS);
+    ack->header.answer = htons(Commands::DISCOVERY_ACK);
+    ack->header.length = htons(sizeof(Packet::ACK_DISCOVERY) - sizeof(Packet::ACK_HEADER));
+    ack->header.ack_id = htons(req_id);
+
+    ack->spec_version_major = htons(1);
+    ack->spec_version_minor = htons(2);
+    ack->device_mode = htonl(Register::DEVICEMODE_BIGENDIAN);
+    ack->DeviceMACHigh = htons((uint16_t)(identity.mac >> 32));
+    ack->DeviceMACLow = htonl((uint32_t)identity.mac);
+    ack->IPConfigOptions = htonl(readRegister(Register::SUPPORTED_IPCFG_REGISTER));
+    ack->IPConfigCurrent = htonl(readRegister(Register::CURRENT_IPCFG_REGISTER));
+    ack->CurrentIP = htonl(currentIP);
+    ack->CurrentSubnetMask = htonl(currentSubnet);
+    ack->DefaultGateway = htonl(currentGateway);
+
+    // read from memory so that names written by clients are reported
+    readMemory(Register::MANUFACTURER_NAME_REGISTER, (uint8_t*)ack->ManufacturerName, 32);
+    readMemory(Register::MODEL_NAME_REGISTER, (uint8_t*)ack->ModelName, 32);
+    readMemory(Register::DEVICE_VERSION_REGISTER, (uint8_t*)ack->DeviceVersion, 32);
+    readMemory(Register::MANUFACTURER_INFO_REGISTER, (uint8_t*)ack->ManufacturerSpecificInformation, 48);
+    readMemory(Register::SERIAL_NUMBER_REGISTER, (uint8_t*)ack->Serialnumber, 16);
+    readMemory(Register::USER_DEFINED_NAME_REGISTER, (uint8_t*)ack->UserDefinedName, 16);
+
+    return result;
+}
+
+
+CommandResult EmulatedCamera::handleForceIP (const uint8_t* data, size_t size, uint16_t req_id)
+{
+    CommandResult result = {};
+
+    if (size < sizeof(Packet::CMD_FORCEIP))
+    {
+        result.ack = ackHeader(Status::INVALID_HEADER, Commands::FORCEIP_ACK, 0, req_id);
+        return result;
+    }
+
+    auto cmd = (const Packet::CMD_FORCEIP*)data;
+
+    uint64_t mac = ((uint64_t)ntohs(cmd->DeviceMACHigh) << 32) | ntohl(cmd->DeviceMACLow);
+
+    if (mac != identity.mac)
+    {
+        // addressed to another device
+        return result;
+    }
+
+    // tcam-network sends the addresses in network byte order
+    uint32_t ip = ntohl(cmd->StaticIP);
+
+    if (ip == 0)
+    {
+        // restart the ip configuration cycle
+        currentIP = readRegister(Register::PERSISTANT_IPADDRESS_REGISTER);
+        currentSubnet = readRegister(Register::PERSISTANT_SUBNETMASK_REGISTER);
+        currentGateway = readRegister(Register::PERSISTANT_DEFAULTGATEWAY_REGISTER);
+    }
+    else
+    {
+        currentIP = ip;
+        currentSubnet = ntohl(cmd->StaticSubnetMask);
+        currentGateway = ntohl(cmd->StaticGateway);
+    }
+
+    storeRegister(Register::CURRENT_IPADDRESS_REGISTER, currentIP);
+    storeRegister(Register::CURRENT_SUBNETMASK_REGISTER, currentSubnet);
+    storeRegister(Register::CURRENT_DEFAULTGATEWAY_REGISTER, currentGateway);
+
+    result.ack = ackHeader(Status::SUCCESS, Commands::FORCEIP_ACK, 0, req_id);
+
+    return result;
+}
+
+
+CommandResult EmulatedCamera::handleReadReg (const uint8_t* data, size_t size, uint16_t req_id)
+{
+    CommandResult result = {};
+
+    size_t count = (size - sizeof(Packet::COMMAND_HEADER)) / sizeof(uint32_t);
+
+    if (count == 0)
+    {
+        result.ack = ackHeader(Status::INVALID_PARAMETER, Commands::READREG_ACK, 0, req_id);
+        return result;
+    }
+
+    auto cmd = (const Packet::CMD_READREG*)data;
+
+    result.ack = ackHeader(Status::SUCCESS, Commands::READREG_ACK, count * sizeof(uint32_t), req_id);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t address = ntohl(cmd->address[i]);
+
+        if (address % 4)
+        {
+            result.ack = ackHeader(Status::BAD_ALIGNMENT, Commands::READREG_ACK, 0, req_id);
+            return result;
+        }
+
+        uint32_t value = htonl(readRegister(address));
+        auto ptr = (const uint8_t*)&value;
+        result.ack.insert(result.ack.end(), ptr, ptr + sizeof(value));
+    }
+
+    return result;
+}
+
+
+CommandResult EmulatedCamera::handleWriteReg (const uint8_t* data, size_t size, uint16_t req_id)
+{
+    CommandResult result = {};
+
+    size_t count = (size - sizeof(Packet::COMMAND_HEADER)) / sizeof(Packet::CMD_WRITEREG_OP);
+
+    auto cmd = (const Packet::CMD_WRITEREG*)data;
+
+    uint16_t status = count == 0 ? Status::INVALID_PARAMETER : Status::SUCCESS;
+    size_t written = 0;
+
+    for (; written < count && status == Status::SUCCESS; ++written)
+    {
+        uint32_t address = ntohl(cmd->ops[written].address);
+        uint32_t value = cmd->ops[written].value;
+
+        if (address % 4)
+        {
+            status = Status::BAD_ALIGNMENT;
+            break;
+        }
+
+        unsigned int processing = 0;
+        status = writeMemory(address, (const uint8_t*)&value, sizeof(value), processing, result.reboot);
+        result.processingTime_ms += processing;
+    }
+
+    result.ack = ackHeader(status, Commands::WRITEREG_ACK, 4, req_id);
+
+    uint16_t index[2] = { 0, htons((uint16_t)written) };
+    auto ptr = (const uint8_t*)index;
+    result.ack.insert(result.ack.end(), ptr, ptr + sizeof(index));
+
+    return result;
+}
+
+
+CommandResult EmulatedCamera::handleReadMem (const uint8_t* data, size_t size, uint16_t req_id)
+{
+    CommandResult result = {};
+
+    if (size < sizeof(Packet::CMD_READMEM))
+    {
+        result.ack = ackHeader(Status::INVALID_HEADER, Commands::READMEM_ACK, 0, req_id);
+        return result;
+    }
+
+    auto cmd = (const Packet::CMD_READMEM*)data;
+
+    uint32_t address = ntohl(cmd->address);
+    uint16_t count = ntohs(cmd->count);
+
+    if (count % 4 || address % 4)
+    {
+        result.ack = ackHeader(Status::BAD_ALIGNMENT, Commands::READMEM_ACK, 0, req_id);
+        return result;
+    }
+
+    if (count > GVCP_MAX_MEMORY_PAYLOAD)
+    {
+        result.ack = ackHeader(Status::INVALID_PARAMETER, Commands::READMEM_ACK, 0, req_id);
+        return result;
+    }
+
+    result.ack = ackHeader(Status::SUCCESS, Commands::READMEM_ACK, 4 + count, req_id);
+
+    uint32_t addr = htonl(address);
+    auto ptr = (const uint8_t*)&addr;
+    result.ack.insert(result.ack.end(), ptr, ptr + sizeof(addr));
+
+    size_t offset = result.ack.size();
+    result.ack.resize(offset + count);
+    readMemory(address, result.ack.data() + offset, count);
+
+    return result;
+}
+
+
+CommandResult EmulatedCamera::handleWriteMem (const uint8_t* data, size_t size, uint16_t req_id)
+{
+    CommandResult result = {};
+
+    if (size < sizeof(Packet::COMMAND_HEADER) + sizeof(uint32_t))
+    {
+        result.ack = ackHeader(Status::INVALID_HEADER, Commands::WRITEMEM_ACK, 0, req_id);
+        return result;
+    }
+
+    auto cmd = (const Packet::CMD_WRITEMEM*)data;
+
+    uint32_t address = ntohl(cmd->address);
+    size_t count = size - sizeof(Packet::COMMAND_HEADER) - sizeof(uint32_t);
+
+    uint16_t status;
+
+    if (count % 4 || address % 4)
+    {
+        status = Status::BAD_ALIGNMENT;
+    }
+    else if (count == 0 || count > GVCP_MAX_MEMORY_PAYLOAD)
+    {
+        status = Status::INVALID_PARAMETER;
+    }
+    else
+    {
+        status = writeMemory(address, (const uint8_t*)cmd->data, count,
+                             result.processingTime_ms, result.reboot);
+    }
+
+    result.ack = ackHeader(status, Commands::WRITEMEM_ACK, 4, req_id);
+
+    uint16_t index[2] = { 0, htons(status == Status::SUCCESS ? (uint16_t)count : 0) };
+    auto ptr = (const uint8_t*)index;
+    result.ack.insert(result.ack.end(), ptr, ptr + sizeof(index));
+
+    return result;
+}
+
+
+uint16_t EmulatedCamera::writeMemory (uint32_t address, const uint8_t* data, size_t size,
+                                      unsigned int& processingTime_ms, bool& reboot)
+{
+    processingTime_ms = 0;
+
+    if (size == 4)
+    {
+        uint32_t value = ntohl(*(const uint32_t*)data);
+
+        if (address == REBOOT_REGISTER && (value == REBOOT_WARM || value == REBOOT_COLD))
+        {
+            reboot = true;
+            return Status::SUCCESS;
+        }
+
+        for (size_t i = 0; i < flash.size(); ++i)
+        {
+            FlashRegion& f = flash.at(i);
+
+            if (f.unlockRegister != 0 && address == f.unlockRegister)
+            {
+                flashUnlocked.at(i) = (value == f.unlockCode);
+                return Status::SUCCESS;
+            }
+
+            if (f.eraseRegister != 0 && address == f.eraseRegister)
+            {
+                if (f.unlockRegister != 0 && !flashUnlocked.at(i))
+                {
+                    return Status::ACCESS_DENIED;
+                }
+
+                uint32_t offset = value - (value % f.blockSize);
+
+                if (offset >= f.size)
+                {
+                    return Status::INVALID_ADDRESS;
+                }
+
+                // erased pages are dropped; absent flash pages read as 0xFF
+                uint32_t begin = f.base + offset;
+                uint32_t end = begin + std::min(f.blockSize, f.size - offset);
+
+                for (auto iter = memory.lower_bound(begin - (begin % PAGE_SIZE));
+                     iter != memory.end() && iter->first < end;)
+                {
+                    uint32_t page_begin = std::max(iter->first, begin);
+                    uint32_t page_end = std::min<uint32_t>(iter->first + PAGE_SIZE, end);
+
+                    if (page_begin == iter->first && page_end == iter->first + PAGE_SIZE)
+                    {
+                        iter = memory.erase(iter);
+                        continue;
+                    }
+
+                    std::fill(iter->second.begin() + (page_begin - iter->first),
+                              iter->second.begin() + (page_end - iter->first), 0xFF);
+                    ++iter;
+                }
+
+                processingTime_ms = f.eraseTime_ms;
+                return Status::SUCCESS;
+            }
+        }
+    }
+
+    FlashRegion* f = findFlash(address, size);
+
+    if (f != nullptr)
+    {
+        size_t index = f - flash.data();
+
+        if (f->unlockRegister != 0 && !flashUnlocked.at(index))
+        {
+            return Status::WRITE_PROTECT;
+        }
+
+        // programming can only clear bits
+        std::vector<uint8_t> current(size);
+        readMemory(address, current.data(), size);
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            current[i] &= data[i];
+        }
+
+        storeMemory(address, current.data(), size);
+        return Status::SUCCESS;
+    }
+
+    storeMemory(address, data, size);
+
+    return Status::SUCCESS;
+}
+
+
+FlashRegion* EmulatedCamera::findFlash (uint32_t address, size_t size)
+{
+    for (auto& f : flash)
+    {
+        if (address >= f.base && (uint64_t)address + size <= (uint64_t)f.base + f.size)
+        {
+            return &f;
+        }
+    }
+    return nullptr;
+}
+
+
+void EmulatedCamera::readMemory (uint32_t address, uint8_t* data, size_t size) const
+{
+    for (size_t i = 0; i < size;)
+    {
+        uint32_t addr = address + i;
+        uint32_t page_address = addr - (addr % PAGE_SIZE);
+        size_t offset = addr - page_address;
+        size_t chunk = std::min(size - i, PAGE_SIZE - offset);
+
+        auto iter = memory.find(page_address);
+
+        if (iter != memory.end())
+        {
+            memcpy(data + i, iter->second.data() + offset, chunk);
+        }
+        else
+        {
+            uint8_t fill = 0;
+            for (const auto& f : flash)
+            {
+                if (addr >= f.base && addr - f.base < f.size)
+                {
+                    fill = 0xFF;
+                    break;
+                }
+            }
+            memset(data + i, fill, chunk);
+        }
+
+        i += chunk;
+    }
+}
+
+
+void EmulatedCamera::storeMemory (uint32_t address, const uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size;)
+    {
+        uint32_t addr = address + i;
+        uint32_t page_address = addr - (addr % PAGE_SIZE);
+        size_t offset = addr - page_address;
+        size_t chunk = std::min(size - i, PAGE_SIZE - offset);
+
+        auto iter = memory.find(page_address);
+
+        if (iter == memory.end())
+        {
+            page p;
+            readMemory(page_address, p.data(), PAGE_SIZE);
+            iter = memory.insert({page_address, p}).first;
+        }
+
+        memcpy(iter->second.data() + offset, data + i, chunk);
+
+        i += chunk;
+    }
+}
+
+
+uint32_t EmulatedCamera::readRegister (uint32_t address) const
+{
+    uint32_t value;
+    readMemory(address, (uint8_t*)&value, sizeof(value));
+
+    return ntohl(value);
+}
+
+
+void EmulatedCamera::storeRegister (uint32_t address, uint32_t value)
+{
+    value = htonl(value);
+    storeMemory(address, (const uint8_t*)&value, sizeof(value));
+}
+
+
+void EmulatedCamera::storeString (uint32_t address, const std::string& value, size_t size)
+{
+    std::vector<uint8_t> buffer(size, 0);
+
+    // keep the terminating 0
+    memcpy(buffer.data(), value.c_str(), std::min(value.size(), size - 1));
+
+    storeMemory(address, buffer.data(), size);
+}
+
+
+std::vector<uint8_t> EmulatedCamera::ackHeader (uint16_t status, uint16_t answer,
+                                                uint16_t length, uint16_t req_id)
+{
+    std::vector<uint8_t> ret(sizeof(Packet::ACK_HEADER));
+
+    auto header = (Packet::ACK_HEADER*)ret.data();
+
+    header->status = htons(status);
+    header->answer = htons(answer);
+    header->length = htons(length);
+    header->ack_id = htons(req_id);
+
+    return ret;
+}
+
+} /* namespace tis */
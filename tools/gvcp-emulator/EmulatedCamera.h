@@ -0,0 +1,166 @@
+/*
+ * Copyright 2013 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EMULATED_CAMERA_H_
+#define _EMULATED_CAMERA_H_
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace tis
+{
+
+    /// @struct FlashRegion
+    /// @brief memory range that behaves like NOR flash
+    ///
+    /// Writes can only clear bits; a block has to be erased
+    /// by writing its offset to eraseRegister before it can be rewritten.
+    struct FlashRegion
+    {
+        uint32_t base;
+        uint32_t size;
+        uint32_t blockSize;
+
+        /// register receiving the offset of the block to erase; 0 if none
+        uint32_t eraseRegister;
+
+        /// register that has to contain unlockCode before the flash can be changed; 0 if none
+        uint32_t unlockRegister;
+        uint32_t unlockCode;
+
+        /// time a block erase keeps the device busy
+        unsigned int eraseTime_ms;
+    };
+
+
+    /// @struct CameraIdentity
+    /// @brief values reported in discovery acknowledges and bootstrap registers
+    struct CameraIdentity
+    {
+        std::string vendor;
+        std::string model;
+        std::string version;
+        std::string serial;
+        std::string userName;
+
+        /// content of the manufacturer specific information; e.g. "@Type=3@Model=XYZ@"
+        std::string manufacturerInfo;
+
+        uint64_t mac;
+
+        // host byte order
+        uint32_t ip;
+        uint32_t subnet;
+        uint32_t gateway;
+    };
+
+
+    /// @struct CommandResult
+    /// @brief answer of the emulated camera to a single command
+    struct CommandResult
+    {
+        /// acknowledge that shall be sent; empty if none
+        std::vector<uint8_t> ack;
+
+        /// time the device needs before the acknowledge can be sent
+        unsigned int processingTime_ms;
+
+        /// device restarts after the acknowledge
+        bool reboot;
+    };
+
+
+class EmulatedCamera
+{
+public:
+
+    EmulatedCamera (const CameraIdentity& identity, const std::vector<FlashRegion>& flash);
+
+    /// @name getCurrentIP
+    /// @return ip in host byte order
+    uint32_t getCurrentIP () const;
+
+    uint64_t getMAC () const;
+
+    const std::string& getSerialNumber () const;
+
+    /// @name handleCommand
+    /// @param data - GVCP command as received
+    /// @param size - size of data
+    /// @return acknowledge and timing of the command
+    CommandResult handleCommand (const uint8_t* data, size_t size);
+
+    /// @name reboot
+    /// @brief restore the state a power cycle leaves behind
+    void reboot ();
+
+private:
+
+    static const size_t PAGE_SIZE = 4096;
+
+    typedef std::array<uint8_t, PAGE_SIZE> page;
+
+    CommandResult handleDiscovery (uint16_t req_id);
+
+    CommandResult handleForceIP (const uint8_t* data, size_t size, uint16_t req_id);
+
+    CommandResult handleReadReg (const uint8_t* data, size_t size, uint16_t req_id);
+
+    CommandResult handleWriteReg (const uint8_t* data, size_t size, uint16_t req_id);
+
+    CommandResult handleReadMem (const uint8_t* data, size_t size, uint16_t req_id);
+
+    CommandResult handleWriteMem (const uint8_t* data, size_t size, uint16_t req_id);
+
+    /// @return GVCP status of the write
+    uint16_t writeMemory (uint32_t address, const uint8_t* data, size_t size,
+                          unsigned int& processingTime_ms, bool& reboot);
+
+    void readMemory (uint32_t address, uint8_t* data, size_t size) const;
+
+    void storeMemory (uint32_t address, const uint8_t* data, size_t size);
+
+    uint32_t readRegister (uint32_t address) const;
+
+    void storeRegister (uint32_t address, uint32_t value);
+
+    void storeString (uint32_t address, const std::string& value, size_t size);
+
+    FlashRegion* findFlash (uint32_t address, size_t size);
+
+    static std::vector<uint8_t> ackHeader (uint16_t status, uint16_t answer,
+                                           uint16_t length, uint16_t req_id);
+
+    CameraIdentity identity;
+
+    uint32_t currentIP;
+    uint32_t currentSubnet;
+    uint32_t currentGateway;
+
+    std::vector<FlashRegion> flash;
+    std::vector<bool> flashUnlocked;
+
+    // sparse memory; absent pages read as 0 or as erased flash
+    std::map<uint32_t, page> memory;
+
+}; /* class EmulatedCamera */
+
+} /* namespace tis */
+
+#endif /* _EMULATED_CAMERA_H_ */
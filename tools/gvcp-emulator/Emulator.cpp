@@ -0,0 +1,378 @@
+/*
+ * Copyright 2013 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Emulator.h"
+
+#include "gigevision.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace tis
+{
+
+// upper limit for a single poll; reboots and stop requests are checked this often
+static const int MAX_POLL_MS = 100;
+
+
+Emulator::Emulator (const EmulatorOptions& _options,
+                    std::vector<std::unique_ptr<EmulatedCamera>> cameras)
+    : options(_options), fd(-1), running(false), sendBlocked(false), rng(std::random_device()()),
+      sequence(0), statistics()
+{
+    for (auto& cam : cameras)
+    {
+        Device dev;
+        dev.camera = std::move(cam);
+        dev.rebooting = false;
+
+        devices.push_back(std::move(dev));
+    }
+}
+
+
+Emulator::~Emulator ()
+{
+    if (fd != -1)
+    {
+        close(fd);
+    }
+}
+
+
+void Emulator::run ()
+{
+    openSocket();
+
+    running = true;
+
+    while (running)
+    {
+        pollfd p = { fd, (short)(POLLIN | (sendBlocked ? POLLOUT : 0)), 0 };
+
+        int ret = poll(&p, 1, timeout());
+
+        if (ret < 0 && errno != EINTR)
+        {
+            throw std::runtime_error(std::string("poll failed: ") + strerror(errno));
+        }
+
+        if (ret > 0 && (p.revents & POLLIN))
+        {
+            receive();
+        }
+
+        if (ret > 0 && (p.revents & POLLOUT))
+        {
+            sendBlocked = false;
+        }
+
+        finishReboots();
+        sendDue();
+    }
+}
+
+
+void Emulator::stop ()
+{
+    running = false;
+}
+
+
+EmulatorStatistics Emulator::getStatistics () const
+{
+    return statistics;
+}
+
+
+void Emulator::openSocket ()
+{
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd == -1)
+    {
+        throw std::runtime_error(std::string("Unable to create socket: ") + strerror(errno));
+    }
+
+    int on = 1;
+
+    // IP_PKTINFO tells which camera a unicast command was sent to
+    // and allows answering with the address of that camera
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0
+        || setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on)) != 0
+        || setsockopt(fd, IPPROTO_IP, IP_PKTINFO, &on, sizeof(on)) != 0)
+    {
+        throw std::runtime_error(std::string("Unable to configure socket: ") + strerror(errno));
+    }
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options.port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        throw std::runtime_error("Unable to bind port " + std::to_string(options.port)
+                                 + ": " + strerror(errno));
+    }
+}
+
+
+void Emulator::receive ()
+{
+    uint8_t buffer[1500];
+    char control[CMSG_SPACE(sizeof(in_pktinfo))];
+
+    while (true)
+    {
+        sockaddr_in peer = {};
+        iovec iov = { buffer, sizeof(buffer) };
+
+        msghdr msg = {};
+        msg.msg_name = &peer;
+        msg.msg_namelen = sizeof(peer);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t size = recvmsg(fd, &msg, 0);
+
+        if (size < 0)
+        {
+            // EAGAIN; everything has been read
+            return;
+        }
+
+        statistics.received++;
+
+        in_addr destination = {};
+        for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c != nullptr; c = CMSG_NXTHDR(&msg, c))
+        {
+            if (c->cmsg_level == IPPROTO_IP && c->cmsg_type == IP_PKTINFO)
+            {
+                destination = ((in_pktinfo*)CMSG_DATA(c))->ipi_addr;
+            }
+        }
+
+        uint32_t dest = ntohl(destination.s_addr);
+        bool delivered = false;
+
+        // unicast commands are routed by the current ip of the camera
+        for (auto& dev : devices)
+        {
+            if (dev.camera->getCurrentIP() == dest && !dev.rebooting)
+            {
+                handleCommand(dev, buffer, size, peer, false);
+                delivered = true;
+            }
+        }
+
+        if (delivered)
+        {
+            continue;
+        }
+
+        // everything else is treated as broadcast;
+        // FORCEIP is filtered by mac inside the camera
+        for (auto& dev : devices)
+        {
+            if (!dev.rebooting)
+            {
+                handleCommand(dev, buffer, size, peer, true);
+                delivered = true;
+            }
+        }
+
+        if (!delivered)
+        {
+            statistics.unknownDestination++;
+        }
+    }
+}
+
+
+void Emulator::handleCommand (Device& dev, const uint8_t* data, size_t size,
+                              const sockaddr_in& peer, bool broadcast)
+{
+    if (size >= sizeof(Packet::COMMAND_HEADER) && broadcast)
+    {
+        uint16_t command = ntohs(((const Packet::COMMAND_HEADER*)data)->command);
+
+        // real devices ignore broadcast commands except these two
+        if (command != Commands::DISCOVERY_CMD && command != Commands::FORCEIP_CMD)
+        {
+            return;
+        }
+    }
+
+    if (drop())
+    {
+        statistics.droppedCommands++;
+        return;
+    }
+
+    CommandResult result = dev.camera->handleCommand(data, size);
+
+    auto now = clock::now();
+
+    // commands are processed one after another
+    dev.busyUntil = std::max(dev.busyUntil, now)
+        + std::chrono::milliseconds(result.processingTime_ms);
+
+    std::uniform_int_distribution<unsigned int> jitter(0, options.jitter_ms);
+
+    auto due = std::max(now + std::chrono::milliseconds(options.latency_ms + jitter(rng)),
+                        dev.busyUntil);
+
+    if (!result.ack.empty())
+    {
+        PendingAck ack;
+        ack.due = due;
+        ack.sequence = sequence++;
+        ack.data = std::move(result.ack);
+        ack.destination = peer;
+
+        ack.source = {};
+        ack.source.sin_family = AF_INET;
+        ack.source.sin_port = htons(options.port);
+        ack.source.sin_addr.s_addr = htonl(dev.camera->getCurrentIP());
+
+        pending.push(std::move(ack));
+    }
+
+    if (result.reboot)
+    {
+        dev.rebooting = true;
+        dev.offlineUntil = due + std::chrono::milliseconds(options.rebootTime_ms);
+    }
+}
+
+
+void Emulator::finishReboots ()
+{
+    auto now = clock::now();
+
+    for (auto& dev : devices)
+    {
+        if (dev.rebooting && dev.offlineUntil <= now)
+        {
+            dev.camera->reboot();
+            dev.rebooting = false;
+            dev.busyUntil = now;
+        }
+    }
+}
+
+
+void Emulator::sendDue ()
+{
+    if (sendBlocked)
+    {
+        return;
+    }
+
+    auto now = clock::now();
+
+    while (!pending.empty() && pending.top().due <= now)
+    {
+        const PendingAck& ack = pending.top();
+
+        if (drop())
+        {
+            statistics.droppedAcks++;
+            pending.pop();
+            continue;
+        }
+
+        char control[CMSG_SPACE(sizeof(in_pktinfo))] = {};
+        iovec iov = { (void*)ack.data.data(), ack.data.size() };
+
+        msghdr msg = {};
+        msg.msg_name = (void*)&ack.destination;
+        msg.msg_namelen = sizeof(ack.destination);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        // answer with the address of the camera
+        cmsghdr* c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = IPPROTO_IP;
+        c->cmsg_type = IP_PKTINFO;
+        c->cmsg_len = CMSG_LEN(sizeof(in_pktinfo));
+        ((in_pktinfo*)CMSG_DATA(c))->ipi_spec_dst = ack.source.sin_addr;
+
+        ssize_t ret = sendmsg(fd, &msg, 0);
+
+        if (ret < 0 && errno == EINVAL)
+        {
+            // the camera address is not configured on this host;
+            // let the kernel choose so that discovery still works
+            msg.msg_control = nullptr;
+            msg.msg_controllen = 0;
+
+            ret = sendmsg(fd, &msg, 0);
+        }
+
+        if (ret < 0 && (errno == EAGAIN || errno == ENOBUFS))
+        {
+            // hundreds of discovery acknowledges fill the send buffer;
+            // continue once poll reports the socket as writable
+            sendBlocked = true;
+            return;
+        }
+
+        statistics.answered++;
+        pending.pop();
+    }
+}
+
+
+bool Emulator::drop ()
+{
+    if (options.loss <= 0.0)
+    {
+        return false;
+    }
+
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+    return dist(rng) < options.loss;
+}
+
+
+int Emulator::timeout () const
+{
+    if (pending.empty() || sendBlocked)
+    {
+        return MAX_POLL_MS;
+    }
+
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(pending.top().due - clock::now());
+
+    return std::max(0, std::min<int>(wait.count(), MAX_POLL_MS));
+}
+
+} /* namespace tis */
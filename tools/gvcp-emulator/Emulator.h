@@ -0,0 +1,168 @@
+/*
+ * Copyright 2013 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EMULATOR_H_
+#define _EMULATOR_H_
+
+#include "EmulatedCamera.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include <netinet/in.h>
+
+namespace tis
+{
+
+    /// @struct EmulatorOptions
+    /// @brief network conditions the emulated cameras experience
+    struct EmulatorOptions
+    {
+        /// delay of every acknowledge
+        unsigned int latency_ms;
+
+        /// random additional delay of every acknowledge
+        unsigned int jitter_ms;
+
+        /// probability that a command or acknowledge is dropped; 0.0 - 1.0
+        double loss;
+
+        /// time a camera does not answer after a reboot command
+        unsigned int rebootTime_ms;
+
+        /// port the emulator listens on
+        unsigned short port;
+
+        EmulatorOptions ()
+            : latency_ms(0), jitter_ms(0), loss(0.0), rebootTime_ms(5000), port(3956)
+        {}
+    };
+
+
+    /// @struct EmulatorStatistics
+    struct EmulatorStatistics
+    {
+        uint64_t received;
+        uint64_t answered;
+        uint64_t droppedCommands;
+        uint64_t droppedAcks;
+        uint64_t unknownDestination;
+    };
+
+
+class Emulator
+{
+public:
+
+    Emulator (const EmulatorOptions& options,
+              std::vector<std::unique_ptr<EmulatedCamera>> cameras);
+
+    ~Emulator ();
+
+    Emulator (const Emulator&) = delete;
+    Emulator& operator= (const Emulator&) = delete;
+
+    /// @name run
+    /// @brief serve commands until stop is called
+    /// @throw std::runtime_error when the socket can not be created
+    void run ();
+
+    /// @name stop
+    /// @brief end run; may be called from a signal handler
+    void stop ();
+
+    EmulatorStatistics getStatistics () const;
+
+private:
+
+    typedef std::chrono::steady_clock clock;
+
+    struct PendingAck
+    {
+        clock::time_point due;
+        uint64_t sequence;
+
+        std::vector<uint8_t> data;
+        sockaddr_in source;
+        sockaddr_in destination;
+    };
+
+    struct LaterAck
+    {
+        bool operator() (const PendingAck& a, const PendingAck& b) const
+        {
+            if (a.due != b.due)
+            {
+                return a.due > b.due;
+            }
+            return a.sequence > b.sequence;
+        }
+    };
+
+    /// per camera state that is not visible on the wire
+    struct Device
+    {
+        std::unique_ptr<EmulatedCamera> camera;
+
+        /// commands are answered in order; a busy device delays later acks
+        clock::time_point busyUntil;
+
+        /// rebooting devices do not answer at all
+        clock::time_point offlineUntil;
+        bool rebooting;
+    };
+
+    void openSocket ();
+
+    void receive ();
+
+    void sendDue ();
+
+    void handleCommand (Device& dev, const uint8_t* data, size_t size,
+                        const sockaddr_in& peer, bool broadcast);
+
+    void finishReboots ();
+
+    bool drop ();
+
+    int timeout () const;
+
+    EmulatorOptions options;
+
+    std::vector<Device> devices;
+
+    int fd;
+    std::atomic<bool> running;
+
+    /// send buffer is full; acknowledges wait for POLLOUT
+    bool sendBlocked;
+
+    std::mt19937 rng;
+
+    uint64_t sequence;
+    std::priority_queue<PendingAck, std::vector<PendingAck>, LaterAck> pending;
+
+    EmulatorStatistics statistics;
+
+}; /* class Emulator */
+
+} /* namespace tis */
+
+#endif /* _EMULATOR_H_ */
@@ -0,0 +1,271 @@
+/*
+ * Copyright 2013 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Emulator.h"
+#include "utils.h"
+
+#include <csignal>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+
+using namespace tis;
+
+
+// OUI of The Imaging Source
+static const uint64_t MAC_PREFIX = 0x000748000000ULL;
+
+static Emulator* emulator = nullptr;
+
+
+/// @name printHelp
+/// @brief prints complete overview over possible actions
+void printHelp ()
+{
+    std::cout << "\ngvcp-emulator - emulates GigE Vision cameras for discovery, ip configuration and firmware tests"
+              << "\n\nusage: gvcp-emulator [parameter]...\n\n"
+
+              << "Available parameter:\n"
+              << "    count=N                  - number of emulated cameras; default 1\n"
+              << "    ip=X.X.X.X               - ip of the first camera; the others use consecutive addresses\n"
+              << "    subnet=X.X.X.X           - subnetmask of all cameras; default 255.255.255.0\n"
+              << "    gateway=X.X.X.X          - gateway of all cameras; default 0.0.0.0\n"
+              << "    vendor=\"xyz\"             - manufacturer name; default \"The Imaging Source Europe GmbH\"\n"
+              << "    model=\"xyz\"              - model name; default \"DFK 33GP1300\"\n"
+              << "    version=\"xyz\"            - device version\n"
+              << "    type=N                   - device type reported in the manufacturer information; default 3\n"
+              << "    serial=N                 - serial number of the first camera; default 10000000\n"
+              << "    latency=ms               - delay of every acknowledge\n"
+              << "    jitter=ms                - random additional delay of every acknowledge\n"
+              << "    loss=0.N                 - probability that a command or acknowledge is lost\n"
+              << "    reboot-time=ms           - time a camera is offline after a reboot command; default 5000\n"
+              << "    flash=BASE:SIZE:BLOCK[:ERASE[:UNLOCK:CODE]]\n"
+              << "                             - emulate NOR flash; may be given several times\n"
+              << "    erase-time=ms            - time a block erase keeps the camera busy; default 50\n"
+              << "    port=N                   - port to listen on; default 3956\n"
+              << std::endl;
+
+    std::cout << "Examples:\n\n"
+
+              << "    gvcp-emulator count=200 ip=10.10.0.10 subnet=255.255.0.0 loss=0.01 latency=2\n"
+              << "    gvcp-emulator ip=10.10.0.10 flash=0x100000:0x100000:0x1000:0xEF000010\n\n"
+              << std::endl;
+}
+
+
+static uint32_t parseIP (const std::string& value)
+{
+    int ip = ip2int(value);
+
+    if (ip == -1 && value != "255.255.255.255")
+    {
+        throw std::invalid_argument("Invalid address \"" + value + "\"");
+    }
+
+    return ntohl(ip);
+}
+
+
+static FlashRegion parseFlash (const std::string& value, unsigned int eraseTime)
+{
+    std::vector<uint32_t> fields;
+    std::stringstream ss(value);
+    std::string field;
+
+    while (std::getline(ss, field, ':'))
+    {
+        fields.push_back(std::stoul(field, nullptr, 0));
+    }
+
+    if (fields.size() < 3 || fields.size() == 5 || fields.size() > 6)
+    {
+        throw std::invalid_argument("Invalid flash description \"" + value + "\"");
+    }
+
+    FlashRegion f = {};
+    f.base = fields.at(0);
+    f.size = fields.at(1);
+    f.blockSize = fields.at(2);
+    f.eraseTime_ms = eraseTime;
+
+    if (f.blockSize == 0)
+    {
+        throw std::invalid_argument("Flash block size may not be 0");
+    }
+
+    if (fields.size() > 3)
+    {
+        f.eraseRegister = fields.at(3);
+    }
+
+    if (fields.size() > 4)
+    {
+        f.unlockRegister = fields.at(4);
+        f.unlockCode = fields.at(5);
+    }
+
+    return f;
+}
+
+
+static void stopEmulator (int)
+{
+    if (emulator != nullptr)
+    {
+        emulator->stop();
+    }
+}
+
+
+int main (int argc, char* argv[])
+{
+    std::vector<std::string> args(argv+1, argv + argc);
+
+    unsigned int count = 1;
+    uint32_t ip = parseIP("192.168.0.100");
+    uint32_t subnet = parseIP("255.255.255.0");
+    uint32_t gateway = 0;
+    std::string vendor = "The Imaging Source Europe GmbH";
+    std::string model = "DFK 33GP1300";
+    std::string version = "emulated";
+    unsigned int type = 3;
+    unsigned long serial = 10000000;
+    unsigned int eraseTime = 50;
+    std::vector<std::string> flashArgs;
+
+    EmulatorOptions options;
+
+    try
+    {
+        for (const auto& arg : args)
+        {
+            if (arg == "help" || arg == "-h")
+            {
+                printHelp();
+                return 0;
+            }
+
+            auto pos = arg.find('=');
+
+            if (pos == std::string::npos)
+            {
+                std::cout << "Unknown parameter \"" << arg << "\"\n" << std::endl;
+                return 1;
+            }
+
+            std::string key = arg.substr(0, pos);
+            std::string value = arg.substr(pos + 1);
+
+            if (key == "count")
+                count = std::stoul(value);
+            else if (key == "ip")
+                ip = parseIP(value);
+            else if (key == "subnet")
+                subnet = parseIP(value);
+            else if (key == "gateway")
+                gateway = parseIP(value);
+            else if (key == "vendor")
+                vendor = value;
+            else if (key == "model")
+                model = value;
+            else if (key == "version")
+                version = value;
+            else if (key == "type")
+                type = std::stoul(value);
+            else if (key == "serial")
+                serial = std::stoul(value);
+            else if (key == "latency")
+                options.latency_ms = std::stoul(value);
+            else if (key == "jitter")
+                options.jitter_ms = std::stoul(value);
+            else if (key == "loss")
+                options.loss = std::stod(value);
+            else if (key == "reboot-time")
+                options.rebootTime_ms = std::stoul(value);
+            else if (key == "erase-time")
+                eraseTime = std::stoul(value);
+            else if (key == "port")
+                options.port = std::stoul(value);
+            else if (key == "flash")
+                flashArgs.push_back(value);
+            else
+            {
+                std::cout << "Unknown parameter \"" << arg << "\"\n" << std::endl;
+                return 1;
+            }
+        }
+
+        // erase-time may follow the flash description
+        std::vector<FlashRegion> flash;
+        for (const auto& f : flashArgs)
+        {
+            flash.push_back(parseFlash(f, eraseTime));
+        }
+
+        std::vector<std::unique_ptr<EmulatedCamera>> cameras;
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            CameraIdentity identity;
+            identity.vendor = vendor;
+            identity.model = model;
+            identity.version = version;
+            identity.serial = std::to_string(serial + i);
+            identity.manufacturerInfo = "@Type=" + std::to_string(type) + "@Model=" + model + "@";
+            identity.mac = MAC_PREFIX + i + 1;
+            identity.ip = ip + i;
+            identity.subnet = subnet;
+            identity.gateway = gateway;
+
+            cameras.push_back(std::unique_ptr<EmulatedCamera>(new EmulatedCamera(identity, flash)));
+        }
+
+        Emulator emu(options, std::move(cameras));
+        emulator = &emu;
+
+        signal(SIGINT, stopEmulator);
+        signal(SIGTERM, stopEmulator);
+
+        std::cout << "Emulating " << count << " camera(s) from "
+                  << int2ip(ip) << " to " << int2ip(ip + count - 1)
+                  << " on port " << options.port << std::endl;
+
+        emu.run();
+
+        emulator = nullptr;
+
+        auto stats = emu.getStatistics();
+
+        std::cout << "\nreceived:            " << stats.received
+                  << "\nanswered:            " << stats.answered
+                  << "\ndropped commands:    " << stats.droppedCommands
+                  << "\ndropped acknowledges: " << stats.droppedAcks
+                  << "\nunknown destination: " << stats.unknownDestination
+                  << std::endl;
+    }
+    catch (std::exception& exc)
+    {
+        std::cout << "\n" << exc.what()
+                  << "\n" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
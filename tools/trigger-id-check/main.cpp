@@ -0,0 +1,118 @@
+/*
+ * Copyright 2014 The Imaging Source Europe GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TriggerIdTracker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace tcam;
+
+
+struct scenario
+{
+    const char* name;
+    uint64_t triggers;
+    std::vector<uint64_t> failed; // triggers that did not reach the device
+    std::vector<uint64_t> lost;   // triggers whose frame the device dropped
+};
+
+
+static bool contains (const std::vector<uint64_t>& ids, uint64_t id)
+{
+    return std::find(ids.begin(), ids.end(), id) != ids.end();
+}
+
+
+/// @brief Feeds the frames of a simulated device to a tracker the way CaptureGroup does
+/// @return number of frames with a wrong trigger id
+static unsigned int run (const scenario& sc)
+{
+    TriggerIdTracker tracker;
+    uint64_t frame_count = 0;
+    uint64_t last_frame_count = 0;
+    unsigned int errors = 0;
+
+    for (uint64_t t = 1; t <= sc.triggers; ++t)
+    {
+        if (contains(sc.failed, t))
+        {
+            // CaptureGroup::trigger announces the failure before it returns
+            tracker.skip(t);
+            continue;
+        }
+
+        // the device counts every exposed frame, delivered or not
+        ++frame_count;
+
+        if (contains(sc.lost, t))
+        {
+            continue;
+        }
+
+        uint64_t lost = 0;
+        if (last_frame_count != 0 && frame_count > last_frame_count)
+        {
+            lost = frame_count - last_frame_count - 1;
+        }
+        last_frame_count = frame_count;
+
+        uint64_t id = tracker.expected(lost);
+        tracker.confirm(id);
+
+        if (id != t)
+        {
+            printf("    frame of trigger %lu was assigned to trigger %lu\n",
+                   (unsigned long)t, (unsigned long)id);
+            ++errors;
+        }
+    }
+
+    return errors;
+}
+
+
+int main ()
+{
+    const std::vector<scenario> scenarios =
+        {
+            {"no failures", 10, {}, {}},
+            {"single failed trigger", 10, {3}, {}},
+            {"failed first trigger", 10, {1}, {}},
+            {"consecutive failed triggers", 10, {4, 5, 6}, {}},
+            {"lost frame", 10, {}, {5}},
+            {"failed trigger before lost frame", 10, {3}, {4}},
+            {"lost frame before failed trigger", 10, {5}, {4}},
+            {"failed and lost interleaved", 20, {2, 7, 8, 15}, {3, 9, 16}},
+        };
+
+    int ret = 0;
+
+    for (const auto& sc : scenarios)
+    {
+        unsigned int errors = run(sc);
+
+        printf("%-36s %s\n", sc.name, errors == 0 ? "ok" : "FAILED");
+
+        if (errors != 0)
+        {
+            ret = 1;
+        }
+    }
+
+    return ret;
+}